@@ -49,6 +49,9 @@ CMD_DBG_GET_ACC_32_SAMPLES		= 0x8008
 CMD_DBG_FLASH_AUX_MCU			= 0x8009
 CMD_DBG_GET_PLAT_INFO			= 0x800A
 CMD_DBG_REINDEX_BUNDLE			= 0x800B
+CMD_DBG_GET_AUX_MSG_TRACE		= 0x8012
+CMD_DBG_GET_HID_LATENCY			= 0x8013
+CMD_DBG_GET_WAIT_STATS			= 0x8014
 
 # OLD Command IDs
 CMD_EXPORT_FLASH_START  = 0x8A
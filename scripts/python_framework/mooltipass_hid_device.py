@@ -259,6 +259,38 @@ class mooltipass_hid_device:
 		print("Main MCU minor:", struct.unpack('H', packet["data"][66:68])[0])
 
 		
+	# Dump the inter MCU messages trace, in the format the emulator --aux-trace option expects
+	def dumpAuxMsgTrace(self, filename):
+		# Ask for the oldest available entries
+		packet = self.device.sendHidMessageWaitForAck(self.getPacketForCommand(CMD_DBG_GET_AUX_MSG_TRACE, array('B', struct.pack('I', 0))))
+		nb_traced_msgs, first_entry_id, current_systick, nb_entries = struct.unpack('IIIH', packet["data"][0:14])
+		
+		# Each entry: systick, message type, payload length, direction, reserved, payload start
+		f = open(filename, 'wb')
+		for i in range(0, nb_entries):
+			entry = packet["data"][16+i*16:32+i*16]
+			systick, message_type, payload_length, direction = struct.unpack('IHHB', entry[0:9])
+			print(str(systick - current_systick) + "ms: " + ("sent" if direction == 0 else "received") + " type " + hex(message_type) + ", length " + str(payload_length) + ", payload " + " ".join(hex(x) for x in entry[10:16]))
+			f.write(entry)
+		f.close()
+		print(str(nb_entries) + " of " + str(nb_traced_msgs) + " traced messages written to " + filename)
+		
+	# Get HID messages latency statistics since last call, for USB and BLE
+	def getHidLatency(self):
+		packet = self.device.sendHidMessageWaitForAck(self.getPacketForCommand(CMD_DBG_GET_HID_LATENCY, None))
+		for i, interface in enumerate(["USB", "BLE"]):
+			nb_messages, total_processing_ms, max_processing_ms, max_pickup_delay_ms = struct.unpack('IIHH', packet["data"][i*12:i*12+12])
+			average_processing_ms = float(total_processing_ms) / nb_messages if nb_messages != 0 else 0
+			print(interface + ": " + str(nb_messages) + " messages, processing avg " + "{:.1f}".format(average_processing_ms) + "ms max " + str(max_processing_ms) + "ms, max pickup delay " + str(max_pickup_delay_ms) + "ms")
+		
+	# Get time spent in event waits, asleep or not, since last call for each power source
+	def getWaitStats(self):
+		packet = self.device.sendHidMessageWaitForAck(self.getPacketForCommand(CMD_DBG_GET_WAIT_STATS, None))
+		for i, power_source in enumerate(["USB powered", "Battery powered", "Transitioning to battery"]):
+			nb_waits, total_wait_us, asleep_us = struct.unpack('III', packet["data"][i*12:i*12+12])
+			asleep_pct = 100.0 * asleep_us / total_wait_us if total_wait_us != 0 else 0
+			print(power_source + ": " + str(nb_waits) + " waits, " + str(total_wait_us) + "us waiting, " + str(asleep_us) + "us asleep (" + "{:.1f}".format(asleep_pct) + "%), " + str(total_wait_us - asleep_us) + "us spinning")
+		
 	# Get accelerometer data
 	def getAccData(self):
 		# Random bytes file
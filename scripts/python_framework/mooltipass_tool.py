@@ -72,6 +72,19 @@ def main():
 		elif sys.argv[1] == "platInfo":
 			mooltipass_device.getPlatInfo()
 			
+		elif sys.argv[1] == "auxMsgTrace":
+			# mooltipass_tool.py auxMsgTrace filename
+			if len(sys.argv) > 2:
+				mooltipass_device.dumpAuxMsgTrace(sys.argv[2])
+			else:
+				print("Please specify trace filename")
+			
+		elif sys.argv[1] == "hidLatency":
+			mooltipass_device.getHidLatency()
+			
+		elif sys.argv[1] == "waitStats":
+			mooltipass_device.getWaitStats()
+			
 		elif sys.argv[1] == "accGet":
 			mooltipass_device.getAccData()
 			
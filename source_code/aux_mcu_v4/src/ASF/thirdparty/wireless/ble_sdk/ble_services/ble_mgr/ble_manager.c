@@ -40,6 +40,7 @@
 #include "at_ble_trace.h"
 #include "driver_timer.h"
 #include "logic_bluetooth.h"
+#include "logic_keyboard.h"
 #include "ble_manager.h"
 #include "ble_utils.h"
 #include "logic_rng.h"
@@ -1061,6 +1062,7 @@ at_ble_status_t ble_connected_state_handler(void *params)
                 ble_device_info.bond_info.auth = recalled_bonding_info.auth_type;
                 ble_device_info.conn_info.peer_addr.type = recalled_bonding_info.address_resolv_type;
                 memcpy(ble_device_info.conn_info.peer_addr.addr, recalled_bonding_info.mac_address, sizeof(recalled_bonding_info.mac_address));
+                logic_keyboard_set_ble_host(recalled_bonding_info.mac_address, recalled_bonding_info.tuned_typing_delay);
                 
                 /* Peer LTK */
                 memcpy(ble_device_info.bond_info.peer_ltk.key, recalled_bonding_info.peer_ltk_key, sizeof(recalled_bonding_info.peer_ltk_key));
@@ -1182,6 +1184,7 @@ at_ble_status_t ble_resolv_rand_addr_handler(void *params)
             ble_device_info.bond_info.auth = recalled_bonding_info.auth_type;
             ble_device_info.conn_info.peer_addr.type = recalled_bonding_info.address_resolv_type;
             memcpy(ble_device_info.conn_info.peer_addr.addr, recalled_bonding_info.mac_address, sizeof(recalled_bonding_info.mac_address));
+            logic_keyboard_set_ble_host(recalled_bonding_info.mac_address, recalled_bonding_info.tuned_typing_delay);
                 
             /* Peer LTK */
             memcpy(ble_device_info.bond_info.peer_ltk.key, recalled_bonding_info.peer_ltk_key, sizeof(recalled_bonding_info.peer_ltk_key));
@@ -11,6 +11,16 @@
 // AUX MCU Message payload length
 #define AUX_MCU_MSG_PAYLOAD_LENGTH  552
 
+// Variable length framing: message type + payload length #1 header, trailing CRC16
+#define AUX_MCU_MSG_HEADER_LENGTH   4
+#define AUX_MCU_MSG_CRC_LENGTH      2
+
+// Longest payload sent in a variable length frame (CRC stored after it), longer ones are sent in fixed size frames
+#define AUX_MCU_MSG_VAR_FRAME_MAX_PAYLOAD_LENGTH    (AUX_MCU_MSG_PAYLOAD_LENGTH - AUX_MCU_MSG_CRC_LENGTH)
+
+// Payload length of framing reset requests: oversized so that both framings receive a fixed size frame
+#define AUX_MCU_MSG_FRAMING_RESET_PAYLOAD_LENGTH    0xFFFF
+
 // HID payload size
 #define HID_PAYLOAD_SIZE            64
 
@@ -36,6 +36,13 @@ volatile aux_mcu_message_t comms_main_mcu_temp_message;
 volatile BOOL comms_main_mcu_usb_msg_answered_using_first_bytes = FALSE;
 volatile BOOL comms_main_mcu_ble_msg_answered_using_first_bytes = FALSE;
 volatile BOOL comms_main_mcu_other_msg_answered_using_first_bytes = FALSE;
+/* Number of non USB & non BLE messages dealt with since our last buffer credits event, and since framing was set */
+uint16_t comms_main_mcu_nb_other_msg_credits_to_return = 0;
+uint8_t comms_main_mcu_nb_other_msgs_released = 0;
+/* Buffer credits event, small as only sent using variable length frames */
+aux_mcu_credits_event_frame_t comms_main_mcu_credits_event_frame;
+/* CRC16-CCITT nibble lookup table, for variable length frames */
+const uint16_t comms_main_mcu_crc_nibble_table[16] = {0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7, 0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF};
 
 /*! \fn     comms_main_init_rx(void)
 *   \brief  Init communications with aux MCU
@@ -45,6 +52,128 @@ void comms_main_init_rx(void)
     dma_main_mcu_init_rx_transfer();
 }
 
+/*! \fn     comms_main_mcu_compute_crc(volatile uint8_t* frame_pt, uint16_t nb_bytes)
+*   \brief  Compute the CRC16-CCITT of the first bytes of a frame
+*   \param  frame_pt    Pointer to the frame
+*   \param  nb_bytes    Number of bytes
+*   \return The CRC
+*/
+static uint16_t comms_main_mcu_compute_crc(volatile uint8_t* frame_pt, uint16_t nb_bytes)
+{
+    uint16_t crc = 0xFFFF;
+    
+    for (uint16_t i = 0; i < nb_bytes; i++)
+    {
+        crc = (crc << 4) ^ comms_main_mcu_crc_nibble_table[(crc >> 12) ^ (frame_pt[i] >> 4)];
+        crc = (crc << 4) ^ comms_main_mcu_crc_nibble_table[(crc >> 12) ^ (frame_pt[i] & 0x0F)];
+    }
+    return crc;
+}
+
+/*! \fn     comms_main_mcu_compute_frame_crc(volatile aux_mcu_message_t* message)
+*   \brief  Compute the CRC16-CCITT of a variable length frame (header and payload)
+*   \param  message Pointer to the message
+*   \return The CRC
+*/
+uint16_t comms_main_mcu_compute_frame_crc(volatile aux_mcu_message_t* message)
+{
+    _Static_assert(AUX_MCU_MSG_HEADER_LENGTH == offsetof(aux_mcu_message_t, payload), "Incorrect variable length frame header length");
+    return comms_main_mcu_compute_crc((volatile uint8_t*)message, AUX_MCU_MSG_HEADER_LENGTH + message->payload_length1);
+}
+
+/*! \fn     comms_main_mcu_check_received_frame(volatile aux_mcu_message_t* message)
+*   \brief  Check the CRC of a variable length frame received from the main MCU
+*   \param  message Pointer to the received message
+*   \return RETURN_OK if the CRC matches or if the frame has a fixed size
+*   \note   The CRC bytes are then cleared, as the DMA interrupt already cleared the bytes following them
+*/
+static ret_type_te comms_main_mcu_check_received_frame(volatile aux_mcu_message_t* message)
+{
+    uint16_t payload_length = message->payload_length1;
+    
+    /* Fixed size frames do not have a CRC */
+    if ((dma_main_mcu_is_variable_length_framing_enabled() == FALSE) || (payload_length > AUX_MCU_MSG_VAR_FRAME_MAX_PAYLOAD_LENGTH))
+    {
+        return RETURN_OK;
+    }
+    
+    /* Compare CRCs, then clear the CRC bytes */
+    volatile uint8_t* crc_pt = &message->payload[payload_length];
+    uint16_t received_crc = crc_pt[0] | (crc_pt[1] << 8);
+    uint16_t computed_crc = comms_main_mcu_compute_frame_crc(message);
+    crc_pt[0] = 0;
+    crc_pt[1] = 0;
+    
+    if (received_crc == computed_crc)
+    {
+        return RETURN_OK;
+    }
+    else
+    {
+        return RETURN_NOK;
+    }
+}
+
+/*! \fn     comms_main_mcu_return_other_msg_credits_if_needed(void)
+*   \brief  Send our buffer credits state to the main MCU once enough non USB & non BLE messages were dealt with, once our queue is empty or when asked to
+*   \note   Credits are only used with variable length frames. The event contains our total numbers of released and dropped messages, so a lost event doesn't lose credits
+*   \note   It also contains the last request ID and our USB & BLE buffers state, which the main MCU uses to pace multi-packet answers
+*/
+static void comms_main_mcu_return_other_msg_credits_if_needed(void)
+{
+    aux_mcu_credits_event_frame_t* credits_event_pt = &comms_main_mcu_credits_event_frame;
+    
+    /* Same layout as an aux_mcu_message_t event */
+    _Static_assert(offsetof(aux_mcu_credits_event_frame_t, event_id) == offsetof(aux_mcu_message_t, aux_mcu_event_message.event_id), "Incorrect credits event layout");
+    _Static_assert(offsetof(aux_mcu_credits_event_frame_t, nb_other_msgs_released) == offsetof(aux_mcu_message_t, aux_mcu_event_message.payload), "Incorrect credits event layout");
+    
+    if (dma_main_mcu_is_variable_length_framing_enabled() == FALSE)
+    {
+        return;
+    }
+    if ((dma_main_mcu_credits_requested == FALSE) && (comms_main_mcu_nb_other_msg_credits_to_return < DMA_MAIN_MCU_CREDITS_RETURN_THRES) && ((comms_main_mcu_nb_other_msg_credits_to_return == 0) || (dma_main_mcu_nb_other_msgs_queued != 0)))
+    {
+        return;
+    }
+    
+    /* Do not touch a message being sent */
+    dma_wait_for_main_mcu_packet_sent();
+    dma_main_mcu_credits_requested = FALSE;
+    credits_event_pt->message_type = AUX_MCU_MSG_TYPE_AUX_MCU_EVENT;
+    credits_event_pt->payload_length1 = offsetof(aux_mcu_credits_event_frame_t, crc) - AUX_MCU_MSG_HEADER_LENGTH;
+    credits_event_pt->event_id = AUX_MCU_EVENT_MSG_CREDITS;
+    credits_event_pt->nb_other_msgs_released = comms_main_mcu_nb_other_msgs_released;
+    credits_event_pt->nb_other_msgs_dropped = dma_main_mcu_nb_other_msgs_dropped;
+    credits_event_pt->request_id = dma_main_mcu_credits_request_id;
+    credits_event_pt->hid_buffers_busy_flags = 0;
+    if (dma_main_mcu_usb_msg_received != FALSE)
+    {
+        credits_event_pt->hid_buffers_busy_flags |= AUX_MCU_CREDITS_USB_BUFFER_BUSY;
+    }
+    if (dma_main_mcu_ble_msg_received != FALSE)
+    {
+        credits_event_pt->hid_buffers_busy_flags |= AUX_MCU_CREDITS_BLE_BUFFER_BUSY;
+    }
+    uint16_t crc = comms_main_mcu_compute_crc((volatile uint8_t*)credits_event_pt, offsetof(aux_mcu_credits_event_frame_t, crc));
+    credits_event_pt->crc[0] = (uint8_t)crc;
+    credits_event_pt->crc[1] = (uint8_t)(crc >> 8);
+    comms_main_mcu_nb_other_msg_credits_to_return = 0;
+    
+    /* Wake-up main MCU if it is currently sleeping, the function below does wait for a previous transfer to finish */
+    logic_sleep_wakeup_main_mcu_if_needed();
+    dma_main_mcu_init_tx_transfer((void*)&AUXMCU_SERCOM->USART.DATA.reg, (void*)credits_event_pt, (uint16_t)sizeof(*credits_event_pt));
+}
+
+/*! \fn     comms_main_mcu_release_other_msg_slot(void)
+*   \brief  Signal we are done with the non USB & non BLE message we took from our queue, its buffer credit is now owed to the main MCU
+*/
+static void comms_main_mcu_release_other_msg_slot(void)
+{
+    comms_main_mcu_nb_other_msgs_released++;
+    comms_main_mcu_nb_other_msg_credits_to_return++;
+    comms_main_mcu_return_other_msg_credits_if_needed();
+}
+
 /*! \fn     comms_main_mcu_get_temp_tx_message_object_pt(void)
 *   \brief  Get a pointer to our temporary tx message object
 */
@@ -120,11 +249,24 @@ void comms_main_mcu_send_simple_event_alt_buffer(uint16_t event_id, aux_mcu_mess
 */
 void comms_main_mcu_send_message(aux_mcu_message_t* message, uint16_t message_length)
 {
+    uint16_t nb_bytes_to_send = sizeof(aux_mcu_message_t);
+    
     /* Wake-up main MCU if it is currently sleeping */
     logic_sleep_wakeup_main_mcu_if_needed();
     
+    /* Variable length frames: only send header, payload and CRC (payloads leaving no room for the CRC are sent with a fixed size) */
+    if ((dma_main_mcu_is_variable_length_framing_enabled() != FALSE) && (message->payload_length1 <= AUX_MCU_MSG_VAR_FRAME_MAX_PAYLOAD_LENGTH))
+    {
+        /* Do not touch a message being sent */
+        dma_wait_for_main_mcu_packet_sent();
+        uint16_t crc = comms_main_mcu_compute_frame_crc(message);
+        message->payload[message->payload_length1] = (uint8_t)crc;
+        message->payload[message->payload_length1 + 1] = (uint8_t)(crc >> 8);
+        nb_bytes_to_send = AUX_MCU_MSG_HEADER_LENGTH + message->payload_length1 + AUX_MCU_MSG_CRC_LENGTH;
+    }
+    
     /* The function below does wait for a previous transfer to finish and does check for no comms */
-    dma_main_mcu_init_tx_transfer((void*)&AUXMCU_SERCOM->USART.DATA.reg, (void*)message, sizeof(aux_mcu_message_t));    
+    dma_main_mcu_init_tx_transfer((void*)&AUXMCU_SERCOM->USART.DATA.reg, (void*)message, nb_bytes_to_send);    
 }
 
 /*! \fn     comms_main_mcu_deal_with_non_usb_non_ble_message(void)
@@ -234,54 +376,70 @@ void comms_main_mcu_deal_with_non_usb_non_ble_message(aux_mcu_message_t* message
     }    
     else if (message->message_type == AUX_MCU_MSG_TYPE_KEYBOARD_TYPE)
     {
+        hid_interface_te typing_interface = (hid_interface_te)message->keyboard_type_message.interface_identifier;
+        uint16_t delay_between_types = message->keyboard_type_message.delay_between_types;
         BOOL typing_success_bool = TRUE;
         
-        /* Iterate over symbols */
-        uint16_t counter = 0;
-        while(message->keyboard_type_message.keyboard_symbols[counter] != 0)
+        if ((delay_between_types & KEYBOARD_TYPE_ROLLOVER_FLAG) != 0)
         {
-            uint16_t symbol = message->keyboard_type_message.keyboard_symbols[counter];
-            
-            if (symbol == 0xFFFF)
+            /* Pack consecutive keys in reports */
+            if (logic_keyboard_type_symbols_with_rollover(typing_interface, message->keyboard_type_message.keyboard_symbols, delay_between_types) != RETURN_OK)
             {
-                /* Original unicode point can't be typed */
-            }            
-            else if ((symbol & 0x7F00) == 0)
-            {
-                BOOL is_dead_key = FALSE;
-                
-                /* Check for dead key */
-                if ((symbol & 0x8000) != 0)
-                {
-                    is_dead_key = TRUE;
-                }                    
-                
-                /* One key to be typed */
-                if (logic_keyboard_type_symbol((hid_interface_te)message->keyboard_type_message.interface_identifier, (uint8_t)symbol, is_dead_key, message->keyboard_type_message.delay_between_types) != RETURN_OK)
-                {
-                    typing_success_bool = FALSE;
-                    break;
-                }
+                typing_success_bool = FALSE;
             }
-            else
+        }
+        else
+        {
+            /* Iterate over symbols */
+            uint16_t counter = 0;
+            while(message->keyboard_type_message.keyboard_symbols[counter] != 0)
             {
-                /* Two keys to be typed */
-                if (logic_keyboard_type_symbol((hid_interface_te)message->keyboard_type_message.interface_identifier, (uint8_t)(symbol >> 8), FALSE, message->keyboard_type_message.delay_between_types) != RETURN_OK)
+                uint16_t symbol = message->keyboard_type_message.keyboard_symbols[counter];
+            
+                if (symbol == 0xFFFF)
                 {
-                    typing_success_bool = FALSE;
-                    break;
+                    /* Original unicode point can't be typed */
+                }            
+                else if ((symbol & 0x7F00) == 0)
+                {
+                    BOOL is_dead_key = FALSE;
+                
+                    /* Check for dead key */
+                    if ((symbol & 0x8000) != 0)
+                    {
+                        is_dead_key = TRUE;
+                    }                    
+                
+                    /* One key to be typed */
+                    if (logic_keyboard_type_symbol((hid_interface_te)message->keyboard_type_message.interface_identifier, (uint8_t)symbol, is_dead_key, message->keyboard_type_message.delay_between_types) != RETURN_OK)
+                    {
+                        typing_success_bool = FALSE;
+                        break;
+                    }
                 }
-                if (logic_keyboard_type_symbol((hid_interface_te)message->keyboard_type_message.interface_identifier, (uint8_t)symbol, FALSE, message->keyboard_type_message.delay_between_types) != RETURN_OK)
+                else
                 {
-                    typing_success_bool = FALSE;
-                    break;
+                    /* Two keys to be typed */
+                    if (logic_keyboard_type_symbol((hid_interface_te)message->keyboard_type_message.interface_identifier, (uint8_t)(symbol >> 8), FALSE, message->keyboard_type_message.delay_between_types) != RETURN_OK)
+                    {
+                        typing_success_bool = FALSE;
+                        break;
+                    }
+                    if (logic_keyboard_type_symbol((hid_interface_te)message->keyboard_type_message.interface_identifier, (uint8_t)symbol, FALSE, message->keyboard_type_message.delay_between_types) != RETURN_OK)
+                    {
+                        typing_success_bool = FALSE;
+                        break;
+                    }
                 }
-            }
             
-            /* Move on to the next symbol */
-            counter++;
+                /* Move on to the next symbol */
+                counter++;
+            }
         }
             
+        /* Update adaptive pacing before answering: the main MCU stores a new BLE host typing delay while it waits for our answer */
+        logic_keyboard_typing_done(typing_interface, delay_between_types, typing_success_bool);
+        
         /* Send success status */
         memset((void*)message, 0x00, sizeof(aux_mcu_message_t));
         message->message_type = AUX_MCU_MSG_TYPE_KEYBOARD_TYPE;
@@ -426,6 +584,40 @@ void comms_main_mcu_deal_with_non_usb_non_ble_message(aux_mcu_message_t* message
                 logic_bluetooth_set_battery_level(message->main_mcu_command_message.payload[0]);
                 break;
             }
+            case MAIN_MCU_COMMAND_SET_FRAMING:
+            {
+                /* Wait for interrupt to clear this flag if set (wait for full packet receive) */
+                while (comms_main_mcu_other_msg_answered_using_first_bytes != FALSE);
+                BOOL variable_length_framing = (message->main_mcu_command_message.payload[0] != 0)?TRUE:FALSE;
+                
+                /* Framing reset (main MCU rebooted or lost our ACK): the main MCU doesn't know our framing and expects the ACK using the requested one */
+                if (message->payload_length1 == AUX_MCU_MSG_FRAMING_RESET_PAYLOAD_LENGTH)
+                {
+                    dma_wait_for_main_mcu_packet_sent();
+                    dma_main_mcu_set_variable_length_framing(variable_length_framing);
+                }
+                
+                /* Send ACK using the current framing, with the number of buffer credits the main MCU gets for non USB & non BLE messages */
+                dma_wait_for_main_mcu_packet_sent();
+                memset((void*)message, 0x00, sizeof(aux_mcu_message_t));
+                message->message_type = AUX_MCU_MSG_TYPE_AUX_MCU_EVENT;
+                message->aux_mcu_event_message.event_id = AUX_MCU_EVENT_FRAMING_SET;
+                message->aux_mcu_event_message.payload[0] = (variable_length_framing != FALSE)?DMA_MAIN_MCU_NB_OTHER_MSG_SLOTS:0;
+                message->payload_length1 = sizeof(message->aux_mcu_event_message.event_id) + sizeof(uint8_t);
+                comms_main_mcu_send_message(message, (uint16_t)sizeof(*message));
+                
+                /* Reset our buffer credits state: the main MCU counts this message as using a buffer until we're done with it */
+                comms_main_mcu_nb_other_msg_credits_to_return = 0;
+                comms_main_mcu_nb_other_msgs_released = 0;
+                dma_main_mcu_nb_other_msgs_dropped = 0;
+                dma_wait_for_main_mcu_packet_sent();
+                
+                /* Switch framing, rearm RX */
+                dma_main_mcu_disable_transfer();
+                dma_main_mcu_set_variable_length_framing(variable_length_framing);
+                comms_main_init_rx();
+                break;
+            }
             case MAIN_MCU_COMMAND_NO_COMMS_UNAV:
             {
                 /* No comms signal unavailable */
@@ -600,7 +792,7 @@ ret_type_te comms_main_mcu_routine(BOOL filter_and_force_use_of_temp_receive_buf
         /* Set bool and do necessary action: no point in setting the bool after the function call as the dma receiver will overwrite the packet anyways */
         dma_main_mcu_usb_msg_received = FALSE;
         
-        if (comms_main_mcu_usb_msg_answered_using_first_bytes == FALSE)
+        if ((comms_main_mcu_usb_msg_answered_using_first_bytes == FALSE) && (comms_main_mcu_check_received_frame(&dma_main_mcu_usb_rcv_message) == RETURN_OK))
         {
             comms_raw_hid_send_hid_message(USB_INTERFACE, (aux_mcu_message_t*)&dma_main_mcu_usb_rcv_message);
         }
@@ -610,42 +802,55 @@ ret_type_te comms_main_mcu_routine(BOOL filter_and_force_use_of_temp_receive_buf
         /* Set bool and do necessary action: no point in setting the bool after the function call as the dma receiver will overwrite the packet anyways */
         dma_main_mcu_ble_msg_received = FALSE;
         
-        if (comms_main_mcu_ble_msg_answered_using_first_bytes == FALSE)
+        if ((comms_main_mcu_ble_msg_answered_using_first_bytes == FALSE) && (comms_main_mcu_check_received_frame(&dma_main_mcu_ble_rcv_message) == RETURN_OK))
         {
             comms_raw_hid_send_hid_message(BLE_INTERFACE, (aux_mcu_message_t*)&dma_main_mcu_ble_rcv_message);
         }
     }
     if (dma_main_mcu_other_msg_received != FALSE)
     {
-        /* Set bool and do necessary action: no point in setting the bool after the function call as the dma receiver will overwrite the packet anyways */
-        dma_main_mcu_other_msg_received = FALSE;
+        /* Take the oldest queued message (messages answered using their first bytes aren't queued) */
+        volatile aux_mcu_message_t* other_message_pt = dma_main_mcu_pop_other_message();
         
-        if (comms_main_mcu_other_msg_answered_using_first_bytes == FALSE)
+        if (comms_main_mcu_check_received_frame(other_message_pt) == RETURN_OK)
         {
-            if ((filter_and_force_use_of_temp_receive_buffer != FALSE) && (dma_main_mcu_other_message.message_type == expected_message_type))
+            if ((filter_and_force_use_of_temp_receive_buffer != FALSE) && (other_message_pt->message_type == expected_message_type))
             {
                 /* Did we receive a please retry from the main mcu? */
-                if ((resend_send_msg_if_retry_of_type_received != FALSE) && (dma_main_mcu_other_message.message_type == AUX_MCU_MSG_TYPE_FIDO2) && (dma_main_mcu_other_message.fido2_message.message_type == AUX_MCU_FIDO2_RETRY))
+                if ((resend_send_msg_if_retry_of_type_received != FALSE) && (other_message_pt->message_type == AUX_MCU_MSG_TYPE_FIDO2) && (other_message_pt->fido2_message.message_type == AUX_MCU_FIDO2_RETRY))
                 {
                     timer_delay_ms(5);
                     comms_main_mcu_send_message(&main_mcu_send_message, sizeof(main_mcu_send_message));
                 } 
                 else
                 {
-                    memcpy((void*)&comms_main_mcu_temp_message, (void*)&dma_main_mcu_other_message, sizeof(comms_main_mcu_temp_message));
+                    memcpy((void*)&comms_main_mcu_temp_message, (void*)other_message_pt, sizeof(comms_main_mcu_temp_message));
+                    comms_main_mcu_release_other_msg_slot();
                     return RETURN_OK;
                 }
             } 
             else
             {
-                comms_main_mcu_deal_with_non_usb_non_ble_message((aux_mcu_message_t*)&dma_main_mcu_other_message);
+                comms_main_mcu_deal_with_non_usb_non_ble_message((aux_mcu_message_t*)other_message_pt);
             }
         }
+        
+        /* Message dealt with */
+        comms_main_mcu_release_other_msg_slot();
+    }
+    else
+    {
+        /* Answer buffer credits requests */
+        comms_main_mcu_return_other_msg_credits_if_needed();
     }
     
     /* Second: see if we could deal with a packet in advance */
-    /* Ongoing RX transfer received bytes */
-    uint16_t nb_received_bytes_for_ongoing_transfer = sizeof(dma_main_mcu_temp_rcv_message) - dma_main_mcu_get_remaining_bytes_for_rx_transfer();
+    /* Ongoing RX transfer received bytes (variable length frames are only dealt with once complete) */
+    uint16_t nb_received_bytes_for_ongoing_transfer = 0;
+    if (dma_main_mcu_is_variable_length_framing_enabled() == FALSE)
+    {
+        nb_received_bytes_for_ongoing_transfer = sizeof(dma_main_mcu_temp_rcv_message) - dma_main_mcu_get_remaining_bytes_for_rx_transfer();
+    }
     
     /* Depending on the message type, set the correct bool pointers */
     volatile BOOL* answered_with_the_first_bytes_pointer = &comms_main_mcu_other_msg_answered_using_first_bytes;
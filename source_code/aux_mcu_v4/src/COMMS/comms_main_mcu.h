@@ -46,6 +46,8 @@ extern volatile BOOL comms_main_mcu_other_msg_answered_using_first_bytes;
 #define MAIN_MCU_COMMAND_UPDT_DEV_STAT  0x000A
 #define MAIN_MCU_COMMAND_STOP_CHARGE    0x000B
 #define MAIN_MCU_COMMAND_SET_BATTERYLVL 0x000C
+#define MAIN_MCU_COMMAND_SET_FRAMING   0x000D
+#define MAIN_MCU_COMMAND_GET_CREDITS   0x000E
 
 // Debug MCU commands
 #define MAIN_MCU_COMMAND_TX_SWEEP_SGL       0x1000
@@ -69,6 +71,12 @@ extern volatile BOOL comms_main_mcu_other_msg_answered_using_first_bytes;
 #define AUX_MCU_EVENT_USB_DETACHED      0x000C
 #define AUX_MCU_EVENT_CHARGE_LVL_UPDATE 0x000D
 #define AUX_MCU_EVENT_USB_TIMEOUT       0x000E
+#define AUX_MCU_EVENT_FRAMING_SET       0x000F
+#define AUX_MCU_EVENT_MSG_CREDITS       0x0010
+
+// Buffer credits event flags
+#define AUX_MCU_CREDITS_USB_BUFFER_BUSY 0x01
+#define AUX_MCU_CREDITS_BLE_BUFFER_BUSY 0x02
 
 // BLE commands
 #define BLE_MESSAGE_CMD_ENABLE              0x0001
@@ -82,6 +90,12 @@ extern volatile BOOL comms_main_mcu_other_msg_answered_using_first_bytes;
 #define BLE_MESSAGE_RECALL_BOND_INFO_IRK    0x0009
 #define BLE_MESSAGE_GET_BT_6_DIGIT_CODE     0x000A
 #define BLE_MESSAGE_DISCONNECT_FOR_NEXT     0x000B
+#define BLE_MESSAGE_STORE_TYPING_DELAY      0x000C
+
+// Keyboard typing: flags set in delay_between_types to let the aux MCU tune it (lower bits then being the max delay) and to pack keys in reports
+#define KEYBOARD_TYPE_ADAPTIVE_DELAY_FLAG   0x8000
+#define KEYBOARD_TYPE_ROLLOVER_FLAG         0x4000
+#define KEYBOARD_TYPE_DELAY_MASK            0x3FFF
 
 /* FIDO2 messages start */
 #define AUX_MCU_MSG_TYPE_FIDO2_START 0x0001
@@ -156,7 +170,8 @@ typedef struct
     uint8_t host_ltk_random_nb[8];
     uint16_t host_ltk_key_size;
     uint8_t host_csrk_key[16];
-    uint8_t reserved[10];
+    uint16_t tuned_typing_delay;
+    uint8_t reserved[8];
 } nodemgmt_bluetooth_bonding_information_t;
 
 typedef struct
@@ -303,6 +318,28 @@ typedef struct
     };
 } aux_mcu_message_t;
 
+// Buffer credits request & event, only sent using variable length frames
+typedef struct
+{
+    uint16_t message_type;
+    uint16_t payload_length1;
+    uint16_t command;
+    uint8_t request_id;
+    uint8_t crc[AUX_MCU_MSG_CRC_LENGTH];
+} __attribute__((packed)) aux_mcu_credits_request_frame_t;
+
+typedef struct
+{
+    uint16_t message_type;
+    uint16_t payload_length1;
+    uint16_t event_id;
+    uint8_t nb_other_msgs_released;
+    uint8_t nb_other_msgs_dropped;
+    uint8_t request_id;
+    uint8_t hid_buffers_busy_flags;
+    uint8_t crc[AUX_MCU_MSG_CRC_LENGTH];
+} aux_mcu_credits_event_frame_t;
+
 /* Prototypes */
 ret_type_te comms_main_mcu_routine(BOOL filter_and_force_use_of_temp_receive_buffer, uint16_t expected_message_type, BOOL resend_send_msg_if_retry_of_type_received);
 ret_type_te comms_main_mcu_fetch_bonding_info_for_mac(uint8_t address_resolv_type, uint8_t* mac_addr, nodemgmt_bluetooth_bonding_information_t* bonding_info);
@@ -312,6 +349,7 @@ void comms_main_mcu_send_simple_event_alt_buffer(uint16_t event_id, aux_mcu_mess
 void comms_main_mcu_send_message(aux_mcu_message_t* message, uint16_t message_length);
 BOOL comms_aux_mcu_get_received_packet(aux_mcu_message_t** message, BOOL arm_new_rx);
 void comms_main_mcu_deal_with_non_usb_non_ble_message(aux_mcu_message_t* message);
+uint16_t comms_main_mcu_compute_frame_crc(volatile aux_mcu_message_t* message);
 uint16_t comms_main_mcu_get_bonding_info_irks(uint8_t** irk_keys_buffer);
 aux_mcu_message_t* comms_main_mcu_get_temp_tx_message_object_pt(void);
 aux_mcu_message_t* comms_main_mcu_get_temp_rx_message_object_pt(void);
@@ -149,6 +149,7 @@ void comms_raw_hid_send_packet(hid_interface_te hid_interface, hid_packet_t* pac
     }
     else
     {
+        /* Sent flag is cleared as soon as our BLE raw HID queue can take another packet */
         logic_bluetooth_raw_send((uint8_t*)packet, payload_size);
     }
     
@@ -280,6 +281,31 @@ void comms_raw_hid_connection_set_callback(hid_interface_te hid_interface)
     comms_raw_hid_packet_being_sent[hid_interface] = FALSE;
 } 
 
+/*! \fn     comms_raw_hid_ctap_routine(void)
+*   \brief  Deal with a received CTAP HID packet, if any
+*   \return TRUE if a packet was processed
+*   \note   Also called while waiting for the main MCU answer to a FIDO2 request, so other CTAP channels are served
+*/
+BOOL comms_raw_hid_ctap_routine(void)
+{
+    uint32_t ctap_packet[sizeof(raw_hid_recv_buffer[0])/sizeof(uint32_t)];
+    
+    /* Did we receive a packet? */
+    if (comms_raw_hid_packet_received[CTAP_INTERFACE] == FALSE)
+    {
+        return FALSE;
+    }
+    
+    /* Copy packet and re-arm receive before processing, as processing may take a while and call this function */
+    memcpy(ctap_packet, raw_hid_recv_buffer[CTAP_INTERFACE].raw_packet_uint32, sizeof(ctap_packet));
+    comms_raw_hid_packet_received[CTAP_INTERFACE] = FALSE;
+    comms_raw_hid_arm_packet_receive(CTAP_INTERFACE);
+    
+    /* Process it */
+    ctaphid_handle_packet(ctap_packet);
+    return TRUE;
+}
+
 /*! \fn     comms_usb_communication_routine(void)
 *   \brief  Function called to deal with comms
 *   \return What happened
@@ -339,16 +365,15 @@ comms_usb_ret_te comms_usb_communication_routine(void)
         /* Did we receive a packet? */
         if (comms_raw_hid_packet_received[hid_interface] != FALSE)
         {
-            /* Reset flag */
-            comms_raw_hid_packet_received[hid_interface] = FALSE;
-
             if (hid_interface == CTAP_INTERFACE)
             {
-                ctaphid_handle_packet(raw_hid_recv_buffer[hid_interface].raw_packet_uint32);
-                comms_raw_hid_arm_packet_receive(hid_interface);
+                comms_raw_hid_ctap_routine();
                 return ret_val;
             }
 
+            /* Reset flag */
+            comms_raw_hid_packet_received[hid_interface] = FALSE;
+
             /* Special case: first two bytes set to 0xFF 0xFF, reset flip bit */
             uint8_t* usb_recast = (uint8_t*)&raw_hid_recv_buffer[hid_interface];
             if ((usb_recast[0] == 0xFF) && (usb_recast[1] == 0xFF))
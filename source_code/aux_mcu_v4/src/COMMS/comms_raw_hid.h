@@ -52,6 +52,7 @@ void comms_raw_hid_update_device_status_cache(uint8_t* buffer);
 comms_usb_ret_te comms_usb_communication_routine(void);
 void comms_usb_debug_printf(const char *fmt, ...);
 void comms_usb_clear_enumerated(void);
+BOOL comms_raw_hid_ctap_routine(void);
 BOOL comms_usb_is_enumerated(void);
 
 
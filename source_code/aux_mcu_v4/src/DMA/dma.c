@@ -30,7 +30,15 @@ volatile BOOL dma_main_mcu_packet_sent = TRUE;
 volatile aux_mcu_message_t dma_main_mcu_temp_rcv_message;
 volatile aux_mcu_message_t dma_main_mcu_usb_rcv_message;
 volatile aux_mcu_message_t dma_main_mcu_ble_rcv_message;
-volatile aux_mcu_message_t dma_main_mcu_other_message;
+volatile aux_mcu_message_t dma_main_mcu_other_messages[DMA_MAIN_MCU_NB_OTHER_MSG_SLOTS];
+/* Non USB & non BLE messages queue: write & read indexes, number of queued messages */
+uint16_t dma_main_mcu_other_msg_write_index = 0;
+uint16_t dma_main_mcu_other_msg_read_index = 0;
+volatile uint16_t dma_main_mcu_nb_other_msgs_queued = 0;
+/* Number of non USB & non BLE messages dropped as our queue was full, flag set when the main MCU asks for our buffer credits state & its request ID */
+volatile uint8_t dma_main_mcu_nb_other_msgs_dropped = 0;
+volatile BOOL dma_main_mcu_credits_requested = FALSE;
+volatile uint8_t dma_main_mcu_credits_request_id = 0;
 /* Message received flags */
 volatile BOOL dma_main_mcu_usb_msg_received = FALSE;
 volatile BOOL dma_main_mcu_ble_msg_received = FALSE;
@@ -38,6 +46,46 @@ volatile BOOL dma_main_mcu_other_msg_received = FALSE;
 /* MCU systick value when the main MCU message sent interrupt happened */
 volatile uint32_t dma_main_mcu_message_sent_mcu_systick_val;
 volatile uint32_t dma_main_mcu_message_sent_systick_val;
+/* Variable length main MCU frames: enable flag, header reception flag */
+BOOL dma_main_mcu_variable_length_frames = FALSE;
+volatile BOOL dma_main_mcu_rx_header_stage = FALSE;
+
+/*! \fn     dma_main_mcu_copy_received_message(volatile aux_mcu_message_t* destination)
+*   \brief  Copy the message we just received to its dedicated buffer
+*   \param  destination Where to copy the message
+*   \note   For variable length frames, only the received bytes are copied (CRC included) and the rest is cleared
+*/
+static inline void dma_main_mcu_copy_received_message(volatile aux_mcu_message_t* destination)
+{
+    uint16_t nb_bytes_to_copy = sizeof(dma_main_mcu_temp_rcv_message);
+    
+    if ((dma_main_mcu_variable_length_frames != FALSE) && (dma_main_mcu_temp_rcv_message.payload_length1 <= AUX_MCU_MSG_VAR_FRAME_MAX_PAYLOAD_LENGTH))
+    {
+        nb_bytes_to_copy = AUX_MCU_MSG_HEADER_LENGTH + dma_main_mcu_temp_rcv_message.payload_length1 + AUX_MCU_MSG_CRC_LENGTH;
+        memset((uint8_t*)destination + nb_bytes_to_copy, 0, sizeof(dma_main_mcu_temp_rcv_message) - nb_bytes_to_copy);
+    }
+    memcpy((void*)destination, (void*)&dma_main_mcu_temp_rcv_message, nb_bytes_to_copy);
+}
+
+#ifndef BOOTLOADER
+/*! \fn     dma_main_mcu_is_credits_request_received(void)
+*   \brief  Check if the variable length frame we just received is a valid buffer credits request
+*   \return TRUE or FALSE
+*/
+static inline BOOL dma_main_mcu_is_credits_request_received(void)
+{
+    volatile uint8_t* crc_pt = &dma_main_mcu_temp_rcv_message.main_mcu_command_message.payload[1];
+    
+    if ((dma_main_mcu_variable_length_frames != FALSE) && (dma_main_mcu_temp_rcv_message.message_type == AUX_MCU_MSG_TYPE_MAIN_MCU_CMD) && (dma_main_mcu_temp_rcv_message.main_mcu_command_message.command == MAIN_MCU_COMMAND_GET_CREDITS) && (dma_main_mcu_temp_rcv_message.payload_length1 == sizeof(uint16_t) + sizeof(uint8_t)))
+    {
+        if (comms_main_mcu_compute_frame_crc(&dma_main_mcu_temp_rcv_message) == (crc_pt[0] | (crc_pt[1] << 8)))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+#endif
 
 /*! \fn     DMAC_Handler(void)
 *   \brief  Function called by interrupt when RX is done
@@ -46,7 +94,25 @@ void DMAC_Handler(void)
 {    
     /* MAIN MCU RX routine */
     DMAC->CHID.reg = DMAC_CHID_ID(DMA_DESCID_RX_COMMS);
-    if ((DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_TCMPL) != 0)
+    if (((DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_TCMPL) != 0) && (dma_main_mcu_rx_header_stage != FALSE))
+    {
+        /* Variable length frame header received: clear interrupt, fetch payload & CRC */
+        DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL;
+        dma_main_mcu_rx_header_stage = FALSE;
+        uint16_t nb_bytes_to_receive = dma_main_mcu_temp_rcv_message.payload_length1 + AUX_MCU_MSG_CRC_LENGTH;
+        
+        /* Payload length leaving no room for the CRC (special reboot packet, framing reset): frame sent with a fixed size */
+        if (dma_main_mcu_temp_rcv_message.payload_length1 > AUX_MCU_MSG_VAR_FRAME_MAX_PAYLOAD_LENGTH)
+        {
+            nb_bytes_to_receive = sizeof(dma_main_mcu_temp_rcv_message) - AUX_MCU_MSG_HEADER_LENGTH;
+        }
+        
+        /* Resume DMA channel operation */
+        dma_descriptors[DMA_DESCID_RX_COMMS].BTCNT.bit.BTCNT = nb_bytes_to_receive;
+        dma_descriptors[DMA_DESCID_RX_COMMS].DSTADDR.reg = (uint32_t)(&dma_main_mcu_temp_rcv_message) + AUX_MCU_MSG_HEADER_LENGTH + nb_bytes_to_receive;
+        DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+    }
+    else if ((DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_TCMPL) != 0)
     {
         /* Set transfer done boolean, clear interrupt */
         dma_aux_mcu_packet_received = TRUE;
@@ -59,7 +125,7 @@ void DMAC_Handler(void)
         /* Depending on message received, copy to the right rcv buffer and set flag */
         if (dma_main_mcu_temp_rcv_message.message_type == AUX_MCU_MSG_TYPE_USB)
         {
-            memcpy((void*)&dma_main_mcu_usb_rcv_message, (void*)&dma_main_mcu_temp_rcv_message, sizeof(dma_main_mcu_temp_rcv_message));
+            dma_main_mcu_copy_received_message(&dma_main_mcu_usb_rcv_message);
             /* Check if received message has already been dealt with, do not set received flag if so */
             if (comms_main_mcu_usb_msg_answered_using_first_bytes != FALSE)
             {
@@ -72,7 +138,7 @@ void DMAC_Handler(void)
         }
         else if (dma_main_mcu_temp_rcv_message.message_type == AUX_MCU_MSG_TYPE_BLE)
         {
-            memcpy((void*)&dma_main_mcu_ble_rcv_message, (void*)&dma_main_mcu_temp_rcv_message, sizeof(dma_main_mcu_temp_rcv_message));
+            dma_main_mcu_copy_received_message(&dma_main_mcu_ble_rcv_message);
             /* Check if received message has already been dealt with, do not set received flag if so */
             if (comms_main_mcu_ble_msg_answered_using_first_bytes != FALSE)
             {
@@ -83,19 +149,37 @@ void DMAC_Handler(void)
                 dma_main_mcu_ble_msg_received = TRUE;
             }
         }
-        else
+        else if (dma_main_mcu_is_credits_request_received() != FALSE)
         {
-            memcpy((void*)&dma_main_mcu_other_message, (void*)&dma_main_mcu_temp_rcv_message, sizeof(dma_main_mcu_temp_rcv_message));
-            /* Check if received message has already been dealt with, do not set received flag if so */
+            /* Buffer credits request: doesn't use a queue slot, answered by our comms routine */
+            dma_main_mcu_credits_request_id = dma_main_mcu_temp_rcv_message.main_mcu_command_message.payload[0];
+            dma_main_mcu_credits_requested = TRUE;
+        }
+        else if (dma_main_mcu_nb_other_msgs_queued < DMA_MAIN_MCU_NB_OTHER_MSG_SLOTS)
+        {
+            dma_main_mcu_copy_received_message(&dma_main_mcu_other_messages[dma_main_mcu_other_msg_write_index]);
+            /* Check if received message has already been dealt with, do not queue it if so */
             if (comms_main_mcu_other_msg_answered_using_first_bytes != FALSE)
             {
                 comms_main_mcu_other_msg_answered_using_first_bytes = FALSE;
             }
             else
             {
+                if (++dma_main_mcu_other_msg_write_index == DMA_MAIN_MCU_NB_OTHER_MSG_SLOTS)
+                {
+                    dma_main_mcu_other_msg_write_index = 0;
+                }
+                dma_main_mcu_nb_other_msgs_queued++;
                 dma_main_mcu_other_msg_received = TRUE;
             }    
         }
+        else
+        {
+            /* Queue full (main MCU sent it without a buffer credit): drop message, the main MCU is told by our next credits event */
+            comms_main_mcu_other_msg_answered_using_first_bytes = FALSE;
+            dma_main_mcu_nb_other_msgs_dropped++;
+            dma_main_mcu_credits_requested = TRUE;
+        }
         #else
             /* Bootloader: we're only receiving other messages :D */
             dma_main_mcu_other_msg_received = TRUE;
@@ -324,6 +408,53 @@ void dma_main_mcu_init_tx_transfer(void* spi_data_p, void* datap, uint16_t size)
     __enable_irq();
 }
 
+/*! \fn     dma_main_mcu_pop_other_message(void)
+*   \brief  Remove the oldest non USB & non BLE message from the received messages queue
+*   \return Pointer to the message, valid until the main MCU gets its buffer credit back
+*   \note   Only call when dma_main_mcu_other_msg_received is set
+*/
+volatile aux_mcu_message_t* dma_main_mcu_pop_other_message(void)
+{
+    volatile aux_mcu_message_t* message_pt = &dma_main_mcu_other_messages[dma_main_mcu_other_msg_read_index];
+    
+    /* Update read index */
+    if (++dma_main_mcu_other_msg_read_index == DMA_MAIN_MCU_NB_OTHER_MSG_SLOTS)
+    {
+        dma_main_mcu_other_msg_read_index = 0;
+    }
+    
+    /* Update message count & flag, which are also used by the DMA interrupt */
+    __disable_irq();
+    __DMB();
+    if (--dma_main_mcu_nb_other_msgs_queued == 0)
+    {
+        dma_main_mcu_other_msg_received = FALSE;
+    }
+    __DMB();
+    __enable_irq();
+    
+    return message_pt;
+}
+
+/*! \fn     dma_main_mcu_set_variable_length_framing(BOOL enable)
+*   \brief  Select variable length or fixed size frames for the main MCU comms
+*   \param  enable  TRUE to use variable length frames
+*   \note   To be called while RX is disabled, takes effect at the next transfers
+*/
+void dma_main_mcu_set_variable_length_framing(BOOL enable)
+{
+    dma_main_mcu_variable_length_frames = enable;
+}
+
+/*! \fn     dma_main_mcu_is_variable_length_framing_enabled(void)
+*   \brief  Check if variable length frames are used for the main MCU comms
+*   \return TRUE or FALSE
+*/
+BOOL dma_main_mcu_is_variable_length_framing_enabled(void)
+{
+    return dma_main_mcu_variable_length_frames;
+}
+
 /*! \fn     dma_main_mcu_disable_transfer(void)
 *   \brief  Disable the DMA transfer for the main MCU comms
 */
@@ -361,10 +492,19 @@ void dma_main_mcu_disable_transfer(void)
 */
 void dma_main_mcu_init_rx_transfer(void)
 {
+    uint16_t nb_bytes_to_receive = (uint16_t)sizeof(dma_main_mcu_temp_rcv_message);
+    
+    /* Variable length frames: only receive the header, the interrupt will then fetch the rest */
+    dma_main_mcu_rx_header_stage = dma_main_mcu_variable_length_frames;
+    if (dma_main_mcu_variable_length_frames != FALSE)
+    {
+        nb_bytes_to_receive = AUX_MCU_MSG_HEADER_LENGTH;
+    }
+    
     /* Setup transfer size */
-    dma_descriptors[DMA_DESCID_RX_COMMS].BTCNT.bit.BTCNT = (uint16_t)sizeof(dma_main_mcu_temp_rcv_message);
+    dma_descriptors[DMA_DESCID_RX_COMMS].BTCNT.bit.BTCNT = nb_bytes_to_receive;
     /* Source address: DATA register from SPI */
-    dma_descriptors[DMA_DESCID_RX_COMMS].DSTADDR.reg = (uint32_t)(&dma_main_mcu_temp_rcv_message) + sizeof(dma_main_mcu_temp_rcv_message);
+    dma_descriptors[DMA_DESCID_RX_COMMS].DSTADDR.reg = (uint32_t)(&dma_main_mcu_temp_rcv_message) + nb_bytes_to_receive;
     /* Destination address: given value */
     dma_descriptors[DMA_DESCID_RX_COMMS].SRCADDR.reg = (uint32_t)((void*)&AUXMCU_SERCOM->USART.DATA.reg);
     
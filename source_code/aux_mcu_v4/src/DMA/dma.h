@@ -13,18 +13,28 @@
 #include "comms_main_mcu.h"
 #include "defines.h"
 
+/* Defines */
+#define DMA_MAIN_MCU_NB_OTHER_MSG_SLOTS     3
+#define DMA_MAIN_MCU_CREDITS_RETURN_THRES   2
+
 /* Global vars */
 extern volatile aux_mcu_message_t dma_main_mcu_temp_rcv_message;
 extern volatile aux_mcu_message_t dma_main_mcu_usb_rcv_message;
 extern volatile aux_mcu_message_t dma_main_mcu_ble_rcv_message;
-extern volatile aux_mcu_message_t dma_main_mcu_other_message;
 extern volatile BOOL dma_main_mcu_other_msg_received;
 extern volatile BOOL dma_main_mcu_usb_msg_received;
 extern volatile BOOL dma_main_mcu_ble_msg_received;
+extern volatile uint16_t dma_main_mcu_nb_other_msgs_queued;
+extern volatile uint8_t dma_main_mcu_nb_other_msgs_dropped;
+extern volatile BOOL dma_main_mcu_credits_requested;
+extern volatile uint8_t dma_main_mcu_credits_request_id;
 
 /* Prototypes */
 void dma_main_mcu_init_tx_transfer(void* spi_data_p, void* datap, uint16_t size);
+volatile aux_mcu_message_t* dma_main_mcu_pop_other_message(void);
 uint16_t dma_main_mcu_get_remaining_bytes_for_rx_transfer(void);
+void dma_main_mcu_set_variable_length_framing(BOOL enable);
+BOOL dma_main_mcu_is_variable_length_framing_enabled(void);
 BOOL dma_main_mcu_check_and_clear_dma_transfer_flag(void);
 void dma_wait_for_main_mcu_packet_sent(void);
 void dma_main_mcu_init_rx_transfer(void);
@@ -6,6 +6,7 @@
  */ 
 #include "platform_defines.h"
 #include "logic_bluetooth.h"
+#include "logic_keyboard.h"
 #include "conf_serialdrv.h"
 #include "driver_timer.h"
 #include "device_info.h"
@@ -33,8 +34,15 @@ hid_control_mode_ntf_t logic_bluetooth_hid_control_point_value[HID_MAX_SERV_INST
 hid_report_ntf_t logic_bluetooth_report_ntf_info[BLE_TOTAL_NUMBER_OF_REPORTS];
 /* HID GATT services instances */
 hid_gatt_serv_handler_t logic_bluetooth_hid_gatt_instances[HID_MAX_SERV_INST];
-/* Notification we're sending */
-notif_sending_te logic_bluetooth_notif_being_sent = NONE_NOTIF_SENDING;
+/* Notifications we're sending, in the order they'll be confirmed */
+notif_sending_te logic_bluetooth_notifs_being_sent[BLE_NOTIFS_IN_FLIGHT_FIFO_LENGTH];
+uint16_t logic_bluetooth_notifs_being_sent_read_idx = 0;
+uint16_t logic_bluetooth_nb_notifs_being_sent = 0;
+/* Raw HID packets to send, the first one being handed to the BLE stack until its notification is confirmed */
+uint8_t logic_bluetooth_raw_hid_queue[BLE_RAW_HID_QUEUE_LENGTH][64];
+uint16_t logic_bluetooth_raw_hid_queue_read_idx = 0;
+uint16_t logic_bluetooth_raw_hid_queue_nb_packets = 0;
+BOOL logic_bluetooth_raw_hid_notif_being_sent = FALSE;
 /* HID service instances */
 hid_serv_t logic_bluetooth_hid_serv_instances[HID_MAX_SERV_INST];
 /* Boot notification structure for keyboard service in boot protocol */
@@ -86,6 +94,90 @@ static at_ble_status_t hid_custom_event(void *param)
     return status;
 }
 
+/*! \fn     logic_bluetooth_can_add_notif_being_sent(void)
+*   \brief  Know if we can keep track of another notification
+*   \return TRUE if there's room in our notifications FIFO
+*   \note   To be checked before handing a notification to the BLE stack: an untracked notification would shift the confirmations of the next ones
+*/
+static BOOL logic_bluetooth_can_add_notif_being_sent(void)
+{
+    if (logic_bluetooth_nb_notifs_being_sent < ARRAY_SIZE(logic_bluetooth_notifs_being_sent))
+    {
+        return TRUE;
+    } 
+    else
+    {
+        DBG_LOG("ERROR: too many notifications waiting for a confirmation");
+        return FALSE;
+    }
+}
+
+/*! \fn     logic_bluetooth_add_notif_being_sent(notif_sending_te notif)
+*   \brief  Keep track of a notification handed to the BLE stack
+*   \param  notif   Notification type
+*   \note   Room must have been checked with logic_bluetooth_can_add_notif_being_sent
+*/
+static void logic_bluetooth_add_notif_being_sent(notif_sending_te notif)
+{
+    logic_bluetooth_notifs_being_sent[(logic_bluetooth_notifs_being_sent_read_idx + logic_bluetooth_nb_notifs_being_sent) % ARRAY_SIZE(logic_bluetooth_notifs_being_sent)] = notif;
+    logic_bluetooth_nb_notifs_being_sent++;
+}
+
+/*! \fn     logic_bluetooth_release_raw_hid_queue_head(void)
+*   \brief  Remove the first packet of our raw HID queue, letting the raw HID sender give us another one if the queue was full
+*/
+static void logic_bluetooth_release_raw_hid_queue_head(void)
+{
+    BOOL queue_was_full = (logic_bluetooth_raw_hid_queue_nb_packets == ARRAY_SIZE(logic_bluetooth_raw_hid_queue))?TRUE:FALSE;
+    
+    memset(logic_bluetooth_raw_hid_queue[logic_bluetooth_raw_hid_queue_read_idx], 0, sizeof(logic_bluetooth_raw_hid_queue[0]));
+    logic_bluetooth_raw_hid_queue_read_idx = (logic_bluetooth_raw_hid_queue_read_idx + 1) % ARRAY_SIZE(logic_bluetooth_raw_hid_queue);
+    logic_bluetooth_raw_hid_queue_nb_packets--;
+    
+    if (queue_was_full != FALSE)
+    {
+        comms_raw_hid_send_callback(BLE_INTERFACE);
+    }
+}
+
+/*! \fn     logic_bluetooth_send_next_raw_hid_packet(void)
+*   \brief  Hand the first packet of our raw HID queue to the BLE stack, if the previous one was confirmed
+*   \note   at_ble_notification_send only names the characteristic, its value being read when the notification goes over the air:
+*   \note   its value is therefore only set again once the previous notification is confirmed
+*/
+static void logic_bluetooth_send_next_raw_hid_packet(void)
+{
+    while ((logic_bluetooth_raw_hid_notif_being_sent == FALSE) && (logic_bluetooth_raw_hid_queue_nb_packets != 0) && (logic_bluetooth_can_add_notif_being_sent() != FALSE))
+    {
+        if (logic_bluetooth_update_report(logic_bluetooth_ble_connection_handle, BLE_RAW_HID_SERVICE_INSTANCE, BLE_RAW_HID_IN_REPORT_NB, logic_bluetooth_raw_hid_queue[logic_bluetooth_raw_hid_queue_read_idx], sizeof(logic_bluetooth_raw_hid_queue[0])) == RETURN_OK)
+        {
+            logic_bluetooth_add_notif_being_sent(RAW_HID_NOTIF_SENDING);
+            logic_bluetooth_raw_hid_notif_being_sent = TRUE;
+        }
+        else
+        {
+            /* No confirmation will come for this packet */
+            logic_bluetooth_release_raw_hid_queue_head();
+        }
+    }
+}
+
+/*! \fn     logic_bluetooth_reset_notifs_being_sent(void)
+*   \brief  Forget the notifications being sent and the queued raw HID packets, as they won't be confirmed anymore
+*/
+static void logic_bluetooth_reset_notifs_being_sent(void)
+{
+    logic_bluetooth_notifs_being_sent_read_idx = 0;
+    logic_bluetooth_nb_notifs_being_sent = 0;
+    memset(logic_bluetooth_raw_hid_queue, 0, sizeof(logic_bluetooth_raw_hid_queue));
+    logic_bluetooth_raw_hid_queue_read_idx = 0;
+    logic_bluetooth_raw_hid_queue_nb_packets = 0;
+    logic_bluetooth_raw_hid_notif_being_sent = FALSE;
+    
+    /* Unblock a possible raw HID sender */
+    comms_raw_hid_send_callback(BLE_INTERFACE);
+}
+
 /*! \fn     logic_bluetooth_store_temp_ban_connected_address(uint8_t* address)
 *   \brief  Store provided address for potential upcoming ban
 */
@@ -184,6 +276,12 @@ static at_ble_status_t logic_bluetooth_hid_disconnected_callback(void *params)
     logic_bluetooth_just_paired = FALSE;
     logic_bluetooth_connected = FALSE;
     logic_bluetooth_paired = FALSE;
+    
+    /* Forget typing pacing host */
+    logic_keyboard_set_ble_host(0, 0);
+    
+    /* Notifications in flight won't be confirmed */
+    logic_bluetooth_reset_notifs_being_sent();
 
     /* From battery service */
     logic_bluetooth_battery_notification_flag = TRUE;    
@@ -274,6 +372,10 @@ void logic_bluetooth_successfull_pairing_call(ble_connected_dev_info_t* dev_info
     temp_tx_message_pt->ble_message.bonding_information_to_store_message.host_ltk_key_size = dev_info->host_ltk.key_size;
     memcpy(temp_tx_message_pt->ble_message.bonding_information_to_store_message.host_csrk_key, dev_info->host_csrk.key, sizeof(dev_info->host_csrk.key));
     
+    /* Typing pacing not tuned yet for that host */
+    temp_tx_message_pt->ble_message.bonding_information_to_store_message.tuned_typing_delay = 0;
+    logic_keyboard_set_ble_host(dev_info->conn_info.peer_addr.addr, 0);
+    
     /* Zero stuff */
     memset(temp_tx_message_pt->ble_message.bonding_information_to_store_message.reserved, 0, sizeof(temp_tx_message_pt->ble_message.bonding_information_to_store_message.reserved));
         
@@ -337,6 +439,7 @@ static const ble_gap_event_cb_t hid_app_gap_handle =
 static at_ble_status_t logic_bluetooth_notification_confirmed_callback(void* params)
 {
     at_ble_cmd_complete_event_t* notification_status;
+    notif_sending_te notif_confirmed = NONE_NOTIF_SENDING;
     notification_status = (at_ble_cmd_complete_event_t*) params;
     
     /* Debug */
@@ -349,15 +452,25 @@ static at_ble_status_t logic_bluetooth_notification_confirmed_callback(void* par
         DBG_LOG("ERROR: failed sending notification to peer");
     }
     
-    if (logic_bluetooth_notif_being_sent == RAW_HID_NOTIF_SENDING)
+    /* Confirmations come in the order notifications were sent */
+    if (logic_bluetooth_nb_notifs_being_sent != 0)
     {
-        comms_raw_hid_send_callback(BLE_INTERFACE);
+        notif_confirmed = logic_bluetooth_notifs_being_sent[logic_bluetooth_notifs_being_sent_read_idx];
+        logic_bluetooth_notifs_being_sent_read_idx = (logic_bluetooth_notifs_being_sent_read_idx + 1) % ARRAY_SIZE(logic_bluetooth_notifs_being_sent);
+        logic_bluetooth_nb_notifs_being_sent--;
     }
-    else if (logic_bluetooth_notif_being_sent == KEYBOARD_NOTIF_SENDING)
+    
+    if (notif_confirmed == RAW_HID_NOTIF_SENDING)
+    {
+        /* Packet sent over the air: the stack won't read the characteristic value anymore */
+        logic_bluetooth_raw_hid_notif_being_sent = FALSE;
+        logic_bluetooth_release_raw_hid_queue_head();
+    }
+    else if (notif_confirmed == KEYBOARD_NOTIF_SENDING)
     {
         logic_bluetooth_typed_report_sent = TRUE;
     }
-    else if (logic_bluetooth_notif_being_sent == BATTERY_NOTIF_SENDING)
+    else if (notif_confirmed == BATTERY_NOTIF_SENDING)
     {
         /* From battery service */
         if(notification_status->status == AT_BLE_SUCCESS)
@@ -366,8 +479,8 @@ static at_ble_status_t logic_bluetooth_notification_confirmed_callback(void* par
         }
     }
     
-    /* Reset flag */
-    logic_bluetooth_notif_being_sent = NONE_NOTIF_SENDING;
+    /* Next raw HID packet, also when it was waiting for room in our notifications FIFO */
+    logic_bluetooth_send_next_raw_hid_packet();
 
     return AT_BLE_SUCCESS;
 }
@@ -748,8 +861,9 @@ uint8_t logic_bluetooth_get_report_characteristic(uint16_t handle, uint8_t serv,
 *   \param  report_id   Report ID
 *   \param  report      Report to be send
 *   \param  len         Length of report
+*   \return RETURN_OK if the notification was handed to the BLE stack
 */
-void logic_bluetooth_update_report(uint16_t conn_handle, uint8_t serv_inst, uint8_t reportid, uint8_t* report, uint16_t len)
+ret_type_te logic_bluetooth_update_report(uint16_t conn_handle, uint8_t serv_inst, uint8_t reportid, uint8_t* report, uint16_t len)
 {
     // TODO: should we check for notification subscription?
     uint16_t status = 0;
@@ -768,12 +882,18 @@ void logic_bluetooth_update_report(uint16_t conn_handle, uint8_t serv_inst, uint
             {
                 DBG_LOG("ERROR: Couldn't send notification, reason %d", status);
             }
+            else
+            {
+                return RETURN_OK;
+            }
         }
         else
         {
             DBG_LOG("ERROR: couldn't update characteristic %d for hid instance %d and report id %d: sending %d bytes", id, serv_inst, reportid, len);
         }
     }
+    
+    return RETURN_NOK;
 }
 
 /*! \fn     logic_bluetooth_hid_profile_init(uint8_t servinst, uint8_t device, uint8_t *mode, uint8_t report_num, uint8_t *report_type, uint8_t **report_val, uint8_t *report_len, hid_info_t *info)
@@ -1563,21 +1683,35 @@ void logic_bluetooth_raw_send(uint8_t* data, uint16_t data_len)
     if (logic_bluetooth_can_communicate_with_host != FALSE)
     {
         /* Check for overflow */
-        if (data_len > sizeof(logic_bluetooth_raw_hid_data_out_buf))
+        if (data_len > sizeof(logic_bluetooth_raw_hid_queue[0]))
+        {
+            data_len = sizeof(logic_bluetooth_raw_hid_queue[0]);
+        }
+        
+        /* The raw HID sender only gives us a packet when our queue has room */
+        if (logic_bluetooth_raw_hid_queue_nb_packets == ARRAY_SIZE(logic_bluetooth_raw_hid_queue))
         {
-            data_len = sizeof(logic_bluetooth_raw_hid_data_out_buf);
+            DBG_LOG("ERROR: BLE raw HID queue full");
+            return;
         }
         
-        /* Copy data to buffer */
-        memset(logic_bluetooth_raw_hid_data_out_buf, 0, sizeof(logic_bluetooth_raw_hid_data_out_buf));
-        memcpy(logic_bluetooth_raw_hid_data_out_buf, data, data_len);
+        /* Copy data to the end of our queue */
+        uint8_t* packet_pt = logic_bluetooth_raw_hid_queue[(logic_bluetooth_raw_hid_queue_read_idx + logic_bluetooth_raw_hid_queue_nb_packets) % ARRAY_SIZE(logic_bluetooth_raw_hid_queue)];
+        memset(packet_pt, 0, sizeof(logic_bluetooth_raw_hid_queue[0]));
+        memcpy(packet_pt, data, data_len);
+        logic_bluetooth_raw_hid_queue_nb_packets++;
         
         /* Debug */
-        DBG_LOG("BLE send: %02x %02x %02x%02x %02x%02x", logic_bluetooth_raw_hid_data_out_buf[0], logic_bluetooth_raw_hid_data_out_buf[1], logic_bluetooth_raw_hid_data_out_buf[2], logic_bluetooth_raw_hid_data_out_buf[3], logic_bluetooth_raw_hid_data_out_buf[4], logic_bluetooth_raw_hid_data_out_buf[5]);
+        DBG_LOG("BLE send: %02x %02x %02x%02x %02x%02x", packet_pt[0], packet_pt[1], packet_pt[2], packet_pt[3], packet_pt[4], packet_pt[5]);
+        
+        /* Send it if the BLE stack is done with the previous one */
+        logic_bluetooth_send_next_raw_hid_packet();
         
-        /* Send data */
-        logic_bluetooth_notif_being_sent = RAW_HID_NOTIF_SENDING;
-        logic_bluetooth_update_report(logic_bluetooth_ble_connection_handle, BLE_RAW_HID_SERVICE_INSTANCE, BLE_RAW_HID_IN_REPORT_NB, logic_bluetooth_raw_hid_data_out_buf, sizeof(logic_bluetooth_raw_hid_data_out_buf));
+        /* Otherwise the send callback is called once the first queued packet is confirmed */
+        if (logic_bluetooth_raw_hid_queue_nb_packets < ARRAY_SIZE(logic_bluetooth_raw_hid_queue))
+        {
+            comms_raw_hid_send_callback(BLE_INTERFACE);
+        }
     }
     else
     {
@@ -1594,14 +1728,29 @@ void logic_bluetooth_raw_send(uint8_t* data, uint16_t data_len)
 */
 ret_type_te logic_bluetooth_send_modifier_and_key(uint8_t modifier, uint8_t key, uint8_t second_key)
 {
-    if (logic_bluetooth_can_communicate_with_host != FALSE)
+    uint8_t keys[2] = {key, second_key};
+    return logic_bluetooth_send_modifier_and_keys(modifier, keys, ARRAY_SIZE(keys));
+}
+
+/*! \fn     logic_bluetooth_send_modifier_and_keys(uint8_t modifier, uint8_t* keys, uint16_t nb_keys)
+*   \brief  Send modifier and up to 6 keys through keyboard link
+*   \param  modifier    HID modifier
+*   \param  keys        HID keys
+*   \param  nb_keys     Number of keys
+*   \return If we were able to correctly type
+*/
+ret_type_te logic_bluetooth_send_modifier_and_keys(uint8_t modifier, uint8_t* keys, uint16_t nb_keys)
+{
+    if ((logic_bluetooth_can_communicate_with_host != FALSE) && (nb_keys <= sizeof(logic_bluetooth_keyboard_in_report) - 2) && (logic_bluetooth_can_add_notif_being_sent() != FALSE))
     {
-        logic_bluetooth_notif_being_sent = KEYBOARD_NOTIF_SENDING;
         logic_bluetooth_keyboard_in_report[0] = modifier;
-        logic_bluetooth_keyboard_in_report[2] = key;
-        logic_bluetooth_keyboard_in_report[3] = second_key;
+        memset(&logic_bluetooth_keyboard_in_report[2], 0, sizeof(logic_bluetooth_keyboard_in_report) - 2);
+        memcpy(&logic_bluetooth_keyboard_in_report[2], keys, nb_keys);
         logic_bluetooth_typed_report_sent = FALSE;
-        logic_bluetooth_update_report(logic_bluetooth_ble_connection_handle, BLE_KEYBOARD_HID_SERVICE_INSTANCE, BLE_KEYBOARD_HID_IN_REPORT_NB, logic_bluetooth_keyboard_in_report, sizeof(logic_bluetooth_keyboard_in_report));
+        if (logic_bluetooth_update_report(logic_bluetooth_ble_connection_handle, BLE_KEYBOARD_HID_SERVICE_INSTANCE, BLE_KEYBOARD_HID_IN_REPORT_NB, logic_bluetooth_keyboard_in_report, sizeof(logic_bluetooth_keyboard_in_report)) == RETURN_OK)
+        {
+            logic_bluetooth_add_notif_being_sent(KEYBOARD_NOTIF_SENDING);
+        }
         
         /* OK I'm still not sure about this one... but I think it should be OK. Stack trace is main > comms_main_mcu_routine > comms_main_mcu_deal_with_non_usb_non_ble_message > logic_keyboard_type_symbol > logic_keyboard_type_key_with_modifier to here */
         timer_start_timer(TIMER_BT_TYPING_TIMEOUT, 1000);
@@ -1633,7 +1782,7 @@ ret_type_te logic_bluetooth_send_modifier_and_key(uint8_t modifier, uint8_t key,
 void logic_bluetooth_routine(void)
 {
     /* Update battery pct if needed */
-    if (logic_bluetooth_pending_battery_level != UINT8_MAX)
+    if ((logic_bluetooth_pending_battery_level != UINT8_MAX) && (logic_bluetooth_can_add_notif_being_sent() != FALSE))
     {
         logic_bluetooth_ble_battery_level = logic_bluetooth_pending_battery_level;
         logic_bluetooth_pending_battery_level = UINT8_MAX;
@@ -1645,11 +1794,7 @@ void logic_bluetooth_routine(void)
             {
                 DBG_LOG("Notif battery level:%d%%", logic_bluetooth_ble_battery_level);
                 logic_bluetooth_battery_notification_flag = FALSE;
-                logic_bluetooth_notif_being_sent = BATTERY_NOTIF_SENDING;
-            }
-            else
-            {
-                logic_bluetooth_notif_being_sent = NONE_NOTIF_SENDING;
+                logic_bluetooth_add_notif_being_sent(BATTERY_NOTIF_SENDING);
             }
         }
     }
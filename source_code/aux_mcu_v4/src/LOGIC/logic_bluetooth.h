@@ -26,6 +26,10 @@ typedef enum    {NONE_NOTIF_SENDING = 0, KEYBOARD_NOTIF_SENDING, RAW_HID_NOTIF_S
 #define BLE_MAX_REPORTS_FOR_GIVEN_SVC       2
 #define HID_MAX_SERV_INST				    2
 #define HID_MAX_CHARACTERISTIC              7
+/* Raw HID packets copied in our queue, only the first one being handed to the BLE stack */
+#define BLE_RAW_HID_QUEUE_LENGTH            3
+/* One raw HID notification, one battery notification and keyboard notifications not confirmed in time */
+#define BLE_NOTIFS_IN_FLIGHT_FIFO_LENGTH    5
 
 /** @brief APP_HID_FAST_ADV between 0x0020 and 0x4000 in 0.625 ms units (20ms to 10.24s). */
 //	<o> Fast Advertisement Interval <100-1000:50>
@@ -272,8 +276,9 @@ typedef struct hid_reportref_desc
 /* Prototypes */
 void logic_bluetooth_hid_profile_init(uint8_t servinst, uint8_t device, uint8_t* mode, uint8_t report_num, uint8_t* report_type, uint8_t** report_val, uint8_t* report_len, hid_info_t* info);
 void logic_bluetooth_boot_key_report_update(at_ble_handle_t conn_handle, uint8_t serv_inst, uint8_t* bootreport, uint16_t len);
-void logic_bluetooth_update_report(uint16_t conn_handle, uint8_t serv_inst, uint8_t reportid, uint8_t* report, uint16_t len);
+ret_type_te logic_bluetooth_update_report(uint16_t conn_handle, uint8_t serv_inst, uint8_t reportid, uint8_t* report, uint16_t len);
 void logic_bluetooth_successfull_pairing_call(ble_connected_dev_info_t* dev_info, at_ble_connected_t* connected_info);
+ret_type_te logic_bluetooth_send_modifier_and_keys(uint8_t modifier, uint8_t* keys, uint16_t nb_keys);
 ret_type_te logic_bluetooth_send_modifier_and_key(uint8_t modifier, uint8_t key, uint8_t second_key);
 uint8_t logic_bluetooth_get_report_characteristic(uint16_t handle, uint8_t serv, uint8_t reportid);
 uint8_t logic_bluetooth_get_notif_instance(uint8_t serv_num, uint16_t char_handle);
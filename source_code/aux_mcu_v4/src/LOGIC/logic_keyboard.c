@@ -8,10 +8,212 @@
 #include "platform_defines.h"
 #include "logic_bluetooth.h"
 #include "logic_keyboard.h"
+#include "comms_main_mcu.h"
 #include "driver_timer.h"
 #include "usb.h"
 /* Buffer containing the keys to be sent through USB */
 uint8_t logic_keyboard_usb_hid_keys_buffer[8];
+_Static_assert(sizeof(logic_keyboard_usb_hid_keys_buffer) == LOGIC_KEYBOARD_NB_REPORT_KEYS + 2, "Keyboard report can't fit all keys");
+/* Set when the last USB keyboard report was picked up by the host */
+volatile BOOL logic_keyboard_usb_report_sent = FALSE;
+/* Adaptive typing pacing, for USB & BLE */
+logic_keyboard_pacing_t logic_keyboard_pacing[BLE_INTERFACE+1];
+/* Currently connected BLE host: known flag, mac address and typing delay stored with its bonding information */
+BOOL logic_keyboard_ble_host_known = FALSE;
+uint8_t logic_keyboard_ble_host_mac[6];
+uint16_t logic_keyboard_ble_host_stored_delay;
+
+
+/*! \fn     logic_keyboard_usb_report_sent_callback(void)
+*   \brief  Called when a USB keyboard report was picked up by the host
+*/
+void logic_keyboard_usb_report_sent_callback(void)
+{
+    logic_keyboard_usb_report_sent = TRUE;
+}
+
+/*! \fn     logic_keyboard_set_ble_host(uint8_t* mac_address, uint16_t stored_typing_delay)
+*   \brief  Set the currently connected bonded BLE host
+*   \param  mac_address         Host mac address as stored in its bonding information, 0 if none
+*   \param  stored_typing_delay Tuned typing delay stored in its bonding information, 0 if never tuned
+*/
+void logic_keyboard_set_ble_host(uint8_t* mac_address, uint16_t stored_typing_delay)
+{
+    if (mac_address == 0)
+    {
+        logic_keyboard_ble_host_known = FALSE;
+        stored_typing_delay = 0;
+    }
+    else
+    {
+        memcpy(logic_keyboard_ble_host_mac, mac_address, sizeof(logic_keyboard_ble_host_mac));
+        logic_keyboard_ble_host_known = TRUE;
+    }
+    
+    /* Start from the value tuned for that host */
+    logic_keyboard_ble_host_stored_delay = stored_typing_delay;
+    logic_keyboard_pacing[BLE_INTERFACE].tuned_delay = stored_typing_delay;
+    logic_keyboard_pacing[BLE_INTERFACE].max_report_latency = 0;
+    logic_keyboard_pacing[BLE_INTERFACE].report_failed = FALSE;
+}
+
+/*! \fn     logic_keyboard_get_delay_between_types(hid_interface_te interface, uint16_t delay_between_types)
+*   \brief  Get the delay to apply between reports
+*   \param  interface           HID interface on which we're typing
+*   \param  delay_between_types Delay as sent by the main MCU, possibly with typing flags
+*   \return Delay in ms
+*/
+static uint16_t logic_keyboard_get_delay_between_types(hid_interface_te interface, uint16_t delay_between_types)
+{
+    uint16_t max_delay = delay_between_types & KEYBOARD_TYPE_DELAY_MASK;
+    
+    if (((delay_between_types & KEYBOARD_TYPE_ADAPTIVE_DELAY_FLAG) == 0) || (interface > BLE_INTERFACE))
+    {
+        return max_delay;
+    }
+    
+    /* Not tuned yet: start from the user set delay */
+    if ((logic_keyboard_pacing[interface].tuned_delay == 0) || (logic_keyboard_pacing[interface].tuned_delay > max_delay))
+    {
+        return max_delay;
+    }
+    else
+    {
+        return logic_keyboard_pacing[interface].tuned_delay;
+    }
+}
+
+/*! \fn     logic_keyboard_send_report(hid_interface_te interface, uint8_t modifier, uint8_t* keys, uint16_t nb_keys, BOOL measure_latency)
+*   \brief  Send a keyboard report
+*   \param  interface           HID interface on which to send the report
+*   \param  modifier            Modifier (alt, shift...)
+*   \param  keys                Keys to send
+*   \param  nb_keys             Number of keys, up to LOGIC_KEYBOARD_NB_REPORT_KEYS
+*   \param  measure_latency     Set to wait for the report completion and record its latency for adaptive pacing
+*   \return If we were able to send the report
+*/
+static ret_type_te logic_keyboard_send_report(hid_interface_te interface, uint8_t modifier, uint8_t* keys, uint16_t nb_keys, BOOL measure_latency)
+{
+    uint32_t send_start_systick = timer_get_systick();
+    uint32_t report_latency;
+    
+    if (interface == USB_INTERFACE)
+    {
+        logic_keyboard_usb_hid_keys_buffer[0] = modifier;
+        memset(&logic_keyboard_usb_hid_keys_buffer[2], 0, LOGIC_KEYBOARD_NB_REPORT_KEYS);
+        memcpy(&logic_keyboard_usb_hid_keys_buffer[2], keys, nb_keys);
+        logic_keyboard_usb_report_sent = FALSE;
+        usb_send(USB_KEYBOARD_ENDPOINT, (uint8_t*)logic_keyboard_usb_hid_keys_buffer, sizeof(logic_keyboard_usb_hid_keys_buffer));
+        
+        if (measure_latency == FALSE)
+        {
+            return RETURN_OK;
+        }
+        
+        /* Wait for host pickup */
+        while ((logic_keyboard_usb_report_sent == FALSE) && ((timer_get_systick() - send_start_systick) < LOGIC_KEYBOARD_REPORT_TIMEOUT_MS));
+        if (logic_keyboard_usb_report_sent == FALSE)
+        {
+            logic_keyboard_pacing[USB_INTERFACE].report_failed = TRUE;
+        }
+    }
+    else
+    {
+        /* Function returns once the notification is sent */
+        if (logic_bluetooth_send_modifier_and_keys(modifier, keys, nb_keys) != RETURN_OK)
+        {
+            if (measure_latency != FALSE)
+            {
+                logic_keyboard_pacing[BLE_INTERFACE].report_failed = TRUE;
+            }
+            return RETURN_NOK;
+        }
+        
+        if (measure_latency == FALSE)
+        {
+            return RETURN_OK;
+        }
+    }
+    
+    /* Record max latency */
+    report_latency = timer_get_systick() - send_start_systick;
+    if (report_latency > logic_keyboard_pacing[interface].max_report_latency)
+    {
+        logic_keyboard_pacing[interface].max_report_latency = (uint16_t)report_latency;
+    }
+    return RETURN_OK;
+}
+
+/*! \fn     logic_keyboard_typing_done(hid_interface_te interface, uint16_t delay_between_types, BOOL typing_success)
+*   \brief  Update the adaptive pacing once a string was typed
+*   \param  interface           HID interface on which we typed
+*   \param  delay_between_types Delay as sent by the main MCU, possibly with typing flags
+*   \param  typing_success      If the string was correctly typed
+*   \note   Pacing goes up straight away on latency increase or failure, and down by halving the gap to the target
+*/
+void logic_keyboard_typing_done(hid_interface_te interface, uint16_t delay_between_types, BOOL typing_success)
+{
+    uint16_t max_delay = delay_between_types & KEYBOARD_TYPE_DELAY_MASK;
+    
+    if (((delay_between_types & KEYBOARD_TYPE_ADAPTIVE_DELAY_FLAG) == 0) || (interface > BLE_INTERFACE))
+    {
+        return;
+    }
+    
+    logic_keyboard_pacing_t* pacing_pt = &logic_keyboard_pacing[interface];
+    uint16_t current_delay = logic_keyboard_get_delay_between_types(interface, delay_between_types);
+    uint16_t target_delay = pacing_pt->max_report_latency*LOGIC_KEYBOARD_PACING_LATENCY_FACTOR + LOGIC_KEYBOARD_PACING_MARGIN_MS;
+    uint16_t new_delay;
+    
+    if ((typing_success == FALSE) || (pacing_pt->report_failed != FALSE))
+    {
+        /* Host couldn't keep up: back off */
+        new_delay = current_delay*2;
+        if (new_delay < LOGIC_KEYBOARD_PACING_MIN_BACKOFF_MS)
+        {
+            new_delay = LOGIC_KEYBOARD_PACING_MIN_BACKOFF_MS;
+        }
+    }
+    else if (target_delay >= current_delay)
+    {
+        new_delay = target_delay;
+    }
+    else
+    {
+        new_delay = current_delay - (current_delay - target_delay + 1)/2;
+    }
+    
+    /* User set delay is the upper bound, 0 means not tuned */
+    if (new_delay > max_delay)
+    {
+        new_delay = max_delay;
+    }
+    if (new_delay == 0)
+    {
+        new_delay = 1;
+    }
+    pacing_pt->tuned_delay = new_delay;
+    pacing_pt->max_report_latency = 0;
+    pacing_pt->report_failed = FALSE;
+    
+    /* Persist BLE tuned value with the host bonding information when it moved enough */
+    if ((interface == BLE_INTERFACE) && (logic_keyboard_ble_host_known != FALSE))
+    {
+        uint16_t delay_diff = (new_delay > logic_keyboard_ble_host_stored_delay)? (new_delay - logic_keyboard_ble_host_stored_delay) : (logic_keyboard_ble_host_stored_delay - new_delay);
+        
+        if (delay_diff >= LOGIC_KEYBOARD_PACING_STORE_HYST_MS)
+        {
+            aux_mcu_message_t* temp_tx_message_pt;
+            comms_main_mcu_get_empty_packet_ready_to_be_sent(&temp_tx_message_pt, AUX_MCU_MSG_TYPE_BLE_CMD);
+            temp_tx_message_pt->ble_message.message_id = BLE_MESSAGE_STORE_TYPING_DELAY;
+            memcpy(temp_tx_message_pt->ble_message.payload, logic_keyboard_ble_host_mac, sizeof(logic_keyboard_ble_host_mac));
+            temp_tx_message_pt->ble_message.payload_as_uint16_t[sizeof(logic_keyboard_ble_host_mac)/2] = new_delay;
+            temp_tx_message_pt->payload_length1 = sizeof(temp_tx_message_pt->ble_message.message_id) + sizeof(logic_keyboard_ble_host_mac) + sizeof(uint16_t);
+            comms_main_mcu_send_message((void*)temp_tx_message_pt, (uint16_t)sizeof(aux_mcu_message_t));
+            logic_keyboard_ble_host_stored_delay = new_delay;
+        }
+    }
+}
 
 
 /*! \fn     logic_keyboard_type_lock_shortcut(hid_interface_te interface_id, uint8_t l_symbol)
@@ -42,6 +244,47 @@ void logic_keyboard_type_lock_shortcut(hid_interface_te interface_id, uint8_t l_
     }
 }
 
+/*! \fn     logic_keyboard_type_keys_with_modifier(hid_interface_te interface, uint8_t* keys, uint16_t nb_keys, uint8_t modifier, uint16_t delay_between_types)
+*   \brief  Press several distinct keys at once with a given modifier, then release them
+*   \param  interface           HID interface on which to type the keystrokes
+*   \param  keys                Keys to send
+*   \param  nb_keys             Number of keys, up to LOGIC_KEYBOARD_NB_REPORT_KEYS
+*   \param  modifier            Modifier (alt, shift...)
+*   \param  delay_between_types Delay between types in ms, possibly with typing flags
+*   \return If we were able to type the keys
+*/
+static ret_type_te logic_keyboard_type_keys_with_modifier(hid_interface_te interface, uint8_t* keys, uint16_t nb_keys, uint8_t modifier, uint16_t delay_between_types)
+{
+    BOOL adaptive_pacing = ((delay_between_types & KEYBOARD_TYPE_ADAPTIVE_DELAY_FLAG) != 0)? TRUE : FALSE;
+    uint16_t report_delay = logic_keyboard_get_delay_between_types(interface, delay_between_types);
+    
+    // Send modifier
+    if (modifier != 0)
+    {
+        if (logic_keyboard_send_report(interface, modifier, keys, 0, adaptive_pacing) != RETURN_OK)
+        {
+            return RETURN_NOK;
+        }
+        timer_delay_ms(report_delay);
+    }
+    
+    // Send modifier + keys
+    if (logic_keyboard_send_report(interface, modifier, keys, nb_keys, adaptive_pacing) != RETURN_OK)
+    {
+        return RETURN_NOK;
+    }
+    timer_delay_ms(report_delay);
+    
+    // Release all
+    if (logic_keyboard_send_report(interface, 0, keys, 0, adaptive_pacing) != RETURN_OK)
+    {
+        return RETURN_NOK;
+    }
+    timer_delay_ms(report_delay);
+    
+    return RETURN_OK; 
+}
+
 /*! \fn     logic_keyboard_type_key_with_modifier(hid_interface_te interface, uint8_t key, uint8_t modifier, uint16_t delay_between_types)
 *   \brief  Perform a single keystroke
 *   \param  interface           HID interface on which to type the keystroke
@@ -51,57 +294,47 @@ void logic_keyboard_type_lock_shortcut(hid_interface_te interface_id, uint8_t l_
 *   \return If we were able to type the key
 */
 ret_type_te logic_keyboard_type_key_with_modifier(hid_interface_te interface, uint8_t key, uint8_t modifier, uint16_t delay_between_types)
-{        
-    // Send modifier
-    if (modifier != 0)
+{
+    return logic_keyboard_type_keys_with_modifier(interface, &key, 1, modifier, delay_between_types);
+}
+
+/*! \fn     logic_keyboard_get_key_and_modifier(uint8_t symbol, uint8_t* key, uint8_t* modifier)
+*   \brief  Get the HID key and modifier for an encoded symbol
+*   \param  symbol      The symbol
+*   \param  key         Where to store the HID key
+*   \param  modifier    Where to store the modifier
+*/
+static void logic_keyboard_get_key_and_modifier(uint8_t symbol, uint8_t* key, uint8_t* modifier)
+{
+    uint8_t masked_key = symbol & (SHIFT_MASK|ALTGR_MASK);
+    
+    if (masked_key == (SHIFT_MASK|ALTGR_MASK))
     {
-        if (interface == USB_INTERFACE)
-        {
-            logic_keyboard_usb_hid_keys_buffer[0] = modifier;
-            usb_send(USB_KEYBOARD_ENDPOINT, (uint8_t*)logic_keyboard_usb_hid_keys_buffer, sizeof(logic_keyboard_usb_hid_keys_buffer));
-        } 
-        else
-        {
-            if (logic_bluetooth_send_modifier_and_key(modifier, 0, 0) != RETURN_OK)
-            {
-                return RETURN_NOK;
-            }
-        }
-        timer_delay_ms(delay_between_types);
+        *modifier = KEY_SHIFT|KEY_RIGHT_ALT;
     }
-    
-    // Send modifier + key
-    if (interface == USB_INTERFACE)
+    else if (masked_key == SHIFT_MASK)
     {
-        logic_keyboard_usb_hid_keys_buffer[2] = key;
-        usb_send(USB_KEYBOARD_ENDPOINT, (uint8_t*)logic_keyboard_usb_hid_keys_buffer, sizeof(logic_keyboard_usb_hid_keys_buffer));
+        *modifier = KEY_SHIFT;
+    }
+    else if (masked_key == ALTGR_MASK)
+    {
+        // We need altgr for the numbered keys, only possible because we don't use the numerical keypad
+        *modifier = KEY_RIGHT_ALT;
     }
     else
     {
-        if (logic_bluetooth_send_modifier_and_key(modifier, key, 0) != RETURN_OK)
-        {
-            return RETURN_NOK;
-        }
+        *modifier = 0;
     }
-    timer_delay_ms(delay_between_types);
     
-    // Release all
-    if (interface == USB_INTERFACE)
+    if ((symbol & 0x3F) == KEY_EUROPE_2)
     {
-        logic_keyboard_usb_hid_keys_buffer[0] = 0;
-        logic_keyboard_usb_hid_keys_buffer[2] = 0;
-        usb_send(USB_KEYBOARD_ENDPOINT, (uint8_t*)logic_keyboard_usb_hid_keys_buffer, sizeof(logic_keyboard_usb_hid_keys_buffer));
+        // Because of a redefine of KEY_EUROPE_2 for storage purposes we need to do that
+        *key = KEY_EUROPE_2_REAL;
     }
     else
     {
-        if (logic_bluetooth_send_modifier_and_key(0, 0, 0) != RETURN_OK)
-        {
-            return RETURN_NOK;
-        }
+        *key = symbol & ~(SHIFT_MASK|ALTGR_MASK);
     }
-    timer_delay_ms(delay_between_types);    
-    
-    return RETURN_OK; 
 }
 
 /*! \fn     logic_keyboard_type_symbol(hid_interface_te interface, uint8_t symbol, BOOL is_dead_key, uint16_t delay_between_types)
@@ -114,54 +347,93 @@ ret_type_te logic_keyboard_type_key_with_modifier(hid_interface_te interface, ui
 */
 ret_type_te logic_keyboard_type_symbol(hid_interface_te interface, uint8_t symbol, BOOL is_dead_key, uint16_t delay_between_types)
 {
-    uint8_t masked_key = symbol & (SHIFT_MASK|ALTGR_MASK);
     ret_type_te return_val;
-        
-    if ((symbol & 0x3F) == KEY_EUROPE_2)
+    uint8_t modifier;
+    uint8_t key;
+    
+    logic_keyboard_get_key_and_modifier(symbol, &key, &modifier);
+    return_val = logic_keyboard_type_key_with_modifier(interface, key, modifier, delay_between_types);
+    
+    /* Add space if typed character is a dead key */
+    if ((is_dead_key != FALSE) && (return_val == RETURN_OK))
     {
-        // Because of a redefine of KEY_EUROPE_2 for storage purposes we need to do that
-        uint8_t mod_tbs = 0;
-            
-        if (masked_key == (SHIFT_MASK|ALTGR_MASK))
+        return_val = logic_keyboard_type_key_with_modifier(interface, KEY_SPACE, 0, delay_between_types);        
+    }
+    
+    return return_val;
+}
+
+/*! \fn     logic_keyboard_type_symbols_with_rollover(hid_interface_te interface, uint16_t* symbols, uint16_t delay_between_types)
+*   \brief  Type a 0 terminated string of encoded symbols, packing consecutive keys into a single report
+*   \param  interface           HID interface on which to type the symbols
+*   \param  symbols             The symbols, as sent by the main MCU
+*   \param  delay_between_types Delay between reports, possibly with typing flags
+*   \return If we were able to type all symbols
+*   \note   Keys sharing a report have the same modifier and are all distinct, duplicates get a release in between
+*   \note   Dead keys and two keys symbols are typed on their own as they rely on the press order
+*/
+ret_type_te logic_keyboard_type_symbols_with_rollover(hid_interface_te interface, uint16_t* symbols, uint16_t delay_between_types)
+{
+    uint8_t report_keys[LOGIC_KEYBOARD_NB_REPORT_KEYS];
+    uint16_t nb_report_keys = 0;
+    uint8_t report_modifier = 0;
+    uint8_t modifier;
+    uint8_t key;
+    
+    for (uint16_t i = 0; symbols[i] != 0; i++)
+    {
+        uint16_t symbol = symbols[i];
+        
+        /* Original unicode point can't be typed */
+        if (symbol == 0xFFFF)
         {
-            mod_tbs = KEY_SHIFT|KEY_RIGHT_ALT;
+            continue;
         }
-        else if (masked_key == SHIFT_MASK)
+        
+        logic_keyboard_get_key_and_modifier((uint8_t)symbol, &key, &modifier);
+        
+        /* Flush current report if that key can't join it */
+        if ((nb_report_keys != 0) && (((symbol & 0xFF00) != 0) || (modifier != report_modifier) || (nb_report_keys == LOGIC_KEYBOARD_NB_REPORT_KEYS) || (memchr(report_keys, key, nb_report_keys) != 0)))
         {
-            mod_tbs = KEY_SHIFT;
+            if (logic_keyboard_type_keys_with_modifier(interface, report_keys, nb_report_keys, report_modifier, delay_between_types) != RETURN_OK)
+            {
+                return RETURN_NOK;
+            }
+            nb_report_keys = 0;
         }
-        else if (masked_key == ALTGR_MASK)
+        
+        if ((symbol & 0xFF00) == 0)
         {
-            mod_tbs = KEY_RIGHT_ALT;
+            /* Join current report */
+            report_modifier = modifier;
+            report_keys[nb_report_keys++] = key;
+        }
+        else if ((symbol & 0x7F00) == 0)
+        {
+            /* Dead key, followed by a space */
+            if (logic_keyboard_type_symbol(interface, (uint8_t)symbol, TRUE, delay_between_types) != RETURN_OK)
+            {
+                return RETURN_NOK;
+            }
+        }
+        else
+        {
+            /* Two keys to be typed */
+            if (logic_keyboard_type_symbol(interface, (uint8_t)(symbol >> 8), FALSE, delay_between_types) != RETURN_OK)
+            {
+                return RETURN_NOK;
+            }
+            if (logic_keyboard_type_symbol(interface, (uint8_t)symbol, FALSE, delay_between_types) != RETURN_OK)
+            {
+                return RETURN_NOK;
+            }
         }
-            
-        // Send the correct KEY_EUROPE_2 with the correct modifier
-        return_val = logic_keyboard_type_key_with_modifier(interface, KEY_EUROPE_2_REAL, mod_tbs, delay_between_types);
-    }
-    else if (masked_key == (SHIFT_MASK|ALTGR_MASK))
-    {
-        return_val = logic_keyboard_type_key_with_modifier(interface, symbol & ~(SHIFT_MASK|ALTGR_MASK), KEY_SHIFT|KEY_RIGHT_ALT, delay_between_types);
-    }
-    else if (masked_key == SHIFT_MASK)
-    {
-        // If we need shift
-        return_val = logic_keyboard_type_key_with_modifier(interface, symbol & ~SHIFT_MASK, KEY_SHIFT, delay_between_types);
-    }
-    else if (masked_key == ALTGR_MASK)
-    {
-        // We need altgr for the numbered keys, only possible because we don't use the numerical keypad
-        return_val = logic_keyboard_type_key_with_modifier(interface, symbol & ~ALTGR_MASK, KEY_RIGHT_ALT, delay_between_types);
-    }
-    else
-    {
-        return_val = logic_keyboard_type_key_with_modifier(interface, symbol, 0, delay_between_types);
     }
     
-    /* Add space if typed character is a dead key */
-    if ((is_dead_key != FALSE) && (return_val == RETURN_OK))
+    /* Type remaining keys */
+    if (nb_report_keys != 0)
     {
-        return_val = logic_keyboard_type_key_with_modifier(interface, KEY_SPACE, 0, delay_between_types);        
+        return logic_keyboard_type_keys_with_modifier(interface, report_keys, nb_report_keys, report_modifier, delay_between_types);
     }
-    
-    return return_val;
-}
\ No newline at end of file
+    return RETURN_OK;
+}
@@ -12,6 +12,12 @@
 #include "defines.h"
 
 /* Defines */
+#define LOGIC_KEYBOARD_NB_REPORT_KEYS           6
+#define LOGIC_KEYBOARD_REPORT_TIMEOUT_MS        50
+#define LOGIC_KEYBOARD_PACING_LATENCY_FACTOR    2
+#define LOGIC_KEYBOARD_PACING_MARGIN_MS         1
+#define LOGIC_KEYBOARD_PACING_MIN_BACKOFF_MS    4
+#define LOGIC_KEYBOARD_PACING_STORE_HYST_MS     3
 #define SHIFT_MASK  0x80
 #define ALTGR_MASK  0x40
 #define KEY_CTRL               0x01
@@ -133,9 +139,21 @@
 #define KEY_F15                0x6A
 #define KEY_WIN_L              0xE3
 
+/* Typedefs */
+typedef struct
+{
+    uint16_t tuned_delay;           // Tuned delay between reports in ms, 0 if not tuned yet
+    uint16_t max_report_latency;    // Max report completion latency seen while typing the current string
+    BOOL report_failed;             // A report timed out or failed while typing the current string
+} logic_keyboard_pacing_t;
+
 /* Prototypes */
 ret_type_te logic_keyboard_type_key_with_modifier(hid_interface_te interface, uint8_t key, uint8_t modifier, uint16_t delay_between_types);
 ret_type_te logic_keyboard_type_symbol(hid_interface_te interface, uint8_t symbol, BOOL is_dead_key, uint16_t delay_between_types);
+ret_type_te logic_keyboard_type_symbols_with_rollover(hid_interface_te interface, uint16_t* symbols, uint16_t delay_between_types);
+void logic_keyboard_typing_done(hid_interface_te interface, uint16_t delay_between_types, BOOL typing_success);
 void logic_keyboard_type_lock_shortcut(hid_interface_te interface_id, uint8_t l_symbol);
+void logic_keyboard_set_ble_host(uint8_t* mac_address, uint16_t stored_typing_delay);
+void logic_keyboard_usb_report_sent_callback(void);
 
 #endif /* LOGIC_KEYBOARD_H_ */
\ No newline at end of file
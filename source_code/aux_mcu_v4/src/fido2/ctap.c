@@ -9,6 +9,8 @@
 // Modifications:
 // -Removed code related to U2F
 // -Removed code related to PIN
+// -Other CTAP channels are served while waiting for the main MCU
+// -getInfo response is encoded once and then served from a cache
 //
 #include <stdio.h>
 #include <stdlib.h>
@@ -25,6 +27,10 @@
 #include "ctap.h"
 #include "cbor.h"
 
+// getInfo response never changes: it is encoded on first request
+static uint8_t ctap_get_info_cache[CTAP_GET_INFO_CACHE_SIZE];
+static uint16_t ctap_get_info_cache_length = 0;
+
 uint8_t ctap_get_info(CborEncoder * encoder)
 {
     int ret;
@@ -107,6 +113,54 @@ uint8_t ctap_get_info(CborEncoder * encoder)
     return CTAP1_ERR_SUCCESS;
 }
 
+/*
+ * MiniBLE: browsers query getInfo for every ceremony, serve it from a cache
+ * Also used to answer getInfo without a CTAP_RESPONSE while another request waits for the main MCU
+ */
+uint8_t ctap_get_info_cache_data(uint8_t ** data, uint16_t * length)
+{
+    CborEncoder encoder;
+    uint8_t status;
+
+    if (ctap_get_info_cache_length == 0)
+    {
+        memset(&encoder, 0, sizeof(CborEncoder));
+        cbor_encoder_init(&encoder, ctap_get_info_cache, sizeof(ctap_get_info_cache), 0);
+        status = ctap_get_info(&encoder);
+        if (status != CTAP1_ERR_SUCCESS)
+        {
+            return status;
+        }
+        ctap_get_info_cache_length = cbor_encoder_get_buffer_size(&encoder, ctap_get_info_cache);
+    }
+
+    *data = ctap_get_info_cache;
+    *length = ctap_get_info_cache_length;
+    return CTAP1_ERR_SUCCESS;
+}
+
+uint8_t ctap_get_info_cached(CTAP_RESPONSE * resp)
+{
+    uint16_t length;
+    uint8_t * data;
+    uint8_t status;
+
+    status = ctap_get_info_cache_data(&data, &length);
+    if (status != CTAP1_ERR_SUCCESS)
+    {
+        return status;
+    }
+
+    if (length > resp->data_size)
+    {
+        return CTAP1_ERR_OTHER;
+    }
+
+    memcpy(resp->data, data, length);
+    resp->length = length;
+    return CTAP1_ERR_SUCCESS;
+}
+
 static int ctap_add_cose_key(CborEncoder * cose_key, uint8_t * x, uint8_t * y)
 {
     int ret;
@@ -195,6 +249,9 @@ static ret_type_te ctap_make_credential_aux_comm(CTAP_requestCommon *common, CTA
         while ((timer_has_timer_expired(TIMER_TIMEOUT_FUNCTS, TRUE) == TIMER_RUNNING) && (ret != RETURN_OK))
         {
             ret = comms_main_mcu_routine(TRUE, AUX_MCU_MSG_TYPE_FIDO2, TRUE);
+
+            /* Serve other CTAP channels in the meantime */
+            comms_raw_hid_ctap_routine();
         }
         timer_start_timer(TIMER_TIMEOUT_FUNCTS, 50);
         ctaphid_update_status(2);
@@ -309,6 +366,9 @@ static ret_type_te ctap_get_assertion_aux_comm(CTAP_requestCommon *common, CTAP_
         while ((timer_has_timer_expired(TIMER_TIMEOUT_FUNCTS, TRUE) == TIMER_RUNNING) && (ret != RETURN_OK))
         {
             ret = comms_main_mcu_routine(TRUE, AUX_MCU_MSG_TYPE_FIDO2, TRUE);
+
+            /* Serve other CTAP channels in the meantime */
+            comms_raw_hid_ctap_routine();
         }
         timer_start_timer(TIMER_TIMEOUT_FUNCTS, 50);
         ctaphid_update_status(2);
@@ -482,6 +542,9 @@ int ctap_authenticate_credential(struct rpId * rp, CTAP_credentialDescriptor * d
         while ((timer_has_timer_expired(TIMER_TIMEOUT_FUNCTS, TRUE) == TIMER_RUNNING) && (ret != RETURN_OK))
         {
             ret = comms_main_mcu_routine(TRUE, AUX_MCU_MSG_TYPE_FIDO2, TRUE);
+
+            /* Serve other CTAP channels in the meantime */
+            comms_raw_hid_ctap_routine();
         }
         timer_start_timer(TIMER_TIMEOUT_FUNCTS, 50);
         ctaphid_update_status(2);
@@ -802,9 +865,7 @@ uint8_t ctap_request(uint8_t * pkt_raw, int length, CTAP_RESPONSE * resp)
             break;
         case CTAP_GET_INFO:
             printf1(TAG_CTAP,"CTAP_GET_INFO");
-            status = ctap_get_info(&encoder);
-
-            resp->length = cbor_encoder_get_buffer_size(&encoder, buf);
+            status = ctap_get_info_cached(resp);
 
             dump_hex1(TAG_DUMP, buf, resp->length);
 
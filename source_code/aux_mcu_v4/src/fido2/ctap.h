@@ -111,6 +111,7 @@
 #define DISPLAY_NAME_LIMIT          65  // Must be minimum of 64 bytes but can be more.
 #define ICON_LIMIT                  128 // Must be minimum of 64 bytes but can be more.
 #define CTAP_MAX_MESSAGE_SIZE       1024
+#define CTAP_GET_INFO_CACHE_SIZE    128
 
 #define CREDENTIAL_TAG_SIZE         16
 
@@ -284,6 +285,8 @@ uint8_t ctap_add_attest_statement(CborEncoder * map, uint8_t * sigder, int len);
 uint8_t ctap_add_user_entity(CborEncoder * map, CTAP_userEntity * user);
 void ctap_update_pin(uint8_t * pin, int len);
 uint8_t ctap_get_info(CborEncoder * encoder);
+uint8_t ctap_get_info_cache_data(uint8_t ** data, uint16_t * length);
+uint8_t ctap_get_info_cached(CTAP_RESPONSE * resp);
 uint8_t ctap_decrement_pin_attempts(void);
 int8_t ctap_leftover_pin_attempts(void);
 void ctap_reset_pin_attempts(void);
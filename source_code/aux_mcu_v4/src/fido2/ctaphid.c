@@ -7,6 +7,7 @@
 //
 // Modified by MiniBLE developers
 // -Removed Solo specific message support
+// -Per channel reassembly buffers, requests needing the main MCU are queued
 //
 #include <stdio.h>
 #include <stdlib.h>
@@ -44,6 +45,17 @@ typedef struct
     uint8_t buf[HID_MESSAGE_SIZE];
 } CTAPHID_WRITE_BUFFER;
 
+typedef struct
+{
+    uint8_t buf[CTAPHID_BUFFER_SIZE];
+    uint32_t cid;
+    int cmd;
+    uint16_t bcnt;
+    int offset;
+    int seq;
+    uint32_t queue_ticket;
+} CTAPHID_RX_BUFFER;
+
 struct CID
 {
     uint32_t cid;
@@ -62,14 +74,16 @@ static struct CID CIDS[5];
 
 static uint64_t active_cid_timestamp;
 
-static uint8_t ctap_buffer[CTAPHID_BUFFER_SIZE];
-static uint32_t ctap_buffer_cid;
-static int ctap_buffer_cmd;
-static uint16_t ctap_buffer_bcnt;
-static int ctap_buffer_offset;
-static int ctap_packet_seq;
+// One reassembly buffer per channel with a request in progress
+static CTAPHID_RX_BUFFER ctap_buffers[CTAPHID_NB_RX_BUFFERS];
+// Buffer of the request currently waiting for the main MCU, NULL if none
+static CTAPHID_RX_BUFFER * ctap_in_flight_buffer;
+// CBOR response, only used by requests processed outside of a main MCU wait: ~1KB kept off the 8KB stack
+static CTAP_RESPONSE ctap_resp;
+// Incremented each time a request is queued, to serve queued requests in order
+static uint32_t ctap_queue_ticket;
 
-static void buffer_reset(void);
+static void buffer_reset(CTAPHID_RX_BUFFER * rxb);
 
 #define CTAPHID_WRITE_INIT      0x01
 #define CTAPHID_WRITE_FLUSH     0x02
@@ -80,8 +94,13 @@ static void ctaphid_write(CTAPHID_WRITE_BUFFER * wb, void * _data, int len);
 
 void ctaphid_init(void)
 {
+    uint32_t i;
     state = IDLE;
-    buffer_reset();
+    for (i = 0; i < CTAPHID_NB_RX_BUFFERS; i++)
+    {
+        buffer_reset(&ctap_buffers[i]);
+    }
+    ctap_in_flight_buffer = NULL;
     //ctap_reset_state();
 }
 
@@ -169,24 +188,24 @@ static int is_cont_pkt(CTAPHID_PACKET * pkt)
 }
 
 
-static int buffer_packet(CTAPHID_PACKET * pkt)
+static int buffer_packet(CTAPHID_RX_BUFFER * rxb, CTAPHID_PACKET * pkt)
 {
     if (pkt->pkt.init.cmd & TYPE_INIT)
     {
-        ctap_buffer_bcnt = ctaphid_packet_len(pkt);
-        int pkt_len = (ctap_buffer_bcnt < CTAPHID_INIT_PAYLOAD_SIZE) ? ctap_buffer_bcnt : CTAPHID_INIT_PAYLOAD_SIZE;
-        ctap_buffer_cmd = pkt->pkt.init.cmd;
-        ctap_buffer_cid = pkt->cid;
-        ctap_buffer_offset = pkt_len;
-        ctap_packet_seq = -1;
-        memmove(ctap_buffer, pkt->pkt.init.payload, pkt_len);
+        rxb->bcnt = ctaphid_packet_len(pkt);
+        int pkt_len = (rxb->bcnt < CTAPHID_INIT_PAYLOAD_SIZE) ? rxb->bcnt : CTAPHID_INIT_PAYLOAD_SIZE;
+        rxb->cmd = pkt->pkt.init.cmd;
+        rxb->cid = pkt->cid;
+        rxb->offset = pkt_len;
+        rxb->seq = -1;
+        memmove(rxb->buf, pkt->pkt.init.payload, pkt_len);
     }
     else
     {
-        int leftover = ctap_buffer_bcnt - ctap_buffer_offset;
+        int leftover = rxb->bcnt - rxb->offset;
         int diff = leftover - CTAPHID_CONT_PAYLOAD_SIZE;
-        ctap_packet_seq++;
-        if (ctap_packet_seq != pkt->pkt.cont.seq)
+        rxb->seq++;
+        if (rxb->seq != pkt->pkt.cont.seq)
         {
             return SEQUENCE_ERROR;
         }
@@ -194,33 +213,34 @@ static int buffer_packet(CTAPHID_PACKET * pkt)
         if (diff <= 0)
         {
             // only move the leftover amount
-            memmove(ctap_buffer + ctap_buffer_offset, pkt->pkt.cont.payload, leftover);
-            ctap_buffer_offset += leftover;
+            memmove(rxb->buf + rxb->offset, pkt->pkt.cont.payload, leftover);
+            rxb->offset += leftover;
         }
         else
         {
-            memmove(ctap_buffer + ctap_buffer_offset, pkt->pkt.cont.payload, CTAPHID_CONT_PAYLOAD_SIZE);
-            ctap_buffer_offset += CTAPHID_CONT_PAYLOAD_SIZE;
+            memmove(rxb->buf + rxb->offset, pkt->pkt.cont.payload, CTAPHID_CONT_PAYLOAD_SIZE);
+            rxb->offset += CTAPHID_CONT_PAYLOAD_SIZE;
         }
     }
     return SUCESS;
 }
 
-static void buffer_reset(void)
+static void buffer_reset(CTAPHID_RX_BUFFER * rxb)
 {
-    ctap_buffer_bcnt = 0;
-    ctap_buffer_offset = 0;
-    ctap_packet_seq = 0;
-    ctap_buffer_cid = 0;
+    rxb->bcnt = 0;
+    rxb->offset = 0;
+    rxb->seq = 0;
+    rxb->cid = 0;
+    rxb->queue_ticket = 0;
 }
 
-static int buffer_status(void)
+static int buffer_status(CTAPHID_RX_BUFFER * rxb)
 {
-    if (ctap_buffer_bcnt == 0)
+    if ((rxb == NULL) || (rxb->cid == 0))
     {
         return EMPTY;
     }
-    else if (ctap_buffer_offset == ctap_buffer_bcnt)
+    else if (rxb->offset == rxb->bcnt)
     {
         return BUFFERED;
     }
@@ -230,20 +250,55 @@ static int buffer_status(void)
     }
 }
 
-static int buffer_cmd(void)
+// Get the buffer used by a given channel, NULL if none
+static CTAPHID_RX_BUFFER * buffer_get(uint32_t cid)
 {
-    return ctap_buffer_cmd;
+    uint32_t i;
+    for (i = 0; i < CTAPHID_NB_RX_BUFFERS; i++)
+    {
+        if ((ctap_buffers[i].cid != 0) && (ctap_buffers[i].cid == cid))
+        {
+            return &ctap_buffers[i];
+        }
+    }
+    return NULL;
 }
 
-static uint32_t buffer_cid(void)
+// Get a free buffer for a given channel, NULL if all are used
+static CTAPHID_RX_BUFFER * buffer_alloc(uint32_t cid)
 {
-    return ctap_buffer_cid;
+    uint32_t i;
+    for (i = 0; i < CTAPHID_NB_RX_BUFFERS; i++)
+    {
+        if (ctap_buffers[i].cid == 0)
+        {
+            buffer_reset(&ctap_buffers[i]);
+            ctap_buffers[i].cid = cid;
+            return &ctap_buffers[i];
+        }
+    }
+    return NULL;
 }
 
+// Get the oldest queued request, NULL if none
+static CTAPHID_RX_BUFFER * buffer_next_queued(void)
+{
+    CTAPHID_RX_BUFFER * oldest = NULL;
+    uint32_t i;
+    for (i = 0; i < CTAPHID_NB_RX_BUFFERS; i++)
+    {
+        if ((ctap_buffers[i].queue_ticket != 0) && ((oldest == NULL) || (ctap_buffers[i].queue_ticket < oldest->queue_ticket)))
+        {
+            oldest = &ctap_buffers[i];
+        }
+    }
+    return oldest;
+}
 
-static int buffer_len(void)
+// Requests that need a round trip to the main MCU (and user presence)
+static int request_needs_main_mcu(int cmd, uint16_t bcnt, uint8_t cbor_cmd)
 {
-    return ctap_buffer_bcnt;
+    return ((cmd == CTAPHID_CBOR) && (bcnt > 0) && ((cbor_cmd == CTAP_MAKE_CREDENTIAL) || (cbor_cmd == CTAP_GET_ASSERTION)));
 }
 
 // Buffer data and send in HID_MESSAGE_SIZE chunks
@@ -345,12 +400,13 @@ void ctaphid_check_timeouts(void)
     {
         if (CIDS[i].busy && ((millis() - CIDS[i].last_used) >= 750))
         {
+            CTAPHID_RX_BUFFER * rxb = buffer_get(CIDS[i].cid);
             printf1(TAG_HID, "TIMEOUT CID: %08x", CIDS[i].cid);
             ctaphid_send_error(CIDS[i].cid, CTAP1_ERR_TIMEOUT);
             CIDS[i].busy = 0;
-            if (CIDS[i].cid == buffer_cid())
+            if ((rxb != NULL) && (rxb != ctap_in_flight_buffer))
             {
-                buffer_reset();
+                buffer_reset(rxb);
             }
             // memset(CIDS + i, 0, sizeof(struct CID));
         }
@@ -362,9 +418,15 @@ void ctaphid_update_status(int8_t status)
 {
     CTAPHID_WRITE_BUFFER wb;
     //printf1(TAG_HID, "Send device update %d!",status);
+
+    if (ctap_in_flight_buffer == NULL)
+    {
+        return;
+    }
+
     ctaphid_write_buffer_init(&wb);
 
-    wb.cid = buffer_cid();
+    wb.cid = ctap_in_flight_buffer->cid;
     wb.cmd = CTAPHID_KEEPALIVE;
     wb.bcnt = 1;
 
@@ -372,9 +434,10 @@ void ctaphid_update_status(int8_t status)
     ctaphid_write(&wb, NULL, 0);
 }
 
-static int ctaphid_buffer_packet(uint32_t * pkt_raw, uint8_t * cmd, uint32_t * cid, int * len)
+static int ctaphid_buffer_packet(uint32_t * pkt_raw, uint8_t * cmd, uint32_t * cid, int * len, CTAPHID_RX_BUFFER ** rxb_pt)
 {
     CTAPHID_PACKET * pkt = (CTAPHID_PACKET *)(pkt_raw);
+    CTAPHID_RX_BUFFER * rxb;
 
     if (!is_cont_pkt(pkt)) {printf2(TAG_ERR, "  length: %d", ctaphid_packet_len(pkt));}
 
@@ -384,6 +447,7 @@ static int ctaphid_buffer_packet(uint32_t * pkt_raw, uint8_t * cmd, uint32_t * c
 
 
     *cid = pkt->cid;
+    *rxb_pt = NULL;
 
     if (is_init_pkt(pkt))
     {
@@ -400,7 +464,6 @@ static int ctaphid_buffer_packet(uint32_t * pkt_raw, uint8_t * cmd, uint32_t * c
             return HID_ERROR;
         }
 
-        ctaphid_init();
         if (is_broadcast(pkt))
         {
             // Check if any existing cids are busy first ?
@@ -415,6 +478,14 @@ static int ctaphid_buffer_packet(uint32_t * pkt_raw, uint8_t * cmd, uint32_t * c
             printf1(TAG_HID, "synchronizing to cid");
             oldcid = pkt->cid;
             newcid = pkt->cid;
+
+            // Abort any request being received or queued on this channel
+            rxb = buffer_get(newcid);
+            if ((rxb != NULL) && (rxb != ctap_in_flight_buffer))
+            {
+                buffer_reset(rxb);
+            }
+
             if (cid_exists(newcid))
                 ret = cid_refresh(newcid);
             else
@@ -439,89 +510,81 @@ static int ctaphid_buffer_packet(uint32_t * pkt_raw, uint8_t * cmd, uint32_t * c
             return HID_ERROR;
         }
 
-        if (! cid_exists(pkt->cid) && ! is_cont_pkt(pkt))
-        {
-            if (buffer_status() == EMPTY)
-            {
-                add_cid(pkt->cid);
-            }
-        }
+        rxb = buffer_get(pkt->cid);
 
-        if (cid_exists(pkt->cid))
+        if (! is_cont_pkt(pkt))
         {
-            if (buffer_status() == BUFFERING)
+            if (rxb != NULL)
             {
-                if (pkt->cid == buffer_cid() && ! is_cont_pkt(pkt))
+                if (buffer_status(rxb) == BUFFERING)
                 {
                     printf2(TAG_ERR,"INVALID_SEQ");
-                    printf2(TAG_ERR,"Have %d/%d bytes", ctap_buffer_offset, ctap_buffer_bcnt);
+                    printf2(TAG_ERR,"Have %d/%d bytes", rxb->offset, rxb->bcnt);
+                    *rxb_pt = rxb;
                     *cmd = CTAP1_ERR_INVALID_SEQ;
                     return HID_ERROR;
                 }
-                else if (pkt->cid != buffer_cid())
+
+                // Cancel a queued request, the one being processed by the main MCU can't be
+                if (pkt->pkt.init.cmd == CTAPHID_CANCEL)
                 {
-                    if (! is_cont_pkt(pkt))
+                    if (rxb != ctap_in_flight_buffer)
                     {
-                        printf2(TAG_ERR,"BUSY with %08x", buffer_cid());
-                        *cmd = CTAP1_ERR_CHANNEL_BUSY;
-                        return HID_ERROR;
-                    }
-                    else
-                    {
-                        printf2(TAG_ERR,"ignoring random cont packet from %04x",pkt->cid);
-                        return HID_IGNORE;
+                        buffer_reset(rxb);
                     }
+                    return HID_IGNORE;
                 }
-            }
-            if (! is_cont_pkt(pkt))
-            {
 
-                if (ctaphid_packet_len(pkt) > CTAPHID_BUFFER_SIZE)
-                {
-                    *cmd = CTAP1_ERR_INVALID_LENGTH;
-                    return HID_ERROR;
-                }
+                printf2(TAG_ERR,"BUSY with %08x", rxb->cid);
+                *cmd = CTAP1_ERR_CHANNEL_BUSY;
+                return HID_ERROR;
             }
-            else
+
+            if (ctaphid_packet_len(pkt) > CTAPHID_BUFFER_SIZE)
             {
-                if (buffer_status() == EMPTY || pkt->cid != buffer_cid())
-                {
-                    printf2(TAG_ERR,"ignoring random cont packet from %04x",pkt->cid);
-                    return HID_IGNORE;
-                }
+                *cmd = CTAP1_ERR_INVALID_LENGTH;
+                return HID_ERROR;
             }
 
-            if (buffer_packet(pkt) == SEQUENCE_ERROR)
+            if ((! cid_exists(pkt->cid)) && (add_cid(pkt->cid) == -1))
             {
-                printf2(TAG_ERR,"Buffering sequence error");
-                *cmd = CTAP1_ERR_INVALID_SEQ;
+                printf2(TAG_ERR,"BUSY");
+                *cmd = CTAP1_ERR_CHANNEL_BUSY;
                 return HID_ERROR;
             }
-            ret = cid_refresh(pkt->cid);
-            if (ret != 0)
+
+            rxb = buffer_alloc(pkt->cid);
+            if (rxb == NULL)
             {
-                printf2(TAG_ERR,"Error, refresh cid failed");
-                exit(1);
+                printf2(TAG_ERR,"BUSY, no free buffer");
+                *cmd = CTAP1_ERR_CHANNEL_BUSY;
+                return HID_ERROR;
             }
         }
-        else if (is_cont_pkt(pkt))
+        else if (buffer_status(rxb) != BUFFERING)
         {
-            printf2(TAG_ERR,"ignoring unwarranted cont packet");
-
-            // Ignore
+            printf2(TAG_ERR,"ignoring random cont packet from %04x",pkt->cid);
             return HID_IGNORE;
         }
-        else
+
+        *rxb_pt = rxb;
+        if (buffer_packet(rxb, pkt) == SEQUENCE_ERROR)
         {
-            printf2(TAG_ERR,"BUSY");
-            *cmd = CTAP1_ERR_CHANNEL_BUSY;
+            printf2(TAG_ERR,"Buffering sequence error");
+            *cmd = CTAP1_ERR_INVALID_SEQ;
             return HID_ERROR;
         }
+        ret = cid_refresh(pkt->cid);
+        if (ret != 0)
+        {
+            printf2(TAG_ERR,"Error, refresh cid failed");
+            exit(1);
+        }
     }
 
-    *len = buffer_len();
-    *cmd = buffer_cmd();
-    return buffer_status();
+    *len = rxb->bcnt;
+    *cmd = rxb->cmd;
+    return buffer_status(rxb);
 }
 
 extern void _check_ret(CborError ret, int line, const char * filename);
@@ -529,45 +592,19 @@ extern void _check_ret(CborError ret, int line, const char * filename);
                             if ((r) != CborNoError) exit(1);
 
 /**
- * Removed Solo specific messages
+ * Process a fully received request
  */
-uint8_t ctaphid_handle_packet(uint32_t * pkt_raw)
+static uint8_t ctaphid_process_request(CTAPHID_RX_BUFFER * rxb)
 {
-    uint8_t cmd;
-    uint32_t cid;
-    int len;
+    uint8_t cmd = rxb->cmd;
+    uint32_t cid = rxb->cid;
+    int len = rxb->bcnt;
 #ifndef DISABLE_CTAPHID_CBOR
     int status;
+    int needs_main_mcu;
 #endif
 
-    static uint8_t is_busy = 0;
-    static CTAPHID_WRITE_BUFFER wb;
-    CTAP_RESPONSE ctap_resp;
-
-    int bufstatus = ctaphid_buffer_packet(pkt_raw, &cmd, &cid, &len);
-
-    if (bufstatus == HID_IGNORE)
-    {
-        return 0;
-    }
-
-    if (bufstatus == HID_ERROR)
-    {
-        cid_del(cid);
-        if (cmd == CTAP1_ERR_INVALID_SEQ)
-        {
-            buffer_reset();
-        }
-        ctaphid_send_error(cid, cmd);
-        return 0;
-    }
-
-    if (bufstatus == BUFFERING)
-    {
-        active_cid_timestamp = millis();
-        return 0;
-    }
-
+    CTAPHID_WRITE_BUFFER wb;
 
     switch(cmd)
     {
@@ -585,7 +622,7 @@ uint8_t ctaphid_handle_packet(uint32_t * pkt_raw)
             wb.cmd = CTAPHID_PING;
             wb.bcnt = len;
             timestamp();
-            ctaphid_write(&wb, ctap_buffer, len);
+            ctaphid_write(&wb, rxb->buf, len);
             ctaphid_write(&wb, NULL,0);
             printf1(TAG_TIME,"PING writeback: %d ms",timestamp());
 
@@ -614,17 +651,44 @@ uint8_t ctaphid_handle_packet(uint32_t * pkt_raw)
             {
                 printf2(TAG_ERR,"Error,invalid 0 length field for cbor packet");
                 ctaphid_send_error(cid, CTAP1_ERR_INVALID_LENGTH);
-                return 0;
+                break;
             }
-            if (is_busy)
+
+            // Served while another request waits for the main MCU: ctap_resp is in use, only answer getInfo
+            if (ctap_in_flight_buffer != NULL)
             {
-                printf1(TAG_HID,"Channel busy for CBOR");
-                ctaphid_send_error(cid, CTAP1_ERR_CHANNEL_BUSY);
-                return 0;
+                uint16_t info_length;
+                uint8_t * info_data;
+
+                if ((rxb->buf[0] != CTAP_GET_INFO) || (ctap_get_info_cache_data(&info_data, &info_length) != CTAP1_ERR_SUCCESS))
+                {
+                    ctaphid_send_error(cid, CTAP1_ERR_CHANNEL_BUSY);
+                    break;
+                }
+
+                status = CTAP1_ERR_SUCCESS;
+                ctaphid_write_buffer_init(&wb);
+                wb.cid = cid;
+                wb.cmd = CTAPHID_CBOR;
+                wb.bcnt = (info_length+1);
+                ctaphid_write(&wb, &status, 1);
+                ctaphid_write(&wb, info_data, info_length);
+                ctaphid_write(&wb, NULL, 0);
+                break;
+            }
+
+            // Other channels are served while we wait for the main MCU
+            needs_main_mcu = request_needs_main_mcu(rxb->cmd, rxb->bcnt, rxb->buf[0]);
+            if (needs_main_mcu)
+            {
+                ctap_in_flight_buffer = rxb;
             }
-            is_busy = 1;
             ctap_response_init(&ctap_resp);
-            status = ctap_request(ctap_buffer, len, &ctap_resp);
+            status = ctap_request(rxb->buf, len, &ctap_resp);
+            if (needs_main_mcu)
+            {
+                ctap_in_flight_buffer = NULL;
+            }
 
             ctaphid_write_buffer_init(&wb);
             wb.cid = cid;
@@ -637,23 +701,75 @@ uint8_t ctaphid_handle_packet(uint32_t * pkt_raw)
             ctaphid_write(&wb, ctap_resp.data, ctap_resp.length);
             ctaphid_write(&wb, NULL, 0);
             printf1(TAG_TIME,"CBOR writeback: %d ms",timestamp());
-            is_busy = 0;
             break;
 #endif
         case CTAPHID_CANCEL:
             printf1(TAG_HID,"CTAPHID_CANCEL");
-            is_busy = 0;
             break;
         default:
-            printf2(TAG_ERR,"error, unimplemented HID cmd: %02x\r", buffer_cmd());
+            printf2(TAG_ERR,"error, unimplemented HID cmd: %02x\r", cmd);
             ctaphid_send_error(cid, CTAP1_ERR_INVALID_COMMAND);
             break;
     }
     cid_del(cid);
-    buffer_reset();
+    buffer_reset(rxb);
 
     printf1(TAG_HID,"");
-    if (!is_busy) return cmd;
-    else return 0;
+    return cmd;
+}
+
+/**
+ * Removed Solo specific messages
+ * Requests needing the main MCU received while another one is processed are queued,
+ * other requests are directly processed (this function may be called while waiting for the main MCU)
+ */
+uint8_t ctaphid_handle_packet(uint32_t * pkt_raw)
+{
+    CTAPHID_RX_BUFFER * rxb;
+    uint8_t cmd;
+    uint32_t cid;
+    int len;
+
+    int bufstatus = ctaphid_buffer_packet(pkt_raw, &cmd, &cid, &len, &rxb);
+
+    if (bufstatus == HID_IGNORE)
+    {
+        return 0;
+    }
+
+    if (bufstatus == HID_ERROR)
+    {
+        cid_del(cid);
+        if ((cmd == CTAP1_ERR_INVALID_SEQ) && (rxb != NULL) && (rxb != ctap_in_flight_buffer))
+        {
+            buffer_reset(rxb);
+        }
+        ctaphid_send_error(cid, cmd);
+        return 0;
+    }
+
+    if (bufstatus == BUFFERING)
+    {
+        active_cid_timestamp = millis();
+        return 0;
+    }
+
+    // Main MCU busy with another request: queue it
+    if ((ctap_in_flight_buffer != NULL) && request_needs_main_mcu(rxb->cmd, rxb->bcnt, rxb->buf[0]))
+    {
+        printf1(TAG_HID,"Queuing request from %08x", cid);
+        rxb->queue_ticket = ++ctap_queue_ticket;
+        return 0;
+    }
+
+    cmd = ctaphid_process_request(rxb);
+
+    // Serve the requests queued while the main MCU was busy
+    while ((ctap_in_flight_buffer == NULL) && ((rxb = buffer_next_queued()) != NULL))
+    {
+        rxb->queue_ticket = 0;
+        ctaphid_process_request(rxb);
+    }
 
+    return cmd;
 }
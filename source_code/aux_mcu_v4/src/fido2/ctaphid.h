@@ -8,6 +8,7 @@
 // Modified by MiniBLE developers
 // -Decreased CTAPHID_BUFFER SIZE to 1024
 // -Addded capability CAPABILITY_NMSG (MEANING NOT SUPPORTED)
+// -Added CTAPHID_NB_RX_BUFFERS reassembly buffers, one per channel with a request in progress
 //
 #ifndef _CTAPHID_H_H
 #define _CTAPHID_H_H
@@ -55,6 +56,7 @@
 #define CTAPHID_BROADCAST_CID       0xffffffff
 
 #define CTAPHID_BUFFER_SIZE         1024
+#define CTAPHID_NB_RX_BUFFERS       2       // One for the request waiting for the main MCU, one for a queued or other request
 
 #define CAPABILITY_WINK             0x01
 #define CAPABILITY_LOCK             0x02
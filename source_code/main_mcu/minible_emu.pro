@@ -34,6 +34,9 @@ SOURCES += src/EMU/lis2hh12.c \
     src/BearSSL/src/symcipher/aes_ct_ctr.c \
     src/BearSSL/src/symcipher/aes_ct_ctrcbc.c \
     src/BearSSL/src/symcipher/aes_ct_enc.c \
+    src/BearSSL/src/symcipher/aes_ct64.c \
+    src/BearSSL/src/symcipher/aes_ct64_ctrcbc.c \
+    src/BearSSL/src/symcipher/aes_ct64_enc.c \
     src/BearSSL/src/hash/sha2small.c \
     src/BearSSL/src/mac/hmac.c \
     src/BearSSL/src/rand/hmac_drbg.c \
@@ -62,6 +65,8 @@ SOURCES += src/EMU/lis2hh12.c \
     src/BearSSL/src/codec/ccopy.c \
     src/BearSSL/src/codec/dec32be.c \
     src/BearSSL/src/codec/enc32be.c \
+    src/BearSSL/src/codec/dec32le.c \
+    src/BearSSL/src/codec/enc32le.c \
     src/COMMS/comms_aux_mcu.c \
     src/COMMS/comms_hid_msgs.c \
     src/COMMS/comms_hid_msgs_debug.c \
@@ -86,6 +91,7 @@ SOURCES += src/EMU/lis2hh12.c \
     src/LOGIC/logic_power.c \
     src/LOGIC/logic_security.c \
     src/LOGIC/logic_smartcard.c \
+    src/LOGIC/logic_tasks.c \
     src/LOGIC/logic_user.c \
     src/LOGIC/logic_accelerometer.c \
     src/NODEMGMT/nodemgmt.c \
@@ -178,6 +184,7 @@ HEADERS  += src/MainWindow.h \ \
     src/LOGIC/logic_power.h \
     src/LOGIC/logic_security.h \
     src/LOGIC/logic_smartcard.h \
+    src/LOGIC/logic_tasks.h \
     src/LOGIC/logic_user.h \
     src/NODEMGMT/nodemgmt.h \
     src/OLED/mooltipass_graphics_bundle.h \
@@ -36,6 +36,7 @@
 #include "gui_prompts.h"
 #include "logic_user.h"
 #include "text_ids.h"
+#include "dbflash.h"
 #include "sh1122.h"
 #include "main.h"
 #include "dma.h"
@@ -49,6 +50,22 @@ BOOL aux_mcu_message_answered_using_first_bytes = FALSE;
 BOOL aux_mcu_comms_aux_mcu_routine_function_called = FALSE;
 /* Flag set to specify that the first aux mcu function call wanted to rearm rx */
 BOOL aux_mcu_comms_prev_aux_mcu_routine_wants_to_arm_rx = FALSE;
+#ifdef DEBUG_USB_COMMANDS_ENABLED
+/* Ring buffer of the last sent and received messages headers, and number of traced messages since boot */
+aux_mcu_msg_trace_entry_t comms_aux_mcu_msg_trace[AUX_MCU_MSG_TRACE_NB_ENTRIES];
+uint32_t comms_aux_mcu_nb_traced_msgs = 0;
+/* HID messages latency statistics for USB & BLE, last aux MCU messages polling systick */
+comms_aux_mcu_hid_latency_t comms_aux_mcu_usb_latency;
+comms_aux_mcu_hid_latency_t comms_aux_mcu_ble_latency;
+uint32_t comms_aux_mcu_prev_routine_call_systick = 0;
+/* HID message being processed, for nested prompts time exclusion */
+comms_aux_mcu_hid_processing_t comms_aux_mcu_hid_processing;
+#endif
+/* Buffer credits request, small as only sent using variable length frames, and its ID */
+aux_mcu_credits_request_frame_t comms_aux_mcu_credits_request_frame;
+uint8_t comms_aux_mcu_credits_request_id = 0;
+/* CRC16-CCITT nibble lookup table, for variable length frames */
+const uint16_t comms_aux_mcu_crc_nibble_table[16] = {0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7, 0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF};
 
 
 /*! \fn     comms_aux_arm_rx_and_clear_no_comms(void)
@@ -60,6 +77,206 @@ void comms_aux_arm_rx_and_clear_no_comms(void)
     platform_io_clear_no_comms();
 }
 
+/*! \fn     comms_aux_mcu_compute_crc(uint8_t* frame_pt, uint16_t nb_bytes)
+*   \brief  Compute the CRC16-CCITT of the first bytes of a frame
+*   \param  frame_pt    Pointer to the frame
+*   \param  nb_bytes    Number of bytes
+*   \return The CRC
+*/
+static uint16_t comms_aux_mcu_compute_crc(uint8_t* frame_pt, uint16_t nb_bytes)
+{
+    uint16_t crc = 0xFFFF;
+    
+    for (uint16_t i = 0; i < nb_bytes; i++)
+    {
+        crc = (crc << 4) ^ comms_aux_mcu_crc_nibble_table[(crc >> 12) ^ (frame_pt[i] >> 4)];
+        crc = (crc << 4) ^ comms_aux_mcu_crc_nibble_table[(crc >> 12) ^ (frame_pt[i] & 0x0F)];
+    }
+    return crc;
+}
+
+/*! \fn     comms_aux_mcu_compute_frame_crc(aux_mcu_message_t* message)
+*   \brief  Compute the CRC16-CCITT of a variable length frame (header and payload)
+*   \param  message Pointer to the message
+*   \return The CRC
+*/
+uint16_t comms_aux_mcu_compute_frame_crc(aux_mcu_message_t* message)
+{
+    _Static_assert(AUX_MCU_MSG_HEADER_LENGTH == offsetof(aux_mcu_message_t, payload), "Incorrect variable length frame header length");
+    return comms_aux_mcu_compute_crc((uint8_t*)message, AUX_MCU_MSG_HEADER_LENGTH + message->payload_length1);
+}
+
+/*! \fn     comms_aux_mcu_trace_message(aux_mcu_message_t* message, uint8_t direction)
+*   \brief  Store a message header in the messages trace
+*   \param  message     Pointer to the message
+*   \param  direction   AUX_MCU_MSG_TRACE_DIR_SENT or AUX_MCU_MSG_TRACE_DIR_RECEIVED
+*/
+static inline void comms_aux_mcu_trace_message(aux_mcu_message_t* message, uint8_t direction)
+{
+#ifdef DEBUG_USB_COMMANDS_ENABLED
+    aux_mcu_msg_trace_entry_t* entry_pt = &comms_aux_mcu_msg_trace[comms_aux_mcu_nb_traced_msgs % AUX_MCU_MSG_TRACE_NB_ENTRIES];
+    
+    entry_pt->systick = timer_get_systick();
+    entry_pt->message_type = message->message_type;
+    entry_pt->payload_length1 = message->payload_length1;
+    entry_pt->direction = direction;
+    entry_pt->reserved = 0;
+    memcpy(entry_pt->payload_head, message->payload, sizeof(entry_pt->payload_head));
+    comms_aux_mcu_nb_traced_msgs++;
+#else
+    (void)message;
+    (void)direction;
+#endif
+}
+
+/*! \fn     comms_aux_mcu_get_msg_trace(aux_mcu_msg_trace_entry_t* entries, uint32_t* first_entry_id, uint32_t* nb_traced_msgs)
+*   \brief  Get the still available messages trace entries, oldest first
+*   \param  entries         Where to store the entries, AUX_MCU_MSG_TRACE_NB_ENTRIES max
+*   \param  first_entry_id  In: ID of the first wanted entry, out: ID of the first returned entry
+*   \param  nb_traced_msgs  Where to store the number of messages traced since boot
+*   \return Number of returned entries
+*/
+uint16_t comms_aux_mcu_get_msg_trace(aux_mcu_msg_trace_entry_t* entries, uint32_t* first_entry_id, uint32_t* nb_traced_msgs)
+{
+    uint16_t nb_entries = 0;
+    
+#ifdef DEBUG_USB_COMMANDS_ENABLED
+    /* Older entries were overwritten */
+    if ((*first_entry_id > comms_aux_mcu_nb_traced_msgs) || (comms_aux_mcu_nb_traced_msgs - *first_entry_id > AUX_MCU_MSG_TRACE_NB_ENTRIES))
+    {
+        *first_entry_id = (comms_aux_mcu_nb_traced_msgs > AUX_MCU_MSG_TRACE_NB_ENTRIES)? comms_aux_mcu_nb_traced_msgs - AUX_MCU_MSG_TRACE_NB_ENTRIES : 0;
+    }
+    
+    /* Copy entries */
+    for (uint32_t entry_id = *first_entry_id; entry_id < comms_aux_mcu_nb_traced_msgs; entry_id++)
+    {
+        entries[nb_entries++] = comms_aux_mcu_msg_trace[entry_id % AUX_MCU_MSG_TRACE_NB_ENTRIES];
+    }
+    *nb_traced_msgs = comms_aux_mcu_nb_traced_msgs;
+#else
+    (void)entries;
+    *first_entry_id = 0;
+    *nb_traced_msgs = 0;
+#endif
+    
+    return nb_entries;
+}
+
+#ifdef DEBUG_USB_COMMANDS_ENABLED
+/*! \fn     comms_aux_mcu_log_hid_latency(BOOL is_message_from_usb, uint32_t pickup_delay_ms, uint32_t processing_ms)
+*   \brief  Update HID messages latency statistics
+*   \param  is_message_from_usb Set to TRUE if the message came from USB
+*   \param  pickup_delay_ms     Time during which aux MCU messages weren't polled before the message pickup
+*   \param  processing_ms       Time between message pickup and reply
+*/
+static inline void comms_aux_mcu_log_hid_latency(BOOL is_message_from_usb, uint32_t pickup_delay_ms, uint32_t processing_ms)
+{
+    comms_aux_mcu_hid_latency_t* latency_pt = (is_message_from_usb != FALSE)? &comms_aux_mcu_usb_latency : &comms_aux_mcu_ble_latency;
+    
+    latency_pt->nb_messages++;
+    latency_pt->total_processing_ms += processing_ms;
+    if (processing_ms > latency_pt->max_processing_ms)
+    {
+        latency_pt->max_processing_ms = (processing_ms > UINT16_MAX)? UINT16_MAX : (uint16_t)processing_ms;
+    }
+    if (pickup_delay_ms > latency_pt->max_pickup_delay_ms)
+    {
+        latency_pt->max_pickup_delay_ms = (pickup_delay_ms > UINT16_MAX)? UINT16_MAX : (uint16_t)pickup_delay_ms;
+    }
+}
+
+/*! \fn     comms_aux_mcu_note_messages_polling(uint32_t systick)
+*   \brief  Account for an aux MCU messages polling done by comms_aux_mcu_routine()
+*   \param  systick     Polling systick
+*   \note   Polls done while a HID message is processed come from a prompt: that time is excluded from its processing time
+*/
+static inline void comms_aux_mcu_note_messages_polling(uint32_t systick)
+{
+    if (comms_aux_mcu_hid_processing.msg_being_processed != FALSE)
+    {
+        if (comms_aux_mcu_hid_processing.last_nested_poll_systick != 0)
+        {
+            comms_aux_mcu_hid_processing.nested_prompts_ms += systick - comms_aux_mcu_hid_processing.last_nested_poll_systick;
+        }
+        comms_aux_mcu_hid_processing.last_nested_poll_systick = systick;
+    }
+}
+
+/*! \fn     comms_aux_mcu_start_hid_processing(comms_aux_mcu_hid_processing_t* outer_processing)
+*   \brief  Start measuring a HID message processing time
+*   \param  outer_processing    Where to save the processing state of the message whose prompt we may be in
+*/
+static inline void comms_aux_mcu_start_hid_processing(comms_aux_mcu_hid_processing_t* outer_processing)
+{
+    *outer_processing = comms_aux_mcu_hid_processing;
+    comms_aux_mcu_hid_processing.msg_being_processed = TRUE;
+    comms_aux_mcu_hid_processing.nested_prompts_ms = 0;
+    comms_aux_mcu_hid_processing.last_nested_poll_systick = 0;
+}
+
+/*! \fn     comms_aux_mcu_end_hid_processing(comms_aux_mcu_hid_processing_t* outer_processing, BOOL is_message_from_usb, uint32_t pickup_delay_ms, uint32_t pickup_systick)
+*   \brief  Log a HID message latency statistics, nested prompts time excluded, and restore the outer message processing state
+*   \param  outer_processing    Processing state saved by comms_aux_mcu_start_hid_processing()
+*   \param  is_message_from_usb Set to TRUE if the message came from USB
+*   \param  pickup_delay_ms     Time during which aux MCU messages weren't polled before the message pickup
+*   \param  pickup_systick      Message pickup systick
+*/
+static inline void comms_aux_mcu_end_hid_processing(comms_aux_mcu_hid_processing_t* outer_processing, BOOL is_message_from_usb, uint32_t pickup_delay_ms, uint32_t pickup_systick)
+{
+    comms_aux_mcu_log_hid_latency(is_message_from_usb, pickup_delay_ms, timer_get_systick() - pickup_systick - comms_aux_mcu_hid_processing.nested_prompts_ms);
+    comms_aux_mcu_hid_processing = *outer_processing;
+}
+#endif
+
+/*! \fn     comms_aux_mcu_get_and_reset_hid_latency(comms_aux_mcu_hid_latency_t* usb_latency, comms_aux_mcu_hid_latency_t* ble_latency)
+*   \brief  Get and reset HID messages latency statistics
+*   \param  usb_latency Where to store statistics for USB messages
+*   \param  ble_latency Where to store statistics for BLE messages
+*/
+void comms_aux_mcu_get_and_reset_hid_latency(comms_aux_mcu_hid_latency_t* usb_latency, comms_aux_mcu_hid_latency_t* ble_latency)
+{
+#ifdef DEBUG_USB_COMMANDS_ENABLED
+    *usb_latency = comms_aux_mcu_usb_latency;
+    *ble_latency = comms_aux_mcu_ble_latency;
+    memset(&comms_aux_mcu_usb_latency, 0, sizeof(comms_aux_mcu_usb_latency));
+    memset(&comms_aux_mcu_ble_latency, 0, sizeof(comms_aux_mcu_ble_latency));
+#else
+    memset(usb_latency, 0, sizeof(*usb_latency));
+    memset(ble_latency, 0, sizeof(*ble_latency));
+#endif
+}
+
+/*! \fn     comms_aux_mcu_check_received_frame(void)
+*   \brief  Check the CRC of a variable length frame received from the aux MCU
+*   \return RETURN_OK if the CRC matches or if the frame has a fixed size
+*   \note   Bytes following the payload are cleared, as they would be for fixed size frames
+*/
+static RET_TYPE comms_aux_mcu_check_received_frame(void)
+{
+    uint16_t payload_length = aux_mcu_receive_message.payload_length1;
+    
+    /* Fixed size frames do not have a CRC */
+    if ((dma_aux_mcu_is_variable_length_framing_enabled() == FALSE) || (payload_length > AUX_MCU_MSG_VAR_FRAME_MAX_PAYLOAD_LENGTH))
+    {
+        return RETURN_OK;
+    }
+    
+    /* Compare CRCs, then clear the frame tail */
+    uint8_t* crc_pt = &aux_mcu_receive_message.payload[payload_length];
+    uint16_t received_crc = crc_pt[0] | (crc_pt[1] << 8);
+    uint16_t computed_crc = comms_aux_mcu_compute_frame_crc(&aux_mcu_receive_message);
+    memset((void*)crc_pt, 0, sizeof(aux_mcu_receive_message) - AUX_MCU_MSG_HEADER_LENGTH - payload_length);
+    
+    if (received_crc == computed_crc)
+    {
+        return RETURN_OK;
+    }
+    else
+    {
+        return RETURN_NOK;
+    }
+}
+
 /*! \fn     comms_aux_mcu_get_temp_tx_message_object_pt(void)
 *   \brief  Get a pointer to our temporary tx message object
 */
@@ -68,24 +285,169 @@ aux_mcu_message_t* comms_aux_mcu_get_temp_tx_message_object_pt(void)
     return &aux_mcu_send_message;
 }
 
+/*! \fn     comms_aux_mcu_request_credits_state(void)
+*   \brief  Ask the aux MCU to send its buffer credits state
+*   \return The request ID, echoed by the aux MCU in its answer
+*   \note   This request doesn't use an aux MCU buffer
+*/
+static uint8_t comms_aux_mcu_request_credits_state(void)
+{
+    aux_mcu_credits_request_frame_t* request_pt = &comms_aux_mcu_credits_request_frame;
+    
+    /* Same layout as an aux_mcu_message_t main MCU command */
+    _Static_assert(offsetof(aux_mcu_credits_request_frame_t, command) == offsetof(aux_mcu_message_t, main_mcu_command_message.command), "Incorrect credits request layout");
+    _Static_assert(offsetof(aux_mcu_credits_request_frame_t, request_id) == offsetof(aux_mcu_message_t, main_mcu_command_message.payload), "Incorrect credits request layout");
+    
+    /* Do not touch a request being sent */
+    dma_wait_for_aux_mcu_packet_sent();
+    request_pt->message_type = AUX_MCU_MSG_TYPE_MAIN_MCU_CMD;
+    request_pt->payload_length1 = offsetof(aux_mcu_credits_request_frame_t, crc) - AUX_MCU_MSG_HEADER_LENGTH;
+    request_pt->command = MAIN_MCU_COMMAND_GET_CREDITS;
+    request_pt->request_id = ++comms_aux_mcu_credits_request_id;
+    uint16_t crc = comms_aux_mcu_compute_crc((uint8_t*)request_pt, offsetof(aux_mcu_credits_request_frame_t, crc));
+    request_pt->crc[0] = (uint8_t)crc;
+    request_pt->crc[1] = (uint8_t)(crc >> 8);
+    dma_aux_mcu_init_tx_transfer(AUXMCU_SERCOM, (void*)request_pt, sizeof(*request_pt));
+    
+    return comms_aux_mcu_credits_request_id;
+}
+
+/*! \fn     comms_aux_mcu_wait_for_credits_request_answer(uint8_t request_id)
+*   \brief  Wait for the aux MCU to answer a buffer credits request
+*   \param  request_id  The request ID
+*   \return TRUE if the answer came before AUX_MCU_CREDITS_REQUEST_TIMEOUT_MS
+*/
+static BOOL comms_aux_mcu_wait_for_credits_request_answer(uint8_t request_id)
+{
+    uint32_t request_systick = timer_get_systick();
+    
+    while (dma_aux_mcu_get_last_credits_request_answered() != request_id)
+    {
+        if ((timer_get_systick() - request_systick) >= AUX_MCU_CREDITS_REQUEST_TIMEOUT_MS)
+        {
+            return FALSE;
+        }
+    }
+    
+    return TRUE;
+}
+
+/*! \fn     comms_aux_mcu_wait_for_other_msg_credit(void)
+*   \brief  Wait for a buffer credit to send a non USB & non BLE message, asking the aux MCU for its credits state when none comes
+*   \return TRUE if a credit was taken, FALSE if none came before AUX_MCU_MESSAGE_REPLY_TIMEOUT_MS
+*   \note   Credits events are lost while our RX buffer is in use: when no credit comes, the message is counted as using an aux MCU buffer anyway
+*/
+static BOOL comms_aux_mcu_wait_for_other_msg_credit(void)
+{
+    uint32_t wait_start_systick = timer_get_systick();
+    uint32_t request_systick = wait_start_systick;
+    
+    while (dma_aux_mcu_take_other_msg_credit(FALSE) == FALSE)
+    {
+        if ((timer_get_systick() - wait_start_systick) >= AUX_MCU_MESSAGE_REPLY_TIMEOUT_MS)
+        {
+            dma_aux_mcu_take_other_msg_credit(TRUE);
+            return FALSE;
+        }
+        else if ((timer_get_systick() - request_systick) >= AUX_MCU_CREDITS_REQUEST_TIMEOUT_MS)
+        {
+            comms_aux_mcu_request_credits_state();
+            request_systick = timer_get_systick();
+        }
+    }
+    
+    return TRUE;
+}
+
+/*! \fn     comms_aux_mcu_was_other_msg_dropped(uint8_t nb_dropped_msgs_before_send)
+*   \brief  Ask the aux MCU for its buffer credits state to know if the message we sent without a credit was dropped
+*   \param  nb_dropped_msgs_before_send Number of dropped messages reported by the aux MCU before our message was sent
+*   \return TRUE if the aux MCU reported dropping a message, FALSE if it stored it or didn't answer
+*/
+static BOOL comms_aux_mcu_was_other_msg_dropped(uint8_t nb_dropped_msgs_before_send)
+{
+    /* Our request is received after our message, so the answer covers it */
+    comms_aux_mcu_wait_for_credits_request_answer(comms_aux_mcu_request_credits_state());
+    
+    if (dma_aux_mcu_get_nb_other_msgs_dropped() != nb_dropped_msgs_before_send)
+    {
+        return TRUE;
+    }
+    else
+    {
+        return FALSE;
+    }
+}
+
+/*! \fn     comms_aux_mcu_transmit_message(void)
+*   \brief  Start the DMA transfer of aux_mcu_send_message, adding the CRC for variable length frames
+*/
+static void comms_aux_mcu_transmit_message(void)
+{
+    /* Variable length frames: only send header, payload and CRC (payloads leaving no room for the CRC and special frames are sent with a fixed size) */
+    uint16_t nb_bytes_to_send = sizeof(aux_mcu_send_message);
+    if ((dma_aux_mcu_is_variable_length_framing_enabled() != FALSE) && (aux_mcu_send_message.payload_length1 <= AUX_MCU_MSG_VAR_FRAME_MAX_PAYLOAD_LENGTH))
+    {
+        /* Do not touch a message being sent */
+        dma_wait_for_aux_mcu_packet_sent();
+        uint16_t crc = comms_aux_mcu_compute_frame_crc(&aux_mcu_send_message);
+        aux_mcu_send_message.payload[aux_mcu_send_message.payload_length1] = (uint8_t)crc;
+        aux_mcu_send_message.payload[aux_mcu_send_message.payload_length1 + 1] = (uint8_t)(crc >> 8);
+        nb_bytes_to_send = AUX_MCU_MSG_HEADER_LENGTH + aux_mcu_send_message.payload_length1 + AUX_MCU_MSG_CRC_LENGTH;
+    }
+    
+    /* The function below does wait for a previous transfer to finish */
+    dma_aux_mcu_init_tx_transfer(AUXMCU_SERCOM, (void*)&aux_mcu_send_message, nb_bytes_to_send);
+    comms_aux_mcu_trace_message(&aux_mcu_send_message, AUX_MCU_MSG_TRACE_DIR_SENT);
+}
+
 /*! \fn     comms_aux_mcu_send_message(BOOL wait_for_send)
 *   \brief  Send aux_mcu_send_message to the AUX MCU
 *   \param  wait_for_send   Set to TRUE for function return when message is sent
+*   \return RETURN_NOK if the aux MCU kept reporting dropping the message
 *   \note   Transfer is done through DMA so aux_mcu_send_message will be accessed after this function returns if boolean is set to false
 */
-void comms_aux_mcu_send_message(BOOL wait_for_send)
+RET_TYPE comms_aux_mcu_send_message(BOOL wait_for_send)
 {
-    /* As the aux MCU has 3 buffers (one for USB messages, one for BLE messages, one for others), check for timeout in case message is of type other */
+    RET_TYPE return_val = RETURN_OK;
+    uint16_t nb_resends = 0;
+
+    /* As the aux MCU has 1 buffer for USB messages, 1 for BLE messages and a few for others, check for a free one in case message is of type other */
+    BOOL sent_without_credit = FALSE;
+    BOOL use_flood_timer = FALSE;
+    uint8_t nb_dropped_msgs = 0;
     if ((aux_mcu_send_message.message_type != AUX_MCU_MSG_TYPE_USB) && (aux_mcu_send_message.message_type != AUX_MCU_MSG_TYPE_BLE))
     {
-        while (timer_has_timer_expired(TIMER_AUX_MCU_FLOOD, FALSE) == TIMER_RUNNING);
+        if (dma_aux_mcu_get_nb_other_msg_buffers() == 0)
+        {
+            /* Aux MCU doesn't return buffer credits: use flood timeout */
+            use_flood_timer = TRUE;
+            while (timer_has_timer_expired(TIMER_AUX_MCU_FLOOD, FALSE) == TIMER_RUNNING);
+        }
+        else
+        {
+            nb_dropped_msgs = dma_aux_mcu_get_nb_other_msgs_dropped();
+            sent_without_credit = (comms_aux_mcu_wait_for_other_msg_credit() == FALSE)?TRUE:FALSE;
+        }
     }
     
-    /* The function below does wait for a previous transfer to finish */
-    dma_aux_mcu_init_tx_transfer(AUXMCU_SERCOM, (void*)&aux_mcu_send_message, sizeof(aux_mcu_send_message));
+    comms_aux_mcu_transmit_message();
     
-    /* As the aux MCU has 3 buffers (one for USB messages, one for BLE messages, one for others), start a timer in case message is of type other */
-    if ((aux_mcu_send_message.message_type != AUX_MCU_MSG_TYPE_USB) && (aux_mcu_send_message.message_type != AUX_MCU_MSG_TYPE_BLE))
+    /* Sent without a buffer credit: resend the message a few times if the aux MCU reports dropping it */
+    while ((sent_without_credit != FALSE) && (comms_aux_mcu_was_other_msg_dropped(nb_dropped_msgs) != FALSE))
+    {
+        if (nb_resends++ == AUX_MCU_DROPPED_MSG_MAX_RESENDS)
+        {
+            return_val = RETURN_NOK;
+            break;
+        }
+        nb_dropped_msgs = dma_aux_mcu_get_nb_other_msgs_dropped();
+        sent_without_credit = (comms_aux_mcu_wait_for_other_msg_credit() == FALSE)?TRUE:FALSE;
+        comms_aux_mcu_transmit_message();
+    }
+    
+    /* No buffer credits: start a timer in case message is of type other */
+    if (use_flood_timer != FALSE)
     {
         timer_start_timer(TIMER_AUX_MCU_FLOOD, AUX_FLOOD_TIMEOUT_MS);        
     }
@@ -95,6 +457,49 @@ void comms_aux_mcu_send_message(BOOL wait_for_send)
     {
         dma_wait_for_aux_mcu_packet_sent();
     }
+    
+    return return_val;
+}
+
+/*! \fn     comms_aux_mcu_wait_for_streamed_hid_message_forwarded(BOOL is_message_from_usb)
+*   \brief  Wait for the aux MCU to be done with the last HID message streamed to an interface, before sending another one
+*   \param  is_message_from_usb Set to TRUE for the USB interface
+*   \note   The aux MCU answers our requests once it dealt with the messages received before them.
+*   \note   Answers can't be received while a message waits in our receive buffer, a fixed delay is then used as with aux MCUs not returning buffer credits
+*/
+void comms_aux_mcu_wait_for_streamed_hid_message_forwarded(BOOL is_message_from_usb)
+{
+    uint8_t busy_flag = (is_message_from_usb != FALSE)?AUX_MCU_CREDITS_USB_BUFFER_BUSY:AUX_MCU_CREDITS_BLE_BUFFER_BUSY;
+    uint32_t wait_start_systick = timer_get_systick();
+    
+    while ((dma_aux_mcu_get_nb_other_msg_buffers() != 0) && (dma_aux_mcu_check_dma_transfer_flag() == FALSE) && ((timer_get_systick() - wait_start_systick) < AUX_MCU_MESSAGE_REPLY_TIMEOUT_MS))
+    {
+        if ((comms_aux_mcu_wait_for_credits_request_answer(comms_aux_mcu_request_credits_state()) != FALSE) && ((dma_aux_mcu_get_hid_buffers_busy_flags() & busy_flag) == 0))
+        {
+            return;
+        }
+    }
+    
+    while (timer_has_timer_expired(TIMER_AUX_MCU_FLOOD, FALSE) == TIMER_RUNNING);
+}
+
+/*! \fn     comms_aux_mcu_send_streamed_hid_message(BOOL is_message_from_usb)
+*   \brief  Send the HID message stored in aux_mcu_send_message before the final answer is returned by the HID parser
+*   \param  is_message_from_usb Set to TRUE if the request came from USB
+*   \note   Used to send back-to-back multi-packet answers, each packet being sent once the aux MCU forwarded the previous one
+*/
+void comms_aux_mcu_send_streamed_hid_message(BOOL is_message_from_usb)
+{
+    /* Wait for the previous streamed packet to be forwarded by the aux MCU */
+    comms_aux_mcu_wait_for_streamed_hid_message_forwarded(is_message_from_usb);
+    
+    /* Set message type and compute payload size */
+    aux_mcu_send_message.message_type = (is_message_from_usb != FALSE)?AUX_MCU_MSG_TYPE_USB:AUX_MCU_MSG_TYPE_BLE;
+    aux_mcu_send_message.payload_length1 = aux_mcu_send_message.hid_message.payload_length + sizeof(aux_mcu_send_message.hid_message.message_type) + sizeof(aux_mcu_send_message.hid_message.payload_length);
+    
+    /* Send message, wait for it to be sent as the caller will fill the next one */
+    comms_aux_mcu_send_message(TRUE);
+    timer_start_timer(TIMER_AUX_MCU_FLOOD, (is_message_from_usb != FALSE)?USB_STREAM_PACKET_MS:BLE_STREAM_PACKET_MS);
 }
 
 /*! \fn     comms_aux_mcu_wait_for_message_sent(void)
@@ -179,8 +584,9 @@ void comms_aux_mcu_hard_comms_reset_with_aux_mcu_reboot(void)
     /* Wait for platform to boot */
     timer_delay_ms(100);
 
-    /* Reset our comms */
+    /* Reset our comms, the aux MCU boots using fixed size frames */
     dma_aux_mcu_disable_transfer();
+    dma_aux_mcu_set_variable_length_framing(FALSE);
 
     /* Enable our comms, clear no comms signal */
     comms_aux_arm_rx_and_clear_no_comms();
@@ -214,6 +620,87 @@ RET_TYPE comms_aux_mcu_send_receive_ping(void)
     return return_val;
 }
 
+/*! \fn     comms_aux_mcu_set_variable_length_framing(BOOL enable)
+*   \brief  Switch aux MCU comms between fixed size and variable length frames
+*   \param  enable  TRUE to use variable length frames
+*   \return Success or not (aux MCU firmwares not supporting it do not answer)
+*   \note   To be called while no other messages are exchanged
+*/
+RET_TYPE comms_aux_mcu_set_variable_length_framing(BOOL enable)
+{
+    aux_mcu_message_t* temp_rx_message_pt;
+    aux_mcu_message_t* temp_tx_message_pt;
+    RET_TYPE return_val;
+    
+    /* Already using the requested framing? */
+    if (dma_aux_mcu_is_variable_length_framing_enabled() == enable)
+    {
+        return RETURN_OK;
+    }
+
+    /* Send request using the current framing */
+    comms_aux_mcu_get_empty_packet_ready_to_be_sent(&temp_tx_message_pt, AUX_MCU_MSG_TYPE_MAIN_MCU_CMD);
+    temp_tx_message_pt->main_mcu_command_message.command = MAIN_MCU_COMMAND_SET_FRAMING;
+    temp_tx_message_pt->main_mcu_command_message.payload[0] = (uint8_t)enable;
+    temp_tx_message_pt->payload_length1 = sizeof(temp_tx_message_pt->main_mcu_command_message.command) + sizeof(uint8_t);
+    comms_aux_mcu_send_message(TRUE);
+
+    /* Aux MCU acknowledges using the current framing, then switches */
+    return_val = comms_aux_mcu_active_wait(&temp_rx_message_pt, FALSE, AUX_MCU_MSG_TYPE_AUX_MCU_EVENT, FALSE, AUX_MCU_EVENT_FRAMING_SET);
+    if (return_val == RETURN_OK)
+    {
+        dma_aux_mcu_set_variable_length_framing(enable);
+        
+        /* Ack may specify the number of buffer credits we get for non USB & non BLE messages */
+        if ((enable != FALSE) && (temp_rx_message_pt->payload_length1 > sizeof(temp_rx_message_pt->aux_mcu_event_message.event_id)))
+        {
+            dma_aux_mcu_set_nb_other_msg_buffers(temp_rx_message_pt->aux_mcu_event_message.payload[0]);
+        }
+    }
+    else
+    {
+        /* The aux MCU may have switched while we missed its ACK: get both of us back to fixed size frames */
+        comms_aux_mcu_reset_framing();
+    }
+
+    /* Rearm receive */
+    comms_aux_arm_rx_and_clear_no_comms();
+
+    return return_val;
+}
+
+/*! \fn     comms_aux_mcu_reset_framing(void)
+*   \brief  Get the aux MCU back to fixed size frames whatever its current framing is
+*   \return Success or not
+*   \note   Used when our framing may not match the aux MCU one: after our reboot or a missed framing ACK
+*/
+RET_TYPE comms_aux_mcu_reset_framing(void)
+{
+    aux_mcu_message_t* temp_rx_message_pt;
+    aux_mcu_message_t* temp_tx_message_pt;
+    RET_TYPE return_val;
+    
+    /* Reset our comms to fixed size frames */
+    dma_aux_mcu_disable_transfer();
+    dma_aux_mcu_set_variable_length_framing(FALSE);
+    comms_aux_arm_rx_and_clear_no_comms();
+    
+    /* Oversized payload length: the request is received as a fixed size frame by both framings */
+    comms_aux_mcu_get_empty_packet_ready_to_be_sent(&temp_tx_message_pt, AUX_MCU_MSG_TYPE_MAIN_MCU_CMD);
+    temp_tx_message_pt->main_mcu_command_message.command = MAIN_MCU_COMMAND_SET_FRAMING;
+    temp_tx_message_pt->main_mcu_command_message.payload[0] = (uint8_t)FALSE;
+    temp_tx_message_pt->payload_length1 = AUX_MCU_MSG_FRAMING_RESET_PAYLOAD_LENGTH;
+    comms_aux_mcu_send_message(TRUE);
+    
+    /* Aux MCU switches first, then acknowledges using fixed size frames */
+    return_val = comms_aux_mcu_active_wait(&temp_rx_message_pt, FALSE, AUX_MCU_MSG_TYPE_AUX_MCU_EVENT, FALSE, AUX_MCU_EVENT_FRAMING_SET);
+    
+    /* Rearm receive */
+    comms_aux_arm_rx_and_clear_no_comms();
+    
+    return return_val;
+}
+
 /*! \fn     comms_aux_mcu_deal_with_ble_message(aux_mcu_message_t* received_message, msg_restrict_type_te answer_restrict_type)
 *   \brief  Deal with received BLE message
 *   \param  received_message        Pointer to received message
@@ -261,6 +748,15 @@ comms_msg_rcvd_te comms_aux_mcu_deal_with_ble_message(aux_mcu_message_t* receive
             }
             break;
         }
+        case BLE_MESSAGE_STORE_TYPING_DELAY:
+        {
+            /* Typing pacing tuned by the aux MCU for the connected host: 6 bytes mac address followed by the delay */
+            if (received_message->payload_length1 == sizeof(received_message->ble_message.message_id) + MEMBER_SIZE(nodemgmt_bluetooth_bonding_information_t, mac_address) + sizeof(uint16_t))
+            {
+                nodemgmt_store_bluetooth_bonding_typing_delay(received_message->ble_message.payload, received_message->ble_message.payload_as_uint16_t[MEMBER_SIZE(nodemgmt_bluetooth_bonding_information_t, mac_address)/2]);
+            }
+            break;
+        }
         case BLE_MESSAGE_RECALL_BOND_INFO:
         {
             /* Prepare answer */
@@ -536,6 +1032,13 @@ comms_msg_rcvd_te comms_aux_mcu_routine(msg_restrict_type_te answer_restrict_typ
 {    
 #ifdef EMULATOR_BUILD
     DELAYMS(1);
+#endif
+#ifdef DEBUG_USB_COMMANDS_ENABLED
+    /* For latency statistics: time since messages were last polled */
+    uint32_t routine_call_systick = timer_get_systick();
+    uint32_t pickup_delay_ms = routine_call_systick - comms_aux_mcu_prev_routine_call_systick;
+    comms_aux_mcu_prev_routine_call_systick = routine_call_systick;
+    comms_aux_mcu_note_messages_polling(routine_call_systick);
 #endif
     /* Recursivity: set function called flag */
     BOOL function_already_called = FALSE;
@@ -555,8 +1058,12 @@ comms_msg_rcvd_te comms_aux_mcu_routine(msg_restrict_type_te answer_restrict_typ
         aux_mcu_comms_prev_aux_mcu_routine_wants_to_arm_rx = FALSE;
     }
 
-    /* Ongoing RX transfer received bytes */
-    uint16_t nb_received_bytes_for_ongoing_transfer = sizeof(aux_mcu_receive_message) - dma_aux_mcu_get_remaining_bytes_for_rx_transfer();
+    /* Ongoing RX transfer received bytes (variable length frames are only dealt with once complete) */
+    uint16_t nb_received_bytes_for_ongoing_transfer = 0;
+    if (dma_aux_mcu_is_variable_length_framing_enabled() == FALSE)
+    {
+        nb_received_bytes_for_ongoing_transfer = sizeof(aux_mcu_receive_message) - dma_aux_mcu_get_remaining_bytes_for_rx_transfer();
+    }
 
     /* For return: type of message received */
     comms_msg_rcvd_te msg_rcvd = NO_MSG_RCVD;
@@ -609,7 +1116,7 @@ comms_msg_rcvd_te comms_aux_mcu_routine(msg_restrict_type_te answer_restrict_typ
     else if (dma_aux_mcu_check_and_clear_dma_transfer_flag() != FALSE)
     {
         /* Second part transfer, check if we have already dealt with this packet and if it is valid */
-        if ((aux_mcu_message_answered_using_first_bytes == FALSE) && ((aux_mcu_receive_message.payload_length1 != 0) || ((aux_mcu_receive_message.payload_length1 == 0) && (aux_mcu_receive_message.rx_payload_valid_flag != 0))))
+        if ((aux_mcu_message_answered_using_first_bytes == FALSE) && (comms_aux_mcu_check_received_frame() == RETURN_OK) && ((aux_mcu_receive_message.payload_length1 != 0) || ((aux_mcu_receive_message.payload_length1 == 0) && (aux_mcu_receive_message.rx_payload_valid_flag != 0))))
         {
             arm_rx_transfer = TRUE;
             should_deal_with_packet = TRUE;
@@ -645,6 +1152,7 @@ comms_msg_rcvd_te comms_aux_mcu_routine(msg_restrict_type_te answer_restrict_typ
         /* Note: there's a case where we don't rearm DMA if the message is valid but payload is too long... was lazy to implement it */
         return NO_MSG_RCVD;
     }
+    comms_aux_mcu_trace_message(&aux_mcu_receive_message, AUX_MCU_MSG_TRACE_DIR_RECEIVED);
 
     /* USB / BLE Messages */
     if ((aux_mcu_receive_message.message_type == AUX_MCU_MSG_TYPE_USB) || (aux_mcu_receive_message.message_type == AUX_MCU_MSG_TYPE_BLE))
@@ -660,6 +1168,11 @@ comms_msg_rcvd_te comms_aux_mcu_routine(msg_restrict_type_te answer_restrict_typ
 
         /* Clear TX message just in case */
         memset((void*)&aux_mcu_send_message, 0, sizeof(aux_mcu_send_message));
+        
+        #ifdef DEBUG_USB_COMMANDS_ENABLED
+        comms_aux_mcu_hid_processing_t outer_hid_processing;
+        comms_aux_mcu_start_hid_processing(&outer_hid_processing);
+        #endif
 
         /* Depending on command ID, prepare return */
         if (aux_mcu_receive_message.hid_message.message_type == HID_CMD_ID_CANCEL_REQ)
@@ -685,7 +1198,10 @@ comms_msg_rcvd_te comms_aux_mcu_routine(msg_restrict_type_te answer_restrict_typ
         }
         else
         {
+            uint32_t nb_dbflash_bytes_read = dbflash_nb_bytes_read;
+            uint16_t parsed_message_type = aux_mcu_receive_message.hid_message.message_type;
             hid_reply_payload_length = comms_hid_msgs_parse(&aux_mcu_receive_message.hid_message, payload_length - sizeof(aux_mcu_receive_message.hid_message.message_type) - sizeof(aux_mcu_receive_message.hid_message.payload_length), &aux_mcu_send_message.hid_message, answer_restrict_type, is_message_from_usb);
+            comms_hid_msgs_debug_log_dbflash_reads(parsed_message_type, dbflash_nb_bytes_read - nb_dbflash_bytes_read);
         }
         #endif
 
@@ -699,6 +1215,10 @@ comms_msg_rcvd_te comms_aux_mcu_routine(msg_restrict_type_te answer_restrict_typ
             /* Send message */
             comms_aux_mcu_send_message(FALSE);
         }
+        
+        #ifdef DEBUG_USB_COMMANDS_ENABLED
+        comms_aux_mcu_end_hid_processing(&outer_hid_processing, is_message_from_usb, pickup_delay_ms, routine_call_systick);
+        #endif
     }
     else if (aux_mcu_receive_message.message_type == AUX_MCU_MSG_TYPE_BOOTLOADER)
     {
@@ -809,20 +1329,23 @@ RET_TYPE comms_aux_mcu_active_wait(aux_mcu_message_t** rx_message_pt_pt, BOOL do
         reloop = FALSE;
 
         /* Wait for complete message to be received */
-        BOOL dma_check_return = FALSE;
-        timer_flag_te timer_flag_return = TIMER_RUNNING;
-        while((dma_check_return == FALSE) && (timer_flag_return == TIMER_RUNNING))
+        BOOL dma_check_return;
+        if (do_not_touch_dma_flags == FALSE)
         {
-            if (do_not_touch_dma_flags == FALSE)
-            {
-                dma_check_return = dma_aux_mcu_check_and_clear_dma_transfer_flag();
-            }
-            else
-            {
-                dma_check_return = dma_aux_mcu_check_dma_transfer_flag();
-            }
-            timer_flag_return = timer_has_timer_expired(TIMER_TIMEOUT_FUNCTS, FALSE);
+            dma_check_return = timer_wait_for_event_or_timer_expiry(dma_aux_mcu_check_and_clear_dma_transfer_flag, TIMER_TIMEOUT_FUNCTS);
         }
+        else
+        {
+            dma_check_return = timer_wait_for_event_or_timer_expiry(dma_aux_mcu_check_dma_transfer_flag, TIMER_TIMEOUT_FUNCTS);
+        }
+        
+        #ifdef DEBUG_USB_COMMANDS_ENABLED
+        /* For latency statistics: messages were polled until now */
+        if (dma_check_return == FALSE)
+        {
+            comms_aux_mcu_prev_routine_call_systick = timer_get_systick();
+        }
+        #endif
 
         /* Did the timer expire? */
         if (dma_check_return == FALSE)
@@ -842,17 +1365,18 @@ RET_TYPE comms_aux_mcu_active_wait(aux_mcu_message_t** rx_message_pt_pt, BOOL do
         }
 
         /* Check if message is invalid */
-        if ((payload_length > AUX_MCU_MSG_PAYLOAD_LENGTH) || ((aux_mcu_receive_message.payload_length1 == 0) && (aux_mcu_receive_message.rx_payload_valid_flag == 0)))
+        if ((comms_aux_mcu_check_received_frame() != RETURN_OK) || (payload_length > AUX_MCU_MSG_PAYLOAD_LENGTH) || ((aux_mcu_receive_message.payload_length1 == 0) && (aux_mcu_receive_message.rx_payload_valid_flag == 0)))
         {
             /* Reloop, rearm receive */
             reloop = TRUE;
             dma_aux_mcu_check_and_clear_dma_transfer_flag();
             comms_aux_arm_rx_and_clear_no_comms();
         }
-
         /* Check if received message is the one we expected */
-        if ((aux_mcu_receive_message.message_type != expected_packet) || ((expected_event >= 0) && (aux_mcu_receive_message.aux_mcu_event_message.event_id != expected_event)))
+        else if ((aux_mcu_receive_message.message_type != expected_packet) || ((expected_event >= 0) && (aux_mcu_receive_message.aux_mcu_event_message.event_id != expected_event)))
         {
+            comms_aux_mcu_trace_message(&aux_mcu_receive_message, AUX_MCU_MSG_TRACE_DIR_RECEIVED);
+            
             /* Reloop, rearm receive */
             reloop = TRUE;
             dma_aux_mcu_check_and_clear_dma_transfer_flag();
@@ -877,6 +1401,15 @@ RET_TYPE comms_aux_mcu_active_wait(aux_mcu_message_t** rx_message_pt_pt, BOOL do
                 /* Clear TX message just in case */
                 memset((void*)&aux_mcu_send_message, 0, sizeof(aux_mcu_send_message));
                 
+                #ifdef DEBUG_USB_COMMANDS_ENABLED
+                /* For latency statistics: we're polling messages while waiting */
+                uint32_t pickup_systick = timer_get_systick();
+                uint32_t pickup_delay_ms = pickup_systick - comms_aux_mcu_prev_routine_call_systick;
+                comms_aux_mcu_prev_routine_call_systick = pickup_systick;
+                comms_aux_mcu_hid_processing_t outer_hid_processing;
+                comms_aux_mcu_start_hid_processing(&outer_hid_processing);
+                #endif
+                
                 /* Parse message */
                 #ifndef DEBUG_USB_COMMANDS_ENABLED
                 hid_reply_payload_length = comms_hid_msgs_parse(&aux_mcu_receive_message.hid_message, payload_length - sizeof(aux_mcu_receive_message.hid_message.message_type) - sizeof(aux_mcu_receive_message.hid_message.payload_length), &aux_mcu_send_message.hid_message, MSG_RESTRICT_ALL, is_message_from_usb);
@@ -887,7 +1420,10 @@ RET_TYPE comms_aux_mcu_active_wait(aux_mcu_message_t** rx_message_pt_pt, BOOL do
                 }
                 else
                 {
+                    uint32_t nb_dbflash_bytes_read = dbflash_nb_bytes_read;
+                    uint16_t parsed_message_type = aux_mcu_receive_message.hid_message.message_type;
                     hid_reply_payload_length = comms_hid_msgs_parse(&aux_mcu_receive_message.hid_message, payload_length - sizeof(aux_mcu_receive_message.hid_message.message_type) - sizeof(aux_mcu_receive_message.hid_message.payload_length), &aux_mcu_send_message.hid_message, MSG_RESTRICT_ALL, is_message_from_usb);
+                    comms_hid_msgs_debug_log_dbflash_reads(parsed_message_type, dbflash_nb_bytes_read - nb_dbflash_bytes_read);
                 }
                 #endif
                 
@@ -901,6 +1437,10 @@ RET_TYPE comms_aux_mcu_active_wait(aux_mcu_message_t** rx_message_pt_pt, BOOL do
                     /* Send message */
                     comms_aux_mcu_send_message(FALSE);
                 }
+                
+                #ifdef DEBUG_USB_COMMANDS_ENABLED
+                comms_aux_mcu_end_hid_processing(&outer_hid_processing, is_message_from_usb, pickup_delay_ms, pickup_systick);
+                #endif
             }
             else if (aux_mcu_receive_message.message_type == AUX_MCU_MSG_TYPE_RNG_TRANSFER)
             {                
@@ -929,6 +1469,10 @@ RET_TYPE comms_aux_mcu_active_wait(aux_mcu_message_t** rx_message_pt_pt, BOOL do
             }
         }
     }while (reloop != FALSE);
+    comms_aux_mcu_trace_message(&aux_mcu_receive_message, AUX_MCU_MSG_TRACE_DIR_RECEIVED);
+    #ifdef DEBUG_USB_COMMANDS_ENABLED
+    comms_aux_mcu_prev_routine_call_systick = timer_get_systick();
+    #endif
 
     /* Store pointer to message */
     *rx_message_pt_pt = &aux_mcu_receive_message;
@@ -59,6 +59,8 @@
 #define MAIN_MCU_COMMAND_UPDT_DEV_STAT  0x000A
 #define MAIN_MCU_COMMAND_STOP_CHARGE    0x000B
 #define MAIN_MCU_COMMAND_SET_BATTERYLVL 0x000C
+#define MAIN_MCU_COMMAND_SET_FRAMING   0x000D
+#define MAIN_MCU_COMMAND_GET_CREDITS   0x000E
 
 // Debug MCU commands
 #define MAIN_MCU_COMMAND_TX_SWEEP_SGL       0x1000
@@ -82,6 +84,12 @@
 #define AUX_MCU_EVENT_USB_DETACHED      0x000C
 #define AUX_MCU_EVENT_CHARGE_LVL_UPDATE 0x000D
 #define AUX_MCU_EVENT_USB_TIMEOUT       0x000E
+#define AUX_MCU_EVENT_FRAMING_SET       0x000F
+#define AUX_MCU_EVENT_MSG_CREDITS       0x0010
+
+// Buffer credits event flags
+#define AUX_MCU_CREDITS_USB_BUFFER_BUSY 0x01
+#define AUX_MCU_CREDITS_BLE_BUFFER_BUSY 0x02
 
 // BLE commands
 #define BLE_MESSAGE_CMD_ENABLE              0x0001
@@ -95,6 +103,12 @@
 #define BLE_MESSAGE_RECALL_BOND_INFO_IRK    0x0009
 #define BLE_MESSAGE_GET_BT_6_DIGIT_CODE     0x000A
 #define BLE_MESSAGE_DISCONNECT_FOR_NEXT     0x000B
+#define BLE_MESSAGE_STORE_TYPING_DELAY      0x000C
+
+// Keyboard typing: flags set in delay_between_types to let the aux MCU tune it (lower bits then being the max delay) and to pack keys in reports
+#define KEYBOARD_TYPE_ADAPTIVE_DELAY_FLAG   0x8000
+#define KEYBOARD_TYPE_ROLLOVER_FLAG         0x4000
+#define KEYBOARD_TYPE_DELAY_MASK            0x3FFF
 
 /* FIDO2 messages start */
 #define AUX_MCU_MSG_TYPE_FIDO2_START 0x0001
@@ -110,6 +124,12 @@
 #define AUX_MCU_MSG_TYPE_FIDO2_END   AUX_MCU_FIDO2_RETRY
 /* FIDO2 messages end */
 
+/* Inter MCU messages trace */
+#define AUX_MCU_MSG_TRACE_NB_ENTRIES        32
+#define AUX_MCU_MSG_TRACE_PAYLOAD_HEAD_LGTH 6
+#define AUX_MCU_MSG_TRACE_DIR_SENT          0
+#define AUX_MCU_MSG_TRACE_DIR_RECEIVED      1
+
 /* Typedefs */
 typedef struct
 {
@@ -315,21 +335,75 @@ typedef struct
     };
 } aux_mcu_message_t;
 
+// Buffer credits request & event, only sent using variable length frames
+typedef struct
+{
+    uint16_t message_type;
+    uint16_t payload_length1;
+    uint16_t command;
+    uint8_t request_id;
+    uint8_t crc[AUX_MCU_MSG_CRC_LENGTH];
+} __attribute__((packed)) aux_mcu_credits_request_frame_t;
+
+typedef struct
+{
+    uint16_t message_type;
+    uint16_t payload_length1;
+    uint16_t event_id;
+    uint8_t nb_other_msgs_released;
+    uint8_t nb_other_msgs_dropped;
+    uint8_t request_id;
+    uint8_t hid_buffers_busy_flags;
+    uint8_t crc[AUX_MCU_MSG_CRC_LENGTH];
+} aux_mcu_credits_event_frame_t;
+
+typedef struct
+{
+    uint32_t systick;                   // Systick when the message was sent or picked up
+    uint16_t message_type;              // Message type
+    uint16_t payload_length1;           // Payload length #1
+    uint8_t direction;                  // AUX_MCU_MSG_TRACE_DIR_xxx
+    uint8_t reserved;                   // Reserved
+    uint8_t payload_head[AUX_MCU_MSG_TRACE_PAYLOAD_HEAD_LGTH];  // First payload bytes (command / event id...)
+} aux_mcu_msg_trace_entry_t;
+
+typedef struct
+{
+    uint32_t nb_messages;               // HID messages dealt with since last read
+    uint32_t total_processing_ms;       // Cumulated time between message pickup and reply
+    uint16_t max_processing_ms;         // Longest time between message pickup and reply
+    uint16_t max_pickup_delay_ms;       // Longest time without aux MCU messages polling before a message pickup
+} comms_aux_mcu_hid_latency_t;
+
+typedef struct
+{
+    BOOL msg_being_processed;           // A HID message is being processed
+    uint32_t nested_prompts_ms;         // Time spent in prompts polling aux MCU messages while processing it
+    uint32_t last_nested_poll_systick;  // Systick of the last of these polls, 0 if none
+} comms_aux_mcu_hid_processing_t;
+
 
 /* Prototypes */
 RET_TYPE comms_aux_mcu_active_wait(aux_mcu_message_t** rx_message_pt_pt, BOOL do_not_touch_dma_flags, uint16_t expected_packet, BOOL single_try, int16_t expected_event);
 comms_msg_rcvd_te comms_aux_mcu_deal_with_ble_message(aux_mcu_message_t* received_message, msg_restrict_type_te answer_restrict_type);
+void comms_aux_mcu_get_and_reset_hid_latency(comms_aux_mcu_hid_latency_t* usb_latency, comms_aux_mcu_hid_latency_t* ble_latency);
+uint16_t comms_aux_mcu_get_msg_trace(aux_mcu_msg_trace_entry_t* entries, uint32_t* first_entry_id, uint32_t* nb_traced_msgs);
 void comms_aux_mcu_get_empty_packet_ready_to_be_sent(aux_mcu_message_t** message_pt_pt, uint16_t message_type);
+void comms_aux_mcu_wait_for_streamed_hid_message_forwarded(BOOL is_message_from_usb);
 comms_msg_rcvd_te comms_aux_mcu_routine(msg_restrict_type_te answer_restrict_type);
 void comms_aux_mcu_deal_with_received_event(aux_mcu_message_t* received_message);
+void comms_aux_mcu_send_streamed_hid_message(BOOL is_message_from_usb);
 aux_mcu_message_t* comms_aux_mcu_get_temp_tx_message_object_pt(void);
+uint16_t comms_aux_mcu_compute_frame_crc(aux_mcu_message_t* message);
 void comms_aux_mcu_send_simple_command_message(uint16_t command);
+RET_TYPE comms_aux_mcu_set_variable_length_framing(BOOL enable);
 void comms_aux_mcu_hard_comms_reset_with_aux_mcu_reboot(void);
 void comms_aux_mcu_update_device_status_buffer(void);
-void comms_aux_mcu_send_message(BOOL wait_for_send);
+RET_TYPE comms_aux_mcu_send_message(BOOL wait_for_send);
 RET_TYPE comms_aux_mcu_send_receive_ping(void);
 void comms_aux_mcu_wait_for_message_sent(void);
 void comms_aux_arm_rx_and_clear_no_comms(void);
+RET_TYPE comms_aux_mcu_reset_framing(void);
 
 
 #endif /* COMMS_AUX_MCU_H_ */
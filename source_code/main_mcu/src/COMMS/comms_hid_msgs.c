@@ -24,6 +24,7 @@
 #include "smartcard_highlevel.h"
 #include "logic_encryption.h"
 #include "logic_smartcard.h"
+#include "logic_database.h"
 #include "gui_dispatcher.h"
 #include "comms_hid_msgs.h"
 #include "logic_security.h"
@@ -849,6 +850,17 @@ int16_t comms_hid_msgs_parse(hid_message_t* rcv_msg, uint16_t supposed_payload_l
             return send_msg->payload_length;
         }
         
+        case HID_CMD_COMPACT_DB:
+        {
+            /* Relocate credential nodes, report page changes needed to browse the database before & after */
+            send_msg->payload_as_uint16[1] = nodemgmt_get_cred_db_page_touches();
+            send_msg->payload_as_uint16[0] = nodemgmt_compact_credential_database();
+            send_msg->payload_as_uint16[2] = nodemgmt_get_cred_db_page_touches();
+            send_msg->payload_length = 3*sizeof(uint16_t);
+            send_msg->message_type = rcv_message_type;
+            return send_msg->payload_length;
+        }
+        
         case HID_CMD_ID_GET_CRED:
         {
             /* Default answer: Nope! */
@@ -1242,7 +1254,29 @@ int16_t comms_hid_msgs_parse(hid_message_t* rcv_msg, uint16_t supposed_payload_l
             uint16_t string_length = utils_strnlen(rcv_msg->payload_as_cust_char_t, max_cust_char_length);
             
             /* Check for valid length, not exceeding payload size, then prompt user */
-            if ((string_length < max_cust_char_length) && ((string_length + 1) == (rcv_msg->payload_length / (uint16_t)sizeof(cust_char_t))) && (logic_security_is_smc_inserted_unlocked() == FALSE) && (logic_user_add_data_service(rcv_msg->payload_as_cust_char_t, is_message_from_usb) == RETURN_OK))
+            if ((string_length < max_cust_char_length) && ((string_length + 1) == (rcv_msg->payload_length / (uint16_t)sizeof(cust_char_t))) && (logic_security_is_smc_inserted_unlocked() != FALSE) && (logic_user_add_data_service(rcv_msg->payload_as_cust_char_t, is_message_from_usb) == RETURN_OK))
+            {
+                /* Set success byte */
+                send_msg->payload[0] = HID_1BYTE_ACK;
+            }
+            else
+            {
+                /* Set failure byte */
+                send_msg->payload[0] = HID_1BYTE_NACK;
+            }
+            
+            send_msg->message_type = rcv_message_type;
+            send_msg->payload_length = 1;
+            return 1;
+        }
+        
+        case HID_CMD_ADD_FILE_DATA_ID:
+        {
+            /* Header size */
+            uint16_t chunk_header_length = sizeof(rcv_msg->file_chunk) - sizeof(rcv_msg->file_chunk.data);
+            
+            /* Check for valid length, then store chunk */
+            if ((rcv_msg->payload_length >= chunk_header_length) && (rcv_msg->file_chunk.chunk_length <= sizeof(rcv_msg->file_chunk.data)) && ((chunk_header_length + rcv_msg->file_chunk.chunk_length) == rcv_msg->payload_length) && (logic_user_add_file_chunk(&rcv_msg->file_chunk, is_message_from_usb) == RETURN_OK))
             {
                 /* Set success byte */
                 send_msg->payload[0] = HID_1BYTE_ACK;
@@ -1258,6 +1292,33 @@ int16_t comms_hid_msgs_parse(hid_message_t* rcv_msg, uint16_t supposed_payload_l
             return 1;
         }
         
+        case HID_CMD_GET_FILE_DATA_ID:
+        {
+            /* Input sanitazing */
+            uint16_t max_cust_char_length = max_payload_size/sizeof(cust_char_t);
+            
+            /* Get string length */
+            uint16_t string_length = utils_strnlen(rcv_msg->payload_as_cust_char_t, max_cust_char_length);
+            
+            /* Check for valid length, not exceeding payload size, then stream file */
+            if ((string_length < max_cust_char_length) && ((string_length + 1) == (rcv_msg->payload_length / (uint16_t)sizeof(cust_char_t))))
+            {
+                int16_t payload_length = logic_user_stream_file(rcv_msg->payload_as_cust_char_t, send_msg, is_message_from_usb);
+                
+                /* Success: last chunk is in send_msg */
+                if (payload_length >= 0)
+                {
+                    return payload_length;
+                }
+            }
+            
+            /* Set failure byte */
+            send_msg->message_type = rcv_message_type;
+            send_msg->payload[0] = HID_1BYTE_NACK;
+            send_msg->payload_length = 1;
+            return 1;
+        }
+        
         case HID_CMD_SET_USER_KEYB_ID:
         {
             BOOL is_usb_interface_wanted = (BOOL)rcv_msg->payload[0];
@@ -1401,6 +1462,56 @@ int16_t comms_hid_msgs_parse(hid_message_t* rcv_msg, uint16_t supposed_payload_l
             return 1;   
         }
         
+        case HID_CMD_SEARCH_SERVICES:
+        {
+            /* Get query length */
+            uint16_t query_length = utils_strnlen(rcv_msg->search_services_req.query, MEMBER_ARRAY_SIZE(hid_message_search_services_req_t, query));
+            
+            /* User logged in, valid mode, non empty null terminated query within payload? */
+            if ((logic_security_is_smc_inserted_unlocked() != FALSE) && \
+                (rcv_msg->search_services_req.search_mode <= SEARCH_MODE_SUBSTRING) && \
+                (query_length > 0) && (query_length < MEMBER_ARRAY_SIZE(hid_message_search_services_req_t, query)) && \
+                (rcv_msg->payload_length >= sizeof(rcv_msg->search_services_req.search_mode) + sizeof(rcv_msg->search_services_req.start_after_addr) + (query_length + 1)*sizeof(cust_char_t)))
+            {
+                /* Store request: message buffer may be used while prompting the user */
+                cust_char_t query[MEMBER_ARRAY_SIZE(hid_message_search_services_req_t, query)];
+                service_search_mode_te search_mode = (service_search_mode_te)rcv_msg->search_services_req.search_mode;
+                uint16_t start_after_addr = rcv_msg->search_services_req.start_after_addr;
+                utils_strcpy(query, rcv_msg->search_services_req.query);
+                
+                /* Results reveal service names: outside of management mode, the user approves the first search of the session */
+                if ((logic_security_is_management_mode_set() == FALSE) && (logic_security_is_service_search_approved() == FALSE))
+                {
+                    cust_char_t* two_line_prompt_2;
+                    custom_fs_get_string_from_file(ACCESS_TO_TEXT_ID, &two_line_prompt_2, TRUE);
+                    confirmationText_t conf_text_2_lines = {.lines[0]=query, .lines[1]=two_line_prompt_2};
+                    mini_input_yes_no_ret_te prompt_return = gui_prompts_ask_for_confirmation(2, &conf_text_2_lines, TRUE, TRUE, TRUE);
+                    gui_dispatcher_get_back_to_current_screen();
+                    
+                    /* Did the user approve? */
+                    if (prompt_return != MINI_INPUT_RET_YES)
+                    {
+                        send_msg->message_type = rcv_message_type;
+                        send_msg->payload[0] = HID_1BYTE_NACK;
+                        send_msg->payload_length = 1;
+                        return 1;
+                    }
+                    logic_security_set_service_search_approved();
+                }
+                
+                send_msg->search_services_answer.nb_results = logic_database_search_services(query, search_mode, start_after_addr, send_msg->search_services_answer.parent_addrs, ARRAY_SIZE(send_msg->search_services_answer.parent_addrs));
+                send_msg->payload_length = sizeof(send_msg->search_services_answer.nb_results) + send_msg->search_services_answer.nb_results*sizeof(send_msg->search_services_answer.parent_addrs[0]);
+                send_msg->message_type = rcv_message_type;
+                return send_msg->payload_length;
+            }
+            
+            /* Set failure byte */
+            send_msg->message_type = rcv_message_type;
+            send_msg->payload[0] = HID_1BYTE_NACK;
+            send_msg->payload_length = 1;
+            return 1;
+        }
+        
         default: break;
     }
     
@@ -73,6 +73,7 @@
 #define HID_CMD_CREATE_FILE_ID      0x0021
 #define HID_CMD_ADD_FILE_DATA_ID    0x0022
 #define HID_CMD_GET_FILE_DATA_ID    0x0023
+#define HID_CMD_SEARCH_SERVICES     0x0024
 // Below: commands requiring MMM
 #define HID_CMD_GET_START_PARENTS   0x0100
 #define HID_CMD_END_MMM             0x0101
@@ -90,6 +91,7 @@
 #define HID_CMD_WRITE_NODE          0x010D
 #define HID_CMD_GET_CPZ_LUT_ENTRY   0x010E
 #define HID_CMD_GET_FAVORITES       0x010F
+#define HID_CMD_COMPACT_DB          0x0110
 // Define used to identify commands
 #define HID_FIRST_CMD_FOR_MMM       HID_CMD_GET_START_PARENTS
 #define HID_LAST_CMD_FOR_MMM        0x0200
@@ -172,6 +174,29 @@ typedef struct
     uint16_t aux_dac_register_val;
 } hid_message_get_battery_status_t;
 
+typedef struct
+{
+    uint32_t file_length;       // Total file length, only used in the first uploaded chunk
+    uint16_t chunk_id;          // Chunk number, starting at 0
+    uint16_t last_chunk_flag;   // Set for the last chunk of a file
+    uint16_t chunk_length;      // Number of valid bytes in data
+    uint16_t reserved;          // Reserved for future use
+    uint8_t data[512];          // File data
+} hid_message_file_chunk_t;
+
+typedef struct
+{
+    uint16_t search_mode;       // See service_search_mode_te
+    uint16_t start_after_addr;  // Parent address after which the search starts, 0 for first page
+    cust_char_t query[126];     // Null terminated search query
+} hid_message_search_services_req_t;
+
+typedef struct
+{
+    uint16_t nb_results;        // Number of parent addresses below
+    uint16_t parent_addrs[64];  // Matching parent addresses, in credentials list order
+} hid_message_search_services_answer_t;
+
 typedef struct
 {
     uint16_t message_type;
@@ -191,6 +216,9 @@ typedef struct
         hid_message_get_cred_answer_t get_credential_answer;
         hid_message_get_set_category_strings_t get_set_cat_strings;
         hid_message_setup_existing_user_req_t setup_existing_user_req;
+        hid_message_file_chunk_t file_chunk;
+        hid_message_search_services_req_t search_services_req;
+        hid_message_search_services_answer_t search_services_answer;
     };
 } hid_message_t;
 
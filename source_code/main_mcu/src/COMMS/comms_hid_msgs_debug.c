@@ -25,6 +25,7 @@
 #include "comms_hid_msgs_debug.h"
 #include "comms_hid_msgs.h"
 #include "gui_dispatcher.h"
+#include "logic_encryption.h"
 #include "logic_aux_mcu.h"
 #include "comms_aux_mcu.h"
 #include "driver_sercom.h"
@@ -33,11 +34,15 @@
 #include "platform_io.h"
 #include "logic_power.h"
 #include "dataflash.h"
+#include "nodemgmt.h"
 #include "sh1122.h"
 #include "main.h"
 #include "dma.h"
 /* Variable to know if we're allowing bundle upload */
 BOOL comms_hid_msgs_debug_upload_allowed = FALSE;
+/* Number of dbflash bytes read while parsing the last non debug command */
+uint32_t comms_hid_msgs_debug_last_cmd_nb_bytes_read = 0;
+uint16_t comms_hid_msgs_debug_last_cmd_id = 0;
 
 
 #ifdef DEBUG_USB_PRINTF_ENABLED
@@ -84,6 +89,17 @@ void comms_hid_msgs_debug_printf(const char *fmt, ...)
 #pragma GCC diagnostic pop
 #endif
 
+/*! \fn     comms_hid_msgs_debug_log_dbflash_reads(uint16_t message_type, uint32_t nb_bytes_read)
+*   \brief  Store the number of dbflash bytes read while parsing a non debug command
+*   \param  message_type    Parsed message type
+*   \param  nb_bytes_read   Number of bytes read
+*/
+void comms_hid_msgs_debug_log_dbflash_reads(uint16_t message_type, uint32_t nb_bytes_read)
+{
+    comms_hid_msgs_debug_last_cmd_nb_bytes_read = nb_bytes_read;
+    comms_hid_msgs_debug_last_cmd_id = message_type;
+}
+
 /*! \fn     comms_hid_msgs_parse_debug(hid_message_t* rcv_msg, uint16_t supposed_payload_length, hid_message_t* send_msg, msg_restrict_type_te answer_restrict_type)
 *   \brief  Parse an incoming message from USB or BLE
 *   \param  rcv_msg                 Received message
@@ -450,6 +466,84 @@ int16_t comms_hid_msgs_parse_debug(hid_message_t* rcv_msg, uint16_t supposed_pay
             
             return sizeof(send_msg->battery_status);
         }
+        case HID_CMD_ID_AES_CTR_BENCHMARK:
+        {
+            /* Number of kB to decrypt for each backend, as first uint16_t */
+            uint16_t nb_kbytes = 16;
+            if ((rcv_msg->payload_length >= sizeof(uint16_t)) && (rcv_msg->payload_as_uint16[0] != 0))
+            {
+                nb_kbytes = rcv_msg->payload_as_uint16[0];
+            }
+            
+            /* Keep screen on, as this may take a while */
+            logic_device_activity_detected();
+            
+            /* Bytes per second for each backend, 0 if not available */
+            send_msg->payload_as_uint32[AES_CTR_BENCH_CT_PER_BLOB] = logic_encryption_ctr_benchmark(AES_CTR_BENCH_CT_PER_BLOB, nb_kbytes);
+            send_msg->payload_as_uint32[AES_CTR_BENCH_CT_BATCH] = logic_encryption_ctr_benchmark(AES_CTR_BENCH_CT_BATCH, nb_kbytes);
+            send_msg->payload_as_uint32[AES_CTR_BENCH_CT64_BATCH] = logic_encryption_ctr_benchmark(AES_CTR_BENCH_CT64_BATCH, nb_kbytes);
+            send_msg->payload_length = 3*sizeof(uint32_t);
+            return 3*sizeof(uint32_t);
+        }
+        case HID_CMD_ID_GET_DBFLASH_WEAR:
+        {
+            /* Sanity check */
+            _Static_assert(sizeof(nodemgmt_wear_stats_t) + sizeof(nodemgmt_wear_profile_stats_t) <= sizeof(send_msg->payload), "Wear statistics don't fit in payload");
+            
+            /* Flush pending counters, then send wear statistics followed by profile pages statistics */
+            nodemgmt_wear_stats_flush(FALSE);
+            nodemgmt_read_wear_stats((nodemgmt_wear_stats_t*)send_msg->payload, (nodemgmt_wear_profile_stats_t*)&send_msg->payload[sizeof(nodemgmt_wear_stats_t)]);
+            send_msg->payload_length = sizeof(nodemgmt_wear_stats_t) + sizeof(nodemgmt_wear_profile_stats_t);
+            return sizeof(nodemgmt_wear_stats_t) + sizeof(nodemgmt_wear_profile_stats_t);
+        }
+        case HID_CMD_ID_GET_DBFLASH_READS:
+        {
+            hid_message_dbflash_reads_t* dbflash_reads_pt = (hid_message_dbflash_reads_t*)send_msg->payload;
+            
+            /* Send number of bytes read since boot and while parsing last command */
+            dbflash_reads_pt->total_nb_bytes_read = dbflash_nb_bytes_read;
+            dbflash_reads_pt->last_cmd_id = comms_hid_msgs_debug_last_cmd_id;
+            dbflash_reads_pt->reserved = 0;
+            dbflash_reads_pt->last_cmd_nb_bytes_read = comms_hid_msgs_debug_last_cmd_nb_bytes_read;
+            send_msg->payload_length = sizeof(hid_message_dbflash_reads_t);
+            return sizeof(hid_message_dbflash_reads_t);
+        }
+        case HID_CMD_ID_GET_AUX_MSG_TRACE:
+        {
+            hid_message_aux_msg_trace_t* msg_trace_pt = (hid_message_aux_msg_trace_t*)send_msg->payload;
+            
+            /* Sanity check */
+            _Static_assert(sizeof(hid_message_aux_msg_trace_t) <= sizeof(send_msg->payload), "Messages trace doesn't fit in payload");
+            
+            /* ID of the first wanted entry as first uint32_t, oldest available one by default */
+            msg_trace_pt->first_entry_id = 0;
+            if (rcv_msg->payload_length >= sizeof(uint32_t))
+            {
+                msg_trace_pt->first_entry_id = rcv_msg->payload_as_uint32[0];
+            }
+            
+            /* Send available entries, current systick allows the host to match them with its own timeline */
+            msg_trace_pt->nb_entries = comms_aux_mcu_get_msg_trace(msg_trace_pt->entries, &msg_trace_pt->first_entry_id, &msg_trace_pt->nb_traced_msgs);
+            msg_trace_pt->current_systick = timer_get_systick();
+            msg_trace_pt->reserved = 0;
+            send_msg->payload_length = sizeof(hid_message_aux_msg_trace_t) - sizeof(msg_trace_pt->entries) + msg_trace_pt->nb_entries*sizeof(aux_mcu_msg_trace_entry_t);
+            return send_msg->payload_length;
+        }
+        case HID_CMD_ID_GET_HID_LATENCY:
+        {
+            /* USB then BLE statistics, reset once read */
+            comms_aux_mcu_hid_latency_t* latency_stats_pt = (comms_aux_mcu_hid_latency_t*)send_msg->payload;
+            comms_aux_mcu_get_and_reset_hid_latency(&latency_stats_pt[0], &latency_stats_pt[1]);
+            send_msg->payload_length = 2*sizeof(comms_aux_mcu_hid_latency_t);
+            return 2*sizeof(comms_aux_mcu_hid_latency_t);
+        }
+        case HID_CMD_ID_GET_WAIT_STATS:
+        {
+            /* Event wait statistics for each power source, reset once read */
+            timer_get_and_reset_wait_stats((timer_wait_stats_t*)send_msg->payload);
+            send_msg->payload_length = TIMER_WAIT_STATS_NB_POWER_SOURCES*sizeof(timer_wait_stats_t);
+            return TIMER_WAIT_STATS_NB_POWER_SOURCES*sizeof(timer_wait_stats_t);
+        }
         default: break;
     }
     
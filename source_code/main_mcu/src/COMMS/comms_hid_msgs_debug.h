@@ -26,6 +26,7 @@
 
 #include "platform_defines.h"
 #include "comms_hid_msgs.h"
+#include "comms_aux_mcu.h"
 
 /* Defines */
 #define HID_MESSAGE_START_CMD_ID_DBG        0x8000
@@ -45,9 +46,35 @@
 #define HID_CMD_ID_SET_OLED_PARAMS          0x800C
 #define HID_CMD_ID_GET_BATTERY_STATUS       0x800D
 #define HID_CMD_ID_FLASH_AUX_AND_MAIN       0x800E
+#define HID_CMD_ID_AES_CTR_BENCHMARK        0x800F
+#define HID_CMD_ID_GET_DBFLASH_WEAR         0x8010
+#define HID_CMD_ID_GET_DBFLASH_READS        0x8011
+#define HID_CMD_ID_GET_AUX_MSG_TRACE        0x8012
+#define HID_CMD_ID_GET_HID_LATENCY          0x8013
+#define HID_CMD_ID_GET_WAIT_STATS           0x8014
+
+/* Typedefs */
+typedef struct
+{
+    uint32_t total_nb_bytes_read;       // Bytes read from dbflash since boot
+    uint16_t last_cmd_id;               // Last parsed non debug HID command
+    uint16_t reserved;                  // Reserved
+    uint32_t last_cmd_nb_bytes_read;    // Bytes read from dbflash while parsing it
+} hid_message_dbflash_reads_t;
+
+typedef struct
+{
+    uint32_t nb_traced_msgs;            // Messages traced since boot
+    uint32_t first_entry_id;            // Trace ID of the first entry below
+    uint32_t current_systick;           // Systick when answering
+    uint16_t nb_entries;                // Number of entries below
+    uint16_t reserved;                  // Reserved
+    aux_mcu_msg_trace_entry_t entries[AUX_MCU_MSG_TRACE_NB_ENTRIES];
+} hid_message_aux_msg_trace_t;
 
 /* Prototypes */
 int16_t comms_hid_msgs_parse_debug(hid_message_t* rcv_msg, uint16_t supposed_payload_length, hid_message_t* send_msg, msg_restrict_type_te answer_restrict_type);
+void comms_hid_msgs_debug_log_dbflash_reads(uint16_t message_type, uint32_t nb_bytes_read);
 #ifdef DEBUG_USB_PRINTF_ENABLED
     void comms_hid_msgs_debug_printf(const char *fmt, ...);
 #else
@@ -22,6 +22,7 @@
 #include <asf.h>
 #include "platform_defines.h"
 #include "comms_aux_mcu.h"
+#include "driver_timer.h"
 #include "platform_io.h"
 #include "dma.h"
 /* DMA Descriptors for our transfers and their DMA priority levels (highest number is higher priority, contrary to what is written in some datasheets) */
@@ -33,10 +34,14 @@
 // SPI RX routine for transfer from accelerometer: level 2
 // SPI TX routine for transfer to accelerometer: level 2
 // SPI TX routine for transfer to a display: level 1
-DmacDescriptor dma_writeback_descriptors[7] __attribute__ ((aligned (16)));
-DmacDescriptor dma_descriptors[7] __attribute__ ((aligned (16)));
+// SPI RX routine for dbflash read-ahead: level 0
+// SPI TX routine for dbflash read-ahead: level 0
+DmacDescriptor dma_writeback_descriptors[9] __attribute__ ((aligned (16)));
+DmacDescriptor dma_descriptors[9] __attribute__ ((aligned (16)));
 /* Boolean to specify if the last DMA transfer for the custom_fs is done */
 volatile BOOL dma_custom_fs_transfer_done = FALSE;
+/* Boolean to specify if the last DMA transfer for the dbflash is done */
+volatile BOOL dma_dbflash_transfer_done = FALSE;
 /* Boolean to specify if the last DMA transfer for the oled display is done */
 volatile BOOL dma_oled_transfer_done = FALSE;
 /* Boolean to specify if the last DMA transfer for the accelerometer is done */
@@ -47,6 +52,37 @@ volatile BOOL dma_aux_mcu_packet_received = FALSE;
 volatile BOOL dma_aux_mcu_packet_sent = TRUE;
 /* Boolean to specify if DMA needs to be rearmed to receive an aux MCU packet (use with caution) */
 volatile BOOL dma_aux_mcu_rx_transfer_to_be_rearmed = TRUE;
+/* Variable length aux MCU frames: enable flag, header reception flag, receive buffer & its size */
+BOOL dma_aux_mcu_variable_length_frames = FALSE;
+volatile BOOL dma_aux_mcu_rx_header_stage = FALSE;
+aux_mcu_message_t* dma_aux_mcu_rx_frame_pt;
+uint16_t dma_aux_mcu_rx_frame_size;
+/* Aux MCU buffers for non USB & non BLE messages, number of messages we sent using them */
+uint16_t dma_aux_mcu_nb_other_msg_buffers = 0;
+uint8_t dma_aux_mcu_nb_other_msgs_sent = 0;
+/* Numbers of these messages released & dropped by the aux MCU, last credits request it answered, its USB & BLE buffers state (only sent using variable length frames) */
+volatile uint8_t dma_aux_mcu_nb_other_msgs_released = 0;
+volatile uint8_t dma_aux_mcu_nb_other_msgs_dropped = 0;
+volatile uint8_t dma_aux_mcu_last_credits_request_answered = 0;
+volatile uint8_t dma_aux_mcu_hid_buffers_busy_flags = 0;
+
+/*! \fn     dma_aux_mcu_is_credits_event_received(void)
+*   \brief  Check if the variable length frame we just received is a valid buffer credits event
+*   \return TRUE or FALSE
+*/
+static inline BOOL dma_aux_mcu_is_credits_event_received(void)
+{
+    uint8_t* crc_pt = &dma_aux_mcu_rx_frame_pt->aux_mcu_event_message.payload[4];
+    
+    if ((dma_aux_mcu_rx_frame_pt->message_type == AUX_MCU_MSG_TYPE_AUX_MCU_EVENT) && (dma_aux_mcu_rx_frame_pt->aux_mcu_event_message.event_id == AUX_MCU_EVENT_MSG_CREDITS) && (dma_aux_mcu_rx_frame_pt->payload_length1 == sizeof(uint16_t) + 4*sizeof(uint8_t)))
+    {
+        if (comms_aux_mcu_compute_frame_crc(dma_aux_mcu_rx_frame_pt) == (crc_pt[0] | (crc_pt[1] << 8)))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
 
 
 /*! \fn     DMAC_Handler(void)
@@ -56,7 +92,40 @@ void DMAC_Handler(void)
 {    
     /* AUX MCU RX routine */
     DMAC->CHID.reg = DMAC_CHID_ID(DMA_DESCID_RX_COMMS);
-    if ((DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_TCMPL) != 0)
+    if (((DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_TCMPL) != 0) && (dma_aux_mcu_rx_header_stage != FALSE))
+    {
+        /* Variable length frame header received: clear interrupt, fetch payload & CRC */
+        DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL;
+        dma_aux_mcu_rx_header_stage = FALSE;
+        uint16_t nb_bytes_to_receive = dma_aux_mcu_rx_frame_pt->payload_length1 + AUX_MCU_MSG_CRC_LENGTH;
+        
+        /* Payload length leaving no room for the CRC: frame sent with a fixed size */
+        if (dma_aux_mcu_rx_frame_pt->payload_length1 > AUX_MCU_MSG_VAR_FRAME_MAX_PAYLOAD_LENGTH)
+        {
+            nb_bytes_to_receive = dma_aux_mcu_rx_frame_size - AUX_MCU_MSG_HEADER_LENGTH;
+        }
+        
+        /* Resume DMA channel operation */
+        dma_descriptors[DMA_DESCID_RX_COMMS].BTCNT.bit.BTCNT = nb_bytes_to_receive;
+        dma_descriptors[DMA_DESCID_RX_COMMS].DSTADDR.reg = (uint32_t)dma_aux_mcu_rx_frame_pt + AUX_MCU_MSG_HEADER_LENGTH + nb_bytes_to_receive;
+        DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+    }
+    else if (((DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_TCMPL) != 0) && (dma_aux_mcu_variable_length_frames != FALSE) && (dma_aux_mcu_is_credits_event_received() != FALSE))
+    {
+        /* Buffer credits state sent by the aux MCU: clear interrupt, store its total numbers of released & dropped messages and its HID buffers state */
+        DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL;
+        dma_aux_mcu_nb_other_msgs_released = dma_aux_mcu_rx_frame_pt->aux_mcu_event_message.payload[0];
+        dma_aux_mcu_nb_other_msgs_dropped = dma_aux_mcu_rx_frame_pt->aux_mcu_event_message.payload[1];
+        dma_aux_mcu_hid_buffers_busy_flags = dma_aux_mcu_rx_frame_pt->aux_mcu_event_message.payload[3];
+        dma_aux_mcu_last_credits_request_answered = dma_aux_mcu_rx_frame_pt->aux_mcu_event_message.payload[2];
+        
+        /* Receive the next frame header in the same buffer, our RX buffer stays available */
+        dma_aux_mcu_rx_header_stage = TRUE;
+        dma_descriptors[DMA_DESCID_RX_COMMS].BTCNT.bit.BTCNT = AUX_MCU_MSG_HEADER_LENGTH;
+        dma_descriptors[DMA_DESCID_RX_COMMS].DSTADDR.reg = (uint32_t)dma_aux_mcu_rx_frame_pt + AUX_MCU_MSG_HEADER_LENGTH;
+        DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+    }
+    else if ((DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_TCMPL) != 0)
     {
         /* Set transfer done boolean, clear interrupt */
         platform_io_set_no_comms();
@@ -83,6 +152,15 @@ void DMAC_Handler(void)
         DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL;
     }
     
+    /* RX routine for dbflash */
+    DMAC->CHID.reg = DMAC_CHID_ID(DMA_DESCID_RX_DBFLASH);
+    if ((DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_TCMPL) != 0)
+    {
+        /* Set transfer done boolean, clear interrupt */
+        dma_dbflash_transfer_done = TRUE;
+        DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL;
+    }
+    
     /* OLED TX routine */
     DMAC->CHID.reg = DMAC_CHID_ID(DMA_DESCID_TX_OLED);
     if ((DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_TCMPL) != 0)
@@ -116,12 +194,30 @@ void dma_set_custom_fs_flag_done(void)
     dma_custom_fs_transfer_done = TRUE;
 }
 
+/*! \fn     dma_aux_mcu_check_packet_sent(void)
+*   \brief  Check if the last aux MCU packet was sent
+*   \return TRUE or FALSE
+*/
+static BOOL dma_aux_mcu_check_packet_sent(void)
+{
+    return dma_aux_mcu_packet_sent;
+}
+
+/*! \fn     dma_aux_mcu_check_rx_transfer_to_be_rearmed(void)
+*   \brief  Check if the current aux MCU packet was completely received
+*   \return TRUE or FALSE
+*/
+static BOOL dma_aux_mcu_check_rx_transfer_to_be_rearmed(void)
+{
+    return dma_aux_mcu_rx_transfer_to_be_rearmed;
+}
+
 /*! \fn     dma_wait_for_aux_mcu_packet_sent(void)
 *   \brief  Wait for aux mcu packet to be sent
 */
 void dma_wait_for_aux_mcu_packet_sent(void)
 {
-    while (dma_aux_mcu_packet_sent == FALSE);
+    timer_wait_for_event(dma_aux_mcu_check_packet_sent);
 }
 
 /*! \fn     dma_reset(void)
@@ -205,6 +301,41 @@ void dma_init(void)
     dma_chctrlb_reg.bit.TRIGSRC = DATAFLASH_DMA_SERCOM_TXTRIG;                              // Select RX trigger
     DMAC->CHCTRLB = dma_chctrlb_reg;                                                        // Write register
 
+    /* Setup transfer descriptor for dbflash RX */
+    dma_descriptors[DMA_DESCID_RX_DBFLASH].BTCTRL.reg = DMAC_BTCTRL_VALID;                      // Valid descriptor
+    dma_descriptors[DMA_DESCID_RX_DBFLASH].BTCTRL.bit.STEPSIZE = DMAC_BTCTRL_STEPSIZE_X1_Val;   // 1 byte address increment
+    dma_descriptors[DMA_DESCID_RX_DBFLASH].BTCTRL.bit.STEPSEL = DMAC_BTCTRL_STEPSEL_DST_Val;    // Step selection for destination
+    dma_descriptors[DMA_DESCID_RX_DBFLASH].BTCTRL.bit.DSTINC = 1;                               // Destination Address Increment is enabled.
+    dma_descriptors[DMA_DESCID_RX_DBFLASH].BTCTRL.bit.BEATSIZE = DMAC_BTCTRL_BEATSIZE_BYTE_Val; // Byte data transfer
+    dma_descriptors[DMA_DESCID_RX_DBFLASH].BTCTRL.bit.BLOCKACT = DMAC_BTCTRL_BLOCKACT_INT_Val;  // Once data block is transferred, generate interrupt
+    dma_descriptors[DMA_DESCID_RX_DBFLASH].DESCADDR.reg = 0;                                    // No next descriptor address
+    
+    /* Setup DMA channel */
+    DMAC->CHID.reg = DMAC_CHID_ID(DMA_DESCID_RX_DBFLASH);                                       // Select channel
+    dma_chctrlb_reg.reg = 0;                                                                    // Clear it
+    dma_chctrlb_reg.bit.LVL = 0;                                                                // Priority level
+    dma_chctrlb_reg.bit.TRIGACT = DMAC_CHCTRLB_TRIGACT_BEAT_Val;                                // One trigger required for each beat transfer
+    dma_chctrlb_reg.bit.TRIGSRC = DBFLASH_DMA_SERCOM_RXTRIG;                                    // Select RX trigger
+    DMAC->CHCTRLB = dma_chctrlb_reg;                                                            // Write register
+    DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TCMPL;                                               // Enable channel transfer complete interrupt
+
+    /* Setup transfer descriptor for dbflash TX */
+    dma_descriptors[DMA_DESCID_TX_DBFLASH].BTCTRL.reg = DMAC_BTCTRL_VALID;                      // Valid descriptor
+    dma_descriptors[DMA_DESCID_TX_DBFLASH].BTCTRL.bit.STEPSIZE = DMAC_BTCTRL_STEPSIZE_X1_Val;   // 1 byte address increment
+    dma_descriptors[DMA_DESCID_TX_DBFLASH].BTCTRL.bit.STEPSEL = DMAC_BTCTRL_STEPSEL_SRC_Val;    // Step selection for source
+    dma_descriptors[DMA_DESCID_TX_DBFLASH].BTCTRL.bit.SRCINC = 1;                               // Source Address Increment is enabled.
+    dma_descriptors[DMA_DESCID_TX_DBFLASH].BTCTRL.bit.BEATSIZE = DMAC_BTCTRL_BEATSIZE_BYTE_Val; // Byte data transfer
+    dma_descriptors[DMA_DESCID_TX_DBFLASH].BTCTRL.bit.BLOCKACT = DMAC_BTCTRL_BLOCKACT_NOACT_Val;// Once data block is transferred, do nothing
+    dma_descriptors[DMA_DESCID_TX_DBFLASH].DESCADDR.reg = 0;                                    // No next descriptor address
+    
+    /* Setup DMA channel */
+    DMAC->CHID.reg = DMAC_CHID_ID(DMA_DESCID_TX_DBFLASH);                                       // Select channel
+    dma_chctrlb_reg.reg = 0;                                                                    // Clear it
+    dma_chctrlb_reg.bit.LVL = 0;                                                                // Priority level
+    dma_chctrlb_reg.bit.TRIGACT = DMAC_CHCTRLB_TRIGACT_BEAT_Val;                                // One trigger required for each beat transfer
+    dma_chctrlb_reg.bit.TRIGSRC = DBFLASH_DMA_SERCOM_TXTRIG;                                    // Select TX trigger
+    DMAC->CHCTRLB = dma_chctrlb_reg;                                                            // Write register
+
     /* Setup transfer descriptor for oled TX */
     dma_descriptors[DMA_DESCID_TX_OLED].BTCTRL.reg = DMAC_BTCTRL_VALID;                     // Valid descriptor
     dma_descriptors[DMA_DESCID_TX_OLED].BTCTRL.bit.STEPSIZE = DMAC_BTCTRL_STEPSIZE_X1_Val;  // 1 byte address increment
@@ -397,10 +528,54 @@ BOOL dma_aux_mcu_check_dma_transfer_flag(void)
 */
 void dma_aux_mcu_wait_for_current_packet_reception_and_clear_flag(void)
 {
-    while (dma_aux_mcu_rx_transfer_to_be_rearmed == FALSE);
+    timer_wait_for_event(dma_aux_mcu_check_rx_transfer_to_be_rearmed);
     dma_aux_mcu_packet_received = FALSE;
 }
 
+/*! \fn     dma_dbflash_check_and_clear_dma_transfer_flag(void)
+*   \brief  Check if a DMA transfer that we requested for dbflash read-ahead is done
+*   \note   If the flag is true, flag will be cleared to false
+*   \return TRUE or FALSE
+*/
+BOOL dma_dbflash_check_and_clear_dma_transfer_flag(void)
+{
+    /* flag can't be set twice, code is safe */
+    if (dma_dbflash_transfer_done != FALSE)
+    {
+        dma_dbflash_transfer_done = FALSE;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/*! \fn     dma_dbflash_init_transfer(Sercom* sercom, void* datap, uint16_t size)
+*   \brief  Initialize a DMA transfer from the dbflash bus to the array
+*   \param  sercom      Pointer to a sercom module
+*   \param  datap       Pointer to where to store the data
+*   \param  size        Number of bytes to transfer
+*/
+void dma_dbflash_init_transfer(Sercom* sercom, void* datap, uint16_t size)
+{
+    volatile void *spi_data_p = &sercom->SPI.DATA.reg;
+    cpu_irq_enter_critical();
+    
+    /* SPI RX DMA TRANSFER */
+    dma_descriptors[DMA_DESCID_RX_DBFLASH].BTCNT.bit.BTCNT = (uint16_t)size;
+    dma_descriptors[DMA_DESCID_RX_DBFLASH].SRCADDR.reg = (uint32_t)spi_data_p;
+    dma_descriptors[DMA_DESCID_RX_DBFLASH].DSTADDR.reg = (uint32_t)datap + size;
+    DMAC->CHID.reg= DMAC_CHID_ID(DMA_DESCID_RX_DBFLASH);
+    DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+    
+    /* SPI TX DMA TRANSFER: clock out the buffer contents */
+    dma_descriptors[DMA_DESCID_TX_DBFLASH].BTCNT.bit.BTCNT = (uint16_t)size;
+    dma_descriptors[DMA_DESCID_TX_DBFLASH].DSTADDR.reg = (uint32_t)spi_data_p;
+    dma_descriptors[DMA_DESCID_TX_DBFLASH].SRCADDR.reg = (uint32_t)datap + size;
+    DMAC->CHID.reg= DMAC_CHID_ID(DMA_DESCID_TX_DBFLASH);
+    DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
+    
+    cpu_irq_leave_critical();
+}
+
 /*! \fn     dma_custom_fs_init_transfer(Sercom* sercom, void* datap, uint16_t size)
 *   \brief  Initialize a DMA transfer from the flash bus to the array
 *   \param  sercom      Pointer to a sercom module
@@ -679,7 +854,7 @@ void dma_aux_mcu_init_tx_transfer(Sercom* sercom, void* datap, uint16_t size)
 {
     volatile void *usart_data_p = &sercom->USART.DATA.reg;
     /* Wait for previous transfer to be done */
-    while (dma_aux_mcu_packet_sent == FALSE);
+    timer_wait_for_event(dma_aux_mcu_check_packet_sent);
     
     cpu_irq_enter_critical();
     
@@ -700,6 +875,103 @@ void dma_aux_mcu_init_tx_transfer(Sercom* sercom, void* datap, uint16_t size)
     cpu_irq_leave_critical();
 }
 
+/*! \fn     dma_aux_mcu_set_variable_length_framing(BOOL enable)
+*   \brief  Select variable length or fixed size frames for the aux MCU comms
+*   \param  enable  TRUE to use variable length frames
+*   \note   To be called while RX is disabled, takes effect at the next transfers
+*/
+void dma_aux_mcu_set_variable_length_framing(BOOL enable)
+{
+    dma_aux_mcu_variable_length_frames = enable;
+    
+    /* Buffer credits are only returned using variable length frames */
+    if (enable == FALSE)
+    {
+        dma_aux_mcu_set_nb_other_msg_buffers(0);
+    }
+}
+
+/*! \fn     dma_aux_mcu_set_nb_other_msg_buffers(uint16_t nb_buffers)
+*   \brief  Set the number of aux MCU buffers for non USB & non BLE messages, and reset the buffer credits state
+*   \param  nb_buffers  Number of buffers, 0 if the aux MCU doesn't return buffer credits
+*   \note   The framing command that got us these buffers is counted as using one until the aux MCU releases it
+*/
+void dma_aux_mcu_set_nb_other_msg_buffers(uint16_t nb_buffers)
+{
+    cpu_irq_enter_critical();
+    dma_aux_mcu_nb_other_msg_buffers = nb_buffers;
+    dma_aux_mcu_nb_other_msgs_sent = (nb_buffers != 0)?1:0;
+    dma_aux_mcu_nb_other_msgs_released = 0;
+    dma_aux_mcu_nb_other_msgs_dropped = 0;
+    cpu_irq_leave_critical();
+}
+
+/*! \fn     dma_aux_mcu_get_nb_other_msg_buffers(void)
+*   \brief  Get the number of aux MCU buffers for non USB & non BLE messages
+*   \return Number of buffers, 0 if the aux MCU doesn't return buffer credits
+*/
+uint16_t dma_aux_mcu_get_nb_other_msg_buffers(void)
+{
+    return dma_aux_mcu_nb_other_msg_buffers;
+}
+
+/*! \fn     dma_aux_mcu_take_other_msg_credit(BOOL force)
+*   \brief  Try to take a buffer credit to send a non USB & non BLE message to the aux MCU
+*   \param  force   Set to TRUE to count the message as using an aux MCU buffer even if none is known to be free
+*   \return TRUE if a credit was taken
+*/
+BOOL dma_aux_mcu_take_other_msg_credit(BOOL force)
+{
+    /* Buffers in use: messages we sent minus the ones the aux MCU released or dropped. These totals only grow, so reading them while an event arrives can't overestimate our credits */
+    uint8_t nb_buffers_used = (uint8_t)(dma_aux_mcu_nb_other_msgs_sent - dma_aux_mcu_nb_other_msgs_released - dma_aux_mcu_nb_other_msgs_dropped);
+    
+    if ((nb_buffers_used < dma_aux_mcu_nb_other_msg_buffers) || (force != FALSE))
+    {
+        dma_aux_mcu_nb_other_msgs_sent++;
+        return TRUE;
+    }
+    else
+    {
+        return FALSE;
+    }
+}
+
+/*! \fn     dma_aux_mcu_get_nb_other_msgs_dropped(void)
+*   \brief  Get the number of non USB & non BLE messages the aux MCU reported as dropped
+*   \return Number of dropped messages, modulo 256
+*/
+uint8_t dma_aux_mcu_get_nb_other_msgs_dropped(void)
+{
+    return dma_aux_mcu_nb_other_msgs_dropped;
+}
+
+/*! \fn     dma_aux_mcu_get_last_credits_request_answered(void)
+*   \brief  Get the ID of the last buffer credits request answered by the aux MCU
+*   \return The request ID
+*/
+uint8_t dma_aux_mcu_get_last_credits_request_answered(void)
+{
+    return dma_aux_mcu_last_credits_request_answered;
+}
+
+/*! \fn     dma_aux_mcu_get_hid_buffers_busy_flags(void)
+*   \brief  Get the aux MCU USB & BLE buffers state, as sent with its last buffer credits event
+*   \return AUX_MCU_CREDITS_xxx_BUFFER_BUSY flags
+*/
+uint8_t dma_aux_mcu_get_hid_buffers_busy_flags(void)
+{
+    return dma_aux_mcu_hid_buffers_busy_flags;
+}
+
+/*! \fn     dma_aux_mcu_is_variable_length_framing_enabled(void)
+*   \brief  Check if variable length frames are used for the aux MCU comms
+*   \return TRUE or FALSE
+*/
+BOOL dma_aux_mcu_is_variable_length_framing_enabled(void)
+{
+    return dma_aux_mcu_variable_length_frames;
+}
+
 /*! \fn     dma_aux_mcu_disable_transfer(void)
 *   \brief  Disable the DMA transfer for the aux MCU comms
 */
@@ -738,6 +1010,15 @@ void dma_aux_mcu_init_rx_transfer(Sercom* sercom, void* datap, uint16_t size)
     volatile void *usart_data_p = &sercom->USART.DATA.reg;
     cpu_irq_enter_critical();
     
+    /* Variable length frames: only receive the header, the interrupt will then fetch the rest */
+    dma_aux_mcu_rx_header_stage = dma_aux_mcu_variable_length_frames;
+    if (dma_aux_mcu_variable_length_frames != FALSE)
+    {
+        dma_aux_mcu_rx_frame_pt = (aux_mcu_message_t*)datap;
+        dma_aux_mcu_rx_frame_size = size;
+        size = AUX_MCU_MSG_HEADER_LENGTH;
+    }
+    
     /* Setup transfer size */
     dma_descriptors[DMA_DESCID_RX_COMMS].BTCNT.bit.BTCNT = (uint16_t)size;
     /* Source address: DATA register from SPI */
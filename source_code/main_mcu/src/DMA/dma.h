@@ -31,16 +31,26 @@
 /* Prototypes */
 void dma_oled_init_transfer(Sercom* sercom, void* datap, uint16_t size, uint16_t dma_trigger);
 void dma_acc_init_transfer(Sercom* sercom, void* datap, uint16_t size, uint8_t* read_cmd);
+void dma_dbflash_init_transfer(Sercom* sercom, void* datap, uint16_t size);
 uint32_t dma_compute_crc32_from_spi(Sercom* sercom, uint32_t size);
 void dma_aux_mcu_init_tx_transfer(Sercom* sercom, void* datap, uint16_t size);
 void dma_aux_mcu_init_rx_transfer(Sercom* sercom, void* datap, uint16_t size);
 void dma_custom_fs_init_transfer(Sercom* sercom, void* datap, uint16_t size);
 void dma_aux_mcu_wait_for_current_packet_reception_and_clear_flag(void);
 uint16_t dma_aux_mcu_get_remaining_bytes_for_rx_transfer(void);
+void dma_aux_mcu_set_nb_other_msg_buffers(uint16_t nb_buffers);
+uint8_t dma_aux_mcu_get_last_credits_request_answered(void);
 BOOL dma_custom_fs_check_and_clear_dma_transfer_flag(void);
+void dma_aux_mcu_set_variable_length_framing(BOOL enable);
+BOOL dma_aux_mcu_is_variable_length_framing_enabled(void);
 BOOL dma_aux_mcu_check_and_clear_dma_transfer_flag(void);
+BOOL dma_dbflash_check_and_clear_dma_transfer_flag(void);
 BOOL dma_oled_check_and_clear_dma_transfer_flag(void);
 BOOL dma_acc_check_and_clear_dma_transfer_flag(void);
+uint8_t dma_aux_mcu_get_hid_buffers_busy_flags(void);
+uint16_t dma_aux_mcu_get_nb_other_msg_buffers(void);
+uint8_t dma_aux_mcu_get_nb_other_msgs_dropped(void);
+BOOL dma_aux_mcu_take_other_msg_credit(BOOL force);
 BOOL dma_aux_mcu_check_dma_transfer_flag(void);
 void dma_wait_for_aux_mcu_packet_sent(void);
 BOOL dma_acc_check_dma_transfer_flag(void);
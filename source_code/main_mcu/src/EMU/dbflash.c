@@ -4,6 +4,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+dbflash_wear_counters_t dbflash_wear_counters;
+uint32_t dbflash_nb_bytes_read = 0;
+
 void dbflash_write_data_pattern_to_flash(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumber, uint16_t offset, uint16_t dataSize, uint8_t pattern)
 {
     char *tmp = malloc(dataSize);
@@ -15,21 +18,39 @@ void dbflash_write_data_pattern_to_flash(spi_flash_descriptor_t* descriptor_pt,
 void dbflash_read_data_from_flash(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumber, uint16_t offset, uint16_t dataSize, void *data)
 {
     emu_dbflash_read(pageNumber * BYTES_PER_PAGE + offset, data, dataSize);
+    dbflash_nb_bytes_read += dataSize;
 }
 
+void dbflash_start_async_read(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumber, uint16_t offset, uint16_t dataSize, void *data)
+{
+    dbflash_read_data_from_flash(descriptor_pt, pageNumber, offset, dataSize, data);
+}
+
+void dbflash_wait_for_async_read_end(spi_flash_descriptor_t* descriptor_pt){}
+
 void dbflash_write_data_to_flash(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumber, uint16_t offset, uint16_t dataSize, void *data)
 {
     emu_dbflash_write(pageNumber * BYTES_PER_PAGE + offset, data, dataSize);
+    dbflash_wear_log_page_program(pageNumber);
 }
 
 void dbflash_page_erase(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumber)
 {
-    char *tmp = malloc(BYTES_PER_PAGE);
+    uint8_t *tmp = malloc(BYTES_PER_PAGE);
     memset(tmp, 0xFF, BYTES_PER_PAGE);
-    dbflash_write_data_to_flash(descriptor_pt, pageNumber, 0, BYTES_PER_PAGE, tmp);
+    emu_dbflash_write(pageNumber * BYTES_PER_PAGE, tmp, BYTES_PER_PAGE);
+    dbflash_wear_log_page_erases(1);
     free(tmp);
 }
 
+void dbflash_block_erase(spi_flash_descriptor_t* descriptor_pt, uint16_t blockNumber)
+{
+    for (uint16_t i = 0; i < PAGE_COUNT/BLOCK_COUNT; i++)
+    {
+        dbflash_page_erase(descriptor_pt, blockNumber*(PAGE_COUNT/BLOCK_COUNT) + i);
+    }
+}
+
 static BOOL initialized = FALSE;
 
 RET_TYPE dbflash_check_presence(spi_flash_descriptor_t* descriptor_pt)
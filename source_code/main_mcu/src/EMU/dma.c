@@ -60,8 +60,20 @@ void dma_aux_mcu_disable_transfer(void){
     aux_rcv_remain = 0;
 }
 
+/* the emulated link always transfers whole messages */
+void dma_aux_mcu_set_variable_length_framing(BOOL enable){}
+BOOL dma_aux_mcu_is_variable_length_framing_enabled(void){return FALSE;}
+void dma_aux_mcu_set_nb_other_msg_buffers(uint16_t nb_buffers){}
+uint16_t dma_aux_mcu_get_nb_other_msg_buffers(void){return 0;}
+BOOL dma_aux_mcu_take_other_msg_credit(BOOL force){return TRUE;}
+uint8_t dma_aux_mcu_get_nb_other_msgs_dropped(void){return 0;}
+uint8_t dma_aux_mcu_get_last_credits_request_answered(void){return 0;}
+uint8_t dma_aux_mcu_get_hid_buffers_busy_flags(void){return 0;}
+
 void dma_custom_fs_init_transfer(Sercom* sercom, void* datap, uint16_t size){}
 BOOL dma_custom_fs_check_and_clear_dma_transfer_flag(void){return TRUE;}
+void dma_dbflash_init_transfer(Sercom* sercom, void* datap, uint16_t size){}
+BOOL dma_dbflash_check_and_clear_dma_transfer_flag(void){return TRUE;}
 BOOL dma_oled_check_and_clear_dma_transfer_flag(void){return TRUE;}
 BOOL dma_acc_check_and_clear_dma_transfer_flag(void){return TRUE;}
 void dma_wait_for_aux_mcu_packet_sent(void){}
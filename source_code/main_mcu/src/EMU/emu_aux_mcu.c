@@ -1,8 +1,10 @@
 #include "emu_aux_mcu.h"
 #include "comms_aux_mcu.h"
+#include "driver_timer.h"
 #include "emulator.h"
 
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
@@ -10,7 +12,62 @@ static BOOL response_valid;
 static aux_mcu_message_t response;
 static BOOL has_been_already_paired_to_device = FALSE;
 
-static void send_hid_message(aux_mcu_message_t *msg);
+/* Emulated BLE link: packets are exchanged at connection events, lost ones are retransmitted at the next ones */
+#define EMU_BLE_LINK_QUEUE_LENGTH   128
+typedef struct {
+    uint32_t due_ms;
+    int size;
+    uint8_t packet[64];
+} emu_ble_link_packet_t;
+
+typedef struct {
+    emu_ble_link_packet_t packets[EMU_BLE_LINK_QUEUE_LENGTH];
+    int read_index;
+    int nb_packets;
+    uint32_t last_event_ms;
+    uint32_t nb_packets_in_last_event;
+} emu_ble_link_queue_t;
+
+static BOOL ble_link_enabled;
+static uint32_t ble_link_latency_ms;
+static uint32_t ble_link_conn_interval_ms;
+static uint32_t ble_link_loss_percent;
+static uint32_t ble_link_packets_per_event;
+static emu_ble_link_queue_t ble_link_to_host;
+static emu_ble_link_queue_t ble_link_from_host;
+static BOOL ble_enabled;
+static BOOL ble_host_connected_reported;
+
+/* Emulated keyboard typing answer, sent once the symbols would have been typed */
+static BOOL typing_answer_pending;
+static uint32_t typing_answer_due_ms;
+
+/* Emulated host channel: USB talks to moolticute, BLE to the --ble-host server through the link model */
+typedef struct {
+    uint16_t message_type;
+    void (*send)(char *data, int size);
+    int (*rcv)(char *data, int size);
+    emu_ble_link_queue_t *from_host_link;
+    BOOL host_connected;
+
+    /* Low-level hid packets from the host are received into this buffer */
+    uint8_t incomingHidPacket[64];
+
+    /* State related to reassembling hid packets into MP messages */
+    int incomingHidFill;
+    BOOL expectFlipBit;
+    uint8_t expectByte1;
+
+    /* Mooltipass protocol messages are assembled inside this structure */
+    aux_mcu_message_t hid_response;
+    int hid_response_fill;
+} emu_hid_channel_t;
+
+static void emu_ble_link_send(char *data, int size);
+static emu_hid_channel_t usb_channel = {.message_type = AUX_MCU_MSG_TYPE_USB, .send = emu_send_hid, .rcv = emu_rcv_hid};
+static emu_hid_channel_t ble_channel = {.message_type = AUX_MCU_MSG_TYPE_BLE, .send = emu_ble_link_send, .rcv = emu_rcv_ble_hid, .from_host_link = &ble_link_from_host};
+
+static void send_hid_message(emu_hid_channel_t *channel, aux_mcu_message_t *msg);
 static BOOL process_main_cmd(aux_mcu_message_t *msg, aux_mcu_message_t *response);
 static BOOL process_ble_cmd(aux_mcu_message_t *msg, aux_mcu_message_t *response);
 
@@ -18,15 +75,221 @@ static BOOL process_ble_cmd(aux_mcu_message_t *msg, aux_mcu_message_t *response)
 typedef enum    {LB_IDLE = 0, LB_CHARGE_START_RAMPING = 1, LB_CHARGING_REACH = 2, LB_ERROR_ST_RAMPING = 3, LB_CUR_MAINTAIN = 4, LB_ERROR_CUR_REACH = 5, LB_ERROR_CUR_MAINTAIN = 6, LB_CHARGING_DONE = 7} lb_state_machine_te;
 static lb_state_machine_te emu_charger_status;
 
+/*! \fn     emu_aux_mcu_ble_link_init(uint32_t latency_ms, uint32_t conn_interval_ms, uint32_t loss_percent, uint32_t packets_per_event)
+*   \brief  Enable the emulated BLE raw HID host channel
+*   \param  latency_ms          Per packet latency
+*   \param  conn_interval_ms    Connection interval
+*   \param  loss_percent        Probability of a packet being lost at a given connection event
+*   \param  packets_per_event   Maximum number of packets exchanged per connection event and direction
+*/
+void emu_aux_mcu_ble_link_init(uint32_t latency_ms, uint32_t conn_interval_ms, uint32_t loss_percent, uint32_t packets_per_event)
+{
+    ble_link_enabled = TRUE;
+    ble_link_latency_ms = latency_ms;
+    ble_link_conn_interval_ms = (conn_interval_ms == 0)? 1 : conn_interval_ms;
+    ble_link_loss_percent = (loss_percent > 99)? 99 : loss_percent;
+    ble_link_packets_per_event = (packets_per_event == 0)? 1 : packets_per_event;
+}
+
+/* schedule a packet at the first connection event following its latency, keeping packets order */
+static void emu_ble_link_queue_packet(emu_ble_link_queue_t *queue, uint8_t *packet, int size)
+{
+    uint32_t event_ms = timer_get_systick() + ble_link_latency_ms;
+    emu_ble_link_packet_t *link_packet;
+
+    if(queue->nb_packets == EMU_BLE_LINK_QUEUE_LENGTH) {
+        fprintf(stderr, "Emulated BLE link queue full, packet dropped\n");
+        return;
+    }
+
+    event_ms = ((event_ms + ble_link_conn_interval_ms - 1) / ble_link_conn_interval_ms) * ble_link_conn_interval_ms;
+    if(event_ms <= queue->last_event_ms) {
+        event_ms = queue->last_event_ms;
+        if(queue->nb_packets_in_last_event == ble_link_packets_per_event)
+            event_ms += ble_link_conn_interval_ms;
+    }
+
+    /* lost packets are retransmitted at the next connection events */
+    while((uint32_t)(rand() % 100) < ble_link_loss_percent)
+        event_ms += ble_link_conn_interval_ms;
+
+    if(event_ms != queue->last_event_ms) {
+        queue->last_event_ms = event_ms;
+        queue->nb_packets_in_last_event = 0;
+    }
+    queue->nb_packets_in_last_event++;
+
+    link_packet = &queue->packets[(queue->read_index + queue->nb_packets++) % EMU_BLE_LINK_QUEUE_LENGTH];
+    link_packet->due_ms = event_ms;
+    link_packet->size = size;
+    memcpy(link_packet->packet, packet, size);
+}
+
+/* get the next packet which went through the link, if any */
+static emu_ble_link_packet_t* emu_ble_link_get_due_packet(emu_ble_link_queue_t *queue)
+{
+    emu_ble_link_packet_t *link_packet = &queue->packets[queue->read_index];
+
+    if((queue->nb_packets == 0) || ((int32_t)(timer_get_systick() - link_packet->due_ms) < 0))
+        return NULL;
+
+    queue->read_index = (queue->read_index + 1) % EMU_BLE_LINK_QUEUE_LENGTH;
+    queue->nb_packets--;
+    return link_packet;
+}
+
+static void emu_ble_link_send(char *data, int size)
+{
+    emu_ble_link_queue_packet(&ble_link_to_host, (uint8_t*)data, size);
+}
+
+static void emu_ble_link_reset(void)
+{
+    memset(&ble_link_to_host, 0, sizeof(ble_link_to_host));
+    memset(&ble_link_from_host, 0, sizeof(ble_link_from_host));
+}
+
+/* time taken by the aux MCU to type symbols: key press and release reports, each waiting for a connection event over BLE */
+static void emu_keyboard_type(aux_mcu_message_t *msg)
+{
+    uint32_t report_ms = msg->keyboard_type_message.delay_between_types & KEYBOARD_TYPE_DELAY_MASK;
+    uint32_t nb_symbols;
+
+    for(nb_symbols = 0; nb_symbols < MEMBER_ARRAY_SIZE(keyboard_type_message_t, keyboard_symbols); nb_symbols++)
+        if(msg->keyboard_type_message.keyboard_symbols[nb_symbols] == 0)
+            break;
+
+    if((msg->keyboard_type_message.interface_identifier != 0) && ble_link_enabled)
+        report_ms += ble_link_latency_ms + ble_link_conn_interval_ms;
+    else
+        report_ms += 1;
+
+    typing_answer_pending = TRUE;
+    typing_answer_due_ms = timer_get_systick() + nb_symbols * 2 * report_ms;
+}
+
+/* Replayed messages trace, as dumped by the HID_CMD_ID_GET_AUX_MSG_TRACE debug command */
+static aux_mcu_msg_trace_entry_t *replay_entries;
+static int replay_nb_entries;
+static int replay_rcv_index;
+static int replay_send_index;
+static BOOL replay_started;
+static BOOL replay_verbose;
+static uint32_t replay_start_systick;
+
+/* only messages whose whole payload was recorded can be replayed */
+static BOOL replay_entry_is_complete(aux_mcu_msg_trace_entry_t *entry)
+{
+    return (entry->payload_length1 != 0) && (entry->payload_length1 <= sizeof(entry->payload_head));
+}
+
+/*! \fn     emu_aux_mcu_replay_init(const char *path, int verbose)
+*   \brief  Load a messages trace: recorded aux MCU messages are then received with the recorded timing,
+*           and the timing of the messages we send is compared with the recorded one
+*   \param  path    Trace file, concatenated aux_mcu_msg_trace_entry_t
+*   \param  verbose Set to print the timing of each sent message next to the recorded one
+*   \note   Received messages whose payload is longer than the recorded payload start are skipped
+*/
+void emu_aux_mcu_replay_init(const char *path, int verbose)
+{
+    FILE *f = fopen(path, "rb");
+    int nb_skipped = 0;
+    long size;
+
+    if(f == NULL) {
+        fprintf(stderr, "Could not open messages trace %s\n", path);
+        return;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    replay_nb_entries = size / sizeof(aux_mcu_msg_trace_entry_t);
+    replay_entries = malloc(replay_nb_entries * sizeof(aux_mcu_msg_trace_entry_t));
+    if((replay_entries == NULL) || (fread(replay_entries, sizeof(aux_mcu_msg_trace_entry_t), replay_nb_entries, f) != (size_t)replay_nb_entries)) {
+        fprintf(stderr, "Could not read messages trace %s\n", path);
+        replay_nb_entries = 0;
+    }
+    fclose(f);
+
+    for(int i = 0; i < replay_nb_entries; i++)
+        if((replay_entries[i].direction == AUX_MCU_MSG_TRACE_DIR_RECEIVED) && !replay_entry_is_complete(&replay_entries[i]))
+            nb_skipped++;
+    if(nb_skipped)
+        fprintf(stderr, "Messages trace %s: %d received messages with a partially recorded payload won't be replayed\n", path, nb_skipped);
+
+    replay_verbose = (verbose != 0);
+}
+
+/* ms elapsed on the recorded timeline, which starts with our first exchange */
+static uint32_t replay_get_elapsed_ms(uint32_t *recorded_ms, int index)
+{
+    if(!replay_started) {
+        replay_started = TRUE;
+        replay_start_systick = timer_get_systick();
+    }
+
+    *recorded_ms = replay_entries[index].systick - replay_entries[0].systick;
+    return timer_get_systick() - replay_start_systick;
+}
+
+/* compare the timing of a sent message with the next recorded one of the same type */
+static void replay_check_sent_message(aux_mcu_message_t *msg)
+{
+    uint32_t recorded_ms, elapsed_ms;
+
+    for(; replay_send_index < replay_nb_entries; replay_send_index++) {
+        aux_mcu_msg_trace_entry_t *entry = &replay_entries[replay_send_index];
+        if((entry->direction == AUX_MCU_MSG_TRACE_DIR_SENT) && (entry->message_type == msg->message_type)) {
+            elapsed_ms = replay_get_elapsed_ms(&recorded_ms, replay_send_index++);
+            if(replay_verbose)
+                fprintf(stderr, "Trace replay: sent type %u at %u ms, recorded at %u ms\n", msg->message_type, elapsed_ms, recorded_ms);
+            return;
+        }
+    }
+}
+
+/* get the next recorded aux MCU message once its time has come */
+static BOOL replay_get_received_message(aux_mcu_message_t *msg)
+{
+    uint32_t recorded_ms;
+
+    while((replay_rcv_index < replay_nb_entries) && ((replay_entries[replay_rcv_index].direction != AUX_MCU_MSG_TRACE_DIR_RECEIVED) || !replay_entry_is_complete(&replay_entries[replay_rcv_index])))
+        replay_rcv_index++;
+
+    if((replay_rcv_index == replay_nb_entries) || (replay_get_elapsed_ms(&recorded_ms, replay_rcv_index) < recorded_ms))
+        return FALSE;
+
+    /* the whole payload fits in the recorded bytes */
+    aux_mcu_msg_trace_entry_t *entry = &replay_entries[replay_rcv_index++];
+    memset(msg, 0, sizeof(*msg));
+    msg->message_type = entry->message_type;
+    msg->payload_length1 = entry->payload_length1;
+    memcpy(msg->payload, entry->payload_head, entry->payload_length1);
+    return TRUE;
+}
+
 void emu_send_aux(char *data, int size)
 {
     aux_mcu_message_t *msg = (aux_mcu_message_t*)data;
     assert(size == sizeof(aux_mcu_message_t));
     assert(response_valid == FALSE);
 
+    if(replay_nb_entries)
+        replay_check_sent_message(msg);
+
     switch(msg->message_type) {
         case AUX_MCU_MSG_TYPE_USB:
-            send_hid_message(msg);
+            send_hid_message(&usb_channel, msg);
+            break;
+
+        case AUX_MCU_MSG_TYPE_BLE:
+            send_hid_message(&ble_channel, msg);
+            break;
+
+        case AUX_MCU_MSG_TYPE_KEYBOARD_TYPE:
+            emu_keyboard_type(msg);
             break;
 
         case AUX_MCU_MSG_TYPE_PLAT_DETAILS:
@@ -87,12 +350,16 @@ static BOOL process_ble_cmd(aux_mcu_message_t *msg, aux_mcu_message_t *resp)
     switch(msg->main_mcu_command_message.command) {
 
         case BLE_MESSAGE_CMD_ENABLE:
+            ble_enabled = TRUE;
             resp->message_type = AUX_MCU_MSG_TYPE_AUX_MCU_EVENT;
             resp->aux_mcu_event_message.event_id = AUX_MCU_EVENT_BLE_ENABLED;
             resp->payload_length1 = sizeof(resp->aux_mcu_event_message.event_id);
             return TRUE;
 
         case BLE_MESSAGE_CMD_DISABLE:
+            ble_enabled = FALSE;
+            ble_host_connected_reported = FALSE;
+            emu_ble_link_reset();
             resp->message_type = AUX_MCU_MSG_TYPE_AUX_MCU_EVENT;
             resp->aux_mcu_event_message.event_id = AUX_MCU_EVENT_BLE_DISABLED;
             resp->payload_length1 = sizeof(resp->aux_mcu_event_message.event_id);
@@ -131,6 +398,8 @@ static BOOL process_ble_cmd(aux_mcu_message_t *msg, aux_mcu_message_t *resp)
         
         case BLE_MESSAGE_DISCONNECT_FOR_NEXT:
         {
+            ble_host_connected_reported = FALSE;
+            emu_ble_link_reset();
             resp->message_type = AUX_MCU_MSG_TYPE_AUX_MCU_EVENT;
             resp->aux_mcu_event_message.event_id = AUX_MCU_EVENT_BLE_DISCONNECTED;
             resp->payload_length1 = sizeof(resp->aux_mcu_event_message.event_id);
@@ -155,7 +424,9 @@ static BOOL process_main_cmd(aux_mcu_message_t *msg, aux_mcu_message_t *resp)
             resp->hid_message.payload_length = cache_payload_size;
             memcpy(resp->hid_message.payload, msg->main_mcu_command_message.payload, cache_payload_size);
             resp->payload_length1 = sizeof(resp->hid_message.message_type) + sizeof(resp->hid_message.payload_length) + resp->hid_message.payload_length;
-            send_hid_message(resp);
+            send_hid_message(&usb_channel, resp);
+            if(ble_host_connected_reported)
+                send_hid_message(&ble_channel, resp);
             return FALSE;
         }
 
@@ -171,12 +442,20 @@ static BOOL process_main_cmd(aux_mcu_message_t *msg, aux_mcu_message_t *resp)
             resp->aux_mcu_event_message.event_id = AUX_MCU_EVENT_USB_DETACHED;
             resp->payload_length1 = sizeof(resp->aux_mcu_event_message.event_id);
             return TRUE;
+
+        case MAIN_MCU_COMMAND_SET_FRAMING:
+            /* acknowledge, emulated link keeps whole messages */
+            resp->message_type = AUX_MCU_MSG_TYPE_AUX_MCU_EVENT;
+            resp->aux_mcu_event_message.event_id = AUX_MCU_EVENT_FRAMING_SET;
+            resp->payload_length1 = sizeof(resp->aux_mcu_event_message.event_id);
+            return TRUE;
     }
 
     return FALSE;
 }
  
-static int emu_rcv_aux_hid(aux_mcu_message_t *msg);
+static int emu_rcv_aux_hid(emu_hid_channel_t *channel, aux_mcu_message_t *msg);
+static int emu_rcv_aux_ble(aux_mcu_message_t *msg);
 
 int emu_rcv_aux(char *data, int size)
 {
@@ -205,16 +484,64 @@ int emu_rcv_aux(char *data, int size)
         }
     }
 
-    return emu_rcv_aux_hid((aux_mcu_message_t*)data);
+    if(replay_nb_entries && replay_get_received_message((aux_mcu_message_t*)data))
+        return sizeof(aux_mcu_message_t);
+
+    if(typing_answer_pending && ((int32_t)(timer_get_systick() - typing_answer_due_ms) >= 0)) {
+        typing_answer_pending = FALSE;
+        memset(&response, 0, sizeof(response));
+        response.message_type = AUX_MCU_MSG_TYPE_KEYBOARD_TYPE;
+        response.payload_length1 = sizeof(uint16_t);
+        response.payload_as_uint16[0] = TRUE;
+        memcpy(data, &response, sizeof(response));
+        return sizeof(response);
+    }
+
+    if(ble_link_enabled && ble_enabled) {
+        int nr = emu_rcv_aux_ble((aux_mcu_message_t*)data);
+        if(nr != 0)
+            return nr;
+    }
+
+    return emu_rcv_aux_hid(&usb_channel, (aux_mcu_message_t*)data);
 }
 
-/*! \fn     send_hid_message(aux_mcu_message_t *msg)
-*   \brief  Send simulated "hid" messages to moolticute
-*   \param  msg   The message to be sent
+/*! \fn     emu_rcv_aux_ble(aux_mcu_message_t *msg)
+*   \brief  Run the emulated BLE link: deliver due packets and report host (dis)connections
+*   \param  msg   Where to store a message for the main MCU
+*   \return Message size, 0 if none
+*/
+static int emu_rcv_aux_ble(aux_mcu_message_t *msg)
+{
+    emu_ble_link_packet_t *link_packet;
+    int nr = emu_rcv_aux_hid(&ble_channel, msg);
+
+    while((link_packet = emu_ble_link_get_due_packet(&ble_link_to_host)) != NULL)
+        emu_send_ble_hid((char*)link_packet->packet, link_packet->size);
+
+    if((nr == 0) && (ble_channel.host_connected != ble_host_connected_reported)) {
+        ble_host_connected_reported = ble_channel.host_connected;
+        if(!ble_host_connected_reported)
+            emu_ble_link_reset();
+
+        memset(msg, 0, sizeof(*msg));
+        msg->message_type = AUX_MCU_MSG_TYPE_AUX_MCU_EVENT;
+        msg->payload_length1 = sizeof(msg->aux_mcu_event_message.event_id);
+        msg->aux_mcu_event_message.event_id = ble_host_connected_reported? AUX_MCU_EVENT_BLE_CONNECTED : AUX_MCU_EVENT_BLE_DISCONNECTED;
+        return sizeof(*msg);
+    }
+
+    return nr;
+}
+
+/*! \fn     send_hid_message(emu_hid_channel_t *channel, aux_mcu_message_t *msg)
+*   \brief  Send simulated "hid" messages to moolticute or the BLE host
+*   \param  channel   Host channel
+*   \param  msg       The message to be sent
 *   \note   The message will possibly be split into multiple hid packets
 */
 
-static void send_hid_message(aux_mcu_message_t *msg)
+static void send_hid_message(emu_hid_channel_t *channel, aux_mcu_message_t *msg)
 {
     uint8_t *payload = msg->payload;
     int payload_length = msg->payload_length1;
@@ -232,147 +559,162 @@ static void send_hid_message(aux_mcu_message_t *msg)
         hidPacket[1] = (p<<4) | (n_hid_packets-1);
         memcpy(hidPacket+2, payload + p * 62, bytesRemain);
 
-        emu_send_hid(hidPacket, bytesRemain+2);
+        channel->send(hidPacket, bytesRemain+2);
     }
 }
 
 
-/* Low-level hid packets from moolticute are received into this buffer */
-static uint8_t incomingHidPacket[64];
-
-/* State related to reassembling hid packets into MP messages */
-static int incomingHidFill;
-static BOOL expectFlipBit;
-static uint8_t expectByte1;
-
-/* Mooltipass protocol messages are assembled inside this structure */
 #define INVALID_LENGTH (-1)
-static aux_mcu_message_t hid_response;
-static int hid_response_fill;
 
-static void reset_hid_processing(void) 
+static void reset_hid_processing(emu_hid_channel_t *channel) 
 {
-    incomingHidFill = 0;
-    hid_response_fill = INVALID_LENGTH;
-    expectFlipBit = FALSE;
-    expectByte1 = 0;
+    channel->incomingHidFill = 0;
+    channel->hid_response_fill = INVALID_LENGTH;
+    channel->expectFlipBit = FALSE;
+    channel->expectByte1 = 0;
 }
 
-/*! \fn     process_hid_packet(void)
-*   \brief  Reassemble HID packets coming from moolticute into Mooltipass protocol messages
+/*! \fn     process_hid_packet(emu_hid_channel_t *channel, uint8_t *packet, int payloadLength)
+*   \brief  Reassemble HID packets coming from the host into Mooltipass protocol messages
+*   \param  channel  Host channel
 *   \param  packet  pointer to packet bytes
 *   \param  payloadLength  number of *payload* bytes, the packet is two bytes longer than this
 *   \note   This copies the packet data into hid_response
 *   \return TRUE if a message is ready
 */
-static BOOL process_hid_packet(uint8_t *packet, int payloadLength)
+static BOOL process_hid_packet(emu_hid_channel_t *channel, uint8_t *packet, int payloadLength)
 {
     uint8_t byte0 = packet[0], byte1 = packet[1];
 
     if(byte0 == 0xff && byte1 == 0xff) {
         /* To reset the flip bit state machine, the computer may simply send a packet with the first two bytes set to 0xFF.
          * The device will then expect the next packet to have the flip bit set to 0. */
-        expectFlipBit = FALSE;
-        hid_response_fill = INVALID_LENGTH;
+        channel->expectFlipBit = FALSE;
+        channel->hid_response_fill = INVALID_LENGTH;
         return FALSE;
     }
 
-    if(((byte0 >> 7) & 1) == expectFlipBit) {
+    if(((byte0 >> 7) & 1) == channel->expectFlipBit) {
         /* Prepare to receive a new packet. If there was anything in the buffer, flush it */
-        hid_response_fill = INVALID_LENGTH;
-        expectFlipBit = !expectFlipBit;
+        channel->hid_response_fill = INVALID_LENGTH;
+        channel->expectFlipBit = !channel->expectFlipBit;
 
-    } else if(hid_response_fill == INVALID_LENGTH) {
+    } else if(channel->hid_response_fill == INVALID_LENGTH) {
         /* The flip bit hasn't changed, AND incoming buffer is empty. This means that a new
          * message was sent without changing the flip bit. Not ok */
         fprintf(stderr, "Incoming HID packet with invalid flip bit\n");
         return FALSE;
 
-    } else if(expectByte1 != byte1) {
+    } else if(channel->expectByte1 != byte1) {
         /* Byte1 can only have one valid value for packets which don't start a message */
-        fprintf(stderr, "Incoming HID packet with invalid byte1: %x != %x\n", byte1, expectByte1);
-        hid_response_fill = INVALID_LENGTH;
+        fprintf(stderr, "Incoming HID packet with invalid byte1: %x != %x\n", byte1, channel->expectByte1);
+        channel->hid_response_fill = INVALID_LENGTH;
         return FALSE;
     }
 
-    if(hid_response_fill == INVALID_LENGTH) {
+    if(channel->hid_response_fill == INVALID_LENGTH) {
         /* Initial packet */
-        memset(&hid_response, 0, sizeof(hid_response));
+        memset(&channel->hid_response, 0, sizeof(channel->hid_response));
 
-        /* These are already zero, but let's make it clear what is happening */
-        hid_response.message_type = AUX_MCU_MSG_TYPE_USB;
-        hid_response_fill = 0;
+        /* Tells the main MCU which host the message comes from */
+        channel->hid_response.message_type = channel->message_type;
+        channel->hid_response_fill = 0;
 
-        expectByte1 = byte1;
+        channel->expectByte1 = byte1;
     }
 
-    if(payloadLength + hid_response_fill > AUX_MCU_MSG_PAYLOAD_LENGTH) {
+    if(payloadLength + channel->hid_response_fill > AUX_MCU_MSG_PAYLOAD_LENGTH) {
         fprintf(stderr, "Incoming HID packets overflow buffer\n");
-        hid_response_fill = INVALID_LENGTH;
+        channel->hid_response_fill = INVALID_LENGTH;
 
     } else {
-        memcpy(hid_response.payload + hid_response_fill, packet+2, payloadLength);
-        hid_response_fill += payloadLength;
+        memcpy(channel->hid_response.payload + channel->hid_response_fill, packet+2, payloadLength);
+        channel->hid_response_fill += payloadLength;
 
         if(((byte1 & 0xf0) >> 4) == (byte1 & 0x0f)) {
             /* This was the final packet, the message is ready */
-            hid_response.payload_length1 = hid_response_fill;
-            hid_response_fill = INVALID_LENGTH;
+            channel->hid_response.payload_length1 = channel->hid_response_fill;
+            channel->hid_response_fill = INVALID_LENGTH;
             return TRUE;
 
         } else {
-            expectByte1 += 0x10;
+            channel->expectByte1 += 0x10;
         }
     }
 
     return FALSE;
 }
 
-/*! \fn     rcv_hid_messages(void)
-*   \brief  Receive simulated "hid" messages from moolticute & reassemble messages
+/* process a whole hid packet, acknowledging it if required */
+static BOOL process_framed_hid_packet(emu_hid_channel_t *channel, uint8_t *packet)
+{
+    int hidPayloadLength = packet[0] & 63;
+    BOOL hid_response_valid;
+
+    if(packet[0] == 0xff && packet[1] == 0xff)
+        hidPayloadLength = 0; /* special case */
+
+    hid_response_valid = process_hid_packet(channel, packet, hidPayloadLength);
+
+    if(hid_response_valid && (packet[0] & 0x40)) {
+        /* send acknowledgement */
+        channel->send((char*)packet, 2 + hidPayloadLength);
+    }
+
+    return hid_response_valid;
+}
+
+/*! \fn     emu_rcv_aux_hid(emu_hid_channel_t *channel, aux_mcu_message_t *msg)
+*   \brief  Receive simulated "hid" messages from the host & reassemble messages
+*   \param  channel   Host channel
+*   \param  msg       Where to store a reassembled message
+*   \return Message size, 0 if none
 *   \note   The packets are concatenated into a stream, but we can split them up based on the payload length byte.
+*           Packets received on a channel with a link model only get processed once they went through it.
 */
-static int emu_rcv_aux_hid(aux_mcu_message_t *msg)
+static int emu_rcv_aux_hid(emu_hid_channel_t *channel, aux_mcu_message_t *msg)
 {
-    int nr = emu_rcv_hid((char*)incomingHidPacket + incomingHidFill, sizeof(incomingHidPacket) - incomingHidFill);
+    int nr = channel->rcv((char*)channel->incomingHidPacket + channel->incomingHidFill, sizeof(channel->incomingHidPacket) - channel->incomingHidFill);
+    emu_ble_link_packet_t *link_packet;
     BOOL hid_response_valid = FALSE;
 
+    channel->host_connected = (nr >= 0);
     if(nr < 0) {
-        /* Moolticute not connected, reset buffers */
-        reset_hid_processing();
+        /* Host not connected, reset buffers */
+        reset_hid_processing(channel);
         return 0;
     }
 
-    incomingHidFill += nr;
+    channel->incomingHidFill += nr;
 
-    if(incomingHidFill >= 2) {
-        int hidPayloadLength = incomingHidPacket[0] & 63;
-        if(incomingHidPacket[0] == 0xff && incomingHidPacket[1] == 0xff)
+    if(channel->incomingHidFill >= 2) {
+        int hidPayloadLength = channel->incomingHidPacket[0] & 63;
+        if(channel->incomingHidPacket[0] == 0xff && channel->incomingHidPacket[1] == 0xff)
             hidPayloadLength = 0; /* special case */
 
         if(hidPayloadLength > 62) {
-            fprintf(stderr, "Invalid HID packet received, byte0 = %x\n", incomingHidPacket[0]);
-            reset_hid_processing();
+            fprintf(stderr, "Invalid HID packet received, byte0 = %x\n", channel->incomingHidPacket[0]);
+            reset_hid_processing(channel);
             return 0;
 
-        } else if(incomingHidFill >= hidPayloadLength+2) {
-            hid_response_valid = process_hid_packet(incomingHidPacket, hidPayloadLength);
-        
-            if(hid_response_valid && (incomingHidPacket[0] & 0x40)) {
-                /* send acknowledgement */
-                emu_send_hid((char*)incomingHidPacket, 2 + hidPayloadLength);
-            }
+        } else if(channel->incomingHidFill >= hidPayloadLength+2) {
+            if(channel->from_host_link != NULL)
+                emu_ble_link_queue_packet(channel->from_host_link, channel->incomingHidPacket, 2 + hidPayloadLength);
+            else
+                hid_response_valid = process_framed_hid_packet(channel, channel->incomingHidPacket);
             
             /* Shift in next packet, if any */
-            incomingHidFill -= 2 + hidPayloadLength;
-            memmove(incomingHidPacket, incomingHidPacket + 2 + hidPayloadLength, incomingHidFill);
+            channel->incomingHidFill -= 2 + hidPayloadLength;
+            memmove(channel->incomingHidPacket, channel->incomingHidPacket + 2 + hidPayloadLength, channel->incomingHidFill);
         }
     }
 
+    if((channel->from_host_link != NULL) && ((link_packet = emu_ble_link_get_due_packet(channel->from_host_link)) != NULL))
+        hid_response_valid = process_framed_hid_packet(channel, link_packet->packet);
+
     if(hid_response_valid) {
-        memcpy(msg, &hid_response, sizeof(hid_response));
-        hid_response_valid = FALSE;
-        return sizeof(hid_response);
+        memcpy(msg, &channel->hid_response, sizeof(channel->hid_response));
+        return sizeof(channel->hid_response);
     }
 
     return 0;
@@ -1,7 +1,19 @@
 #ifndef EMU_AUX_MCU_H
 #define EMU_AUX_MCU_H
 
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void emu_aux_mcu_ble_link_init(uint32_t latency_ms, uint32_t conn_interval_ms, uint32_t loss_percent, uint32_t packets_per_event);
+void emu_aux_mcu_replay_init(const char *path, int verbose);
 void emu_send_aux(char *data, int size);
 int emu_rcv_aux(char *data, int size);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,523 @@
+/* Host side tool for emulator dbflash.bin images:
+ * - "check": linked list consistency checks & per user statistics (fsck for DB dumps)
+ * - "generate": bulk generation of a synthetic, encrypted, credential database for a given user
+ * Built from the firmware nodemgmt.h definitions, see "dbimage" target in Makefile.emu
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "bearssl_block.h"
+#include "nodemgmt.h"
+
+#define DBIMAGE_SIZE                ((uint32_t)PAGE_COUNT*BYTES_PER_PAGE)
+#define DBIMAGE_NODES_PER_PAGE      (BYTES_PER_PAGE/BASE_NODE_SIZE)
+#define DBIMAGE_NB_SLOTS            ((uint32_t)PAGE_COUNT*DBIMAGE_NODES_PER_PAGE)
+#define DBIMAGE_CTR_FLASH_MIN_INCR  32
+
+/* Slot states used by the checker */
+#define SLOT_NOT_REACHED            0
+#define SLOT_REACHED                1
+
+static uint8_t dbimage[DBIMAGE_SIZE];
+static uint8_t slot_state[DBIMAGE_NB_SLOTS];
+static uint32_t nb_errors;
+
+/* Address helpers, same addressing scheme as nodemgmt */
+static uint16_t dbimage_construct_address(uint16_t page, uint16_t node)
+{
+    return (uint16_t)((page << NODEMGMT_ADDR_PAGE_BITSHIFT) | (node & NODEMGMT_ADDR_NODE_MASK));
+}
+
+static uint16_t dbimage_incremented_address(uint16_t addr)
+{
+    #if (BYTES_PER_PAGE == BASE_NODE_SIZE)
+        return addr + (1 << NODEMGMT_ADDR_PAGE_BITSHIFT);
+    #else
+        return addr + 1;
+    #endif
+}
+
+static uint32_t dbimage_slot_index(uint16_t addr)
+{
+    return (uint32_t)nodemgmt_page_from_address(addr)*DBIMAGE_NODES_PER_PAGE + nodemgmt_node_from_address(addr);
+}
+
+static uint8_t* dbimage_node_ptr(uint16_t addr)
+{
+    return &dbimage[(uint32_t)nodemgmt_page_from_address(addr)*BYTES_PER_PAGE + (uint32_t)nodemgmt_node_from_address(addr)*BASE_NODE_SIZE];
+}
+
+static uint16_t dbimage_flags_at(uint32_t slot_index)
+{
+    uint16_t flags;
+    memcpy(&flags, &dbimage[(slot_index/DBIMAGE_NODES_PER_PAGE)*BYTES_PER_PAGE + (slot_index%DBIMAGE_NODES_PER_PAGE)*BASE_NODE_SIZE], sizeof(flags));
+    return flags;
+}
+
+static BOOL dbimage_is_address_in_node_area(uint16_t addr, BOOL child_node)
+{
+    if ((nodemgmt_page_from_address(addr) < PAGE_PER_SECTOR) || (nodemgmt_page_from_address(addr) >= PAGE_COUNT))
+    {
+        return FALSE;
+    }
+    if ((child_node != FALSE) && (nodemgmt_page_from_address(dbimage_incremented_address(addr)) >= PAGE_COUNT))
+    {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static BOOL dbimage_is_flags_valid(uint16_t flags)
+{
+    return (((flags >> NODEMGMT_VALID_BIT_BITSHIFT) & NODEMGMT_VALID_BIT_MASK_FINAL) == NODEMGMT_VBIT_VALID) ? TRUE : FALSE;
+}
+
+static uint16_t dbimage_uid_from_flags(uint16_t flags)
+{
+    return (flags >> NODEMGMT_USERID_BITSHIFT) & NODEMGMT_USERID_MASK_FINAL;
+}
+
+static node_type_te dbimage_type_from_flags(uint16_t flags)
+{
+    return (node_type_te)((flags >> NODEMGMT_TYPE_FLAG_BITSHIFT) & NODEMGMT_TYPE_FLAG_BITMASK_FINAL);
+}
+
+static void dbimage_error(uint16_t uid, uint16_t addr, const char* error_str)
+{
+    printf("user %u, node 0x%04x (page %u node %u): %s\n", uid, addr, nodemgmt_page_from_address(addr), nodemgmt_node_from_address(addr), error_str);
+    nb_errors++;
+}
+
+static nodemgmt_userprofile_t* dbimage_get_user_profile(uint16_t uid)
+{
+    #if BYTES_PER_PAGE == NODEMGMT_USER_PROFILE_SIZE
+        return (nodemgmt_userprofile_t*)&dbimage[(uint32_t)uid*2*BYTES_PER_PAGE];
+    #else
+        return (nodemgmt_userprofile_t*)&dbimage[(uint32_t)uid*BYTES_PER_PAGE];
+    #endif
+}
+
+static BOOL dbimage_is_user_profile_formatted(uint16_t uid)
+{
+    uint8_t* profile_pt = (uint8_t*)dbimage_get_user_profile(uid);
+
+    for (uint16_t i = 0; i < sizeof(nodemgmt_profile_main_data_t); i++)
+    {
+        if (profile_pt[i] != 0xFF)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* Check a node pointed by a list, mark it as reached. Returns FALSE if the list walk should stop */
+static BOOL dbimage_check_node(uint16_t uid, uint16_t addr, BOOL child_node, node_type_te expected_type)
+{
+    if (dbimage_is_address_in_node_area(addr, child_node) == FALSE)
+    {
+        dbimage_error(uid, addr, "address outside of node area");
+        return FALSE;
+    }
+
+    uint16_t flags;
+    memcpy(&flags, dbimage_node_ptr(addr), sizeof(flags));
+
+    if (dbimage_is_flags_valid(flags) == FALSE)
+    {
+        dbimage_error(uid, addr, "pointed node isn't valid");
+        return FALSE;
+    }
+    if (dbimage_uid_from_flags(flags) != uid)
+    {
+        dbimage_error(uid, addr, "pointed node belongs to another user");
+        return FALSE;
+    }
+    if (dbimage_type_from_flags(flags) != expected_type)
+    {
+        dbimage_error(uid, addr, "pointed node has the wrong type");
+        return FALSE;
+    }
+    if (slot_state[dbimage_slot_index(addr)] != SLOT_NOT_REACHED)
+    {
+        dbimage_error(uid, addr, "node already reached: loop or cross linked lists");
+        return FALSE;
+    }
+
+    slot_state[dbimage_slot_index(addr)] = SLOT_REACHED;
+
+    if (child_node != FALSE)
+    {
+        uint16_t fake_flags;
+        uint16_t correct_flags_bit = NODEMGMT_VBIT_INVALID << NODEMGMT_CORRECT_FLAGS_BIT_BITSHIFT;
+        memcpy(&fake_flags, dbimage_node_ptr(dbimage_incremented_address(addr)), sizeof(fake_flags));
+
+        if (((fake_flags & correct_flags_bit) == 0) || ((fake_flags | correct_flags_bit | NODEMGMT_PREVGEN_BIT_BITMASK) != (flags | correct_flags_bit | NODEMGMT_PREVGEN_BIT_BITMASK)))
+        {
+            dbimage_error(uid, addr, "fakeFlags don't match flags");
+        }
+        if (slot_state[dbimage_slot_index(dbimage_incremented_address(addr))] != SLOT_NOT_REACHED)
+        {
+            dbimage_error(uid, addr, "child node second half already reached");
+        }
+        slot_state[dbimage_slot_index(dbimage_incremented_address(addr))] = SLOT_REACHED;
+    }
+
+    return TRUE;
+}
+
+/* Count page changes when browsing all credential nodes, same metric as nodemgmt_get_cred_db_page_touches() */
+static void dbimage_account_page(uint16_t addr, uint16_t* last_page, uint32_t* nb_page_touches)
+{
+    if (nodemgmt_page_from_address(addr) != *last_page)
+    {
+        *last_page = nodemgmt_page_from_address(addr);
+        (*nb_page_touches)++;
+    }
+}
+
+static void dbimage_check_user(uint16_t uid)
+{
+    nodemgmt_userprofile_t* profile_pt = dbimage_get_user_profile(uid);
+    uint32_t nb_cred_parents = 0, nb_cred_children = 0, nb_data_parents = 0, nb_data_nodes = 0;
+    uint32_t nb_page_touches = 0;
+    uint16_t last_page = PAGE_COUNT;
+
+    /* Credential lists */
+    for (uint16_t type_id = 0; type_id < MEMBER_ARRAY_SIZE(nodemgmt_profile_main_data_t, cred_start_addresses); type_id++)
+    {
+        uint16_t prev_parent_addr = NODE_ADDR_NULL;
+        uint16_t parent_addr = profile_pt->main_data.cred_start_addresses[type_id];
+
+        while ((parent_addr != NODE_ADDR_NULL) && (dbimage_check_node(uid, parent_addr, FALSE, NODE_TYPE_PARENT) != FALSE))
+        {
+            parent_cred_node_t* parent_pt = (parent_cred_node_t*)dbimage_node_ptr(parent_addr);
+            uint16_t prev_child_addr = NODE_ADDR_NULL;
+            uint16_t child_addr = parent_pt->nextChildAddress;
+            dbimage_account_page(parent_addr, &last_page, &nb_page_touches);
+            nb_cred_parents++;
+
+            if (parent_pt->prevParentAddress != prev_parent_addr)
+            {
+                dbimage_error(uid, parent_addr, "incorrect previous parent address");
+            }
+
+            while ((child_addr != NODE_ADDR_NULL) && (dbimage_check_node(uid, child_addr, TRUE, NODE_TYPE_CHILD) != FALSE))
+            {
+                node_common_first_three_fields_t* child_pt = (node_common_first_three_fields_t*)dbimage_node_ptr(child_addr);
+                dbimage_account_page(child_addr, &last_page, &nb_page_touches);
+                nb_cred_children++;
+
+                if (child_pt->prevAddress != prev_child_addr)
+                {
+                    dbimage_error(uid, child_addr, "incorrect previous child address");
+                }
+                prev_child_addr = child_addr;
+                child_addr = child_pt->nextAddress;
+            }
+
+            prev_parent_addr = parent_addr;
+            parent_addr = parent_pt->nextParentAddress;
+        }
+    }
+
+    /* Data lists */
+    for (uint16_t type_id = 0; type_id < MEMBER_ARRAY_SIZE(nodemgmt_profile_main_data_t, data_start_addresses); type_id++)
+    {
+        uint16_t prev_parent_addr = NODE_ADDR_NULL;
+        uint16_t parent_addr = profile_pt->main_data.data_start_addresses[type_id];
+
+        while ((parent_addr != NODE_ADDR_NULL) && (dbimage_check_node(uid, parent_addr, FALSE, NODE_TYPE_PARENT_DATA) != FALSE))
+        {
+            parent_data_node_t* parent_pt = (parent_data_node_t*)dbimage_node_ptr(parent_addr);
+            uint16_t data_addr = parent_pt->nextChildAddress;
+            nb_data_parents++;
+
+            if (parent_pt->prevParentAddress != prev_parent_addr)
+            {
+                dbimage_error(uid, parent_addr, "incorrect previous data parent address");
+            }
+
+            while ((data_addr != NODE_ADDR_NULL) && (dbimage_check_node(uid, data_addr, TRUE, NODE_TYPE_DATA) != FALSE))
+            {
+                child_data_node_t* data_pt = (child_data_node_t*)dbimage_node_ptr(data_addr);
+                nb_data_nodes++;
+
+                if (data_pt->data_length > sizeof(data_pt->data) + sizeof(data_pt->data2))
+                {
+                    dbimage_error(uid, data_addr, "incorrect data length");
+                }
+                data_addr = data_pt->nextDataAddress;
+            }
+
+            prev_parent_addr = parent_addr;
+            parent_addr = parent_pt->nextParentAddress;
+        }
+    }
+
+    /* Favorites */
+    for (uint16_t cat_id = 0; cat_id < MEMBER_ARRAY_SIZE(nodemgmt_userprofile_t, category_favorites); cat_id++)
+    {
+        for (uint16_t fav_id = 0; fav_id < MEMBER_ARRAY_SIZE(favorites_for_category_t, favorite); fav_id++)
+        {
+            favorite_addr_t* fav_pt = &profile_pt->category_favorites[cat_id].favorite[fav_id];
+
+            if ((fav_pt->parent_addr == NODE_ADDR_NULL) && (fav_pt->child_addr == NODE_ADDR_NULL))
+            {
+                continue;
+            }
+            if ((dbimage_is_address_in_node_area(fav_pt->parent_addr, FALSE) == FALSE) || (slot_state[dbimage_slot_index(fav_pt->parent_addr)] != SLOT_REACHED) ||
+                (dbimage_is_address_in_node_area(fav_pt->child_addr, TRUE) == FALSE) || (slot_state[dbimage_slot_index(fav_pt->child_addr)] != SLOT_REACHED))
+            {
+                dbimage_error(uid, fav_pt->child_addr, "favorite points to a node not in the user lists");
+            }
+        }
+    }
+
+    printf("user %u: %u services, %u credentials, %u data parents, %u data nodes, %u page changes to browse credentials\n", uid, nb_cred_parents, nb_cred_children, nb_data_parents, nb_data_nodes, nb_page_touches);
+}
+
+static int dbimage_check(void)
+{
+    uint32_t nb_valid_slots = 0;
+
+    memset(slot_state, SLOT_NOT_REACHED, sizeof(slot_state));
+    nb_errors = 0;
+
+    /* Walk the lists of each user having a formatted profile */
+    for (uint16_t uid = 0; uid < NB_MAX_USERS; uid++)
+    {
+        if (dbimage_is_user_profile_formatted(uid) != FALSE)
+        {
+            dbimage_check_user(uid);
+        }
+    }
+
+    /* Orphan nodes: valid nodes that weren't reached */
+    for (uint32_t slot = (uint32_t)PAGE_PER_SECTOR*DBIMAGE_NODES_PER_PAGE; slot < DBIMAGE_NB_SLOTS; slot++)
+    {
+        uint16_t flags = dbimage_flags_at(slot);
+
+        if (dbimage_is_flags_valid(flags) != FALSE)
+        {
+            nb_valid_slots++;
+
+            /* Child nodes second halves (fakeFlags) are reported through their first half */
+            if ((slot_state[slot] == SLOT_NOT_REACHED) && (((flags >> NODEMGMT_CORRECT_FLAGS_BIT_BITSHIFT) & NODEMGMT_CORRECT_FLAGS_BIT_BITMASK_FINAL) == 0))
+            {
+                dbimage_error(dbimage_uid_from_flags(flags), dbimage_construct_address(slot/DBIMAGE_NODES_PER_PAGE, slot%DBIMAGE_NODES_PER_PAGE), "orphan node");
+            }
+        }
+    }
+
+    printf("%u/%u node slots used, %u error(s)\n", nb_valid_slots, DBIMAGE_NB_SLOTS - (uint32_t)PAGE_PER_SECTOR*DBIMAGE_NODES_PER_PAGE, nb_errors);
+    return (nb_errors == 0) ? 0 : 1;
+}
+
+static void dbimage_ascii_to_cust_char(cust_char_t* dest, const char* src, uint16_t max_chars)
+{
+    uint16_t i;
+    for (i = 0; (i < max_chars-1) && (src[i] != 0); i++)
+    {
+        dest[i] = (cust_char_t)src[i];
+    }
+    dest[i] = 0;
+}
+
+static BOOL dbimage_hex_to_bytes(const char* hex, uint8_t* dest, uint16_t nb_bytes)
+{
+    if (strlen(hex) != 2U*nb_bytes)
+    {
+        return FALSE;
+    }
+    for (uint16_t i = 0; i < nb_bytes; i++)
+    {
+        unsigned int byte_val;
+        if (sscanf(&hex[2*i], "%2x", &byte_val) != 1)
+        {
+            return FALSE;
+        }
+        dest[i] = (uint8_t)byte_val;
+    }
+    return TRUE;
+}
+
+/* Generate nb_services services of nb_logins logins each, stored sequentially and in alphabetical order */
+static int dbimage_generate(uint16_t uid, uint32_t nb_services, uint32_t nb_logins, uint8_t* aes_key, uint8_t* nonce)
+{
+    nodemgmt_userprofile_t* profile_pt = dbimage_get_user_profile(uid);
+    uint16_t date = swap16(1 | ((0 << NODEMGMT_MONTH_SHT) & NODEMGMT_MONTH_MASK) | (((2024-2010) << NODEMGMT_YEAR_SHT) & NODEMGMT_YEAR_MASK));
+    uint16_t user_flags = (uint16_t)(uid << NODEMGMT_USERID_BITSHIFT);
+    uint16_t next_free_addr = dbimage_construct_address(PAGE_PER_SECTOR, 0);
+    uint16_t prev_parent_addr = NODE_ADDR_NULL;
+    br_aes_ct_ctrcbc_keys aes_context;
+    uint32_t ctr_val = 0;
+    char string_buffer[64];
+
+    /* Only start with an empty node area, to keep things simple */
+    for (uint32_t slot = (uint32_t)PAGE_PER_SECTOR*DBIMAGE_NODES_PER_PAGE; slot < DBIMAGE_NB_SLOTS; slot++)
+    {
+        if (dbimage_is_flags_valid(dbimage_flags_at(slot)) != FALSE)
+        {
+            printf("Node area isn't empty, aborting\n");
+            return 1;
+        }
+    }
+
+    /* Check that everything fits */
+    if ((nb_services*(1 + 2*nb_logins) > DBIMAGE_NB_SLOTS - (uint32_t)PAGE_PER_SECTOR*DBIMAGE_NODES_PER_PAGE) || (nb_services*nb_logins*(MEMBER_SIZE(child_cred_node_t, password)*8/AES256_CTR_LENGTH) >= 0xFFFFFFUL - DBIMAGE_CTR_FLASH_MIN_INCR))
+    {
+        printf("Too many credentials requested\n");
+        return 1;
+    }
+
+    /* Format user profile */
+    memset(profile_pt, 0, sizeof(*profile_pt));
+    profile_pt->main_data.cred_change_number = 1;
+
+    br_aes_ct_ctrcbc_init(&aes_context, aes_key, AES_KEY_LENGTH/8);
+
+    for (uint32_t service_id = 0; service_id < nb_services; service_id++)
+    {
+        uint16_t parent_addr = next_free_addr;
+        parent_cred_node_t* parent_pt = (parent_cred_node_t*)dbimage_node_ptr(parent_addr);
+        uint16_t prev_child_addr = NODE_ADDR_NULL;
+        next_free_addr = dbimage_incremented_address(next_free_addr);
+
+        /* Parent node, linked to previous one */
+        memset(parent_pt, 0, sizeof(*parent_pt));
+        parent_pt->flags = (uint16_t)((NODE_TYPE_PARENT << NODEMGMT_TYPE_FLAG_BITSHIFT) | user_flags);
+        parent_pt->prevParentAddress = prev_parent_addr;
+        snprintf(string_buffer, sizeof(string_buffer), "service%06u.com", service_id);
+        dbimage_ascii_to_cust_char(parent_pt->service, string_buffer, MEMBER_ARRAY_SIZE(parent_cred_node_t, service));
+        if (prev_parent_addr == NODE_ADDR_NULL)
+        {
+            profile_pt->main_data.cred_start_addresses[0] = parent_addr;
+        }
+        else
+        {
+            ((parent_cred_node_t*)dbimage_node_ptr(prev_parent_addr))->nextParentAddress = parent_addr;
+        }
+        prev_parent_addr = parent_addr;
+
+        for (uint32_t login_id = 0; login_id < nb_logins; login_id++)
+        {
+            uint16_t child_addr = next_free_addr;
+            child_cred_node_t* child_pt = (child_cred_node_t*)dbimage_node_ptr(child_addr);
+            uint8_t ctr_block[AES256_CTR_LENGTH/8];
+            uint32_t carry = 0;
+            next_free_addr = dbimage_incremented_address(dbimage_incremented_address(next_free_addr));
+
+            /* Child node, linked to previous one */
+            memset(child_pt, 0, sizeof(*child_pt));
+            child_pt->flags = (uint16_t)((NODE_TYPE_CHILD << NODEMGMT_TYPE_FLAG_BITSHIFT) | user_flags);
+            child_pt->fakeFlags = child_pt->flags | (NODEMGMT_VBIT_INVALID << NODEMGMT_CORRECT_FLAGS_BIT_BITSHIFT);
+            child_pt->prevChildAddress = prev_child_addr;
+            child_pt->dateCreated = date;
+            child_pt->dateLastUsed = date;
+            child_pt->keyAfterLogin = 0xFFFF;
+            child_pt->keyAfterPassword = 0xFFFF;
+            snprintf(string_buffer, sizeof(string_buffer), "login%06u", login_id);
+            dbimage_ascii_to_cust_char(child_pt->login, string_buffer, MEMBER_ARRAY_SIZE(child_cred_node_t, login));
+            if (prev_child_addr == NODE_ADDR_NULL)
+            {
+                parent_pt->nextChildAddress = child_addr;
+            }
+            else
+            {
+                ((child_cred_node_t*)dbimage_node_ptr(prev_child_addr))->nextChildAddress = child_addr;
+            }
+            prev_child_addr = child_addr;
+
+            /* Password, encrypted the way logic_encryption_ctr_encrypt() does */
+            snprintf(string_buffer, sizeof(string_buffer), "password%06u_%06u", service_id, login_id);
+            dbimage_ascii_to_cust_char(child_pt->cust_char_password, string_buffer, MEMBER_ARRAY_SIZE(child_cred_node_t, cust_char_password));
+            child_pt->passwordBlankFlag = FALSE;
+            child_pt->ctr[0] = (uint8_t)(ctr_val >> 16);
+            child_pt->ctr[1] = (uint8_t)(ctr_val >> 8);
+            child_pt->ctr[2] = (uint8_t)(ctr_val);
+            memcpy(ctr_block, nonce, sizeof(ctr_block));
+            for (int16_t i = sizeof(child_pt->ctr)-1; i >= 0; i--)
+            {
+                carry = (uint32_t)ctr_block[sizeof(ctr_block)-sizeof(child_pt->ctr)+i] + (uint32_t)child_pt->ctr[i] + carry;
+                ctr_block[sizeof(ctr_block)-sizeof(child_pt->ctr)+i] = (uint8_t)carry;
+                carry = (carry >> 8) & 0xFF;
+            }
+            br_aes_ct_ctrcbc_ctr(&aes_context, (void*)ctr_block, (void*)child_pt->password, sizeof(child_pt->password));
+            ctr_val += MEMBER_SIZE(child_cred_node_t, password)*8/AES256_CTR_LENGTH;
+        }
+    }
+
+    /* Next CTR value to be used by the device */
+    ctr_val += DBIMAGE_CTR_FLASH_MIN_INCR;
+    profile_pt->main_data.current_ctr[0] = (uint8_t)(ctr_val >> 16);
+    profile_pt->main_data.current_ctr[1] = (uint8_t)(ctr_val >> 8);
+    profile_pt->main_data.current_ctr[2] = (uint8_t)(ctr_val);
+
+    printf("Generated %u services with %u logins each for user %u\n", nb_services, nb_logins, uid);
+    return 0;
+}
+
+static void dbimage_usage(const char* prog_name)
+{
+    printf("Usage:\n");
+    printf("  %s check <dbflash.bin>\n", prog_name);
+    printf("  %s generate <dbflash.bin> <user id> <nb services> <nb logins per service> <card AES key hex> <CPZ LUT nonce hex>\n", prog_name);
+}
+
+int main(int argc, char* argv[])
+{
+    FILE* image_file;
+    size_t image_length;
+    int return_val;
+
+    if ((argc < 3) || ((strcmp(argv[1], "check") != 0) && (strcmp(argv[1], "generate") != 0)))
+    {
+        dbimage_usage(argv[0]);
+        return 2;
+    }
+
+    /* Load image, the emulator extends it with 0xFF when needed */
+    memset(dbimage, 0xFF, sizeof(dbimage));
+    image_file = fopen(argv[2], "rb");
+    if (image_file != NULL)
+    {
+        image_length = fread(dbimage, 1, sizeof(dbimage), image_file);
+        fclose(image_file);
+        printf("Loaded %u bytes from %s\n", (uint32_t)image_length, argv[2]);
+    }
+    else if (strcmp(argv[1], "check") == 0)
+    {
+        printf("Couldn't open %s\n", argv[2]);
+        return 2;
+    }
+
+    if (strcmp(argv[1], "check") == 0)
+    {
+        return dbimage_check();
+    }
+
+    /* Generate */
+    uint8_t aes_key[AES_KEY_LENGTH/8];
+    uint8_t nonce[AES256_CTR_LENGTH/8];
+    if ((argc != 8) || (atoi(argv[3]) < 0) || (atoi(argv[3]) >= NB_MAX_USERS) || (dbimage_hex_to_bytes(argv[6], aes_key, sizeof(aes_key)) == FALSE) || (dbimage_hex_to_bytes(argv[7], nonce, sizeof(nonce)) == FALSE))
+    {
+        dbimage_usage(argv[0]);
+        return 2;
+    }
+    return_val = dbimage_generate((uint16_t)atoi(argv[3]), (uint32_t)strtoul(argv[4], NULL, 10), (uint32_t)strtoul(argv[5], NULL, 10), aes_key, nonce);
+    if (return_val != 0)
+    {
+        return return_val;
+    }
+
+    /* Write back image, then check it */
+    image_file = fopen(argv[2], "wb");
+    if ((image_file == NULL) || (fwrite(dbimage, 1, sizeof(dbimage), image_file) != sizeof(dbimage)))
+    {
+        printf("Couldn't write %s\n", argv[2]);
+        return 2;
+    }
+    fclose(image_file);
+    return dbimage_check();
+}
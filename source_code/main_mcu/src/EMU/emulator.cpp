@@ -20,6 +20,7 @@ extern "C" {
 #include "emu_oled.h"
 #include "emu_smartcard.h"
 #include "emu_dataflash.h"
+#include "emu_aux_mcu.h"
 #include "emulator_ui.h"
 
 static struct emu_port_t _PORT;
@@ -60,22 +61,49 @@ private:
     QSemaphore app_thread_blocked;
 
     QLocalSocket *hid;
+    QLocalSocket *ble_hid;
+    QString ble_hid_server;
 
-    bool reconnect_hid() {
-        if(hid->state() != QLocalSocket::ConnectedState) {
-            hid->connectToServer("moolticuted_local_dev");
-            hid->waitForConnected(10);
+    bool reconnect(QLocalSocket *socket, const QString &server) {
+        if(socket->state() != QLocalSocket::ConnectedState) {
+            socket->connectToServer(server);
+            socket->waitForConnected(10);
         }
         
-        return hid->state() == QLocalSocket::ConnectedState;
+        return socket->state() == QLocalSocket::ConnectedState;
+    }
+
+    void send(QLocalSocket *socket, char *data, int size) {
+        while(size > 0) {
+            int nb = socket->write(data, size);
+            if(nb <= 0)
+                break;
+
+            data += nb;
+            size -= nb;
+
+            while(socket->bytesToWrite() > 0 && socket->state() == QLocalSocket::ConnectedState)
+                socket->waitForBytesWritten();
+        }
+    }
+
+    int rcv(QLocalSocket *socket, char *data, int size) {
+        socket->waitForReadyRead(0);
+        int nb = socket->read(data, size);
+        return nb > 0 ? nb : 0;
     }
 
 public:
     void run() {
         hid = new QLocalSocket;
+        ble_hid = new QLocalSocket;
         minible_main();
     }
 
+    void set_ble_hid_server(const QString &server) {
+        ble_hid_server = server;
+    }
+
     void stop() {
         appexit_mutex.lock();
         app_exiting = true;
@@ -95,30 +123,28 @@ public:
     }
 
     void send_hid(char *data, int size) {
-        if(!reconnect_hid())
-            return;
+        if(reconnect(hid, "moolticuted_local_dev"))
+            send(hid, data, size);
+    }
 
-        while(size > 0) {
-            int nb = hid->write(data, size);
-            if(nb <= 0)
-                break;
+    int rcv_hid(char *data, int size) {
+        test_stop();
+        if(!reconnect(hid, "moolticuted_local_dev"))
+            return -1;
 
-            data += nb;
-            size -= nb;
+        return rcv(hid, data, size);
+    }
 
-            while(hid->bytesToWrite() > 0 && hid->state() == QLocalSocket::ConnectedState)
-                hid->waitForBytesWritten();
-        }
+    void send_ble_hid(char *data, int size) {
+        if(!ble_hid_server.isEmpty() && reconnect(ble_hid, ble_hid_server))
+            send(ble_hid, data, size);
     }
 
-    int rcv_hid(char *data, int size) {
-        test_stop();
-        if(!reconnect_hid())
+    int rcv_ble_hid(char *data, int size) {
+        if(ble_hid_server.isEmpty() || !reconnect(ble_hid, ble_hid_server))
             return -1;
 
-        hid->waitForReadyRead(0);
-        int nb = hid->read(data, size);
-        return nb > 0 ? nb : 0;
+        return rcv(ble_hid, data, size);
     }
 };
 
@@ -140,6 +166,16 @@ int emu_rcv_hid(char *data, int size)
     return app_thread.rcv_hid(data, size);
 }
 
+void emu_send_ble_hid(char *data, int size)
+{
+    app_thread.send_ble_hid(data, size);
+}
+
+int emu_rcv_ble_hid(char *data, int size)
+{
+    return app_thread.rcv_ble_hid(data, size);
+}
+
 static QElapsedTimer systick_timer;
 static QMutex systick_mutex;
 static uint64_t last_systick;
@@ -177,6 +213,13 @@ int main(int ac, char ** av)
 
     parser.addOption(QCommandLineOption("smartcard", "Smartcard file to be used at startup", "smartcard"));
     parser.addOption(QCommandLineOption("bundle", "Specify path to bundle.img file", "bundle"));
+    parser.addOption(QCommandLineOption("aux-trace", "Replay an inter MCU messages trace dumped from a device", "aux-trace"));
+    parser.addOption(QCommandLineOption("aux-trace-verbose", "Print the timing of each sent message next to the recorded one"));
+    parser.addOption(QCommandLineOption("ble-host", "Local socket server acting as a BLE raw HID host", "ble-host"));
+    parser.addOption(QCommandLineOption("ble-latency", "Emulated BLE per packet latency in ms", "ble-latency", "0"));
+    parser.addOption(QCommandLineOption("ble-interval", "Emulated BLE connection interval in ms", "ble-interval", "15"));
+    parser.addOption(QCommandLineOption("ble-loss", "Emulated BLE packet loss in percent", "ble-loss", "0"));
+    parser.addOption(QCommandLineOption("ble-packets-per-event", "Emulated BLE packets per connection event", "ble-packets-per-event", "4"));
     parser.process(app);
 
     QTimer ms_timer;
@@ -198,6 +241,14 @@ int main(int ac, char ** av)
 
     emu_dataflash_init(parser.value("bundle").toUtf8().constData());
 
+    if(parser.isSet("aux-trace"))
+        emu_aux_mcu_replay_init(parser.value("aux-trace").toUtf8().constData(), parser.isSet("aux-trace-verbose"));
+
+    if(parser.isSet("ble-host")) {
+        app_thread.set_ble_hid_server(parser.value("ble-host"));
+        emu_aux_mcu_ble_link_init(parser.value("ble-latency").toUInt(), parser.value("ble-interval").toUInt(), parser.value("ble-loss").toUInt(), parser.value("ble-packets-per-event").toUInt());
+    }
+
     EmuWindow emu_window;
     emu_window.show();
 
@@ -17,6 +17,8 @@ extern "C" {
 void emu_appexit_test(void);
 void emu_send_hid(char *data, int size);
 int emu_rcv_hid(char *data, int size);
+void emu_send_ble_hid(char *data, int size);
+int emu_rcv_ble_hid(char *data, int size);
 
 int emu_get_battery_level(void);
 BOOL emu_get_usb_charging(void);
@@ -22,6 +22,7 @@
  */
 #include "platform_defines.h"
 #include "custom_bitstream.h"
+#include "driver_timer.h"
 #include "custom_fs.h"
 #include "dma.h"
 
@@ -68,7 +69,7 @@ void bitstream_bitmap_init(bitstream_bitmap_t* bs, bitmap_t* bitmap, custom_fs_a
             
             /* Start filling our buffer */
             custom_fs_continuous_read_from_flash(bs->buf[bs->bufSel], bs->addr, sizeof(bs->buf[0]), bs->_dma_transfer);
-            while(dma_custom_fs_check_and_clear_dma_transfer_flag() == FALSE);
+            timer_wait_for_event(dma_custom_fs_check_and_clear_dma_transfer_flag);
 
             /* Increment address counter */
             bs->addr += sizeof(bs->buf[0]);
@@ -133,7 +134,7 @@ void bitstream_glyph_bitmap_init(bitstream_bitmap_t* bs, font_header_t* font, fo
 
             /* Start filling our buffer */
             custom_fs_continuous_read_from_flash(bs->buf[bs->bufSel], bs->addr, sizeof(bs->buf[0]), bs->_dma_transfer);
-            while(dma_custom_fs_check_and_clear_dma_transfer_flag() == FALSE);
+            timer_wait_for_event(dma_custom_fs_check_and_clear_dma_transfer_flag);
 
             /* Increment address counter */
             bs->addr += sizeof(bs->buf[0]);
@@ -185,7 +186,7 @@ static inline uint8_t bitstream_bitmap_get_next_byte(bitstream_bitmap_t* bs)
                     if (bs->_dma_transfer != FALSE)
                     {
                         /* Trigger a new DMA transfer on current buffer and switch to the new one */
-                        while(dma_custom_fs_check_and_clear_dma_transfer_flag() == FALSE);
+                        timer_wait_for_event(dma_custom_fs_check_and_clear_dma_transfer_flag);
                         custom_fs_continuous_read_from_flash(bs->buf[bs->bufSel], bs->addr, sizeof(bs->buf[0]), bs->_dma_transfer);
                         bs->bufSel = (bs->bufSel+1)&0x01;
                     }
@@ -298,7 +299,7 @@ void bitstream_bitmap_close(bitstream_bitmap_t* bs)
     #ifdef FLASH_ALONE_ON_SPI_BUS
         if (bs->_dma_transfer != FALSE)
         {        
-            while(dma_custom_fs_check_and_clear_dma_transfer_flag() == FALSE);
+            timer_wait_for_event(dma_custom_fs_check_and_clear_dma_transfer_flag);
         }
         custom_fs_stop_continuous_read_from_flash();
     #endif    
@@ -68,8 +68,10 @@
 #define SETTINGS_LEFT_HANDED_ON_USB         13
 #define SETTINGS_PIN_SHOWN_WHEN_BACK        14
 #define SETTINGS_UNLOCK_FEATURE_PARAM       15
+#define SETTINGS_ADAPTIVE_TYPING_DELAY      16
+#define SETTINGS_KEYBOARD_ROLLOVER          17
 /* Set to define the number of settings used */
-#define SETTINGS_NB_USED                    16
+#define SETTINGS_NB_USED                    18
 
 /* Flags IDs */
 #define NB_DEVICE_FLAGS                     32
@@ -21,8 +21,15 @@
 */
 #include "platform_defines.h"
 #include "driver_sercom.h"
+#include "driver_timer.h"
 #include "dbflash.h"
-
+#include "dma.h"
+// Page programs & erases since last flush
+dbflash_wear_counters_t dbflash_wear_counters;
+// Number of bytes read since boot, for profiling
+uint32_t dbflash_nb_bytes_read = 0;
+// Set when a DMA read is ongoing (flash still selected)
+BOOL dbflash_async_read_ongoing = FALSE;
 
 /*! \fn     dbflash_memory_boundary_error_callblack(void)
 *   \brief  Function called when a memory boundary issue occurs
@@ -44,6 +51,9 @@ void dbflash_memory_boundary_error_callblack(void)
 */
 void dbflash_send_command(spi_flash_descriptor_t* descriptor_pt, uint8_t* data, uint32_t length)
 {
+    /* Wait for a possible DMA read to finish */
+    dbflash_wait_for_async_read_end(descriptor_pt);
+    
     /* SS low */
     PORT->Group[descriptor_pt->cs_pin_group].OUTCLR.reg = descriptor_pt->cs_pin_mask;
     
@@ -117,7 +127,10 @@ static inline void dbflash_fill_page_read_write_erase_opcode_from_address(uint16
 *   \param  buffer_size Length of the buffer
 */
 void dbflash_send_data_with_four_bytes_opcode(spi_flash_descriptor_t* descriptor_pt, uint8_t* opcode, uint8_t* buffer, uint16_t buffer_size)
-{   
+{
+    /* Wait for a possible DMA read to finish */
+    dbflash_wait_for_async_read_end(descriptor_pt);
+    
     /* SS low */
     PORT->Group[descriptor_pt->cs_pin_group].OUTCLR.reg = descriptor_pt->cs_pin_mask;
     
@@ -145,7 +158,10 @@ void dbflash_send_data_with_four_bytes_opcode(spi_flash_descriptor_t* descriptor
 *   \param  buffer_size Length of the buffer
 */
 void dbflash_send_data_with_four_bytes_opcode_no_readback(spi_flash_descriptor_t* descriptor_pt, uint8_t* opcode, uint8_t* buffer, uint16_t buffer_size)
-{   
+{
+    /* Wait for a possible DMA read to finish */
+    dbflash_wait_for_async_read_end(descriptor_pt);
+    
     /* SS low */
     PORT->Group[descriptor_pt->cs_pin_group].OUTCLR.reg = descriptor_pt->cs_pin_mask;
     
@@ -174,7 +190,10 @@ void dbflash_send_data_with_four_bytes_opcode_no_readback(spi_flash_descriptor_t
 *   \param  nb_bytes    How many pattern bytes to write
 */
 void dbflash_send_pattern_data_with_four_bytes_opcode(spi_flash_descriptor_t* descriptor_pt, uint8_t* opcode, uint8_t pattern, uint16_t nb_bytes)
-{   
+{
+    /* Wait for a possible DMA read to finish */
+    dbflash_wait_for_async_read_end(descriptor_pt);
+    
     /* SS low */
     PORT->Group[descriptor_pt->cs_pin_group].OUTCLR.reg = descriptor_pt->cs_pin_mask;
     
@@ -200,6 +219,9 @@ void dbflash_send_pattern_data_with_four_bytes_opcode(spi_flash_descriptor_t* de
 */
 void dbflash_wait_for_not_busy(spi_flash_descriptor_t* descriptor_pt)
 {
+    /* Wait for a possible DMA read to finish */
+    dbflash_wait_for_async_read_end(descriptor_pt);
+    
     /* SS low */
     PORT->Group[descriptor_pt->cs_pin_group].OUTCLR.reg = descriptor_pt->cs_pin_mask;
         
@@ -243,6 +265,9 @@ void dbflash_sector_zero_erase(spi_flash_descriptor_t* descriptor_pt, uint8_t se
     
     /* Wait until memory is ready */
     dbflash_wait_for_not_busy(descriptor_pt);
+    
+    /* Wear telemetry */
+    dbflash_wear_log_page_erases((sectorNumber == DBFLASH_SECTOR_ZERO_A_CODE)? DBFLASH_SECTOR_ZER0_A_PAGES : PAGE_PER_SECTOR-DBFLASH_SECTOR_ZER0_A_PAGES);
 }
 
 /*! \fn     dbflash_sector_erase(spi_flash_descriptor_t* descriptor_pt, uint8_t sectorNumber)
@@ -267,6 +292,9 @@ void dbflash_sector_erase(spi_flash_descriptor_t* descriptor_pt, uint8_t sectorN
     
     /* Wait until memory is ready */
     dbflash_wait_for_not_busy(descriptor_pt);   
+    
+    /* Wear telemetry */
+    dbflash_wear_log_page_erases(PAGE_PER_SECTOR);
 }
 
 /*! \fn     dbflash_chip_erase(spi_flash_descriptor_t* descriptor_pt)
@@ -304,6 +332,9 @@ void dbflash_block_erase(spi_flash_descriptor_t* descriptor_pt, uint16_t blockNu
     
     /* Wait until memory is ready */
     dbflash_wait_for_not_busy(descriptor_pt);
+    
+    /* Wear telemetry */
+    dbflash_wear_log_page_erases(PAGE_COUNT/BLOCK_COUNT);
 }
 
 /*! \fn     dbflash_page_erase(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumber)
@@ -328,6 +359,9 @@ void dbflash_page_erase(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumb
     
     /* Wait until memory is ready */
     dbflash_wait_for_not_busy(descriptor_pt);
+    
+    /* Wear telemetry */
+    dbflash_wear_log_page_erases(1);
 }
 
 /*! \fn     dbflash_format_flash(spi_flash_descriptor_t* descriptor_pt) 
@@ -408,6 +442,9 @@ void dbflash_write_data_pattern_to_flash(spi_flash_descriptor_t* descriptor_pt,
     
     /* Wait until memory is ready */
     dbflash_wait_for_not_busy(descriptor_pt);
+    
+    /* Wear telemetry */
+    dbflash_wear_log_page_program(pageNumber);
 }
 
 /*! \fn     dbflash_write_data_to_flash(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumber, uint16_t offset, uint16_t dataSize, void *data)
@@ -448,6 +485,9 @@ void dbflash_write_data_to_flash(spi_flash_descriptor_t* descriptor_pt, uint16_t
     
     /* Wait until memory is ready */
     dbflash_wait_for_not_busy(descriptor_pt);
+    
+    /* Wear telemetry */
+    dbflash_wear_log_page_program(pageNumber);
 }
 
 /*! \fn     dbflash_read_data_from_flash(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumber, uint16_t offset, uint16_t dataSize, void *data)
@@ -487,8 +527,64 @@ void dbflash_read_data_from_flash(spi_flash_descriptor_t* descriptor_pt, uint16_
     uint8_t opcode[4] = {DBFLASH_OPCODE_LOWF_READ};
     dbflash_fill_page_read_write_erase_opcode_from_address(pageNumber, offset, &opcode[1]);
     dbflash_send_data_with_four_bytes_opcode(descriptor_pt, opcode, data, dataSize);
+    dbflash_nb_bytes_read += dataSize;
 } 
 
+/*! \fn     dbflash_start_async_read(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumber, uint16_t offset, uint16_t dataSize, void *data)
+*   \brief  Start a DMA read of flash memory, returning before the data has arrived
+*   \param  descriptor_pt   Pointer to dbflash descriptor
+*   \param  pageNumber      The target page number of flash memory
+*   \param  offset          The starting byte offset to begin reading in pageNumber
+*   \param  dataSize        The number of bytes to read from the flash memory into the data buffer
+*   \param  data            The buffer used to store the data read from flash
+*   \note   The flash stays selected until dbflash_wait_for_async_read_end() is called, which all other functions in this file do
+*/
+void dbflash_start_async_read(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumber, uint16_t offset, uint16_t dataSize, void *data)
+{
+    #ifdef DBFLASH_MEMORY_BOUNDARY_CHECKS
+        // A read-ahead never spans more than 2 pages
+        if ((pageNumber + 2 > PAGE_COUNT) || (offset + dataSize > 2*BYTES_PER_PAGE))
+        {
+            dbflash_memory_boundary_error_callblack();
+        }
+    #endif
+    
+    /* Wait for a possible previous DMA read to finish */
+    dbflash_wait_for_async_read_end(descriptor_pt);
+    
+    /* SS low */
+    PORT->Group[descriptor_pt->cs_pin_group].OUTCLR.reg = descriptor_pt->cs_pin_mask;
+    
+    /* Send opcode */
+    uint8_t opcode[4] = {DBFLASH_OPCODE_LOWF_READ};
+    dbflash_fill_page_read_write_erase_opcode_from_address(pageNumber, offset, &opcode[1]);
+    for (uint16_t i = 0; i < sizeof(opcode); i++)
+    {
+        sercom_spi_send_single_byte(descriptor_pt->sercom_pt, opcode[i]);
+    }
+    
+    /* Let the DMA controller fetch the data */
+    dma_dbflash_init_transfer(descriptor_pt->sercom_pt, data, dataSize);
+    dbflash_async_read_ongoing = TRUE;
+    dbflash_nb_bytes_read += dataSize;
+}
+
+/*! \fn     dbflash_wait_for_async_read_end(spi_flash_descriptor_t* descriptor_pt)
+*   \brief  Wait for a DMA read started by dbflash_start_async_read() to end, then deselect the flash
+*   \param  descriptor_pt   Pointer to dbflash descriptor
+*/
+void dbflash_wait_for_async_read_end(spi_flash_descriptor_t* descriptor_pt)
+{
+    if (dbflash_async_read_ongoing != FALSE)
+    {
+        timer_wait_for_event(dma_dbflash_check_and_clear_dma_transfer_flag);
+        
+        /* SS high */
+        PORT->Group[descriptor_pt->cs_pin_group].OUTSET.reg = descriptor_pt->cs_pin_mask;
+        dbflash_async_read_ongoing = FALSE;
+    }
+}
+
 /*! \fn     dbflash_raw_read(spi_flash_descriptor_t* descriptor_pt, uint8_t* datap, uint16_t addr, uint16_t size)
 *   \brief  Contiguous data read across flash page boundaries with a max 65k bytes addressing space
 *   \param  descriptor_pt   Pointer to dbflash descriptor
@@ -535,4 +631,5 @@ void dbflash_flash_write_buffer_to_page(spi_flash_descriptor_t* descriptor_pt, u
     dbflash_fill_page_read_write_erase_opcode_from_address(page, 0, &op[1]);
     dbflash_send_data_with_four_bytes_opcode(descriptor_pt, op, op, 0);
     dbflash_wait_for_not_busy(descriptor_pt);
+    dbflash_wear_log_page_program(page);
 }
\ No newline at end of file
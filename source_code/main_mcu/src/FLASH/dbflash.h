@@ -36,6 +36,7 @@ void dbflash_send_pattern_data_with_four_bytes_opcode(spi_flash_descriptor_t* de
 void dbflash_read_data_from_flash(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumber, uint16_t offset, uint16_t dataSize, void *data);
 void dbflash_send_data_with_four_bytes_opcode(spi_flash_descriptor_t* descriptor_pt, uint8_t* opcode, uint8_t* buffer, uint16_t buffer_size);
 void dbflash_write_data_to_flash(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumber, uint16_t offset, uint16_t dataSize, void *data);
+void dbflash_start_async_read(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumber, uint16_t offset, uint16_t dataSize, void *data);
 void dbflash_write_buffer(spi_flash_descriptor_t* descriptor_pt, uint8_t* datap, uint16_t offset, uint16_t size);
 void dbflash_raw_read(spi_flash_descriptor_t* descriptor_pt, uint8_t* datap, uint16_t addr, uint16_t size);
 void dbflash_load_page_to_internal_buffer(spi_flash_descriptor_t* descriptor_pt, uint16_t page_number);
@@ -46,6 +47,7 @@ void dbflash_sector_erase(spi_flash_descriptor_t* descriptor_pt, uint8_t sectorN
 void dbflash_block_erase(spi_flash_descriptor_t* descriptor_pt, uint16_t blockNumber);
 void dbflash_page_erase(spi_flash_descriptor_t* descriptor_pt, uint16_t pageNumber);
 void dbflash_enter_ultra_deep_power_down(spi_flash_descriptor_t* descriptor_pt);
+void dbflash_wait_for_async_read_end(spi_flash_descriptor_t* descriptor_pt);
 RET_TYPE dbflash_check_presence(spi_flash_descriptor_t* descriptor_pt);
 void dbflash_wait_for_not_busy(spi_flash_descriptor_t* descriptor_pt);
 void dbflash_format_flash(spi_flash_descriptor_t* descriptor_pt);
@@ -290,4 +292,45 @@ void dbflash_memory_boundary_error_callblack(void);
 // Flash size defines
 #define DBFLASH_SIZE          ((uint32_t)PAGE_COUNT * (uint32_t)BYTES_PER_PAGE)
 
+// Wear telemetry defines
+#define DBFLASH_NB_SECTORS              (SECTOR_END + 1)    // Sector 0 (0a + 0b) included
+#define DBFLASH_WEAR_FLUSH_THRESHOLD    128                 // Number of page programs after which the counters below should be flushed
+
+/* Page programs & erases done since the counters were last flushed */
+/* Flushes may be delayed by long operations (prompts, compaction...): counters are wide enough not to saturate in the meantime */
+typedef struct
+{
+    uint32_t nb_page_programs;
+    uint32_t nb_page_erases;
+    uint32_t sector_programs[DBFLASH_NB_SECTORS];
+    uint16_t sector_zero_page_programs[PAGE_PER_SECTOR];    // Saturating, 65535 programs of a single page between two flushes
+} dbflash_wear_counters_t;
+
+/* Global vars */
+extern dbflash_wear_counters_t dbflash_wear_counters;
+extern uint32_t dbflash_nb_bytes_read;
+
+/*! \fn     dbflash_wear_log_page_program(uint16_t pageNumber)
+*   \brief  Log a page program in the wear counters
+*   \param  pageNumber  The programmed page
+*/
+static inline void dbflash_wear_log_page_program(uint16_t pageNumber)
+{
+    dbflash_wear_counters.nb_page_programs++;
+    dbflash_wear_counters.sector_programs[pageNumber/PAGE_PER_SECTOR]++;
+    if ((pageNumber < PAGE_PER_SECTOR) && (dbflash_wear_counters.sector_zero_page_programs[pageNumber] != UINT16_MAX))
+    {
+        dbflash_wear_counters.sector_zero_page_programs[pageNumber]++;
+    }
+}
+
+/*! \fn     dbflash_wear_log_page_erases(uint16_t nb_pages)
+*   \brief  Log page erases in the wear counters
+*   \param  nb_pages    Number of erased pages
+*/
+static inline void dbflash_wear_log_page_erases(uint16_t nb_pages)
+{
+    dbflash_wear_counters.nb_page_erases += nb_pages;
+}
+
 #endif /* DBFLASH_MEM_H_ */
\ No newline at end of file
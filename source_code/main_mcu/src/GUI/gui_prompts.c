@@ -72,6 +72,9 @@ const uint16_t gui_prompts_notif_popup_anim_length[3] = {INFO_NOTIF_ANIM_LGTH, W
 const uint16_t gui_prompts_notif_popup_anim_bitmap[3] = {BITMAP_INFO_NOTIF_POPUP_ID, BITMAP_WARNING_NOTIF_POPUP_ID, BITMAP_ACTION_NOTIF_POPUP_ID};
 const uint16_t gui_prompts_notif_idle_anim_length[3] = {INFO_NOTIF_IDLE_ANIM_LGTH, WARNING_NOTIF_IDLE_ANIM_LGTH, ACTION_NOTIF_IDLE_ANIM_LGTH};
 const uint16_t gui_prompts_notif_idle_anim_bitmap[3] = {BITMAP_INFO_NOTIF_IDLE_ID, BITMAP_WARNING_NOTIF_IDLE_ID, BITMAP_ACTION_NOTIF_IDLE_ID};
+// Ring cache of decoded logins for the login selection screen
+gui_prompts_login_cache_entry_t gui_prompts_login_cache[LOGIN_SCROLL_CACHE_SIZE];
+uint16_t gui_prompts_login_cache_write_index = 0;
 
 
 /*! \fn     gui_prompts_display_information_on_screen(uint16_t string_id, display_message_te message_type)
@@ -1490,6 +1493,44 @@ mini_input_yes_no_ret_te gui_prompts_ask_for_confirmation(uint16_t nb_args, conf
     return input_answer;
 }
 
+/*! \fn     gui_prompts_reset_login_cache(void)
+*   \brief  Empty the login selection screen ring cache
+*/
+static void gui_prompts_reset_login_cache(void)
+{
+    for (uint16_t i = 0; i < ARRAY_SIZE(gui_prompts_login_cache); i++)
+    {
+        gui_prompts_login_cache[i].child_addr = NODE_ADDR_NULL;
+    }
+    gui_prompts_login_cache_write_index = 0;
+}
+
+/*! \fn     gui_prompts_fetch_login(uint16_t child_addr, child_cred_node_t* temp_half_cnode_pt)
+*   \brief  Get a child node login from the ring cache, reading the node header on a miss
+*   \param  child_addr          Child node address
+*   \param  temp_half_cnode_pt  Half child node buffer, login field populated on return
+*/
+static void gui_prompts_fetch_login(uint16_t child_addr, child_cred_node_t* temp_half_cnode_pt)
+{
+    _Static_assert(MEMBER_ARRAY_SIZE(gui_prompts_login_cache_entry_t, login) == MEMBER_ARRAY_SIZE(child_cred_node_t, login), "Incorrect login cache entry size");
+    
+    /* Cache hit? */
+    for (uint16_t i = 0; i < ARRAY_SIZE(gui_prompts_login_cache); i++)
+    {
+        if (gui_prompts_login_cache[i].child_addr == child_addr)
+        {
+            memcpy(temp_half_cnode_pt->login, gui_prompts_login_cache[i].login, sizeof(temp_half_cnode_pt->login));
+            return;
+        }
+    }
+    
+    /* Miss: read node header and replace oldest entry */
+    nodemgmt_read_cred_child_node_login_and_desc(child_addr, temp_half_cnode_pt);
+    gui_prompts_login_cache[gui_prompts_login_cache_write_index].child_addr = child_addr;
+    memcpy(gui_prompts_login_cache[gui_prompts_login_cache_write_index].login, temp_half_cnode_pt->login, sizeof(temp_half_cnode_pt->login));
+    gui_prompts_login_cache_write_index = (gui_prompts_login_cache_write_index + 1) % ARRAY_SIZE(gui_prompts_login_cache);
+}
+
 /*! \fn     gui_prompts_ask_for_login_select(uint16_t parent_node_addr, uint16_t* chosen_child_node_addr)
 *   \brief  Ask for user login selection / approval
 *   \param  parent_node_addr        Address of the parent node
@@ -1530,6 +1571,9 @@ mini_input_yes_no_ret_te gui_prompts_ask_for_login_select(uint16_t parent_node_a
         return NODE_ADDR_NULL;
     }
     
+    /* Nodes may have changed since last call */
+    gui_prompts_reset_login_cache();
+    
     /* Clear frame buffer */
     #ifdef OLED_INTERNAL_FRAME_BUFFER
     sh1122_load_transition(&plat_oled_descriptor, OLED_IN_OUT_TRANS);
@@ -1552,6 +1596,7 @@ mini_input_yes_no_ret_te gui_prompts_ask_for_login_select(uint16_t parent_node_a
     int16_t animation_step = 0;
     BOOL redraw_needed = TRUE;
     BOOL action_taken = FALSE;
+    uint16_t prefetch_step = 0;
     int16_t displayed_length;
     BOOL scrolling_needed[4];
     
@@ -1652,6 +1697,7 @@ mini_input_yes_no_ret_te gui_prompts_ask_for_login_select(uint16_t parent_node_a
             memset(&text_anim_x_offset[1], 0, sizeof(text_anim_x_offset)-sizeof(text_anim_x_offset[0]));
             memset(&scrolling_needed[1], FALSE, sizeof(scrolling_needed)-sizeof(scrolling_needed[0]));
             redraw_needed = TRUE;
+            prefetch_step = 0;
         }
         
         /* Scrolling logic */
@@ -1690,8 +1736,8 @@ mini_input_yes_no_ret_te gui_prompts_ask_for_login_select(uint16_t parent_node_a
             sh1122_set_min_display_y(&plat_oled_descriptor, LOGIN_SCROLL_Y_BAR+1);
             if ((animation_step > 0) && (before_top_of_list_child_addr != NODE_ADDR_NULL))
             {
-                /* Fetch node */
-                nodemgmt_read_cred_child_node_except_pwd(before_top_of_list_child_addr, temp_half_cnode_pt);
+                /* Fetch login */
+                gui_prompts_fetch_login(before_top_of_list_child_addr, temp_half_cnode_pt);
                 
                 /* Display fading out login */
                 sh1122_refresh_used_font(&plat_oled_descriptor, FONT_UBUNTU_REGULAR_13_ID);
@@ -1716,10 +1762,10 @@ mini_input_yes_no_ret_te gui_prompts_ask_for_login_select(uint16_t parent_node_a
                     /* Load the right font */
                     sh1122_refresh_used_font(&plat_oled_descriptor, fonts_to_be_used[i]);
                     
-                    /* Fetch node if needed */
+                    /* Fetch login if needed */
                     if (i > 0)
                     {
-                        nodemgmt_read_cred_child_node_except_pwd(*(address_to_check_to_display[i]), temp_half_cnode_pt);
+                        gui_prompts_fetch_login(*(address_to_check_to_display[i]), temp_half_cnode_pt);
                     }
                     
                     /* Surround center of list item */
@@ -1793,8 +1839,8 @@ mini_input_yes_no_ret_te gui_prompts_ask_for_login_select(uint16_t parent_node_a
                     {
                         if ((animation_step < 0) && (*(address_to_check_to_display[i+1]) != NODE_ADDR_NULL))
                         {
-                            /* Fetch node */
-                            nodemgmt_read_cred_child_node_except_pwd(*(address_to_check_to_display[i+1]), temp_half_cnode_pt);
+                            /* Fetch login */
+                            gui_prompts_fetch_login(*(address_to_check_to_display[i+1]), temp_half_cnode_pt);
                             
                             /* Display fading out login */
                             sh1122_refresh_used_font(&plat_oled_descriptor, FONT_UBUNTU_REGULAR_13_ID);
@@ -1860,7 +1906,21 @@ mini_input_yes_no_ret_te gui_prompts_ask_for_login_select(uint16_t parent_node_a
             {
                 redraw_needed = FALSE;                
             }
-        }        
+        }
+        else if (prefetch_step < LOGIN_SCROLL_NB_PREFETCH_STEPS)
+        {
+            /* Idle: prefetch one login around the displayed ones per loop, closest ones first */
+            uint16_t prefetch_addr = ((prefetch_step & 0x01) == 0)? after_bottom_list_child_addr : before_top_of_list_child_addr;
+            if ((prefetch_step >= 2) && (prefetch_addr != NODE_ADDR_NULL))
+            {
+                prefetch_addr = ((prefetch_step & 0x01) == 0)? nodemgmt_get_next_child_node_for_cur_category(prefetch_addr) : nodemgmt_get_prev_child_node_for_cur_category(prefetch_addr);
+            }
+            if (prefetch_addr != NODE_ADDR_NULL)
+            {
+                gui_prompts_fetch_login(prefetch_addr, temp_half_cnode_pt);
+            }
+            prefetch_step++;
+        }
     }
     
     return MINI_INPUT_RET_NO;
@@ -112,6 +112,8 @@
 #define LOGIN_SCROLL_Y_SLINE            33
 #define LOGIN_SCROLL_Y_TLINE            49
 #define LOGIN_SCROLL_ANIM_DELAY         15
+#define LOGIN_SCROLL_CACHE_SIZE         8
+#define LOGIN_SCROLL_NB_PREFETCH_STEPS  4
 
 // Delay when scrolling a text
 #define SCROLLING_DEL                   33
@@ -126,6 +128,12 @@ typedef struct
     cust_char_t* lines[4];
 } confirmationText_t;
 
+typedef struct
+{
+    uint16_t child_addr;
+    cust_char_t login[64];
+} gui_prompts_login_cache_entry_t;
+
 /* Prototypes */
 wheel_action_ret_te gui_prompts_render_pin_enter_screen(uint8_t* current_pin, uint16_t selected_digit, uint16_t stringID, int16_t vert_anim_direction, int16_t hor_anim_direction, BOOL six_digit_prompt);
 mini_input_yes_no_ret_te gui_prompts_ask_for_confirmation(uint16_t nb_args, confirmationText_t* text_object, BOOL accept_cancel_message, BOOL parse_aux_messages, BOOL exit_on_power_change);
@@ -248,6 +248,11 @@ RET_TYPE logic_aux_mcu_flash_firmware_update(BOOL connect_to_usb_if_needed)
     /* Send message */
     comms_aux_mcu_send_message(TRUE);
     
+    /* Aux MCU reboots into its bootloader, which only uses fixed size frames */
+    dma_aux_mcu_disable_transfer();
+    dma_aux_mcu_set_variable_length_framing(FALSE);
+    comms_aux_arm_rx_and_clear_no_comms();
+    
     /* Wait for message from aux MCU */
     while(comms_aux_mcu_active_wait(&temp_rx_message, FALSE, AUX_MCU_MSG_TYPE_BOOTLOADER, FALSE, -1) != RETURN_OK){}
     
@@ -306,6 +311,9 @@ RET_TYPE logic_aux_mcu_flash_firmware_update(BOOL connect_to_usb_if_needed)
     /* Let the aux MCU boot */
     timer_delay_ms(1000);
     
+    /* Switch back to variable length frames if the new firmware supports them */
+    comms_aux_mcu_set_variable_length_framing(TRUE);
+    
     /* If USB present, send USB attach message */
     if ((platform_io_is_usb_3v3_present() != FALSE) && (connect_to_usb_if_needed != FALSE))
     {
@@ -21,11 +21,143 @@
 */
 #include <string.h>
 #include "logic_database.h"
+#include "logic_security.h"
 #include "gui_dispatcher.h"
 #include "nodemgmt.h"
 #include "utils.h"
+// Credential ID to child address hash index for webauthn credentials
+webauthn_cred_id_index_entry_t logic_database_cred_id_index[WEBAUTHN_CRED_ID_INDEX_SIZE];
+BOOL logic_database_cred_id_index_complete = FALSE;
+BOOL logic_database_cred_id_index_built = FALSE;
+uint16_t logic_database_cred_id_index_nb_entries = 0;
+// Parents having credentials that didn't fit in the credential ID index
+uint16_t logic_database_cred_id_overflow_parents[WEBAUTHN_CRED_ID_OVERFLOW_SIZE];
+uint16_t logic_database_cred_id_nb_overflow_parents = 0;
+// Service first letter jump table, for the standard credentials list
+service_fletter_index_entry_t logic_database_fletter_index[SERVICE_FLETTER_INDEX_SIZE];
+uint16_t logic_database_fletter_index_category_flags = 0;
+BOOL logic_database_fletter_index_complete = FALSE;
+BOOL logic_database_fletter_index_built = FALSE;
+uint16_t logic_database_fletter_index_nb_entries = 0;
+// Service name search index: trigram signatures, in standard credentials list order
+uint32_t logic_database_search_index_signatures[SERVICE_SEARCH_INDEX_SIZE];
+uint16_t logic_database_search_index_addrs[SERVICE_SEARCH_INDEX_SIZE];
+uint16_t logic_database_search_index_next_addr = NODE_ADDR_NULL;
+BOOL logic_database_search_index_built = FALSE;
+uint16_t logic_database_search_index_nb_entries = 0;
 
 
+/*! \fn     logic_database_invalidate_service_fletter_index(void)
+*   \brief  Invalidate the service first letter jump table, so it gets rebuilt on next use
+*/
+static void logic_database_invalidate_service_fletter_index(void)
+{
+    logic_database_fletter_index_complete = FALSE;
+    logic_database_fletter_index_built = FALSE;
+    logic_database_fletter_index_nb_entries = 0;
+}
+
+/*! \fn     logic_database_invalidate_service_search_index(void)
+*   \brief  Invalidate the service name search index, so it gets rebuilt on next search
+*/
+static void logic_database_invalidate_service_search_index(void)
+{
+    logic_database_search_index_next_addr = NODE_ADDR_NULL;
+    logic_database_search_index_built = FALSE;
+    logic_database_search_index_nb_entries = 0;
+}
+
+/*! \fn     logic_database_invalidate_service_indexes(void)
+*   \brief  Invalidate the service first letter jump table and name search index
+*   \note   To be called on user change, service / credential addition and when nodes may be modified by the host (management mode)
+*/
+void logic_database_invalidate_service_indexes(void)
+{
+    logic_database_invalidate_service_fletter_index();
+    logic_database_invalidate_service_search_index();
+}
+
+/*! \fn     logic_database_build_service_fletter_index(void)
+*   \brief  Build the first letter jump table for the services having logins in the current category
+*   \note   Table is flagged as incomplete if it overflows or if a first letter appears in two different runs
+*/
+static void logic_database_build_service_fletter_index(void)
+{
+    uint16_t next_parent_addr = nodemgmt_get_starting_parent_addr(NODEMGMT_STANDARD_CRED_TYPE_ID);
+    uint16_t category_flags = nodemgmt_get_current_category_flags();
+    parent_node_t temp_pnode;
+    
+    /* Reset table */
+    logic_database_invalidate_service_fletter_index();
+    logic_database_fletter_index_category_flags = category_flags;
+    logic_database_fletter_index_complete = TRUE;
+    logic_database_fletter_index_built = TRUE;
+    
+    /* Go through all parents */
+    while ((next_parent_addr != NODE_ADDR_NULL) && (logic_database_fletter_index_complete != FALSE))
+    {
+        nodemgmt_read_parent_node(next_parent_addr, &temp_pnode, FALSE);
+        cust_char_t fletter = temp_pnode.cred_parent.service[0];
+        
+        /* New first letter run? */
+        if (((logic_database_fletter_index_nb_entries == 0) || (logic_database_fletter_index[logic_database_fletter_index_nb_entries-1].fletter != fletter)) && (nodemgmt_check_for_logins_with_category_in_parent(next_parent_addr, temp_pnode.cred_parent.nextChildAddress, category_flags) != FALSE))
+        {
+            /* Letters showing up in different runs can't be looked up by letter */
+            for (uint16_t i = 0; i < logic_database_fletter_index_nb_entries; i++)
+            {
+                if (logic_database_fletter_index[i].fletter == fletter)
+                {
+                    logic_database_fletter_index_complete = FALSE;
+                }
+            }
+            
+            /* Store new entry */
+            if (logic_database_fletter_index_nb_entries >= SERVICE_FLETTER_INDEX_SIZE)
+            {
+                logic_database_fletter_index_complete = FALSE;
+            }
+            else
+            {
+                logic_database_fletter_index[logic_database_fletter_index_nb_entries].fletter = fletter;
+                logic_database_fletter_index[logic_database_fletter_index_nb_entries].parent_addr = next_parent_addr;
+                logic_database_fletter_index_nb_entries++;
+            }
+        }
+        
+        next_parent_addr = temp_pnode.cred_parent.nextParentAddress;
+    }
+}
+
+/*! \fn     logic_database_get_service_fletter_index_entry(cust_char_t fletter)
+*   \brief  Find the jump table entry for a given first letter, (re)building the table if needed
+*   \param  fletter     The first letter
+*   \return Entry index, -1 if the table can't be used
+*/
+static int16_t logic_database_get_service_fletter_index_entry(cust_char_t fletter)
+{
+    /* Build table on first use or category change */
+    if ((logic_database_fletter_index_built == FALSE) || (logic_database_fletter_index_category_flags != nodemgmt_get_current_category_flags()))
+    {
+        logic_database_build_service_fletter_index();
+    }
+    
+    /* Incomplete table: use the slow path */
+    if (logic_database_fletter_index_complete == FALSE)
+    {
+        return -1;
+    }
+    
+    for (uint16_t i = 0; i < logic_database_fletter_index_nb_entries; i++)
+    {
+        if (logic_database_fletter_index[i].fletter == fletter)
+        {
+            return (int16_t)i;
+        }
+    }
+    
+    return -1;
+}
+
 /*! \fn     logic_database_get_prev_2_fletters_services(uint16_t start_address, cust_char_t start_char, cust_char_t* char_array)
 *   \brief  Get the previous 2 services with different first letters
 *   \param  start_address       Address at which we should start looking
@@ -47,6 +179,22 @@ uint16_t logic_database_get_prev_2_fletters_services(uint16_t start_address, cus
     temp_pnode.cred_parent.prevParentAddress = start_address;
     char_array[0] = ' '; char_array[1] = ' ';
     
+    /* Use the jump table when possible: first service of the previous letter */
+    int16_t fletter_entry = logic_database_get_service_fletter_index_entry(start_char);
+    if (fletter_entry >= 0)
+    {
+        if (fletter_entry >= 2)
+        {
+            char_array[0] = logic_database_fletter_index[fletter_entry-2].fletter;
+        }
+        if (fletter_entry >= 1)
+        {
+            char_array[1] = logic_database_fletter_index[fletter_entry-1].fletter;
+            return logic_database_fletter_index[fletter_entry-1].parent_addr;
+        }
+        return NODE_ADDR_NULL;
+    }
+    
     do
     {
         /* Update current node address */
@@ -56,7 +204,7 @@ uint16_t logic_database_get_prev_2_fletters_services(uint16_t start_address, cus
         nodemgmt_read_parent_node(current_node_addr, &temp_pnode, FALSE);
         
         /* Check if the fchar changed */
-        if ((temp_pnode.cred_parent.service[0] != cur_char) && (nodemgmt_check_for_logins_with_category_in_parent_node(temp_pnode.cred_parent.nextChildAddress, nodemgmt_get_current_category_flags()) != NODE_ADDR_NULL))
+        if ((temp_pnode.cred_parent.service[0] != cur_char) && (nodemgmt_check_for_logins_with_category_in_parent(current_node_addr, temp_pnode.cred_parent.nextChildAddress, nodemgmt_get_current_category_flags()) != FALSE))
         {            
             if (skip_first_change_bool == FALSE)
             {
@@ -87,12 +235,12 @@ uint16_t logic_database_get_prev_2_fletters_services(uint16_t start_address, cus
     /* Check if we are at the first parent node and therefore need to store address & chars */
     if (temp_pnode.cred_parent.prevParentAddress == NODE_ADDR_NULL)
     {
-        if (((storage_index == 1) && (temp_pnode.cred_parent.service[0] != start_char)) && (nodemgmt_check_for_logins_with_category_in_parent_node(temp_pnode.cred_parent.nextChildAddress, nodemgmt_get_current_category_flags()) != NODE_ADDR_NULL))
+        if (((storage_index == 1) && (temp_pnode.cred_parent.service[0] != start_char)) && (nodemgmt_check_for_logins_with_category_in_parent(current_node_addr, temp_pnode.cred_parent.nextChildAddress, nodemgmt_get_current_category_flags()) != FALSE))
         {
             char_array[1] = temp_pnode.cred_parent.service[0];
             return_value = current_node_addr;
         } 
-        else if (((storage_index == 0) && (temp_pnode.cred_parent.service[0] != char_array[1])) && (nodemgmt_check_for_logins_with_category_in_parent_node(temp_pnode.cred_parent.nextChildAddress, nodemgmt_get_current_category_flags()) != NODE_ADDR_NULL))
+        else if (((storage_index == 0) && (temp_pnode.cred_parent.service[0] != char_array[1])) && (nodemgmt_check_for_logins_with_category_in_parent(current_node_addr, temp_pnode.cred_parent.nextChildAddress, nodemgmt_get_current_category_flags()) != FALSE))
         {
             char_array[0] = temp_pnode.cred_parent.service[0];
         }
@@ -119,6 +267,22 @@ uint16_t logic_database_get_next_2_fletters_services(uint16_t start_address, cus
     temp_pnode.cred_parent.nextParentAddress = start_address;
     char_array[0] = ' '; char_array[1] = ' ';
     
+    /* Use the jump table when possible */
+    int16_t fletter_entry = logic_database_get_service_fletter_index_entry(cur_char);
+    if (fletter_entry >= 0)
+    {
+        if (fletter_entry + 2 < (int16_t)logic_database_fletter_index_nb_entries)
+        {
+            char_array[1] = logic_database_fletter_index[fletter_entry+2].fletter;
+        }
+        if (fletter_entry + 1 < (int16_t)logic_database_fletter_index_nb_entries)
+        {
+            char_array[0] = logic_database_fletter_index[fletter_entry+1].fletter;
+            return logic_database_fletter_index[fletter_entry+1].parent_addr;
+        }
+        return NODE_ADDR_NULL;
+    }
+    
     do 
     {
         /* Update current node address */
@@ -128,7 +292,7 @@ uint16_t logic_database_get_next_2_fletters_services(uint16_t start_address, cus
         nodemgmt_read_parent_node(current_node_addr, &temp_pnode, FALSE);
         
         /* Check if the fchar changed */
-        if ((temp_pnode.cred_parent.service[0] != cur_char) && (nodemgmt_check_for_logins_with_category_in_parent_node(temp_pnode.cred_parent.nextChildAddress, nodemgmt_get_current_category_flags()) != NODE_ADDR_NULL))
+        if ((temp_pnode.cred_parent.service[0] != cur_char) && (nodemgmt_check_for_logins_with_category_in_parent(current_node_addr, temp_pnode.cred_parent.nextChildAddress, nodemgmt_get_current_category_flags()) != FALSE))
         {
             char_array[storage_index++] = temp_pnode.cred_parent.service[0];
             cur_char = temp_pnode.cred_parent.service[0];
@@ -224,6 +388,161 @@ uint16_t logic_database_search_service(cust_char_t* name, service_compare_mode_t
     }    
 }
 
+/*! \fn     logic_database_search_fold_char(cust_char_t c)
+*   \brief  Fold an ASCII upper case character to lower case, for case insensitive searches
+*   \param  c   The character
+*   \return The folded character
+*/
+static inline cust_char_t logic_database_search_fold_char(cust_char_t c)
+{
+    if ((c >= 'A') && (c <= 'Z'))
+    {
+        return c - 'A' + 'a';
+    }
+    return c;
+}
+
+/*! \fn     logic_database_get_trigram_signature(cust_char_t* string, uint16_t max_length)
+*   \brief  Compute the 32 bits signature of all the case folded trigrams in a string
+*   \param  string      The string
+*   \param  max_length  Max string length
+*   \return The signature, 0 for strings shorter than 3 characters
+*   \note   If string A contains string B, sig(B) bits are all set in sig(A)
+*/
+static uint32_t logic_database_get_trigram_signature(cust_char_t* string, uint16_t max_length)
+{
+    uint16_t string_length = utils_strnlen(string, max_length);
+    uint32_t signature = 0;
+    
+    for (uint16_t i = 0; i + 2 < string_length; i++)
+    {
+        uint32_t hash = ((uint32_t)logic_database_search_fold_char(string[i]) * 31 + logic_database_search_fold_char(string[i+1])) * 31 + logic_database_search_fold_char(string[i+2]);
+        signature |= (1UL << ((hash ^ (hash >> 5)) & 0x1F));
+    }
+    
+    return signature;
+}
+
+/*! \fn     logic_database_service_matches_query(cust_char_t* service, cust_char_t* query, uint16_t query_length, service_search_mode_te mode)
+*   \brief  Case insensitive check of a service name against a search query
+*   \param  service         The service name
+*   \param  query           The search query
+*   \param  query_length    Query length
+*   \param  mode            Prefix or substring search
+*   \return TRUE if the service name matches
+*/
+static BOOL logic_database_service_matches_query(cust_char_t* service, cust_char_t* query, uint16_t query_length, service_search_mode_te mode)
+{
+    uint16_t service_length = utils_strnlen(service, MEMBER_ARRAY_SIZE(parent_cred_node_t, service));
+    uint16_t last_start_index = (mode == SEARCH_MODE_PREFIX)? 0 : service_length;
+    
+    for (uint16_t start_index = 0; (start_index <= last_start_index) && (start_index + query_length <= service_length); start_index++)
+    {
+        uint16_t i;
+        for (i = 0; i < query_length; i++)
+        {
+            if (logic_database_search_fold_char(service[start_index + i]) != logic_database_search_fold_char(query[i]))
+            {
+                break;
+            }
+        }
+        if (i == query_length)
+        {
+            return TRUE;
+        }
+    }
+    
+    return FALSE;
+}
+
+/*! \fn     logic_database_build_service_search_index(void)
+*   \brief  Build the service name search index: trigram signatures of the first standard services
+*   \note   The index can't be sized for the whole database in RAM: services that don't fit in it are searched by walking the list
+*           from logic_database_search_index_next_addr. Results and their order are the same, only these services are read for each search
+*/
+static void logic_database_build_service_search_index(void)
+{
+    uint16_t next_parent_addr = nodemgmt_get_starting_parent_addr(NODEMGMT_STANDARD_CRED_TYPE_ID);
+    parent_node_t temp_pnode;
+    
+    /* Reset index */
+    logic_database_invalidate_service_search_index();
+    logic_database_search_index_built = TRUE;
+    
+    /* Go through parents until index is full */
+    while ((next_parent_addr != NODE_ADDR_NULL) && (logic_database_search_index_nb_entries < SERVICE_SEARCH_INDEX_SIZE))
+    {
+        nodemgmt_read_parent_node(next_parent_addr, &temp_pnode, FALSE);
+        logic_database_search_index_signatures[logic_database_search_index_nb_entries] = logic_database_get_trigram_signature(temp_pnode.cred_parent.service, ARRAY_SIZE(temp_pnode.cred_parent.service));
+        logic_database_search_index_addrs[logic_database_search_index_nb_entries++] = next_parent_addr;
+        next_parent_addr = temp_pnode.cred_parent.nextParentAddress;
+    }
+    
+    /* Where the slow path should start */
+    logic_database_search_index_next_addr = next_parent_addr;
+}
+
+/*! \fn     logic_database_search_services(cust_char_t* query, service_search_mode_te mode, uint16_t start_after_addr, uint16_t* addresses, uint16_t max_nb_addresses)
+*   \brief  Case insensitive prefix / substring search of the standard services having logins in the current category
+*   \param  query               Null terminated search query
+*   \param  mode                Prefix or substring search
+*   \param  start_after_addr    Parent address after which the search should start (for pagination), NODE_ADDR_NULL to start from the beginning
+*   \param  addresses           Where to store the matching parent addresses
+*   \param  max_nb_addresses    Max number of addresses to store
+*   \return Number of matching parent addresses stored
+*/
+uint16_t logic_database_search_services(cust_char_t* query, service_search_mode_te mode, uint16_t start_after_addr, uint16_t* addresses, uint16_t max_nb_addresses)
+{
+    uint16_t query_length = utils_strnlen(query, MEMBER_ARRAY_SIZE(parent_cred_node_t, service));
+    uint32_t query_signature = logic_database_get_trigram_signature(query, query_length);
+    uint16_t category_flags = nodemgmt_get_current_category_flags();
+    BOOL started = (start_after_addr == NODE_ADDR_NULL)? TRUE : FALSE;
+    uint16_t next_parent_addr;
+    uint16_t nb_matches = 0;
+    parent_node_t temp_pnode;
+    
+    /* Build index on first search */
+    if (logic_database_search_index_built == FALSE)
+    {
+        logic_database_build_service_search_index();
+    }
+    
+    /* Indexed services: only read the ones whose signature could match */
+    for (uint16_t i = 0; (i < logic_database_search_index_nb_entries) && (nb_matches < max_nb_addresses); i++)
+    {
+        if (started == FALSE)
+        {
+            started = (logic_database_search_index_addrs[i] == start_after_addr)? TRUE : FALSE;
+        }
+        else if ((logic_database_search_index_signatures[i] & query_signature) == query_signature)
+        {
+            nodemgmt_read_parent_node(logic_database_search_index_addrs[i], &temp_pnode, FALSE);
+            if ((logic_database_service_matches_query(temp_pnode.cred_parent.service, query, query_length, mode) != FALSE) && (nodemgmt_check_for_logins_with_category_in_parent(logic_database_search_index_addrs[i], temp_pnode.cred_parent.nextChildAddress, category_flags) != FALSE))
+            {
+                addresses[nb_matches++] = logic_database_search_index_addrs[i];
+            }
+        }
+    }
+    
+    /* Services that didn't fit in the index */
+    next_parent_addr = logic_database_search_index_next_addr;
+    while ((next_parent_addr != NODE_ADDR_NULL) && (nb_matches < max_nb_addresses))
+    {
+        nodemgmt_read_parent_node(next_parent_addr, &temp_pnode, FALSE);
+        if (started == FALSE)
+        {
+            started = (next_parent_addr == start_after_addr)? TRUE : FALSE;
+        }
+        else if ((logic_database_service_matches_query(temp_pnode.cred_parent.service, query, query_length, mode) != FALSE) && (nodemgmt_check_for_logins_with_category_in_parent(next_parent_addr, temp_pnode.cred_parent.nextChildAddress, category_flags) != FALSE))
+        {
+            addresses[nb_matches++] = next_parent_addr;
+        }
+        next_parent_addr = temp_pnode.cred_parent.nextParentAddress;
+    }
+    
+    return nb_matches;
+}
+
 /*! \fn     logic_database_search_webauthn_userhandle_in_service(uint16_t parent_addr, uint8_t* user_handle, uint8_t user_handle_len)
 *   \brief  Find a given userhandle for a given parent
 *   \param  parent_addr Parent node address
@@ -259,8 +578,8 @@ uint16_t logic_database_search_webauthn_userhandle_in_service(uint16_t parent_ad
     /* Start going through the nodes */
     do
     {
-        /* Read child node */
-        nodemgmt_read_webauthn_child_node_except_display_name(next_node_addr, temp_half_cnode_pt, FALSE);
+        /* Read child node up to the user handle */
+        nodemgmt_read_node_fields(next_node_addr, child_webauthn_node_t, flags, user_handle_len, temp_half_cnode_pt);
         
         /* Compare with provided user handle */
         if (user_handle_len == temp_half_cnode_pt->user_handle_len && memcmp(temp_half_cnode_pt->user_handle, user_handle, user_handle_len) == 0)
@@ -277,6 +596,156 @@ uint16_t logic_database_search_webauthn_userhandle_in_service(uint16_t parent_ad
     return NODE_ADDR_NULL;
 }
 
+/*! \fn     logic_database_get_credential_id_hash(uint8_t* credential_id)
+*   \brief  Compute the hash used by the credential ID index
+*   \param  credential_id   Credential ID
+*   \return The hash
+*/
+static uint16_t logic_database_get_credential_id_hash(uint8_t* credential_id)
+{
+    uint16_t hash = 0;
+    
+    /* Credential IDs generated by the device are random: folding them is enough */
+    for (uint16_t i = 0; i < MEMBER_SIZE(child_webauthn_node_t, credential_id); i+=2)
+    {
+        hash ^= (((uint16_t)credential_id[i]) << 8) | credential_id[i+1];
+    }
+    return hash;
+}
+
+/*! \fn     logic_database_invalidate_webauthn_cred_id_index(void)
+*   \brief  Invalidate the credential ID index, so it gets rebuilt on next search
+*   \note   To be called on user change and when nodes may be modified by the host (management mode)
+*/
+void logic_database_invalidate_webauthn_cred_id_index(void)
+{
+    memset(logic_database_cred_id_index, 0, sizeof(logic_database_cred_id_index));
+    logic_database_cred_id_index_complete = FALSE;
+    logic_database_cred_id_index_built = FALSE;
+    logic_database_cred_id_index_nb_entries = 0;
+    logic_database_cred_id_nb_overflow_parents = 0;
+}
+
+/*! \fn     logic_database_is_webauthn_cred_id_overflow_parent(uint16_t parent_addr)
+*   \brief  Check if a parent has credentials that didn't fit in the credential ID index
+*   \param  parent_addr     Parent node address
+*   \return TRUE or FALSE
+*/
+static BOOL logic_database_is_webauthn_cred_id_overflow_parent(uint16_t parent_addr)
+{
+    for (uint16_t i = 0; i < logic_database_cred_id_nb_overflow_parents; i++)
+    {
+        if (logic_database_cred_id_overflow_parents[i] == parent_addr)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*! \fn     logic_database_add_to_webauthn_cred_id_index(uint16_t parent_addr, uint16_t child_addr, uint8_t* credential_id)
+*   \brief  Add a credential to the credential ID index
+*   \param  parent_addr     Parent node address
+*   \param  child_addr      Child node address
+*   \param  credential_id   Credential ID
+*   \note   When the index is full, the parent is stored in the overflow list and searches for that parent fall back on walking its child nodes.
+*           The index is only flagged as incomplete when the overflow list is full as well
+*/
+static void logic_database_add_to_webauthn_cred_id_index(uint16_t parent_addr, uint16_t child_addr, uint8_t* credential_id)
+{
+    uint16_t hash = logic_database_get_credential_id_hash(credential_id);
+    
+    /* Index full? */
+    if (logic_database_cred_id_index_nb_entries >= WEBAUTHN_CRED_ID_INDEX_MAX_LOAD)
+    {
+        if (logic_database_is_webauthn_cred_id_overflow_parent(parent_addr) != FALSE)
+        {
+            return;
+        }
+        else if (logic_database_cred_id_nb_overflow_parents < WEBAUTHN_CRED_ID_OVERFLOW_SIZE)
+        {
+            logic_database_cred_id_overflow_parents[logic_database_cred_id_nb_overflow_parents++] = parent_addr;
+        }
+        else
+        {
+            logic_database_cred_id_index_complete = FALSE;
+        }
+        return;
+    }
+    
+    /* Linear probing, taking the first empty or removed slot */
+    for (uint16_t i = 0; i < WEBAUTHN_CRED_ID_INDEX_SIZE; i++)
+    {
+        webauthn_cred_id_index_entry_t* entry_pt = &logic_database_cred_id_index[(hash + i) & (WEBAUTHN_CRED_ID_INDEX_SIZE-1)];
+        
+        if ((entry_pt->parent_addr == NODE_ADDR_NULL) || (entry_pt->child_addr == NODE_ADDR_NULL))
+        {
+            if (entry_pt->parent_addr == NODE_ADDR_NULL)
+            {
+                logic_database_cred_id_index_nb_entries++;
+            }
+            entry_pt->cred_id_hash = hash;
+            entry_pt->parent_addr = parent_addr;
+            entry_pt->child_addr = child_addr;
+            return;
+        }
+    }
+}
+
+/*! \fn     logic_database_remove_from_webauthn_cred_id_index(uint16_t child_addr)
+*   \brief  Remove a credential from the credential ID index
+*   \param  child_addr      Child node address
+*   \note   The slot is kept used so probing sequences of other entries aren't broken
+*/
+static void logic_database_remove_from_webauthn_cred_id_index(uint16_t child_addr)
+{
+    for (uint16_t i = 0; i < WEBAUTHN_CRED_ID_INDEX_SIZE; i++)
+    {
+        if ((logic_database_cred_id_index[i].parent_addr != NODE_ADDR_NULL) && (logic_database_cred_id_index[i].child_addr == child_addr))
+        {
+            logic_database_cred_id_index[i].child_addr = NODE_ADDR_NULL;
+        }
+    }
+}
+
+/*! \fn     logic_database_build_webauthn_cred_id_index(void)
+*   \brief  Build the credential ID index by scanning all webauthn credentials of the current user
+*/
+static void logic_database_build_webauthn_cred_id_index(void)
+{
+    child_webauthn_node_t* temp_half_cnode_pt;
+    uint16_t next_parent_addr;
+    uint16_t next_child_addr;
+    parent_node_t temp_pnode;
+    child_node_t temp_cnode;
+    
+    /* Start from scratch */
+    logic_database_invalidate_webauthn_cred_id_index();
+    logic_database_cred_id_index_complete = TRUE;
+    logic_database_cred_id_index_built = TRUE;
+    temp_half_cnode_pt = &temp_cnode.webauthn_child;
+    
+    /* Go through all webauthn parents and their children */
+    next_parent_addr = nodemgmt_get_starting_parent_addr(NODEMGMT_WEBAUTHN_CRED_TYPE_ID);
+    while ((next_parent_addr != NODE_ADDR_NULL) && (logic_database_cred_id_index_complete != FALSE))
+    {
+        nodemgmt_read_parent_node(next_parent_addr, &temp_pnode, FALSE);
+        next_child_addr = temp_pnode.cred_parent.nextChildAddress;
+        
+        while ((next_child_addr != NODE_ADDR_NULL) && (logic_database_cred_id_index_complete != FALSE))
+        {
+            nodemgmt_read_node_fields(next_child_addr, child_webauthn_node_t, flags, credential_id, temp_half_cnode_pt);
+            logic_database_add_to_webauthn_cred_id_index(next_parent_addr, next_child_addr, temp_half_cnode_pt->credential_id);
+            next_child_addr = temp_half_cnode_pt->nextChildAddress;
+        }
+        
+        next_parent_addr = temp_pnode.cred_parent.nextParentAddress;
+    }
+    
+    /* Clear temp node */
+    memset(&temp_cnode, 0, sizeof(temp_cnode));
+}
+
 /*! \fn     logic_database_search_webauthn_credential_id_in_service(uint16_t parent_addr, uint8_t* credential_id)
 *   \brief  Find a given credential id for a given parent
 *   \param  parent_addr Parent node address
@@ -292,6 +761,42 @@ uint16_t logic_database_search_webauthn_credential_id_in_service(uint16_t parent
     /* Dirty trick */
     temp_half_cnode_pt = (child_webauthn_node_t*)&temp_pnode;
     
+    /* Index built lazily on first search after login, not used in management mode as nodes may be changed by the host */
+    BOOL use_cred_id_index = (logic_security_is_management_mode_set() == FALSE)?TRUE:FALSE;
+    if ((use_cred_id_index != FALSE) && (logic_database_cred_id_index_built == FALSE))
+    {
+        logic_database_build_webauthn_cred_id_index();
+    }
+    
+    /* Look into the index: a single node read per hash match */
+    uint16_t hash = logic_database_get_credential_id_hash(credential_id);
+    for (uint16_t i = 0; (use_cred_id_index != FALSE) && (i < WEBAUTHN_CRED_ID_INDEX_SIZE); i++)
+    {
+        webauthn_cred_id_index_entry_t* entry_pt = &logic_database_cred_id_index[(hash + i) & (WEBAUTHN_CRED_ID_INDEX_SIZE-1)];
+        
+        /* Empty slot: end of probing sequence */
+        if (entry_pt->parent_addr == NODE_ADDR_NULL)
+        {
+            break;
+        }
+        
+        /* Same hash and parent: check credential id */
+        if ((entry_pt->child_addr != NODE_ADDR_NULL) && (entry_pt->cred_id_hash == hash) && (entry_pt->parent_addr == parent_addr))
+        {
+            nodemgmt_read_node_fields(entry_pt->child_addr, child_webauthn_node_t, flags, credential_id, temp_half_cnode_pt);
+            if (memcmp(temp_half_cnode_pt->credential_id, credential_id, MEMBER_SIZE(child_webauthn_node_t, credential_id)) == 0)
+            {
+                return entry_pt->child_addr;
+            }
+        }
+    }
+    
+    /* All credentials of this parent are in the index: no need to look further */
+    if ((use_cred_id_index != FALSE) && (logic_database_cred_id_index_complete != FALSE) && (logic_database_is_webauthn_cred_id_overflow_parent(parent_addr) == FALSE))
+    {
+        return NODE_ADDR_NULL;
+    }
+    
     /* Read parent node and get first child address */
     nodemgmt_read_parent_node(parent_addr, &temp_pnode, TRUE);
     next_node_addr = temp_pnode.cred_parent.nextChildAddress;
@@ -305,8 +810,8 @@ uint16_t logic_database_search_webauthn_credential_id_in_service(uint16_t parent
     /* Start going through the nodes */
     do
     {
-        /* Read child node */
-        nodemgmt_read_webauthn_child_node_except_display_name(next_node_addr, temp_half_cnode_pt, FALSE);
+        /* Read child node up to the credential id */
+        nodemgmt_read_node_fields(next_node_addr, child_webauthn_node_t, flags, credential_id, temp_half_cnode_pt);
         
         /* Compare with provided credential id */
         if (memcmp(temp_half_cnode_pt->credential_id, credential_id, MEMBER_SIZE(child_webauthn_node_t, credential_id)) == 0)
@@ -352,8 +857,8 @@ uint16_t logic_database_search_login_in_service(uint16_t parent_addr, cust_char_
     /* Start going through the nodes */
     do
     {
-        /* Read child node */
-        nodemgmt_read_cred_child_node_except_pwd(next_node_addr, temp_half_cnode_pt);
+        /* Read child node up to the login */
+        nodemgmt_read_node_fields(next_node_addr, child_cred_node_t, flags, login, temp_half_cnode_pt);
         
         /* Compare login with the provided name */        
         if ((utils_custchar_strncmp(login, temp_half_cnode_pt->login, ARRAY_SIZE(temp_half_cnode_pt->login)) == 0) && ((category_filter == FALSE) || (nodemgmt_get_current_category_flags() == 0) || (categoryFromFlags(temp_half_cnode_pt->flags) == nodemgmt_get_current_category_flags())))
@@ -382,8 +887,9 @@ void logic_database_get_login_for_address(uint16_t child_addr, cust_char_t** log
     /* Dirty trick */
     temp_half_cnode_pt = (child_cred_node_t*)&temp_pnode;
     
-    /* Read child node */
-    nodemgmt_read_cred_child_node_except_pwd(child_addr, temp_half_cnode_pt);
+    /* Read child node up to the login */
+    nodemgmt_read_node_fields(child_addr, child_cred_node_t, flags, login, temp_half_cnode_pt);
+    temp_half_cnode_pt->login[MEMBER_ARRAY_SIZE(child_cred_node_t, login)-1] = 0;
     
     /* Copy string */
     utils_strncpy(*login, temp_half_cnode_pt->login, MEMBER_ARRAY_SIZE(child_cred_node_t, login));
@@ -402,8 +908,9 @@ void logic_database_get_webauthn_username_for_address(uint16_t child_addr, cust_
     /* Dirty trick */
     temp_half_cnode_pt = (child_webauthn_node_t*)&temp_pnode;
     
-    /* Read child node */
-    nodemgmt_read_webauthn_child_node_except_display_name(child_addr, temp_half_cnode_pt, FALSE);
+    /* Read child node up to the user name */
+    nodemgmt_read_node_fields(child_addr, child_webauthn_node_t, flags, user_name_t0, temp_half_cnode_pt);
+    temp_half_cnode_pt->user_name_t0 = 0;
     
     /* Copy string */
     utils_strncpy(user_name, temp_half_cnode_pt->user_name, MEMBER_ARRAY_SIZE(child_webauthn_node_t, user_name));
@@ -423,8 +930,8 @@ void logic_database_get_webauthn_userhandle_for_address(uint16_t child_addr, uin
     /* Dirty trick */
     temp_half_cnode_pt = (child_webauthn_node_t*)&temp_pnode;
     
-    /* Read child node */
-    nodemgmt_read_webauthn_child_node_except_display_name(child_addr, temp_half_cnode_pt, FALSE);
+    /* Read child node up to the user handle */
+    nodemgmt_read_node_fields(child_addr, child_webauthn_node_t, flags, user_handle_len, temp_half_cnode_pt);
 
     /* Sanitize user_handle_len to prevent overflow */
     if (temp_half_cnode_pt->user_handle_len > MEMBER_SIZE(child_webauthn_node_t, user_handle))
@@ -515,11 +1022,24 @@ uint16_t logic_database_get_number_of_creds_for_service(uint16_t parent_addr, ui
         return return_val;
     }
     
+    /* No category filtering: use the cached parent summary */
+    if ((category_filter == FALSE) || (nodemgmt_get_current_category_flags() == 0))
+    {
+        *fnode_addr = next_node_addr;
+        return nodemgmt_get_number_of_children_in_parent_node(parent_addr, next_node_addr);
+    }
+    
+    /* No child with the current category */
+    if (nodemgmt_check_for_logins_with_category_in_parent(parent_addr, next_node_addr, nodemgmt_get_current_category_flags()) == FALSE)
+    {
+        return return_val;
+    }
+    
     /* Start going through the nodes */
     do
     {
-        /* Read child node */
-        nodemgmt_read_cred_child_node_except_pwd(next_node_addr, temp_half_cnode_pt);
+        /* Read child node flags & addresses */
+        nodemgmt_read_node_fields(next_node_addr, child_cred_node_t, flags, nextChildAddress, temp_half_cnode_pt);
         
         /* Check for category */
         if ((category_filter == FALSE) || (nodemgmt_get_current_category_flags() == 0) || (categoryFromFlags(temp_half_cnode_pt->flags) == nodemgmt_get_current_category_flags()))
@@ -566,6 +1086,7 @@ uint16_t logic_database_add_service(cust_char_t* service, service_type_te cred_t
     /* Create parent node, function handles flag setting etc */
     if (nodemgmt_create_parent_node(&temp_pnode, cred_type, &storage_addr, data_category_id) == RETURN_OK)
     {
+        logic_database_invalidate_service_indexes();
         return storage_addr;
     }
     else
@@ -601,6 +1122,21 @@ void logic_database_update_webauthn_credential(uint16_t child_address, cust_char
     temp_cnode.signature_counter_msb = 0;
     temp_cnode.signature_counter_lsb = 1;
     
+    /* Update credential ID index: parent address is kept from the previous entry */
+    if (logic_database_cred_id_index_built != FALSE)
+    {
+        for (uint16_t i = 0; i < WEBAUTHN_CRED_ID_INDEX_SIZE; i++)
+        {
+            if ((logic_database_cred_id_index[i].parent_addr != NODE_ADDR_NULL) && (logic_database_cred_id_index[i].child_addr == child_address))
+            {
+                uint16_t parent_addr = logic_database_cred_id_index[i].parent_addr;
+                logic_database_remove_from_webauthn_cred_id_index(child_address);
+                logic_database_add_to_webauthn_cred_id_index(parent_addr, child_address, credential_id);
+                break;
+            }
+        }
+    }
+    
     /* Update dates */
     temp_cnode.dateCreated = nodemgmt_get_current_date();
     temp_cnode.dateLastUsed = nodemgmt_get_current_date();
@@ -696,6 +1232,12 @@ RET_TYPE logic_database_add_webauthn_credential_for_service(uint16_t service_add
     if (ret_val == RETURN_OK)
     {
         nodemgmt_user_db_changed_actions(FALSE);
+        
+        /* Add it to the credential ID index */
+        if (logic_database_cred_id_index_built != FALSE)
+        {
+            logic_database_add_to_webauthn_cred_id_index(service_addr, storage_addr, credential_id);
+        }
     }
 
     /* Return success status */
@@ -749,6 +1291,7 @@ RET_TYPE logic_database_add_credential_for_service(uint16_t service_addr, cust_c
     ret_type_te ret_val = nodemgmt_create_child_node(service_addr, &temp_cnode, &storage_addr);
     if (ret_val == RETURN_OK)
     {
+        logic_database_invalidate_service_indexes();
         nodemgmt_user_db_changed_actions(FALSE);
     }
 
@@ -798,21 +1341,36 @@ void logic_database_fetch_encrypted_password(uint16_t child_node_addr, uint8_t*
 */
 uint16_t logic_database_fill_get_cred_message_answer(uint16_t child_node_addr, hid_message_t* send_msg, uint8_t* cred_ctr, BOOL* prev_gen_credential_flag, BOOL* password_valid)
 {
-    child_cred_node_t temp_cnode;    
-    uint16_t current_index = 0;
+    child_cred_node_t temp_cnode;
     
     /* Read node, ownership checks and text fields sanitizing are done within */
     nodemgmt_read_cred_child_node(child_node_addr, &temp_cnode);
     
+    return logic_database_fill_get_cred_message_answer_from_node(&temp_cnode, send_msg, cred_ctr, prev_gen_credential_flag, password_valid);
+}
+
+/*! \fn     logic_database_fill_get_cred_message_answer_from_node(child_cred_node_t* cnode, hid_message_t* send_msg, uint8_t* cred_ctr, BOOL* prev_gen_credential_flag, BOOL* password_valid)
+*   \brief  Fill a get cred message packet from an already read child node
+*   \param  cnode                       Pointer to the child node, read with nodemgmt_read_cred_child_node
+*   \param  send_msg                    Pointer to send message
+*   \param  cred_ctr                    Where to store credential CTR
+*   \param  prev_gen_credential_flag    Where to store flag for previous gen cred
+*   \param  password_valid              Boolean set depending if the password is valid
+*   \return Payload size without pwd
+*/
+uint16_t logic_database_fill_get_cred_message_answer_from_node(child_cred_node_t* cnode, hid_message_t* send_msg, uint8_t* cred_ctr, BOOL* prev_gen_credential_flag, BOOL* password_valid)
+{
+    uint16_t current_index = 0;
+    
     /* Clear send_msg */
     memset(send_msg->payload, 0x00, sizeof(send_msg->payload));
     
     /* The strcpy below can be done as the message is way bigger than all fields combined */
-    _Static_assert( sizeof(temp_cnode.login) \
-                    + sizeof(temp_cnode.description) \
-                    + sizeof(temp_cnode.thirdField) \
-                    + sizeof(temp_cnode.password) 
-                    + sizeof(temp_cnode.pwdTerminatingZero) + 4 \
+    _Static_assert( sizeof(cnode->login) \
+                    + sizeof(cnode->description) \
+                    + sizeof(cnode->thirdField) \
+                    + sizeof(cnode->password) 
+                    + sizeof(cnode->pwdTerminatingZero) + 4 \
                     < \
                     sizeof(send_msg->payload)
                     - sizeof(send_msg->get_credential_answer.login_name_index) \
@@ -822,25 +1380,25 @@ uint16_t logic_database_fill_get_cred_message_answer(uint16_t child_node_addr, h
     
     /* Login field */
     send_msg->get_credential_answer.login_name_index = current_index;
-    current_index += utils_strcpy(&(send_msg->get_credential_answer.concatenated_strings[current_index]), temp_cnode.login) + 1;
+    current_index += utils_strcpy(&(send_msg->get_credential_answer.concatenated_strings[current_index]), cnode->login) + 1;
     
     /* Description field */
     send_msg->get_credential_answer.description_index = current_index;
-    current_index += utils_strcpy(&(send_msg->get_credential_answer.concatenated_strings[current_index]), temp_cnode.description) + 1;
+    current_index += utils_strcpy(&(send_msg->get_credential_answer.concatenated_strings[current_index]), cnode->description) + 1;
     
     /* Third field */
     send_msg->get_credential_answer.third_field_index = current_index;
-    current_index += utils_strcpy(&(send_msg->get_credential_answer.concatenated_strings[current_index]), temp_cnode.thirdField) + 1;
+    current_index += utils_strcpy(&(send_msg->get_credential_answer.concatenated_strings[current_index]), cnode->thirdField) + 1;
     
     /* Password field */
     send_msg->get_credential_answer.password_index = current_index;
-    memcpy(&(send_msg->get_credential_answer.concatenated_strings[current_index]), temp_cnode.password, sizeof(temp_cnode.password) + sizeof(temp_cnode.pwdTerminatingZero));
+    memcpy(&(send_msg->get_credential_answer.concatenated_strings[current_index]), cnode->password, sizeof(cnode->password) + sizeof(cnode->pwdTerminatingZero));
     
     /* Copy CTR */
-    memcpy(cred_ctr, temp_cnode.ctr, sizeof(temp_cnode.ctr));
+    memcpy(cred_ctr, cnode->ctr, sizeof(cnode->ctr));
     
     /* Set prev gen bool */
-    if ((temp_cnode.flags & NODEMGMT_PREVGEN_BIT_BITMASK) != 0)
+    if ((cnode->flags & NODEMGMT_PREVGEN_BIT_BITMASK) != 0)
     {
         *prev_gen_credential_flag = TRUE;
     } 
@@ -850,7 +1408,7 @@ uint16_t logic_database_fill_get_cred_message_answer(uint16_t child_node_addr, h
     }
     
     /* Set password valid flag */
-    if (temp_cnode.passwordBlankFlag == FALSE)
+    if (cnode->passwordBlankFlag == FALSE)
     {
         *password_valid = TRUE;
     } 
@@ -25,15 +25,38 @@
 #define LOGIC_DATABASE_H_
 
 #include "comms_hid_msgs.h"
+#include "nodemgmt.h"
 #include "defines.h"
 
+/* Defines */
+#define WEBAUTHN_CRED_ID_INDEX_SIZE         64      // Must be a power of 2
+#define WEBAUTHN_CRED_ID_INDEX_MAX_LOAD     48      // Index max number of entries to keep probing short
+#define WEBAUTHN_CRED_ID_OVERFLOW_SIZE      16      // Max number of parents having credentials that didn't fit in the index
+#define SERVICE_FLETTER_INDEX_SIZE          64      // Max number of distinct service first letters in the jump table
+#define SERVICE_SEARCH_INDEX_SIZE           128     // Max number of services in the search index (RAM bound), following ones are searched by walking the list
+
+/* Typedefs */
+typedef struct
+{
+    uint16_t cred_id_hash;          // Hash of the credential ID
+    uint16_t parent_addr;           // Parent node address, NODE_ADDR_NULL for empty slots
+    uint16_t child_addr;            // Child node address, NODE_ADDR_NULL for removed entries
+} webauthn_cred_id_index_entry_t;
+
+typedef struct
+{
+    cust_char_t fletter;            // Service first letter
+    uint16_t parent_addr;           // First parent node starting with that letter and having logins in the indexed category
+} service_fletter_index_entry_t;
 
 /* Prototypes */
 RET_TYPE logic_database_add_webauthn_credential_for_service(uint16_t service_addr, uint8_t* user_handle, uint8_t user_handle_len, cust_char_t* user_name, cust_char_t* display_name, uint8_t* private_key,  uint8_t* ctr, uint8_t* credential_id);
 void logic_database_get_webauthn_data_for_address_and_inc_count(uint16_t child_addr, uint8_t* user_handle, uint8_t* user_handle_len, uint8_t* credential_id, uint8_t* key, uint32_t* count, uint8_t* ctr);
+uint16_t logic_database_fill_get_cred_message_answer_from_node(child_cred_node_t* cnode, hid_message_t* send_msg, uint8_t* cred_ctr, BOOL* prev_gen_credential_flag, BOOL* password_valid);
 void logic_database_update_webauthn_credential(uint16_t child_address, cust_char_t* user_name, cust_char_t* display_name, uint8_t* private_key,  uint8_t* ctr, uint8_t* credential_id);
 uint16_t logic_database_fill_get_cred_message_answer(uint16_t child_node_addr, hid_message_t* send_msg, uint8_t* cred_ctr, BOOL* prev_gen_credential_flag, BOOL* password_valid);
 RET_TYPE logic_database_add_credential_for_service(uint16_t service_addr, cust_char_t* login, cust_char_t* desc, cust_char_t* third, uint8_t* password, uint8_t* ctr);
+uint16_t logic_database_search_services(cust_char_t* query, service_search_mode_te mode, uint16_t start_after_addr, uint16_t* addresses, uint16_t max_nb_addresses);
 void logic_database_fetch_encrypted_password(uint16_t child_node_addr, uint8_t* password, uint8_t* cred_ctr, BOOL* prev_gen_credential_flag);
 uint16_t logic_database_search_service(cust_char_t* name, service_compare_mode_te compare_type, BOOL cred_type, uint16_t category_id);
 void logic_database_update_credential(uint16_t child_addr, cust_char_t* desc, cust_char_t* third, uint8_t* password, uint8_t* ctr);
@@ -47,5 +70,7 @@ uint16_t logic_database_search_login_in_service(uint16_t parent_addr, cust_char_
 uint16_t logic_database_search_webauthn_credential_id_in_service(uint16_t parent_addr, uint8_t* credential_id);
 void logic_database_get_webauthn_username_for_address(uint16_t child_addr, cust_char_t* user_name);
 void logic_database_get_login_for_address(uint16_t child_addr, cust_char_t** login);
+void logic_database_invalidate_webauthn_cred_id_index(void);
+void logic_database_invalidate_service_indexes(void);
 
 #endif /* LOGIC_DATABASE_H_ */
@@ -27,6 +27,7 @@
 #include "bearssl_rand.h"
 #include "bearssl_ec.h"
 #include "custom_fs.h"
+#include "driver_timer.h"
 #include "nodemgmt.h"
 #include "rng.h"
 
@@ -34,6 +35,10 @@
 uint8_t logic_encryption_next_ctr_val[MEMBER_SIZE(nodemgmt_profile_main_data_t, current_ctr)];
 // Current encryption context */
 br_aes_ct_ctrcbc_keys logic_encryption_cur_aes_context;
+#ifdef AES_CT64_BATCH_BACKEND
+// Current encryption context for the 64 bits bitsliced implementation, used for batch decryption
+br_aes_ct64_ctrcbc_keys logic_encryption_cur_aes_ct64_context;
+#endif
 // Current user CPZ user entry
 cpz_lut_entry_t* logic_encryption_cur_cpz_entry;
 // Context used by the SHA256 engine for FIDO2
@@ -110,6 +115,57 @@ void logic_encryption_xor_vector_to_other(uint8_t* destination, uint8_t* source,
     }    
 }
 
+/*! \fn     logic_encryption_build_ctr_block(uint8_t* ctr_block, uint8_t* cred_ctr, BOOL old_gen_decrypt)
+*   \brief  Construct the AES CTR block for a given credential CTR value
+*   \param  ctr_block           Where to store the CTR block
+*   \param  cred_ctr            Credential CTR
+*   \param  old_gen_decrypt     Set to TRUE when decrypting original mini password
+*/
+static void logic_encryption_build_ctr_block(uint8_t* ctr_block, uint8_t* cred_ctr, BOOL old_gen_decrypt)
+{
+    memcpy(ctr_block, logic_encryption_cur_cpz_entry->nonce, AES256_CTR_LENGTH/8);
+    if (old_gen_decrypt == FALSE)
+    {
+        logic_encryption_add_vector_to_other(ctr_block + (AES256_CTR_LENGTH/8 - sizeof(logic_encryption_next_ctr_val)), cred_ctr, sizeof(logic_encryption_next_ctr_val));
+    }
+    else
+    {
+        logic_encryption_xor_vector_to_other(ctr_block + (AES256_CTR_LENGTH/8 - sizeof(logic_encryption_next_ctr_val)), cred_ctr, sizeof(logic_encryption_next_ctr_val));
+    }
+}
+
+/*! \fn     logic_encryption_increment_ctr_block(uint8_t* ctr_block, uint16_t nb_blocks)
+*   \brief  Increment a 128 bits AES CTR block the way the keystream generator does
+*   \param  ctr_block   The CTR block, MSB at [0]
+*   \param  nb_blocks   By how many AES blocks it should be incremented
+*/
+static void logic_encryption_increment_ctr_block(uint8_t* ctr_block, uint16_t nb_blocks)
+{
+    uint32_t carry = nb_blocks;
+    
+    for (int16_t i = AES256_CTR_LENGTH/8-1; (i >= 0) && (carry != 0); i--)
+    {
+        carry = ((uint32_t)ctr_block[i]) + carry;
+        ctr_block[i] = (uint8_t)(carry);
+        carry = carry >> 8;
+    }
+}
+
+/*! \fn     logic_encryption_ctr_keystream_run(uint8_t* ctr_block, uint8_t* data, uint32_t data_length)
+*   \brief  Apply the keystream starting at a given CTR block, using the cached key schedule of the batch backend
+*   \param  ctr_block   CTR block, updated to the next unused block
+*   \param  data        Pointer to data
+*   \param  data_length Data length
+*/
+static void logic_encryption_ctr_keystream_run(uint8_t* ctr_block, uint8_t* data, uint32_t data_length)
+{
+    #ifdef AES_CT64_BATCH_BACKEND
+    br_aes_ct64_ctrcbc_ctr(&logic_encryption_cur_aes_ct64_context, (void*)ctr_block, (void*)data, data_length);
+    #else
+    br_aes_ct_ctrcbc_ctr(&logic_encryption_cur_aes_context, (void*)ctr_block, (void*)data, data_length);
+    #endif
+}
+
 /*! \fn     logic_encryption_get_cpz_lut_entry(uint8_t* buffer)
 *   \brief  Write the current user CPZ LUT entry in buffer
 *   \param  buffer  Where to store the CPZ LUT entry
@@ -155,6 +211,9 @@ void logic_encryption_init_context(uint8_t* card_aes_key, cpz_lut_entry_t* cpz_u
         
         /* Initialize encryption context */
         br_aes_ct_ctrcbc_init(&logic_encryption_cur_aes_context, user_provisioned_key, AES_KEY_LENGTH/8);
+        #ifdef AES_CT64_BATCH_BACKEND
+        br_aes_ct64_ctrcbc_init(&logic_encryption_cur_aes_ct64_context, user_provisioned_key, AES_KEY_LENGTH/8);
+        #endif
         nodemgmt_read_profile_ctr((void*)logic_encryption_next_ctr_val);
         
         /* Clear temp var */
@@ -164,6 +223,9 @@ void logic_encryption_init_context(uint8_t* card_aes_key, cpz_lut_entry_t* cpz_u
     {
         /* Default user account: use smartcard AES key */
         br_aes_ct_ctrcbc_init(&logic_encryption_cur_aes_context, card_aes_key, AES_KEY_LENGTH/8);
+        #ifdef AES_CT64_BATCH_BACKEND
+        br_aes_ct64_ctrcbc_init(&logic_encryption_cur_aes_ct64_context, card_aes_key, AES_KEY_LENGTH/8);
+        #endif
         nodemgmt_read_profile_ctr((void*)logic_encryption_next_ctr_val);
     }
     
@@ -177,6 +239,9 @@ void logic_encryption_init_context(uint8_t* card_aes_key, cpz_lut_entry_t* cpz_u
 void logic_encryption_delete_context(void)
 {
     memset((void*)&logic_encryption_cur_aes_context, 0, sizeof(logic_encryption_cur_aes_context));
+    #ifdef AES_CT64_BATCH_BACKEND
+    memset((void*)&logic_encryption_cur_aes_ct64_context, 0, sizeof(logic_encryption_cur_aes_ct64_context));
+    #endif
     logic_encryption_cur_cpz_entry = 0;
 }
 
@@ -212,12 +277,50 @@ void logic_encryption_pre_ctr_tasks(uint16_t ctr_inc)
 */
 void logic_encryption_post_ctr_tasks(uint16_t ctr_inc)
 {
+    logic_encryption_get_ctr_with_offset(logic_encryption_next_ctr_val, logic_encryption_next_ctr_val, ctr_inc);
+}
+
+/*! \fn     logic_encryption_get_ctr_with_offset(uint8_t* destination, uint8_t* start_ctr, uint16_t nb_blocks)
+*   \brief  Compute the CTR value located nb_blocks after a given CTR value
+*   \param  destination Where to store the resulting CTR value (can be start_ctr)
+*   \param  start_ctr   Start CTR value
+*   \param  nb_blocks   Offset, in AES blocks
+*/
+void logic_encryption_get_ctr_with_offset(uint8_t* destination, uint8_t* start_ctr, uint16_t nb_blocks)
+{
+    uint32_t carry = nb_blocks;
+    
     for (int16_t i = sizeof(logic_encryption_next_ctr_val)-1; i >= 0; i--)
     {
-        ctr_inc = ((uint16_t)logic_encryption_next_ctr_val[i]) + ctr_inc;
-        logic_encryption_next_ctr_val[i] = (uint8_t)(ctr_inc);
-        ctr_inc = (ctr_inc >> 8) & 0x00FF;
-    }    
+        carry = ((uint32_t)start_ctr[i]) + carry;
+        destination[i] = (uint8_t)(carry);
+        carry = carry >> 8;
+    }
+}
+
+/*! \fn     logic_encryption_reserve_ctr_range(uint16_t nb_blocks, uint8_t* ctr_val_reserved)
+*   \brief  Reserve a contiguous range of CTR values, to be used with logic_encryption_ctr_decrypt
+*   \param  nb_blocks           Number of AES blocks to reserve
+*   \param  ctr_val_reserved    Where to store the first reserved CTR value
+*   \note   Unlike pre_ctr_tasks, this also works for increments above CTR_FLASH_MIN_INCR
+*/
+void logic_encryption_reserve_ctr_range(uint16_t nb_blocks, uint8_t* ctr_val_reserved)
+{
+    uint8_t flash_ctr_val[MEMBER_SIZE(nodemgmt_profile_main_data_t, current_ctr)];
+    uint8_t range_end_val[MEMBER_SIZE(nodemgmt_profile_main_data_t, current_ctr)];
+    
+    /* Make sure the CTR value stored in flash stays above the reserved range */
+    nodemgmt_read_profile_ctr(flash_ctr_val);
+    logic_encryption_get_ctr_with_offset(range_end_val, logic_encryption_next_ctr_val, nb_blocks);
+    if (logic_encryption_ctr_array_to_uint32(range_end_val) >= logic_encryption_ctr_array_to_uint32(flash_ctr_val))
+    {
+        logic_encryption_get_ctr_with_offset(flash_ctr_val, range_end_val, CTR_FLASH_MIN_INCR);
+        nodemgmt_set_profile_ctr(flash_ctr_val);
+    }
+    
+    /* Hand out the range */
+    memcpy(ctr_val_reserved, logic_encryption_next_ctr_val, sizeof(logic_encryption_next_ctr_val));
+    logic_encryption_post_ctr_tasks(nb_blocks);
 }
 
 /*! \fn     logic_encryption_ctr_encrypt(uint8_t* data, uint16_t data_length, uint8_t* ctr_val_used)
@@ -262,15 +365,7 @@ void logic_encryption_ctr_decrypt(uint8_t* data, uint8_t* cred_ctr, uint16_t dat
     uint8_t credential_ctr[AES256_CTR_LENGTH/8];
     
     /* Construct CTR for this encryption */
-    memcpy(credential_ctr, logic_encryption_cur_cpz_entry->nonce, sizeof(credential_ctr));
-    if (old_gen_decrypt == FALSE)
-    {
-        logic_encryption_add_vector_to_other(credential_ctr + (sizeof(credential_ctr) - sizeof(logic_encryption_next_ctr_val)), cred_ctr, sizeof(logic_encryption_next_ctr_val));
-    } 
-    else
-    {
-        logic_encryption_xor_vector_to_other(credential_ctr + (sizeof(credential_ctr) - sizeof(logic_encryption_next_ctr_val)), cred_ctr, sizeof(logic_encryption_next_ctr_val));
-    }
+    logic_encryption_build_ctr_block(credential_ctr, cred_ctr, old_gen_decrypt);
     
     /* Decrypt data */
     br_aes_ct_ctrcbc_ctr(&logic_encryption_cur_aes_context, (void*)credential_ctr, (void*)data, data_length);
@@ -279,6 +374,142 @@ void logic_encryption_ctr_decrypt(uint8_t* data, uint8_t* cred_ctr, uint16_t dat
     memset(credential_ctr, 0, sizeof(credential_ctr));  
 }
 
+/*! \fn     logic_encryption_ctr_get_keystream(uint8_t* keystream, uint8_t* cred_ctr, uint16_t data_length, BOOL old_gen_decrypt)
+*   \brief  Compute the keystream that logic_encryption_ctr_decrypt would XOR with the data
+*   \param  keystream           Where to store the keystream
+*   \param  cred_ctr            Credential CTR
+*   \param  data_length         Data length
+*   \param  old_gen_decrypt     Set to TRUE when decrypting original mini password
+*   \note   Allows decrypting data later on with logic_encryption_xor_vector_to_other
+*/
+void logic_encryption_ctr_get_keystream(uint8_t* keystream, uint8_t* cred_ctr, uint16_t data_length, BOOL old_gen_decrypt)
+{
+    memset(keystream, 0, data_length);
+    logic_encryption_ctr_decrypt(keystream, cred_ctr, data_length, old_gen_decrypt);
+}
+
+/*! \fn     logic_encryption_ctr_decrypt_batch(uint8_t* data, uint8_t* cred_ctrs, uint16_t blob_length, uint16_t nb_blobs, BOOL old_gen_decrypt)
+*   \brief  Decrypt a contiguous array of same size blobs, each one encrypted with its own CTR value
+*   \param  data                Pointer to the first blob
+*   \param  cred_ctrs           Array of nb_blobs credential CTRs, stored one after the other
+*   \param  blob_length         Length of a single blob
+*   \param  nb_blobs            Number of blobs
+*   \param  old_gen_decrypt     Set to TRUE when decrypting original mini passwords
+*   \note   Blobs whose CTR blocks follow each other (eg: data nodes) are decrypted in a single keystream run
+*/
+void logic_encryption_ctr_decrypt_batch(uint8_t* data, uint8_t* cred_ctrs, uint16_t blob_length, uint16_t nb_blobs, BOOL old_gen_decrypt)
+{
+    uint8_t blob_ctr[AES256_CTR_LENGTH/8];
+    uint8_t run_ctr[AES256_CTR_LENGTH/8];
+    uint8_t next_ctr[AES256_CTR_LENGTH/8];
+    uint16_t run_start = 0;
+    
+    /* Blobs can only share a keystream run if they end on an AES block boundary */
+    BOOL can_merge_blobs = ((blob_length % (AES256_CTR_LENGTH/8)) == 0)?TRUE:FALSE;
+    
+    for (uint16_t i = 0; i < nb_blobs; i++)
+    {
+        /* Construct CTR for this blob */
+        logic_encryption_build_ctr_block(blob_ctr, &cred_ctrs[i*sizeof(logic_encryption_next_ctr_val)], old_gen_decrypt);
+        
+        /* Start a new run if this blob doesn't continue the previous keystream */
+        if ((i == 0) || (can_merge_blobs == FALSE) || (memcmp(blob_ctr, next_ctr, sizeof(blob_ctr)) != 0))
+        {
+            if (i != 0)
+            {
+                logic_encryption_ctr_keystream_run(run_ctr, &data[(uint32_t)run_start*blob_length], (uint32_t)(i-run_start)*blob_length);
+            }
+            memcpy(run_ctr, blob_ctr, sizeof(run_ctr));
+            memcpy(next_ctr, blob_ctr, sizeof(next_ctr));
+            run_start = i;
+        }
+        
+        /* Compute the CTR block following this blob */
+        logic_encryption_increment_ctr_block(next_ctr, (blob_length*8 + AES256_CTR_LENGTH - 1)/AES256_CTR_LENGTH);
+    }
+    
+    /* Last run */
+    if (nb_blobs != 0)
+    {
+        logic_encryption_ctr_keystream_run(run_ctr, &data[(uint32_t)run_start*blob_length], (uint32_t)(nb_blobs-run_start)*blob_length);
+    }
+    
+    /* Reset vars */
+    memset(blob_ctr, 0, sizeof(blob_ctr));
+    memset(run_ctr, 0, sizeof(run_ctr));
+    memset(next_ctr, 0, sizeof(next_ctr));
+}
+
+/*! \fn     logic_encryption_ctr_benchmark(aes_ctr_bench_mode_te bench_mode, uint16_t nb_kbytes)
+*   \brief  Measure AES CTR decryption throughput, using a random throwaway key
+*   \param  bench_mode  Which decryption path / backend to benchmark
+*   \param  nb_kbytes   Number of kB to decrypt
+*   \return Throughput in bytes per second, 0 if the backend isn't available
+*   \note   Does not touch the current user encryption context
+*/
+uint32_t logic_encryption_ctr_benchmark(aes_ctr_bench_mode_te bench_mode, uint16_t nb_kbytes)
+{
+    uint8_t bench_key[AES_KEY_LENGTH/8];
+    uint8_t bench_ctr[AES256_CTR_LENGTH/8];
+    uint8_t bench_buffer[1024];
+    br_aes_ct_ctrcbc_keys bench_ct_context;
+    #ifdef AES_CT64_BATCH_BACKEND
+    br_aes_ct64_ctrcbc_keys bench_ct64_context;
+    #endif
+    
+    /* Random key, nonce and data: we do not care about the result */
+    rng_fill_array(bench_key, sizeof(bench_key));
+    rng_fill_array(bench_ctr, sizeof(bench_ctr));
+    rng_fill_array(bench_buffer, sizeof(bench_buffer));
+    br_aes_ct_ctrcbc_init(&bench_ct_context, bench_key, sizeof(bench_key));
+    #ifdef AES_CT64_BATCH_BACKEND
+    br_aes_ct64_ctrcbc_init(&bench_ct64_context, bench_key, sizeof(bench_key));
+    #else
+    if (bench_mode == AES_CTR_BENCH_CT64_BATCH)
+    {
+        return 0;
+    }
+    #endif
+    
+    uint32_t start_tick = timer_get_systick();
+    for (uint16_t i = 0; i < nb_kbytes; i++)
+    {
+        if (bench_mode == AES_CTR_BENCH_CT_PER_BLOB)
+        {
+            /* Current per credential path: one keystream call per 128B password, the CTR block being updated by each call */
+            for (uint16_t j = 0; j < sizeof(bench_buffer); j += MEMBER_SIZE(child_cred_node_t, password))
+            {
+                br_aes_ct_ctrcbc_ctr(&bench_ct_context, (void*)bench_ctr, (void*)&bench_buffer[j], MEMBER_SIZE(child_cred_node_t, password));
+            }
+        }
+        else if (bench_mode == AES_CTR_BENCH_CT_BATCH)
+        {
+            br_aes_ct_ctrcbc_ctr(&bench_ct_context, (void*)bench_ctr, (void*)bench_buffer, sizeof(bench_buffer));
+        }
+        #ifdef AES_CT64_BATCH_BACKEND
+        else
+        {
+            br_aes_ct64_ctrcbc_ctr(&bench_ct64_context, (void*)bench_ctr, (void*)bench_buffer, sizeof(bench_buffer));
+        }
+        #endif
+    }
+    uint32_t elapsed_ms = timer_get_systick() - start_tick;
+    
+    /* Reset vars */
+    memset(bench_key, 0, sizeof(bench_key));
+    memset((void*)&bench_ct_context, 0, sizeof(bench_ct_context));
+    #ifdef AES_CT64_BATCH_BACKEND
+    memset((void*)&bench_ct64_context, 0, sizeof(bench_ct64_context));
+    #endif
+    
+    /* Avoid division by 0 on very fast runs */
+    if (elapsed_ms == 0)
+    {
+        elapsed_ms = 1;
+    }
+    return (uint32_t)(((uint64_t)nb_kbytes * sizeof(bench_buffer) * 1000) / elapsed_ms);
+}
+
 
 /*! \fn     logic_encryption_sha256_init(void)
 *   \brief  Initialize sha256 object
@@ -33,12 +33,20 @@
 #define CTR_FLASH_MIN_INCR  32
 #define ECC256_SEED_LENGTH 8
 
+/* Enums */
+typedef enum {AES_CTR_BENCH_CT_PER_BLOB = 0, AES_CTR_BENCH_CT_BATCH = 1, AES_CTR_BENCH_CT64_BATCH = 2} aes_ctr_bench_mode_te;
+
 /* Prototypes */
+void logic_encryption_ctr_decrypt_batch(uint8_t* data, uint8_t* cred_ctrs, uint16_t blob_length, uint16_t nb_blobs, BOOL old_gen_decrypt);
+void logic_encryption_ctr_get_keystream(uint8_t* keystream, uint8_t* cred_ctr, uint16_t data_length, BOOL old_gen_decrypt);
 void logic_encryption_ctr_decrypt(uint8_t* data, uint8_t* cred_ctr, uint16_t data_length, BOOL old_gen_decrypt);
 void logic_encryption_add_vector_to_other(uint8_t* destination, uint8_t* source, uint16_t vector_length);
 void logic_encryption_xor_vector_to_other(uint8_t* destination, uint8_t* source, uint16_t vector_length);
+void logic_encryption_get_ctr_with_offset(uint8_t* destination, uint8_t* start_ctr, uint16_t nb_blocks);
 void logic_encryption_ctr_encrypt(uint8_t* data, uint16_t data_length, uint8_t* ctr_val_used);
+uint32_t logic_encryption_ctr_benchmark(aes_ctr_bench_mode_te bench_mode, uint16_t nb_kbytes);
 void logic_encryption_init_context(uint8_t* card_aes_key, cpz_lut_entry_t* cpz_user_entry);
+void logic_encryption_reserve_ctr_range(uint16_t nb_blocks, uint8_t* ctr_val_reserved);
 cpz_lut_entry_t* logic_encryption_get_cur_cpz_lut_entry(void);
 void logic_encryption_get_cpz_lut_entry(uint8_t* buffer);
 void logic_encryption_post_ctr_tasks(uint16_t ctr_inc);
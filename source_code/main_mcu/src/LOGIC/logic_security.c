@@ -21,14 +21,18 @@
 */
 #include <asf.h>
 #include "logic_bluetooth.h"
+#include "logic_database.h"
 #include "logic_security.h"
 #include "logic_aux_mcu.h"
+#include "nodemgmt.h"
 /* Inserted card unlocked */
 volatile BOOL logic_security_smartcard_inserted_unlocked = FALSE;
 /* Memory management mode */
 volatile BOOL logic_security_management_mode = FALSE;
 BOOL logic_security_management_usb_con_on_enter = FALSE;
 bt_state_te logic_security_management_ble_con_on_enter = FALSE;
+/* Service name searches approved by the user for this session */
+BOOL logic_security_service_search_approved = FALSE;
 
 
 /*! \fn     logic_security_clear_security_bools(void)
@@ -38,6 +42,9 @@ void logic_security_clear_security_bools(void)
 {
     logic_security_smartcard_inserted_unlocked = FALSE;
     logic_security_management_mode = FALSE;
+    logic_security_service_search_approved = FALSE;
+    logic_database_invalidate_webauthn_cred_id_index();
+    logic_database_invalidate_service_indexes();
     // TODO2
     /*
     context_valid_flag = FALSE;
@@ -78,6 +85,9 @@ BOOL logic_security_is_smc_inserted_unlocked(void)
 void logic_security_set_management_mode(void)
 {
     logic_security_management_mode = TRUE;
+    logic_database_invalidate_webauthn_cred_id_index();
+    logic_database_invalidate_service_indexes();
+    nodemgmt_invalidate_parent_summaries();
     logic_security_management_usb_con_on_enter = logic_aux_mcu_is_usb_enumerated();
     logic_security_management_ble_con_on_enter = logic_bluetooth_get_state();
 }
@@ -103,6 +113,9 @@ BOOL logic_security_should_leave_management_mode(void)
 void logic_security_clear_management_mode(void)
 {
     logic_security_management_mode = FALSE;
+    logic_database_invalidate_webauthn_cred_id_index();
+    logic_database_invalidate_service_indexes();
+    nodemgmt_invalidate_parent_summaries();
 }
 
 /*! \fn     logic_security_is_management_mode_set(void)
@@ -113,3 +126,20 @@ BOOL logic_security_is_management_mode_set(void)
 {
     return logic_security_management_mode;
 }
+
+/*! \fn     logic_security_set_service_search_approved(void)
+*   \brief  Remember that the user approved service name searches for this session
+*/
+void logic_security_set_service_search_approved(void)
+{
+    logic_security_service_search_approved = TRUE;
+}
+
+/*! \fn     logic_security_is_service_search_approved(void)
+*   \brief  Check if the user approved service name searches for this session
+*   \return The boolean
+*/
+BOOL logic_security_is_service_search_approved(void)
+{
+    return logic_security_service_search_approved;
+}
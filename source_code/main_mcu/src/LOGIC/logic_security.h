@@ -28,7 +28,9 @@
 
 /* Prototypes */
 BOOL logic_security_should_leave_management_mode(void);
+void logic_security_set_service_search_approved(void);
 void logic_security_smartcard_unlocked_actions(void);
+BOOL logic_security_is_service_search_approved(void);
 BOOL logic_security_is_smc_inserted_unlocked(void);
 BOOL logic_security_is_management_mode_set(void);
 void logic_security_clear_management_mode(void);
@@ -74,12 +74,18 @@ new_pinreturn_type_te logic_smartcard_ask_for_new_pin(volatile uint16_t* new_pin
 */
 void logic_smartcard_handle_removed(void)
 {
+    /* Delete the data of an unfinished file upload */
+    logic_user_cancel_file_upload();
+    
     /* Remove power and flags */
     platform_io_smc_remove_function();
     logic_security_clear_security_bools();
     
     /* Delete encryption context */
     logic_encryption_delete_context();
+    
+    /* Store database wear statistics, worn out user profile may be relocated as nobody is logged in */
+    nodemgmt_wear_stats_flush(TRUE);
 }
 
 /*! \fn     logic_smartcard_handle_inserted(void)
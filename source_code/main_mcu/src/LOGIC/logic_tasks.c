@@ -0,0 +1,84 @@
+/* 
+ * This file is part of the Mooltipass Project (https://github.com/mooltipass).
+ * Copyright (c) 2019 Stephan Mathieu
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!  \file     logic_tasks.c
+*    \brief    Background jobs run from the main loop
+*    Created:  19/10/2026
+*    Author:   Mathieu Stephan
+*    Tasks are only called from the main loop, not while a prompt or another wait loop is active
+*/
+#include "comms_aux_mcu.h"
+#include "driver_timer.h"
+#include "logic_device.h"
+#include "platform_io.h"
+#include "logic_tasks.h"
+#include "nodemgmt.h"
+#include "dbflash.h"
+/* Prototypes for our tasks */
+static void logic_tasks_device_status_update(void);
+static void logic_tasks_dbflash_wear_flush(void);
+static void logic_tasks_adc_watchdog(void);
+/* Tasks list, called in that order */
+const logic_task_t logic_tasks_list[NB_LOGIC_TASKS] = {
+    [TASK_DEVICE_STATUS_UPDATE] = logic_tasks_device_status_update,
+    [TASK_ADC_WATCHDOG] = logic_tasks_adc_watchdog,
+    [TASK_DBFLASH_WEAR_FLUSH] = logic_tasks_dbflash_wear_flush
+};
+
+
+/*! \fn     logic_tasks_device_status_update(void)
+*   \brief  Inform aux MCU of device state changes so it can update its buffer
+*/
+static void logic_tasks_device_status_update(void)
+{
+    if (logic_device_get_state_changed_and_reset_bool() != FALSE)
+    {
+        comms_aux_mcu_update_device_status_buffer();
+    }
+}
+
+/*! \fn     logic_tasks_adc_watchdog(void)
+*   \brief  Fetch battery voltage conversion result and trigger a new one
+*/
+static void logic_tasks_adc_watchdog(void)
+{
+    if (timer_has_timer_expired(TIMER_ADC_WATCHDOG, TRUE) == TIMER_EXPIRED)
+    {
+        platform_io_get_voledin_conversion_result_and_trigger_conversion();
+    }
+}
+
+/*! \fn     logic_tasks_dbflash_wear_flush(void)
+*   \brief  Flush database wear statistics once enough pages were programmed
+*/
+static void logic_tasks_dbflash_wear_flush(void)
+{
+    if (dbflash_wear_counters.nb_page_programs >= DBFLASH_WEAR_FLUSH_THRESHOLD)
+    {
+        nodemgmt_wear_stats_flush(FALSE);
+    }
+}
+
+/*! \fn     logic_tasks_run(void)
+*   \brief  Run our background tasks, to be called from the main loop
+*/
+void logic_tasks_run(void)
+{
+    for (uint16_t i = 0; i < NB_LOGIC_TASKS; i++)
+    {
+        logic_tasks_list[i]();
+    }
+}
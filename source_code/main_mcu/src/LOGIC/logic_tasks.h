@@ -0,0 +1,38 @@
+/* 
+ * This file is part of the Mooltipass Project (https://github.com/mooltipass).
+ * Copyright (c) 2019 Stephan Mathieu
+ * 
+ * This program is free software: you can redistribute it and/or modify  
+ * it under the terms of the GNU General Public License as published by  
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but 
+ * WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License 
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+/*!  \file     logic_tasks.h
+*    \brief    Background jobs run from the main loop
+*    Created:  19/10/2026
+*    Author:   Mathieu Stephan
+*/
+
+
+#ifndef LOGIC_TASKS_H_
+#define LOGIC_TASKS_H_
+
+#include "defines.h"
+
+/* Enums */
+typedef enum {TASK_DEVICE_STATUS_UPDATE = 0, TASK_ADC_WATCHDOG, TASK_DBFLASH_WEAR_FLUSH, NB_LOGIC_TASKS} logic_task_id_te;
+
+/* Typedefs */
+typedef void (*logic_task_t)(void);     // Task function, must return without waiting
+
+/* Prototypes */
+void logic_tasks_run(void);
+
+#endif /* LOGIC_TASKS_H_ */
@@ -50,6 +50,20 @@ BOOL logic_user_lock_unlock_shortcuts = FALSE;
 BOOL logic_user_adding_data_to_service_from_usb = FALSE;
 uint16_t logic_user_data_service_addr = NODE_ADDR_NULL;
 BOOL logic_user_adding_data_to_service = FALSE;
+// File upload state: plain text buffer for the node being filled, reserved child nodes & counters
+uint8_t logic_user_file_node_buffer[MEMBER_SIZE(child_data_node_t, data) + MEMBER_SIZE(child_data_node_t, data2)];
+uint16_t logic_user_file_reserved_nodes[FILE_NB_CHILD_NODES_RESERVED];
+uint8_t logic_user_file_start_ctr[MEMBER_SIZE(nodemgmt_profile_main_data_t, current_ctr)];
+uint16_t logic_user_file_nb_reserved_nodes = 0;
+uint16_t logic_user_file_reserved_node_idx = 0;
+uint16_t logic_user_file_node_buffer_fill = 0;
+uint16_t logic_user_file_cur_node_nb = 0;
+uint16_t logic_user_file_last_node_address = NODE_ADDR_NULL;
+// File download: data nodes decrypted together
+uint8_t logic_user_file_read_buffer[FILE_NB_READ_BATCH_NODES][MEMBER_SIZE(child_data_node_t, data) + MEMBER_SIZE(child_data_node_t, data2)];
+uint16_t logic_user_file_next_chunk_id = 0;
+uint32_t logic_user_file_bytes_received = 0;
+uint32_t logic_user_file_length = 0;
 // User security preferences
 uint16_t logic_user_cur_sec_preferences;
 
@@ -64,6 +78,9 @@ void logic_user_init_context(uint8_t user_id)
     uint16_t user_usb_layout;
     uint16_t user_ble_layout;
     
+    /* Previous user file upload can't be completed anymore */
+    logic_user_cancel_file_upload();
+    
     /* Initialize context and fetch user language & keyboard layout */
     nodemgmt_init_context(user_id, &logic_user_cur_sec_preferences, &user_language, &user_usb_layout, &user_ble_layout);
     custom_fs_set_current_language(utils_check_value_for_range(user_language, 0, custom_fs_get_number_of_languages()-1));
@@ -73,6 +90,10 @@ void logic_user_init_context(uint8_t user_id)
     /* Reset booleans */
     logic_user_data_service_addr = NODE_ADDR_NULL;
     logic_user_adding_data_to_service = FALSE;
+    
+    /* Credential ID & service indexes will be built on first use */
+    logic_database_invalidate_webauthn_cred_id_index();
+    logic_database_invalidate_service_indexes();
 }
 
 /*! \fn     logic_user_set_user_to_be_logged_off_flag(void)
@@ -111,6 +132,25 @@ BOOL logic_user_get_lock_unlock_shortcut_enabled(void)
     return logic_user_lock_unlock_shortcuts;
 }
 
+/*! \fn     logic_user_get_keyboard_typing_delay_field(void)
+*   \brief  Get the delay between key presses to send to the aux MCU, along with the typing flags
+*   \return The delay_between_types field for a keyboard type message
+*/
+static uint16_t logic_user_get_keyboard_typing_delay_field(void)
+{
+    uint16_t delay_between_types = custom_fs_settings_get_device_setting(SETTINGS_DELAY_BETWEEN_PRESSES);
+    
+    if ((BOOL)custom_fs_settings_get_device_setting(SETTINGS_ADAPTIVE_TYPING_DELAY) != FALSE)
+    {
+        delay_between_types |= KEYBOARD_TYPE_ADAPTIVE_DELAY_FLAG;
+    }
+    if ((BOOL)custom_fs_settings_get_device_setting(SETTINGS_KEYBOARD_ROLLOVER) != FALSE)
+    {
+        delay_between_types |= KEYBOARD_TYPE_ROLLOVER_FLAG;
+    }
+    return delay_between_types;
+}
+
 /*! \fn     logic_user_set_language(uint16_t language_id)
 *   \brief  Set language for current user
 *   \param  language_id User language ID
@@ -536,6 +576,9 @@ fido2_return_code_te logic_user_store_webauthn_credential(cust_char_t* rp_id, ui
 */
 RET_TYPE logic_user_add_data_service(cust_char_t* service, BOOL is_message_from_usb)
 {
+    /* A file upload in progress is replaced by this one */
+    logic_user_cancel_file_upload();
+    
     /* Reset booleans */
     logic_user_adding_data_to_service_from_usb = is_message_from_usb;
     logic_user_data_service_addr = NODE_ADDR_NULL;
@@ -580,11 +623,340 @@ RET_TYPE logic_user_add_data_service(cust_char_t* service, BOOL is_message_from_
         return RETURN_NOK;
     }
     
-    /* Set boolean */
+    /* Set boolean, reset upload state */
     logic_user_adding_data_to_service = TRUE;
+    logic_user_file_next_chunk_id = 0;
     
     /* Send success! */
-    return RETURN_NOK;
+    return RETURN_OK;
+}
+
+/*! \fn     logic_user_get_next_file_node_address(void)
+*   \brief  Get the address of the next child node to be used for the file being uploaded
+*   \return The node address or NODE_ADDR_NULL if memory is full
+*   \note   Child nodes are reserved by batches to limit the number of free node scans
+*/
+static uint16_t logic_user_get_next_file_node_address(void)
+{
+    /* Need to reserve a new batch of nodes? */
+    if (logic_user_file_reserved_node_idx >= logic_user_file_nb_reserved_nodes)
+    {
+        logic_user_file_nb_reserved_nodes = nodemgmt_reserve_free_child_nodes(ARRAY_SIZE(logic_user_file_reserved_nodes), logic_user_file_reserved_nodes);
+        logic_user_file_reserved_node_idx = 0;
+        
+        /* Memory full */
+        if (logic_user_file_nb_reserved_nodes == 0)
+        {
+            return NODE_ADDR_NULL;
+        }
+    }
+    
+    return logic_user_file_reserved_nodes[logic_user_file_reserved_node_idx++];
+}
+
+/*! \fn     logic_user_abort_file_upload(void)
+*   \brief  Abort the file upload in progress, deleting the data nodes already written to leave an empty file
+*   \note   The host may then restart the upload from its first chunk
+*/
+static void logic_user_abort_file_upload(void)
+{
+    parent_node_t temp_parent_node;
+    
+    /* Detach the data nodes from the parent */
+    nodemgmt_read_parent_node(logic_user_data_service_addr, &temp_parent_node, FALSE);
+    uint16_t first_node_address = temp_parent_node.data_parent.nextChildAddress;
+    temp_parent_node.data_parent.nextChildAddress = NODE_ADDR_NULL;
+    nodemgmt_write_parent_node_data_block_to_flash(logic_user_data_service_addr, &temp_parent_node);
+    memset(&temp_parent_node, 0, sizeof(temp_parent_node));
+    
+    /* Delete them, reserved nodes not written yet are freed as well */
+    nodemgmt_delete_data_nodes(first_node_address);
+    nodemgmt_user_db_changed_actions(TRUE);
+    
+    /* Reset upload state */
+    memset(logic_user_file_node_buffer, 0, sizeof(logic_user_file_node_buffer));
+    logic_user_file_nb_reserved_nodes = 0;
+    logic_user_file_reserved_node_idx = 0;
+    logic_user_file_node_buffer_fill = 0;
+    logic_user_file_last_node_address = NODE_ADDR_NULL;
+    logic_user_file_next_chunk_id = 0;
+}
+
+/*! \fn     logic_user_cancel_file_upload(void)
+*   \brief  Cancel the file upload in progress if any, deleting the data nodes already written
+*   \note   To be called when the upload can't be completed anymore: logout, new user context or new data service
+*/
+void logic_user_cancel_file_upload(void)
+{
+    if ((logic_user_adding_data_to_service != FALSE) && (logic_user_file_next_chunk_id != 0))
+    {
+        logic_user_abort_file_upload();
+    }
+    logic_user_adding_data_to_service = FALSE;
+}
+
+/*! \fn     logic_user_add_file_chunk(hid_message_file_chunk_t* file_chunk, BOOL is_message_from_usb)
+*   \brief  Add a chunk of data to the file service previously created by logic_user_add_data_service
+*   \param  file_chunk          Pointer to the file chunk, chunk length previously checked
+*   \param  is_message_from_usb BOOL set to true if the request comes from USB
+*   \return success or not
+*   \note   Data is encrypted and written one 512B data node at a time, the CTR range for the complete file being reserved on the first chunk
+*   \note   Failures after the first chunk was accepted leave an empty file, see logic_user_abort_file_upload
+*/
+RET_TYPE logic_user_add_file_chunk(hid_message_file_chunk_t* file_chunk, BOOL is_message_from_usb)
+{
+    /* Are we adding data to a service, from the same interface, and is it the chunk we expect? */
+    if ((logic_user_adding_data_to_service == FALSE) || (logic_user_adding_data_to_service_from_usb != is_message_from_usb) || (file_chunk->chunk_id != logic_user_file_next_chunk_id) || (logic_security_is_smc_inserted_unlocked() == FALSE))
+    {
+        return RETURN_NOK;
+    }
+    
+    /* First chunk: reserve CTR range & first node, store the CTR inside the parent node (data nodes are linked once written) */
+    if (file_chunk->chunk_id == 0)
+    {
+        uint32_t nb_data_nodes = (file_chunk->file_length + sizeof(logic_user_file_node_buffer) - 1) / sizeof(logic_user_file_node_buffer);
+        parent_node_t temp_parent_node;
+        
+        /* Check for valid file length */
+        if ((nb_data_nodes == 0) || (nb_data_nodes > FILE_MAX_NB_DATA_NODES))
+        {
+            logic_user_adding_data_to_service = FALSE;
+            return RETURN_NOK;
+        }
+        
+        /* Reset upload state */
+        logic_user_file_length = file_chunk->file_length;
+        logic_user_file_nb_reserved_nodes = 0;
+        logic_user_file_reserved_node_idx = 0;
+        logic_user_file_node_buffer_fill = 0;
+        logic_user_file_bytes_received = 0;
+        logic_user_file_cur_node_nb = 0;
+        logic_user_file_last_node_address = NODE_ADDR_NULL;
+        
+        /* Reserve first node */
+        uint16_t first_node_address = logic_user_get_next_file_node_address();
+        if (first_node_address == NODE_ADDR_NULL)
+        {
+            logic_user_abort_file_upload();
+            return RETURN_NOK;
+        }
+        
+        /* Reserve CTR values for the complete file */
+        logic_encryption_reserve_ctr_range((uint16_t)nb_data_nodes * (sizeof(logic_user_file_node_buffer)/(AES_BLOCK_SIZE/8)), logic_user_file_start_ctr);
+        
+        /* Update parent node */
+        nodemgmt_read_parent_node(logic_user_data_service_addr, &temp_parent_node, FALSE);
+        temp_parent_node.data_parent.nextChildAddress = NODE_ADDR_NULL;
+        memcpy(temp_parent_node.data_parent.startDataCtr, logic_user_file_start_ctr, sizeof(temp_parent_node.data_parent.startDataCtr));
+        nodemgmt_write_parent_node_data_block_to_flash(logic_user_data_service_addr, &temp_parent_node);
+        
+        /* Node buffer starts empty */
+        memset(logic_user_file_node_buffer, 0, sizeof(logic_user_file_node_buffer));
+    }
+    
+    /* Check that we're not receiving more than announced */
+    if ((logic_user_file_bytes_received + file_chunk->chunk_length) > logic_user_file_length)
+    {
+        logic_user_abort_file_upload();
+        return RETURN_NOK;
+    }
+    
+    /* Fill node buffers, writing them to flash when full or when the file is complete */
+    uint16_t nb_bytes_processed = 0;
+    while (nb_bytes_processed < file_chunk->chunk_length)
+    {
+        uint16_t nb_bytes_to_copy = utils_check_value_for_range(file_chunk->chunk_length - nb_bytes_processed, 0, sizeof(logic_user_file_node_buffer) - logic_user_file_node_buffer_fill);
+        memcpy(&logic_user_file_node_buffer[logic_user_file_node_buffer_fill], &file_chunk->data[nb_bytes_processed], nb_bytes_to_copy);
+        logic_user_file_bytes_received += nb_bytes_to_copy;
+        logic_user_file_node_buffer_fill += nb_bytes_to_copy;
+        nb_bytes_processed += nb_bytes_to_copy;
+        
+        /* Node full or last one? */
+        if ((logic_user_file_node_buffer_fill == sizeof(logic_user_file_node_buffer)) || (logic_user_file_bytes_received == logic_user_file_length))
+        {
+            uint8_t node_ctr[MEMBER_SIZE(nodemgmt_profile_main_data_t, current_ctr)];
+            uint16_t cur_node_address = logic_user_file_reserved_nodes[logic_user_file_reserved_node_idx-1];
+            uint16_t next_node_address = NODE_ADDR_NULL;
+            child_node_t temp_child_node;
+            
+            /* Not the last node: get next node address */
+            if (logic_user_file_bytes_received != logic_user_file_length)
+            {
+                next_node_address = logic_user_get_next_file_node_address();
+            }
+            
+            /* Encrypt node contents: CTR mode encryption & decryption are the same operation */
+            logic_encryption_get_ctr_with_offset(node_ctr, logic_user_file_start_ctr, logic_user_file_cur_node_nb * (sizeof(logic_user_file_node_buffer)/(AES_BLOCK_SIZE/8)));
+            logic_encryption_ctr_decrypt(logic_user_file_node_buffer, node_ctr, sizeof(logic_user_file_node_buffer), FALSE);
+            
+            /* Prepare node & store it */
+            memset(&temp_child_node, 0, sizeof(temp_child_node));
+            temp_child_node.data_child.data_length = logic_user_file_node_buffer_fill;
+            memcpy(temp_child_node.data_child.data, logic_user_file_node_buffer, sizeof(temp_child_node.data_child.data));
+            memcpy(temp_child_node.data_child.data2, &logic_user_file_node_buffer[sizeof(temp_child_node.data_child.data)], sizeof(temp_child_node.data_child.data2));
+            nodemgmt_store_data_node(logic_user_data_service_addr, logic_user_file_last_node_address, cur_node_address, &temp_child_node.data_child);
+            logic_user_file_last_node_address = cur_node_address;
+            
+            /* Clear buffers */
+            memset(logic_user_file_node_buffer, 0, sizeof(logic_user_file_node_buffer));
+            memset(&temp_child_node, 0, sizeof(temp_child_node));
+            logic_user_file_node_buffer_fill = 0;
+            logic_user_file_cur_node_nb++;
+            
+            /* Memory full: delete what was written */
+            if ((logic_user_file_bytes_received != logic_user_file_length) && (next_node_address == NODE_ADDR_NULL))
+            {
+                logic_user_abort_file_upload();
+                return RETURN_NOK;
+            }
+        }
+    }
+    
+    /* Set next expected chunk */
+    logic_user_file_next_chunk_id++;
+    
+    /* File complete? */
+    if (logic_user_file_bytes_received == logic_user_file_length)
+    {
+        /* The last chunk flag must be set on the last chunk */
+        if (file_chunk->last_chunk_flag == FALSE)
+        {
+            logic_user_abort_file_upload();
+            return RETURN_NOK;
+        }
+        
+        logic_user_adding_data_to_service = FALSE;
+        nodemgmt_user_db_changed_actions(TRUE);
+    }
+    else if (file_chunk->last_chunk_flag != FALSE)
+    {
+        /* Host announced a longer file */
+        logic_user_abort_file_upload();
+        return RETURN_NOK;
+    }
+    
+    return RETURN_OK;
+}
+
+/*! \fn     logic_user_stream_file(cust_char_t* service, hid_message_t* send_msg, BOOL is_message_from_usb)
+*   \brief  Send the contents of a file service, one data node per HID packet
+*   \param  service             Pointer to service string
+*   \param  send_msg            Pointer to where to store our answer
+*   \param  is_message_from_usb BOOL set to true if the request comes from USB
+*   \return payload size of the last packet or -1 if error
+*   \note   All packets but the last one are directly sent to the aux MCU, the last one is returned to the HID parser
+*/
+int16_t logic_user_stream_file(cust_char_t* service, hid_message_t* send_msg, BOOL is_message_from_usb)
+{
+    uint8_t node_ctr[MEMBER_SIZE(nodemgmt_profile_main_data_t, current_ctr)];
+    uint8_t batch_ctrs[FILE_NB_READ_BATCH_NODES][MEMBER_SIZE(nodemgmt_profile_main_data_t, current_ctr)];
+    uint16_t batch_lengths[FILE_NB_READ_BATCH_NODES];
+    child_node_t temp_child_node;
+    parent_node_t temp_parent_node;
+    uint16_t chunk_id = 0;
+    
+    /* Copy service locally as the receive buffer may be overwritten */
+    cust_char_t service_copy[MEMBER_ARRAY_SIZE(parent_data_node_t, service)];
+    utils_strncpy(service_copy, service, MEMBER_ARRAY_SIZE(parent_data_node_t, service));
+    service_copy[MEMBER_ARRAY_SIZE(parent_data_node_t, service)-1] = 0;
+    service = service_copy;
+    
+    /* Smartcard present and unlocked? */
+    if (logic_security_is_smc_inserted_unlocked() == FALSE)
+    {
+        return -1;
+    }
+    
+    /* Does service exist? */
+    uint16_t parent_address = logic_database_search_service(service, COMPARE_MODE_MATCH, FALSE, NODEMGMT_STANDARD_DATA_TYPE_ID);
+    
+    /* Service doesn't exist, deny request with a variable timeout for privacy concerns */
+    if (parent_address == NODE_ADDR_NULL)
+    {
+        /* From 1s to 3s */
+        timer_delay_ms(1000 + (rng_get_random_uint16_t()&0x07FF));
+        return -1;
+    }
+    
+    /* Prepare prompt text */
+    cust_char_t* two_line_prompt_2;
+    custom_fs_get_string_from_file(SEND_CREDS_FOR_TEXT_ID, &two_line_prompt_2, TRUE);
+    confirmationText_t conf_text_2_lines = {.lines[0]=service, .lines[1]=two_line_prompt_2};
+    
+    /* Request user approval */
+    mini_input_yes_no_ret_te prompt_return = gui_prompts_ask_for_confirmation(2, &conf_text_2_lines, TRUE, TRUE, TRUE);
+    gui_dispatcher_get_back_to_current_screen();
+    
+    /* Did the user approve? */
+    if (prompt_return != MINI_INPUT_RET_YES)
+    {
+        return -1;
+    }
+    
+    /* Fetch first data node address and CTR */
+    nodemgmt_read_parent_node(parent_address, &temp_parent_node, FALSE);
+    uint16_t data_node_address = temp_parent_node.data_parent.nextChildAddress;
+    memcpy(node_ctr, temp_parent_node.data_parent.startDataCtr, sizeof(node_ctr));
+    
+    /* Empty file */
+    if (data_node_address == NODE_ADDR_NULL)
+    {
+        return -1;
+    }
+    
+    /* Send data nodes, decrypted in batches */
+    while (data_node_address != NODE_ADDR_NULL)
+    {
+        uint16_t nb_batch_nodes = 0;
+        
+        /* Read the next nodes along the chain, their CTR values following each other */
+        while ((data_node_address != NODE_ADDR_NULL) && (nb_batch_nodes < FILE_NB_READ_BATCH_NODES))
+        {
+            if (nodemgmt_read_data_node(data_node_address, &temp_child_node.data_child) != RETURN_OK)
+            {
+                memset(&temp_child_node, 0, sizeof(temp_child_node));
+                memset(logic_user_file_read_buffer, 0, sizeof(logic_user_file_read_buffer));
+                return -1;
+            }
+            
+            memcpy(logic_user_file_read_buffer[nb_batch_nodes], temp_child_node.data_child.data, sizeof(temp_child_node.data_child.data));
+            memcpy(&logic_user_file_read_buffer[nb_batch_nodes][sizeof(temp_child_node.data_child.data)], temp_child_node.data_child.data2, sizeof(temp_child_node.data_child.data2));
+            batch_lengths[nb_batch_nodes] = temp_child_node.data_child.data_length;
+            memcpy(batch_ctrs[nb_batch_nodes], node_ctr, sizeof(node_ctr));
+            logic_encryption_get_ctr_with_offset(node_ctr, node_ctr, sizeof(logic_user_file_read_buffer[0])/(AES_BLOCK_SIZE/8));
+            data_node_address = temp_child_node.data_child.nextDataAddress;
+            memset(&temp_child_node, 0, sizeof(temp_child_node));
+            nb_batch_nodes++;
+        }
+        
+        /* Single keystream run for the whole batch */
+        _Static_assert(MEMBER_SIZE(hid_message_file_chunk_t, data) == sizeof(logic_user_file_read_buffer[0]), "File chunk doesn't match a data node");
+        logic_encryption_ctr_decrypt_batch((uint8_t*)logic_user_file_read_buffer, (uint8_t*)batch_ctrs, sizeof(logic_user_file_read_buffer[0]), nb_batch_nodes, FALSE);
+        
+        for (uint16_t i = 0; i < nb_batch_nodes; i++)
+        {
+            /* Fill answer */
+            memset(&send_msg->file_chunk, 0, sizeof(send_msg->file_chunk));
+            memcpy(send_msg->file_chunk.data, logic_user_file_read_buffer[i], sizeof(send_msg->file_chunk.data));
+            memset(logic_user_file_read_buffer[i], 0, sizeof(logic_user_file_read_buffer[0]));
+            send_msg->file_chunk.chunk_id = chunk_id++;
+            send_msg->file_chunk.chunk_length = batch_lengths[i];
+            send_msg->file_chunk.last_chunk_flag = ((i == nb_batch_nodes-1) && (data_node_address == NODE_ADDR_NULL))?TRUE:FALSE;
+            send_msg->message_type = HID_CMD_GET_FILE_DATA_ID;
+            send_msg->payload_length = sizeof(send_msg->file_chunk) - sizeof(send_msg->file_chunk.data) + send_msg->file_chunk.chunk_length;
+            
+            /* Not the last chunk: send it right away */
+            if (send_msg->file_chunk.last_chunk_flag == FALSE)
+            {
+                comms_aux_mcu_send_streamed_hid_message(is_message_from_usb);
+            }
+        }
+    }
+    
+    /* Let the aux MCU forward the previous packet before our final answer is sent */
+    comms_aux_mcu_wait_for_streamed_hid_message_forwarded(is_message_from_usb);
+    
+    return send_msg->payload_length;
 }
 
 /*! \fn     logic_user_store_credential(cust_char_t* service, cust_char_t* login, cust_char_t* desc, cust_char_t* third, cust_char_t* password)
@@ -914,9 +1286,19 @@ int16_t logic_user_usb_get_credential(cust_char_t* service, cust_char_t* login,
             logic_database_get_login_for_address(child_address, &login);
         }
         
+        /* Credential node & password keystream fetched while the user is prompted */
+        uint8_t pwd_keystream[MEMBER_SIZE(child_cred_node_t, password)];
+        BOOL credential_prefetched = FALSE;
+        child_cred_node_t prefetched_cnode;
+        
         /* If user specified to be prompted for login confirmation */
         if ((logic_user_get_user_security_flags() & USER_SEC_FLG_LOGIN_CONF) != 0)
         {
+            /* Read the still encrypted credential and compute the password keystream: only the XOR is left for after user approval */
+            nodemgmt_read_cred_child_node_no_date_update(child_address, &prefetched_cnode);
+            logic_encryption_ctr_get_keystream(pwd_keystream, prefetched_cnode.ctr, sizeof(pwd_keystream), ((prefetched_cnode.flags & NODEMGMT_PREVGEN_BIT_BITMASK) != 0)?TRUE:FALSE);
+            credential_prefetched = TRUE;
+            
             /* Prepare prompt message */
             cust_char_t* three_line_prompt_2;
             custom_fs_get_string_from_file(SEND_CREDS_FOR_TEXT_ID, &three_line_prompt_2, TRUE);
@@ -930,8 +1312,13 @@ int16_t logic_user_usb_get_credential(cust_char_t* service, cust_char_t* login,
             if (prompt_return != MINI_INPUT_RET_YES)
             {
                 memset(send_msg->payload, 0, sizeof(send_msg->payload));
+                memset(&prefetched_cnode, 0, sizeof(prefetched_cnode));
+                memset(pwd_keystream, 0, sizeof(pwd_keystream));
                 return -1;
             }
+            
+            /* Credential used: update its last used date */
+            nodemgmt_update_cred_child_node_date_last_used(child_address);
         }
         else
         {
@@ -954,8 +1341,16 @@ int16_t logic_user_usb_get_credential(cust_char_t* service, cust_char_t* login,
             gui_dispatcher_set_current_screen(GUI_SCREEN_LOGIN_NOTIF, FALSE, GUI_INTO_MENU_TRANSITION);
         }
         
-        /* Get prefilled message */
-        uint16_t return_payload_size_without_pwd = logic_database_fill_get_cred_message_answer(child_address, send_msg, temp_cred_ctr, &prev_gen_credential_flag, &password_valid_flag);
+        /* Get prefilled message (message buffer may have been used while prompting the user) */
+        uint16_t return_payload_size_without_pwd;
+        if (credential_prefetched != FALSE)
+        {
+            return_payload_size_without_pwd = logic_database_fill_get_cred_message_answer_from_node(&prefetched_cnode, send_msg, temp_cred_ctr, &prev_gen_credential_flag, &password_valid_flag);
+        }
+        else
+        {
+            return_payload_size_without_pwd = logic_database_fill_get_cred_message_answer(child_address, send_msg, temp_cred_ctr, &prev_gen_credential_flag, &password_valid_flag);
+        }
         
         /* Password valid? */
         if (password_valid_flag == FALSE)
@@ -966,7 +1361,14 @@ int16_t logic_user_usb_get_credential(cust_char_t* service, cust_char_t* login,
         else
         {
             /* User approved, decrypt password */
-            logic_encryption_ctr_decrypt((uint8_t*)&(send_msg->get_credential_answer.concatenated_strings[send_msg->get_credential_answer.password_index]), temp_cred_ctr, MEMBER_SIZE(child_cred_node_t, password), prev_gen_credential_flag);
+            if (credential_prefetched != FALSE)
+            {
+                logic_encryption_xor_vector_to_other((uint8_t*)&(send_msg->get_credential_answer.concatenated_strings[send_msg->get_credential_answer.password_index]), pwd_keystream, sizeof(pwd_keystream));
+            }
+            else
+            {
+                logic_encryption_ctr_decrypt((uint8_t*)&(send_msg->get_credential_answer.concatenated_strings[send_msg->get_credential_answer.password_index]), temp_cred_ctr, MEMBER_SIZE(child_cred_node_t, password), prev_gen_credential_flag);
+            }
             
             /* If old generation password, convert it to unicode */
             if (prev_gen_credential_flag != FALSE)
@@ -980,6 +1382,10 @@ int16_t logic_user_usb_get_credential(cust_char_t* service, cust_char_t* login,
             pwd_length = utils_strlen(&(send_msg->get_credential_answer.concatenated_strings[send_msg->get_credential_answer.password_index]));
         }        
         
+        /* Clear prefetched data */
+        memset(&prefetched_cnode, 0, sizeof(prefetched_cnode));
+        memset(pwd_keystream, 0, sizeof(pwd_keystream));
+        
         /* Compute payload size */
         uint16_t return_payload_size = return_payload_size_without_pwd + (pwd_length + 1)*sizeof(cust_char_t);
         
@@ -1367,7 +1773,7 @@ RET_TYPE logic_user_ask_for_credentials_keyb_output(uint16_t parent_address, uin
                             typing_message_to_be_sent->keyboard_type_message.keyboard_symbols[utils_strlen(temp_cnode.login)] = temp_cnode.keyAfterLogin;
                         }
                         custom_fs_get_keyboard_symbols_for_unicode_string(&typing_message_to_be_sent->keyboard_type_message.keyboard_symbols[utils_strlen(temp_cnode.login)], &typing_message_to_be_sent->keyboard_type_message.keyboard_symbols[utils_strlen(temp_cnode.login)], *usb_selected);
-                        typing_message_to_be_sent->keyboard_type_message.delay_between_types = custom_fs_settings_get_device_setting(SETTINGS_DELAY_BETWEEN_PRESSES);
+                        typing_message_to_be_sent->keyboard_type_message.delay_between_types = logic_user_get_keyboard_typing_delay_field();
                         typing_message_to_be_sent->keyboard_type_message.interface_identifier = interface_id;
                         comms_aux_mcu_send_message(TRUE);
                         
@@ -1495,7 +1901,7 @@ RET_TYPE logic_user_ask_for_credentials_keyb_output(uint16_t parent_address, uin
                         typing_message_to_be_sent->keyboard_type_message.keyboard_symbols[utils_strlen(temp_cnode.cust_char_password)] = temp_cnode.keyAfterPassword;
                     }
                     custom_fs_get_keyboard_symbols_for_unicode_string(&typing_message_to_be_sent->keyboard_type_message.keyboard_symbols[utils_strlen(temp_cnode.cust_char_password)], &typing_message_to_be_sent->keyboard_type_message.keyboard_symbols[utils_strlen(temp_cnode.cust_char_password)], *usb_selected);
-                    typing_message_to_be_sent->keyboard_type_message.delay_between_types = custom_fs_settings_get_device_setting(SETTINGS_DELAY_BETWEEN_PRESSES);
+                    typing_message_to_be_sent->keyboard_type_message.delay_between_types = logic_user_get_keyboard_typing_delay_field();
                     typing_message_to_be_sent->keyboard_type_message.interface_identifier = interface_id;
                     comms_aux_mcu_send_message(TRUE);
                     
@@ -30,7 +30,10 @@
 #include "defines.h"
 
 /* Defines */
-#define CHECK_PASSWORD_TIMER_VAL    4000
+#define CHECK_PASSWORD_TIMER_VAL        4000
+#define FILE_NB_CHILD_NODES_RESERVED    8
+#define FILE_NB_READ_BATCH_NODES        4       // Data nodes decrypted in a single keystream run when streaming a file, 512B of static RAM each
+#define FILE_MAX_NB_DATA_NODES          2047
 
 /* Prototypes */
 fido2_return_code_te logic_user_get_webauthn_credential_key_for_rp(cust_char_t* rp_id, uint8_t* user_handle, uint8_t *user_handle_len, uint8_t* credential_id, uint8_t* private_key, uint32_t* count, uint8_t credential_id_allow_list[FIDO2_ALLOW_LIST_MAX_SIZE][FIDO2_CREDENTIAL_ID_LENGTH], uint16_t credential_id_allow_list_length);
@@ -40,7 +43,9 @@ RET_TYPE logic_user_ask_for_credentials_keyb_output(uint16_t parent_address, uin
 RET_TYPE logic_user_store_credential(cust_char_t* service, cust_char_t* login, cust_char_t* desc, cust_char_t* third, cust_char_t* password);
 ret_type_te logic_user_create_new_user(volatile uint16_t* pin_code, uint8_t* provisioned_key, BOOL simple_mode);
 int16_t logic_user_usb_get_credential(cust_char_t* service, cust_char_t* login, hid_message_t* send_msg);
+int16_t logic_user_stream_file(cust_char_t* service, hid_message_t* send_msg, BOOL is_message_from_usb);
 RET_TYPE logic_user_check_credential(cust_char_t* service, cust_char_t* login, cust_char_t* password);
+RET_TYPE logic_user_add_file_chunk(hid_message_file_chunk_t* file_chunk, BOOL is_message_from_usb);
 RET_TYPE logic_user_add_data_service(cust_char_t* service, BOOL is_message_from_usb);
 void logic_user_set_layout_id(uint16_t layout_id, BOOL usb_layout);
 BOOL logic_user_get_and_clear_user_to_be_logged_off_flag(void);
@@ -56,5 +61,6 @@ void logic_user_init_context(uint8_t user_id);
 void logic_user_locked_feature_trigger(void);
 uint8_t logic_user_get_current_user_id(void);
 void logic_user_manual_select_login(void);
+void logic_user_cancel_file_upload(void);
 
 #endif /* LOGIC_USER_H_ */
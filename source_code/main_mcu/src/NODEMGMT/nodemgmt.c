@@ -36,6 +36,15 @@
 nodemgmtHandle_t nodemgmt_current_handle;
 // Current date
 uint16_t nodemgmt_current_date;
+// Per parent children summaries
+nodemgmt_parent_summary_t nodemgmt_parent_summaries[NODEMGMT_PARENT_SUMMARY_CACHE_SIZE];
+// Parent node read-ahead: buffer filled by DMA, its address and the number of flash writes when it was started
+parent_node_t nodemgmt_read_ahead_node;
+uint16_t nodemgmt_read_ahead_addr = NODE_ADDR_NULL;
+uint32_t nodemgmt_read_ahead_nb_writes;
+// Parent node read-ahead: node whose read triggers the next read-ahead, and in which direction
+uint16_t nodemgmt_read_ahead_trigger_addr = NODE_ADDR_NULL;
+BOOL nodemgmt_read_ahead_forward = TRUE;
 
 
 /*! \fn     nodemgmt_set_current_date(uint16_t date)
@@ -257,12 +266,96 @@ void nodemgmt_write_child_node_block_to_flash(uint16_t address, child_node_t* ch
         nodemgmt_categoryflags_to_flags(&(child_node->cred_child.flags), nodemgmt_current_handle.currentCategoryFlags);
         nodemgmt_categoryflags_to_flags(&(child_node->cred_child.fakeFlags), nodemgmt_current_handle.currentCategoryFlags);
     }
+    else
+    {
+        /* Existing child update: parent is unknown, only drop the children summaries if the flags (category) or chain links changed */
+        _Static_assert(0 == offsetof(child_cred_node_t, flags), "Incorrect buffer for flags & addr read");
+        _Static_assert(2 == offsetof(child_cred_node_t, prevChildAddress), "Incorrect buffer for flags & addr read");
+        _Static_assert(4 == offsetof(child_cred_node_t, nextChildAddress), "Incorrect buffer for flags & addr read");
+        uint16_t stored_flags_and_addrs[3];
+        dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(address), BASE_NODE_SIZE * nodemgmt_node_from_address(address), sizeof(stored_flags_and_addrs), (void*)stored_flags_and_addrs);
+        if ((stored_flags_and_addrs[0] != child_node->cred_child.flags) || (stored_flags_and_addrs[1] != child_node->cred_child.prevChildAddress) || (stored_flags_and_addrs[2] != child_node->cred_child.nextChildAddress))
+        {
+            nodemgmt_invalidate_parent_summaries();
+        }
+    }
     
     /* Write to flash */
     dbflash_write_data_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(address), BASE_NODE_SIZE * nodemgmt_node_from_address(address), BASE_NODE_SIZE, (void*)child_node->node_as_bytes);
     dbflash_write_data_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(nodemgmt_get_incremented_address(address)), BASE_NODE_SIZE * nodemgmt_node_from_address(nodemgmt_get_incremented_address(address)), BASE_NODE_SIZE, (void*)(&child_node->node_as_bytes[BASE_NODE_SIZE]));
 }
 
+/*! \fn     nodemgmt_invalidate_read_ahead(void)
+*   \brief  Discard the parent node read-ahead
+*/
+static void nodemgmt_invalidate_read_ahead(void)
+{
+    nodemgmt_read_ahead_trigger_addr = NODE_ADDR_NULL;
+    nodemgmt_read_ahead_addr = NODE_ADDR_NULL;
+}
+
+/*! \fn     nodemgmt_get_read_ahead_data(uint16_t address, uint16_t nb_bytes, void* data)
+*   \brief  Get the first bytes of a parent node from the read-ahead buffer if it holds it
+*   \param  address     Parent node address
+*   \param  nb_bytes    Number of bytes to copy
+*   \param  data        Where to store them
+*   \return TRUE if the data was copied, FALSE if it needs to be read from flash
+*   \note   Any page program or erase since the read-ahead was started discards it
+*/
+static BOOL nodemgmt_get_read_ahead_data(uint16_t address, uint16_t nb_bytes, void* data)
+{
+    if ((address == NODE_ADDR_NULL) || (address != nodemgmt_read_ahead_addr))
+    {
+        return FALSE;
+    }
+    
+    /* Flash written in the meantime? */
+    if (nodemgmt_read_ahead_nb_writes != dbflash_wear_counters.nb_page_programs + dbflash_wear_counters.nb_page_erases)
+    {
+        nodemgmt_invalidate_read_ahead();
+        return FALSE;
+    }
+    
+    dbflash_wait_for_async_read_end(&dbflash_descriptor);
+    memcpy(data, (void*)nodemgmt_read_ahead_node.node_as_bytes, nb_bytes);
+    return TRUE;
+}
+
+/*! \fn     nodemgmt_start_read_ahead(parent_node_t* parent_node)
+*   \brief  Start fetching the parent node next to the one given, in the learnt traversal direction
+*   \param  parent_node Parent node that was just read
+*   \note   The DMA transfer runs while the caller renders the current node
+*/
+static void nodemgmt_start_read_ahead(parent_node_t* parent_node)
+{
+    uint16_t read_ahead_addr = (nodemgmt_read_ahead_forward != FALSE)? parent_node->cred_parent.nextParentAddress : parent_node->cred_parent.prevParentAddress;
+    uint32_t nb_writes = dbflash_wear_counters.nb_page_programs + dbflash_wear_counters.nb_page_erases;
+    nodemgmt_read_ahead_trigger_addr = NODE_ADDR_NULL;
+    
+    /* Nothing to fetch or already fetched */
+    if ((read_ahead_addr == NODE_ADDR_NULL) || ((read_ahead_addr == nodemgmt_read_ahead_addr) && (nb_writes == nodemgmt_read_ahead_nb_writes)))
+    {
+        return;
+    }
+    
+    nodemgmt_read_ahead_addr = read_ahead_addr;
+    nodemgmt_read_ahead_nb_writes = nb_writes;
+    dbflash_start_async_read(&dbflash_descriptor, nodemgmt_page_from_address(read_ahead_addr), BASE_NODE_SIZE * nodemgmt_node_from_address(read_ahead_addr), sizeof(nodemgmt_read_ahead_node.node_as_bytes), (void*)nodemgmt_read_ahead_node.node_as_bytes);
+}
+
+/*! \fn     nodemgmt_read_parent_header(uint16_t address, uint16_t* header)
+*   \brief  Read the flags and prev / next / first child addresses of a parent node
+*   \param  address     Parent node address
+*   \param  header      4 uint16_t buffer to store them
+*/
+static void nodemgmt_read_parent_header(uint16_t address, uint16_t* header)
+{
+    if (nodemgmt_get_read_ahead_data(address, 4*sizeof(uint16_t), (void*)header) == FALSE)
+    {
+        dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(address), BASE_NODE_SIZE*nodemgmt_node_from_address(address), 4*sizeof(uint16_t), (void*)header);
+    }
+}
+
 /*! \fn     nodemgmt_read_parent_node_data_block_from_flash(uint16_t address, parent_node_t* parent_node)
 *   \brief  Read a parent node data block to flash
 *   \param  address     Where to read
@@ -282,9 +375,18 @@ void nodemgmt_read_parent_node_data_block_from_flash(uint16_t address, parent_no
 */
 void nodemgmt_read_parent_node(uint16_t address, parent_node_t* parent_node, BOOL data_clean)
 {
-    nodemgmt_read_parent_node_data_block_from_flash(address, parent_node);
+    if (nodemgmt_get_read_ahead_data(address, sizeof(parent_node->node_as_bytes), (void*)parent_node->node_as_bytes) == FALSE)
+    {
+        nodemgmt_read_parent_node_data_block_from_flash(address, parent_node);
+    }
     nodemgmt_check_user_perm_from_flags_and_lock(parent_node->cred_parent.flags);
     
+    /* List browsing: fetch the following node while this one is rendered */
+    if (address == nodemgmt_read_ahead_trigger_addr)
+    {
+        nodemgmt_start_read_ahead(parent_node);
+    }
+    
     if (data_clean != FALSE)
     {
         parent_node->cred_parent.service[(sizeof(parent_node->cred_parent.service)/sizeof(parent_node->cred_parent.service[0]))-1] = 0;
@@ -301,6 +403,39 @@ void nodemgmt_read_child_node_data_block_from_flash(uint16_t address, child_node
     dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(address), BASE_NODE_SIZE * nodemgmt_node_from_address(address), sizeof(child_node->node_as_bytes), (void*)child_node->node_as_bytes);
 }
 
+/*! \fn     nodemgmt_read_node_bytes(uint16_t address, uint16_t node_offset, uint16_t nb_bytes, void* node)
+*   \brief  Read a byte range of a node in a single flash burst, then check user permission
+*   \param  address     Node address
+*   \param  node_offset Offset of the first byte to read inside the node
+*   \param  nb_bytes    Number of bytes to read
+*   \param  node        Pointer to the node buffer, bytes are stored at the same offset inside it
+*   \note   Use through the nodemgmt_read_node_fields() macro. Flags are read separately when not part of the range
+*/
+void nodemgmt_read_node_bytes(uint16_t address, uint16_t node_offset, uint16_t nb_bytes, void* node)
+{
+    uint16_t flags;
+    
+    /* No debug... no reason it should get stuck here as all callers use struct offsets */
+    if (node_offset + nb_bytes > sizeof(child_node_t))
+    {
+        while(1);
+    }
+    
+    /* Child nodes are contiguous in flash, second half included */
+    dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(address), BASE_NODE_SIZE * nodemgmt_node_from_address(address) + node_offset, nb_bytes, (uint8_t*)node + node_offset);
+    
+    /* Permission check */
+    if (node_offset == 0)
+    {
+        flags = *(uint16_t*)node;
+    }
+    else
+    {
+        dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(address), BASE_NODE_SIZE * nodemgmt_node_from_address(address), sizeof(flags), (void*)&flags);
+    }
+    nodemgmt_check_user_perm_from_flags_and_lock(flags);
+}
+
 /*! \fn     nodemgmt_read_cred_child_node(uint16_t address, child_cred_node_t* child_node)
 *   \brief  Read a child node
 *   \param  address     Where to read
@@ -327,6 +462,49 @@ void nodemgmt_read_cred_child_node(uint16_t address, child_cred_node_t* child_no
     child_node->description[(sizeof(child_node->description)/sizeof(child_node->description[0]))-1] = 0;
 }
 
+/*! \fn     nodemgmt_read_cred_child_node_no_date_update(uint16_t address, child_cred_node_t* child_node)
+*   \brief  Read a child node without updating its last used date
+*   \param  address     Where to read
+*   \param  child_node  Pointer to the node
+*   \note   For reads done before user approval, date is then updated by nodemgmt_update_cred_child_node_date_last_used()
+*/
+void nodemgmt_read_cred_child_node_no_date_update(uint16_t address, child_cred_node_t* child_node)
+{
+    nodemgmt_read_child_node_data_block_from_flash(address, (child_node_t*)child_node);
+    nodemgmt_check_user_perm_from_flags_and_lock(child_node->flags);
+    
+    // String cleaning
+    child_node->pwdTerminatingZero = 0;
+    child_node->login[(sizeof(child_node->login)/sizeof(child_node->login[0]))-1] = 0;
+    child_node->thirdField[(sizeof(child_node->thirdField)/sizeof(child_node->thirdField[0]))-1] = 0;
+    child_node->description[(sizeof(child_node->description)/sizeof(child_node->description[0]))-1] = 0;
+}
+
+/*! \fn     nodemgmt_update_cred_child_node_date_last_used(uint16_t address)
+*   \brief  Set the last used date of a child node to the current date, if we have one
+*   \param  address     Child node address
+*/
+void nodemgmt_update_cred_child_node_date_last_used(uint16_t address)
+{
+    child_cred_node_t temp_cnode;
+    
+    // No date to store
+    if (nodemgmt_current_date == 0x0000)
+    {
+        return;
+    }
+    
+    // Read the node as stored, update the good field and write at the same place
+    nodemgmt_read_child_node_data_block_from_flash(address, (child_node_t*)&temp_cnode);
+    nodemgmt_check_user_perm_from_flags_and_lock(temp_cnode.flags);
+    if (temp_cnode.dateLastUsed != nodemgmt_current_date)
+    {
+        temp_cnode.dateLastUsed = nodemgmt_current_date;
+        nodemgmt_write_child_node_block_to_flash(address, (child_node_t*)&temp_cnode, FALSE);
+    }
+    memset(&temp_cnode, 0, sizeof(temp_cnode));
+}
+
 /*! \fn     nodemgmt_read_cred_child_node_except_pwd(uint16_t address, child_cred_node_t* child_node)
 *   \brief  Read a child node but not the password fields
 *   \param  address     Where to read
@@ -343,6 +521,21 @@ void nodemgmt_read_cred_child_node_except_pwd(uint16_t address, child_cred_node_
     child_node->description[(sizeof(child_node->description)/sizeof(child_node->description[0]))-1] = 0;
 }
 
+/*! \fn     nodemgmt_read_cred_child_node_login_and_desc(uint16_t address, child_cred_node_t* child_node)
+*   \brief  Read only the header of a child node: flags, addresses, dates, login & description
+*   \param  address     Where to read
+*   \param  child_node  Pointer to the node, fields after description are left untouched
+*   \note   Used for lists display, a fraction of the half node read by the function above
+*/
+void nodemgmt_read_cred_child_node_login_and_desc(uint16_t address, child_cred_node_t* child_node)
+{
+    nodemgmt_read_node_fields(address, child_cred_node_t, flags, description, child_node);
+    
+    // String cleaning
+    child_node->login[(sizeof(child_node->login)/sizeof(child_node->login[0]))-1] = 0;
+    child_node->description[(sizeof(child_node->description)/sizeof(child_node->description[0]))-1] = 0;
+}
+
 /*! \fn     nodemgmt_read_webauthn_child_node_except_display_name(uint16_t address, child_webauthn_node_t* child_node, BOOL update_date_and_increment_preinc_count)
 *   \brief  Read a webauthn child node but not the display name field
 *   \param  address                                 Where to read
@@ -414,6 +607,61 @@ void nodemgmt_read_webauthn_child_node(uint16_t address, child_webauthn_node_t*
     child_node->display_name_t0 = 0;
 }
 
+/*! \fn     nodemgmt_get_virtual_user_slot_offset(uint16_t slot, BOOL category_strings_area, uint16_t *page, uint16_t *pageOffset)
+    \brief  Obtains page and page offset for a given virtual user slot
+    \param  slot                    The virtual user slot (0 up to NODEMGMT_BTBONDINFO_VUSER_SLOT_STOP)
+    \param  category_strings_area   TRUE to get the offset of the area used for category strings, FALSE for the user profile one
+    \param  page                    The page containing the area
+    \param  pageOffset              The offset of the page that indicates the start of the area
+ */
+static void nodemgmt_get_virtual_user_slot_offset(uint16_t slot, BOOL category_strings_area, uint16_t *page, uint16_t *pageOffset)
+{
+    /* Check for bad surprises */
+    _Static_assert(NODEMGMT_BTBONDINFO_VUSER_SLOT_STOP*2*NODEMGMT_USER_PROFILE_SIZE <= PAGE_PER_SECTOR*BYTES_PER_PAGE, "Virtual user slots don't fit in sector 0");
+    
+    #if BYTES_PER_PAGE == NODEMGMT_USER_PROFILE_SIZE
+        *page = slot*2 + ((category_strings_area == FALSE)? 0 : 1);
+        *pageOffset = 0;
+    #elif BYTES_PER_PAGE == 2*NODEMGMT_USER_PROFILE_SIZE
+        *page = slot;
+        *pageOffset = (category_strings_area == FALSE)? 0 : NODEMGMT_USER_PROFILE_SIZE;
+    #else
+        #error "User profile isn't a multiple of page size"
+    #endif
+}
+
+/*! \fn     nodemgmt_get_user_profile_slot(uint16_t uid)
+    \brief  Get the virtual user slot storing a given user profile
+    \param  uid     The user id
+    \return The virtual user slot
+    \note   The user profile is stored in its own slot unless it was relocated by the wear leveling logic
+ */
+static uint16_t nodemgmt_get_user_profile_slot(uint16_t uid)
+{
+    uint16_t stats_page, stats_offset;
+    uint8_t profile_slot;
+    uint32_t magic;
+    
+    /* Check that wear statistics are valid before fetching the relocated slot */
+    nodemgmt_get_virtual_user_slot_offset(NODEMGMT_WEAR_STATS_VUSER_SLOT, FALSE, &stats_page, &stats_offset);
+    dbflash_read_data_from_flash(&dbflash_descriptor, stats_page, stats_offset + (size_t)offsetof(nodemgmt_wear_stats_t, magic), sizeof(magic), (void*)&magic);
+    if (magic != NODEMGMT_WEAR_STATS_MAGIC)
+    {
+        return uid;
+    }
+    dbflash_read_data_from_flash(&dbflash_descriptor, stats_page, stats_offset + (size_t)offsetof(nodemgmt_wear_stats_t, profile_slots) + uid, sizeof(profile_slot), (void*)&profile_slot);
+    
+    /* Only spare slots are valid relocation targets */
+    if ((profile_slot >= NODEMGMT_WEAR_SPARE_VUSER_SLOT_START) && (profile_slot < NODEMGMT_WEAR_STATS_VUSER_SLOT))
+    {
+        return profile_slot;
+    }
+    else
+    {
+        return uid;
+    }
+}
+
 /*! \fn     nodemgmt_get_user_profile_starting_offset(uint8_t uid, uint16_t *page, uint16_t *pageOffset)
     \brief  Obtains page and page offset for a given user id
     \param  uid             The id of the user to perform that profile page and offset calculation (0 up to NODE_MAX_UID)
@@ -431,15 +679,7 @@ void nodemgmt_get_user_profile_starting_offset(uint16_t uid, uint16_t *page, uin
     /* Check for bad surprises */    
     _Static_assert(NODEMGMT_USER_PROFILE_SIZE == sizeof(nodemgmt_userprofile_t), "User profile isn't the right size");
     
-    #if BYTES_PER_PAGE == NODEMGMT_USER_PROFILE_SIZE
-        *page = uid*2;
-        *pageOffset = 0;
-    #elif BYTES_PER_PAGE == 2*NODEMGMT_USER_PROFILE_SIZE
-        *page = uid;
-        *pageOffset = 0;
-    #else
-        #error "User profile isn't a multiple of page size"
-    #endif
+    nodemgmt_get_virtual_user_slot_offset(nodemgmt_get_user_profile_slot(uid), FALSE, page, pageOffset);
 }
 
 /*! \fn     nodemgmt_get_bluetooth_bonding_info_starting_offset(uint8_t uid, uint16_t *page, uint16_t *pageOffset)
@@ -500,15 +740,7 @@ void nodemgmt_get_user_category_names_starting_offset(uint16_t uid, uint16_t *pa
     /* Check for bad surprises */    
     _Static_assert(NODEMGMT_USER_PROFILE_SIZE == sizeof(nodemgmt_userprofile_t), "User profile isn't the right size");
     
-    #if BYTES_PER_PAGE == NODEMGMT_USER_PROFILE_SIZE
-        *page = uid*2 + 1;
-        *pageOffset = 0;
-    #elif BYTES_PER_PAGE == 2*NODEMGMT_USER_PROFILE_SIZE
-        *page = uid;
-        *pageOffset = NODEMGMT_USER_PROFILE_SIZE;
-    #else
-        #error "User profile isn't a multiple of page size"
-    #endif
+    nodemgmt_get_virtual_user_slot_offset(nodemgmt_get_user_profile_slot(uid), TRUE, page, pageOffset);
 }
 
 /*! \fn     nodemgmt_format_user_profile(uint16_t uid, uint16_t secPreferences, uint16_t languageId, uint16_t bleKeyboardId)
@@ -550,13 +782,13 @@ void nodemgmt_delete_all_bluetooth_bonding_information(void)
 {
     uint16_t starting_page, stop_page;
     
-     /* Compute the offset: after the last user profile */
+     /* Compute the offset: after the last user profile, and stop before the wear statistics & spare slots */
     #if BYTES_PER_PAGE == NODEMGMT_USER_PROFILE_SIZE
         starting_page = NODEMGMT_BTBONDINFO_VUSER_SLOT_START*2;
-        stop_page = NODEMGMT_BTBONDINFO_VUSER_SLOT_STOP*2;
+        stop_page = (NODEMGMT_BTBONDINFO_VUSER_SLOT_START+NODEMGMT_BTBONDINFO_NB_VUSER_SLOTS)*2;
     #elif BYTES_PER_PAGE == 2*NODEMGMT_USER_PROFILE_SIZE
         starting_page = NODEMGMT_BTBONDINFO_VUSER_SLOT_START;
-        stop_page = NODEMGMT_BTBONDINFO_VUSER_SLOT_STOP;
+        stop_page = NODEMGMT_BTBONDINFO_VUSER_SLOT_START+NODEMGMT_BTBONDINFO_NB_VUSER_SLOTS;
     #else
         #error "User profile isn't a multiple of page size"
     #endif
@@ -568,6 +800,152 @@ void nodemgmt_delete_all_bluetooth_bonding_information(void)
     }
 }
 
+/*! \fn     nodemgmt_read_wear_stats(nodemgmt_wear_stats_t* stats, nodemgmt_wear_profile_stats_t* profile_stats)
+ *  \brief  Read the database wear statistics stored in flash
+ *  \param  stats           Where to store the wear statistics
+ *  \param  profile_stats   Where to store the user profile pages wear statistics
+ *  \note   Statistics are reset if no valid ones are stored in flash
+ */
+void nodemgmt_read_wear_stats(nodemgmt_wear_stats_t* stats, nodemgmt_wear_profile_stats_t* profile_stats)
+{
+    uint16_t temp_page, temp_offset;
+    
+    /* Sanity checks */
+    _Static_assert(sizeof(nodemgmt_wear_stats_t) <= NODEMGMT_USER_PROFILE_SIZE, "Wear statistics too big");
+    _Static_assert(sizeof(nodemgmt_wear_profile_stats_t) <= NODEMGMT_USER_PROFILE_SIZE, "Profile wear statistics too big");
+    _Static_assert(NODEMGMT_BTBONDINFO_VUSER_SLOT_STOP <= NODEMGMT_WEAR_PROFILE_DEFAULT_SLOT, "Virtual user slots can't be stored in a uint8_t");
+    
+    nodemgmt_get_virtual_user_slot_offset(NODEMGMT_WEAR_STATS_VUSER_SLOT, FALSE, &temp_page, &temp_offset);
+    dbflash_read_data_from_flash(&dbflash_descriptor, temp_page, temp_offset, sizeof(*stats), (void*)stats);
+    nodemgmt_get_virtual_user_slot_offset(NODEMGMT_WEAR_STATS_VUSER_SLOT, TRUE, &temp_page, &temp_offset);
+    dbflash_read_data_from_flash(&dbflash_descriptor, temp_page, temp_offset, sizeof(*profile_stats), (void*)profile_stats);
+    
+    /* First use or erased flash */
+    if (stats->magic != NODEMGMT_WEAR_STATS_MAGIC)
+    {
+        memset((void*)stats, 0, sizeof(*stats));
+        memset((void*)profile_stats, 0, sizeof(*profile_stats));
+        memset((void*)stats->profile_slots, NODEMGMT_WEAR_PROFILE_DEFAULT_SLOT, sizeof(stats->profile_slots));
+        stats->magic = NODEMGMT_WEAR_STATS_MAGIC;
+        stats->nb_sectors = DBFLASH_NB_SECTORS;
+    }
+}
+
+#ifdef NODEMGMT_WEAR_PROFILE_RELOCATION
+/*! \fn     nodemgmt_relocate_user_profile(uint16_t src_slot, uint16_t dst_slot)
+ *  \brief  Copy a user profile and its category strings to another virtual user slot
+ *  \param  src_slot    Source virtual user slot
+ *  \param  dst_slot    Destination virtual user slot
+ */
+static void nodemgmt_relocate_user_profile(uint16_t src_slot, uint16_t dst_slot)
+{
+    uint8_t temp_buffer[NODEMGMT_USER_PROFILE_SIZE/4];
+    uint16_t src_page, src_offset;
+    uint16_t dst_page, dst_offset;
+    
+    /* Profile then category strings areas, chunk by chunk */
+    for (uint16_t i = 0; i < 2; i++)
+    {
+        nodemgmt_get_virtual_user_slot_offset(src_slot, (i == 0)? FALSE : TRUE, &src_page, &src_offset);
+        nodemgmt_get_virtual_user_slot_offset(dst_slot, (i == 0)? FALSE : TRUE, &dst_page, &dst_offset);
+        
+        for (uint16_t j = 0; j < NODEMGMT_USER_PROFILE_SIZE; j += sizeof(temp_buffer))
+        {
+            dbflash_read_data_from_flash(&dbflash_descriptor, src_page, src_offset + j, sizeof(temp_buffer), (void*)temp_buffer);
+            dbflash_write_data_to_flash(&dbflash_descriptor, dst_page, dst_offset + j, sizeof(temp_buffer), (void*)temp_buffer);
+        }
+    }
+}
+#endif
+
+/*! \fn     nodemgmt_wear_stats_flush(BOOL allow_relocation)
+ *  \brief  Add the wear counters accumulated by the dbflash driver to the statistics stored in flash
+ *  \param  allow_relocation    Set to TRUE if no user is currently logged in and a worn out user profile may be moved
+ *  \note   Counter remainders below NODEMGMT_WEAR_COUNT_UNIT are kept in RAM for the next flush
+ *  \note   Relocation is only performed when NODEMGMT_WEAR_PROFILE_RELOCATION is defined
+ */
+void nodemgmt_wear_stats_flush(BOOL allow_relocation)
+{
+    nodemgmt_wear_profile_stats_t profile_stats;
+    nodemgmt_wear_stats_t stats;
+    uint16_t temp_page, temp_offset;
+    
+    /* Nothing to flush */
+    if ((dbflash_wear_counters.nb_page_programs == 0) && (dbflash_wear_counters.nb_page_erases == 0))
+    {
+        return;
+    }
+    
+    /* Fetch stored statistics */
+    nodemgmt_read_wear_stats(&stats, &profile_stats);
+    
+    /* Accumulate totals */
+    stats.nb_page_programs += dbflash_wear_counters.nb_page_programs;
+    stats.nb_page_erases += dbflash_wear_counters.nb_page_erases;
+    dbflash_wear_counters.nb_page_programs = 0;
+    dbflash_wear_counters.nb_page_erases = 0;
+    nodemgmt_invalidate_read_ahead();
+    
+    /* Accumulate sector counters */
+    for (uint16_t i = 0; i < DBFLASH_NB_SECTORS; i++)
+    {
+        uint32_t new_count = (uint32_t)stats.sector_programs[i] + dbflash_wear_counters.sector_programs[i]/NODEMGMT_WEAR_COUNT_UNIT;
+        stats.sector_programs[i] = (new_count > UINT16_MAX)? UINT16_MAX : (uint16_t)new_count;
+        dbflash_wear_counters.sector_programs[i] %= NODEMGMT_WEAR_COUNT_UNIT;
+    }
+    
+    /* Accumulate programs of the pages currently storing user profiles */
+    for (uint16_t uid = 0; uid < NB_MAX_USERS; uid++)
+    {
+        uint16_t profile_slot = (stats.profile_slots[uid] == NODEMGMT_WEAR_PROFILE_DEFAULT_SLOT)? uid : stats.profile_slots[uid];
+        nodemgmt_get_virtual_user_slot_offset(profile_slot, FALSE, &temp_page, &temp_offset);
+        uint32_t new_count = (uint32_t)profile_stats.profile_programs[uid] + dbflash_wear_counters.sector_zero_page_programs[temp_page]/NODEMGMT_WEAR_COUNT_UNIT;
+        profile_stats.profile_programs[uid] = (new_count > UINT16_MAX)? UINT16_MAX : (uint16_t)new_count;
+        dbflash_wear_counters.sector_zero_page_programs[temp_page] %= NODEMGMT_WEAR_COUNT_UNIT;
+    }
+    
+    #ifdef NODEMGMT_WEAR_PROFILE_RELOCATION
+    /* Move at most one worn out user profile to the next free spare slot */
+    uint16_t old_profile_slot = UINT16_MAX;
+    if (allow_relocation != FALSE)
+    {
+        for (uint16_t uid = 0; uid < NB_MAX_USERS; uid++)
+        {
+            if ((profile_stats.profile_programs[uid] >= NODEMGMT_WEAR_PROFILE_RELOC_THRESHOLD) && (stats.nb_profile_relocations < NODEMGMT_WEAR_NB_SPARE_VUSER_SLOTS))
+            {
+                uint16_t new_profile_slot = NODEMGMT_WEAR_SPARE_VUSER_SLOT_START + stats.nb_profile_relocations;
+                old_profile_slot = (stats.profile_slots[uid] == NODEMGMT_WEAR_PROFILE_DEFAULT_SLOT)? uid : stats.profile_slots[uid];
+                nodemgmt_relocate_user_profile(old_profile_slot, new_profile_slot);
+                stats.profile_slots[uid] = (uint8_t)new_profile_slot;
+                profile_stats.profile_programs[uid] = 0;
+                stats.nb_profile_relocations++;
+                break;
+            }
+        }
+    }
+    #else
+    (void)allow_relocation;
+    #endif
+    
+    /* Store statistics: the main record is written last as it points to a relocated user profile */
+    nodemgmt_get_virtual_user_slot_offset(NODEMGMT_WEAR_STATS_VUSER_SLOT, TRUE, &temp_page, &temp_offset);
+    dbflash_write_data_to_flash(&dbflash_descriptor, temp_page, temp_offset, sizeof(profile_stats), (void*)&profile_stats);
+    nodemgmt_get_virtual_user_slot_offset(NODEMGMT_WEAR_STATS_VUSER_SLOT, FALSE, &temp_page, &temp_offset);
+    dbflash_write_data_to_flash(&dbflash_descriptor, temp_page, temp_offset, sizeof(stats), (void*)&stats);
+    
+    #ifdef NODEMGMT_WEAR_PROFILE_RELOCATION
+    /* Once the new location is committed, erase the worn out one */
+    if (old_profile_slot != UINT16_MAX)
+    {
+        nodemgmt_get_virtual_user_slot_offset(old_profile_slot, FALSE, &temp_page, &temp_offset);
+        dbflash_page_erase(&dbflash_descriptor, temp_page);
+        #if BYTES_PER_PAGE == NODEMGMT_USER_PROFILE_SIZE
+            dbflash_page_erase(&dbflash_descriptor, temp_page + 1);
+        #endif
+    }
+    #endif
+}
+
 /*! \fn     nodemgmt_store_bluetooth_bonding_information(nodemgmt_bluetooth_bonding_information_t* bonding_information)
  *  \brief  Store bluetooth bonding information
  *  \param  bonding_information Pointer to a bonding information struct
@@ -636,6 +1014,41 @@ RET_TYPE nodemgmt_store_bluetooth_bonding_information(nodemgmt_bluetooth_bonding
     }    
 }
 
+/*! \fn     nodemgmt_store_bluetooth_bonding_typing_delay(uint8_t* mac_address, uint16_t tuned_typing_delay)
+ *  \brief  Update the tuned typing delay stored with the bonding information of a given host
+ *  \param  mac_address         The MAC address, as stored in the bonding information
+ *  \param  tuned_typing_delay  Tuned delay between keyboard reports, in ms
+ *  \return RETURN_OK if we found bonding information for that host
+ */
+RET_TYPE nodemgmt_store_bluetooth_bonding_typing_delay(uint8_t* mac_address, uint16_t tuned_typing_delay)
+{
+    uint8_t mac_address_read[MEMBER_ARRAY_SIZE(nodemgmt_bluetooth_bonding_information_t, mac_address)];
+    uint16_t zero_to_be_valid_read_from_flash;
+    uint16_t temp_page, temp_page_offset;
+    uint16_t temp_uid;
+    
+    for (temp_uid = 0; temp_uid < NB_MAX_BONDING_INFORMATION; temp_uid++)
+    {
+        /* Get page and offset */
+        nodemgmt_get_bluetooth_bonding_info_starting_offset(temp_uid, &temp_page, &temp_page_offset);
+        
+        /* Check for filled slot */
+        dbflash_read_data_from_flash(&dbflash_descriptor, temp_page, temp_page_offset + (size_t)offsetof(nodemgmt_bluetooth_bonding_information_t, zero_to_be_valid), sizeof(zero_to_be_valid_read_from_flash), &zero_to_be_valid_read_from_flash);
+        
+        /* Read mac address */
+        dbflash_read_data_from_flash(&dbflash_descriptor, temp_page, temp_page_offset + (size_t)offsetof(nodemgmt_bluetooth_bonding_information_t, mac_address), sizeof(mac_address_read), mac_address_read);
+        
+        /* Found it? Only overwrite the typing delay */
+        if ((zero_to_be_valid_read_from_flash == 0x0000) && (memcmp(mac_address_read, mac_address, sizeof(mac_address_read)) == 0))
+        {
+            dbflash_write_data_to_flash(&dbflash_descriptor, temp_page, temp_page_offset + (size_t)offsetof(nodemgmt_bluetooth_bonding_information_t, tuned_typing_delay), sizeof(tuned_typing_delay), (void*)&tuned_typing_delay);
+            return RETURN_OK;
+        }
+    }
+    
+    return RETURN_NOK;
+}
+
 /*! \fn     nodemgmt_get_bluetooth_bonding_information_for_mac_addr(uint8_t address_resolv_type, uint8_t* mac_address, nodemgmt_bluetooth_bonding_information_t* bonding_information)
  *  \brief  Get a possible bluetooth bonding information for a given mac address
  *  \param  address_resolv_type Type of address
@@ -924,6 +1337,110 @@ uint16_t nodemgmt_get_next_child_node_for_cur_category(uint16_t search_start_chi
     return nodemgmt_check_for_logins_with_category_in_parent_node(search_start_child_addr, nodemgmt_current_handle.currentCategoryFlags);
 }    
 
+/*! \fn     nodemgmt_invalidate_parent_summaries(void)
+ *  \brief  Invalidate all cached parent children summaries
+ *  \note   To be called on user change and whenever children may have been modified behind our back
+ */
+void nodemgmt_invalidate_parent_summaries(void)
+{
+    #if NODE_ADDR_NULL != 0x0000
+        #error "NODE_ADDR_NULL != 0x0000"
+    #endif
+    memset((void*)nodemgmt_parent_summaries, 0, sizeof(nodemgmt_parent_summaries));
+}
+
+/*! \fn     nodemgmt_get_parent_summary_slot(uint16_t parent_addr)
+ *  \brief  Get the cache slot for a given parent summary
+ *  \param  parent_addr         Parent node address
+ *  \return Pointer to the cache slot
+ */
+static nodemgmt_parent_summary_t* nodemgmt_get_parent_summary_slot(uint16_t parent_addr)
+{
+    _Static_assert((NODEMGMT_PARENT_SUMMARY_CACHE_SIZE & (NODEMGMT_PARENT_SUMMARY_CACHE_SIZE-1)) == 0, "Parent summary cache size isn't a power of 2");
+    return &nodemgmt_parent_summaries[(parent_addr ^ (parent_addr >> 6)) & (NODEMGMT_PARENT_SUMMARY_CACHE_SIZE-1)];
+}
+
+/*! \fn     nodemgmt_get_parent_summary(uint16_t parent_addr, uint16_t first_child_addr)
+ *  \brief  Get the summary of a parent node children, computing it if not cached
+ *  \param  parent_addr         Parent node address
+ *  \param  first_child_addr    Parent node first child address
+ *  \return Pointer to the summary
+ */
+static nodemgmt_parent_summary_t* nodemgmt_get_parent_summary(uint16_t parent_addr, uint16_t first_child_addr)
+{
+    _Static_assert(NODEMGMT_CAT_MASK_FINAL < 8*MEMBER_SIZE(nodemgmt_parent_summary_t, category_bitmask), "Category bitmask too small");
+    nodemgmt_parent_summary_t* summary_pt = nodemgmt_get_parent_summary_slot(parent_addr);
+    uint16_t next_child_node_addr_to_scan = first_child_addr;
+    uint16_t child_read_buffer[4];
+    
+    /* Cache hit, first child check to detect a chain that changed */
+    if ((summary_pt->parent_addr == parent_addr) && (summary_pt->first_child_addr == first_child_addr))
+    {
+        return summary_pt;
+    }
+    
+    /* Sanity check for this hack */
+    _Static_assert(0 == offsetof(child_cred_node_t, flags), "Incorrect buffer for flags & addr read");
+    _Static_assert(4 == offsetof(child_cred_node_t, nextChildAddress), "Incorrect buffer for flags & addr read");
+    
+    /* Hack to read flags & prev / next address */
+    child_cred_node_t* child_node_pt = (child_cred_node_t*)child_read_buffer;
+    
+    /* Compute summary */
+    summary_pt->parent_addr = parent_addr;
+    summary_pt->first_child_addr = first_child_addr;
+    summary_pt->category_bitmask = 0;
+    summary_pt->nb_children = 0;
+    while (next_child_node_addr_to_scan != NODE_ADDR_NULL)
+    {
+        dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(next_child_node_addr_to_scan), BASE_NODE_SIZE*nodemgmt_node_from_address(next_child_node_addr_to_scan), sizeof(child_read_buffer), &child_read_buffer);
+        summary_pt->category_bitmask |= (1 << categoryFromFlags(child_node_pt->flags));
+        summary_pt->nb_children++;
+        next_child_node_addr_to_scan = child_node_pt->nextChildAddress;
+    }
+    
+    return summary_pt;
+}
+
+/*! \fn     nodemgmt_get_number_of_children_in_parent_node(uint16_t parent_addr, uint16_t first_child_addr)
+ *  \brief  Get the number of children of a parent node
+ *  \param  parent_addr         Parent node address
+ *  \param  first_child_addr    Parent node first child address
+ *  \return Number of children
+ */
+uint16_t nodemgmt_get_number_of_children_in_parent_node(uint16_t parent_addr, uint16_t first_child_addr)
+{
+    return nodemgmt_get_parent_summary(parent_addr, first_child_addr)->nb_children;
+}
+
+/*! \fn     nodemgmt_check_for_logins_with_category_in_parent(uint16_t parent_addr, uint16_t first_child_addr, uint16_t category_flags)
+ *  \brief  See if a parent node contains children that have the desired category, using the cached parent summary
+ *  \param  parent_addr         Parent node address
+ *  \param  first_child_addr    Parent node first child address
+ *  \param  category_flags      Desired category flags
+ *  \return TRUE if the parent contains at least one child with the desired category
+ */
+BOOL nodemgmt_check_for_logins_with_category_in_parent(uint16_t parent_addr, uint16_t first_child_addr, uint16_t category_flags)
+{
+    // CATSEARCHLOGIC
+    if (first_child_addr == NODE_ADDR_NULL)
+    {
+        return FALSE;
+    }
+    else if (category_flags == 0)
+    {
+        return TRUE;
+    }
+    else if ((nodemgmt_get_parent_summary(parent_addr, first_child_addr)->category_bitmask & (1 << category_flags)) != 0)
+    {
+        return TRUE;
+    }
+    else
+    {
+        return FALSE;
+    }
+}
+
 /*! \fn     nodemgmt_check_for_logins_with_category_in_parent_node(uint16_t start_child_addr, uint16_t category_flags)
  *  \brief  See if a parent node contains children that have the desired category
  *  \param  start_child_addr    Address of the first child
@@ -999,18 +1516,21 @@ uint16_t nodemgmt_get_prev_parent_node_for_cur_category(uint16_t search_start_pa
     }
     
     /* Read flags and prev/next address */
-    dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(search_start_parent_addr), BASE_NODE_SIZE*nodemgmt_node_from_address(search_start_parent_addr), sizeof(parent_read_buffer), &parent_read_buffer);
+    nodemgmt_read_parent_header(search_start_parent_addr, parent_read_buffer);
     prev_parent_node_addr_to_scan = parent_node_pt->prevParentAddress;
     
     /* Loop */
     while (prev_parent_node_addr_to_scan != NODE_ADDR_NULL)
     {
         /* Read flags and prev/next address */
-        dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(prev_parent_node_addr_to_scan), BASE_NODE_SIZE*nodemgmt_node_from_address(prev_parent_node_addr_to_scan), sizeof(parent_read_buffer), &parent_read_buffer);
+        nodemgmt_read_parent_header(prev_parent_node_addr_to_scan, parent_read_buffer);
 
         /* Check for logins with desired category */
-        if (nodemgmt_check_for_logins_with_category_in_parent_node(parent_node_pt->nextChildAddress, nodemgmt_current_handle.currentCategoryFlags) != NODE_ADDR_NULL)
+        if (nodemgmt_check_for_logins_with_category_in_parent(prev_parent_node_addr_to_scan, parent_node_pt->nextChildAddress, nodemgmt_current_handle.currentCategoryFlags) != FALSE)
         {
+            /* Learn traversal direction: reading this node will trigger the read-ahead of the prev one */
+            nodemgmt_read_ahead_trigger_addr = prev_parent_node_addr_to_scan;
+            nodemgmt_read_ahead_forward = FALSE;
             return prev_parent_node_addr_to_scan;
         }
         
@@ -1052,7 +1572,7 @@ uint16_t nodemgmt_get_next_parent_node_for_cur_category(uint16_t search_start_pa
     if (search_start_parent_addr != NODE_ADDR_NULL)
     {
         /* Read flags and prev/next address */
-        dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(search_start_parent_addr), BASE_NODE_SIZE*nodemgmt_node_from_address(search_start_parent_addr), sizeof(parent_read_buffer), &parent_read_buffer);
+        nodemgmt_read_parent_header(search_start_parent_addr, parent_read_buffer);
         next_parent_node_addr_to_scan = parent_node_pt->nextParentAddress;
     }
     
@@ -1060,11 +1580,14 @@ uint16_t nodemgmt_get_next_parent_node_for_cur_category(uint16_t search_start_pa
     while (next_parent_node_addr_to_scan != NODE_ADDR_NULL)
     {
         /* Read flags and prev/next address */
-        dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(next_parent_node_addr_to_scan), BASE_NODE_SIZE*nodemgmt_node_from_address(next_parent_node_addr_to_scan), sizeof(parent_read_buffer), &parent_read_buffer);
+        nodemgmt_read_parent_header(next_parent_node_addr_to_scan, parent_read_buffer);
 
         /* Check for logins with desired category */
-        if (nodemgmt_check_for_logins_with_category_in_parent_node(parent_node_pt->nextChildAddress, nodemgmt_current_handle.currentCategoryFlags) != NODE_ADDR_NULL)
+        if (nodemgmt_check_for_logins_with_category_in_parent(next_parent_node_addr_to_scan, parent_node_pt->nextChildAddress, nodemgmt_current_handle.currentCategoryFlags) != FALSE)
         {
+            /* Learn traversal direction: reading this node will trigger the read-ahead of the next one */
+            nodemgmt_read_ahead_trigger_addr = next_parent_node_addr_to_scan;
+            nodemgmt_read_ahead_forward = TRUE;
             return next_parent_node_addr_to_scan;
         }
         
@@ -1560,6 +2083,124 @@ void nodemgmt_scan_node_usage(void)
     }
 }
 
+/*! \fn     nodemgmt_write_node_address_field(uint16_t node_addr, uint16_t field_offset, uint16_t address)
+*   \brief  Update a single address field inside a node
+*   \param  node_addr       Address of the node to update
+*   \param  field_offset    Offset of the address field inside the node
+*   \param  address         Address to write
+*/
+static void nodemgmt_write_node_address_field(uint16_t node_addr, uint16_t field_offset, uint16_t address)
+{
+    dbflash_write_data_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(node_addr), BASE_NODE_SIZE * nodemgmt_node_from_address(node_addr) + field_offset, sizeof(address), (void*)&address);
+}
+
+/*! \fn     nodemgmt_reserve_free_child_nodes(uint16_t nb_nodes, uint16_t* child_node_array)
+*   \brief  Reserve a batch of free child nodes, to be written later on
+*   \param  nb_nodes            Number of child nodes we want
+*   \param  child_node_array    An array where to store the addresses
+*   \return The number of child nodes reserved
+*   \note   Free node pointers are moved after the reserved nodes, so other node creations won't use them
+*/
+uint16_t nodemgmt_reserve_free_child_nodes(uint16_t nb_nodes, uint16_t* child_node_array)
+{
+    // No more space?
+    if ((nb_nodes == 0) || (nodemgmt_current_handle.nextChildFreeNode == NODE_ADDR_NULL))
+    {
+        return 0;
+    }
+    
+    // Find the free child nodes, starting with the next free child node
+    uint16_t nb_nodes_found = nodemgmt_find_free_nodes(0, 0, nb_nodes, child_node_array, nodemgmt_page_from_address(nodemgmt_current_handle.nextChildFreeNode), nodemgmt_node_from_address(nodemgmt_current_handle.nextChildFreeNode));
+    if (nb_nodes_found == 0)
+    {
+        return 0;
+    }
+    
+    // Look for free nodes after the last reserved child node
+    uint16_t scan_start_addr = nodemgmt_get_incremented_address(nodemgmt_get_incremented_address(child_node_array[nb_nodes_found-1]));
+    if (nodemgmt_find_free_nodes(1, &nodemgmt_current_handle.nextParentFreeNode, 1, &nodemgmt_current_handle.nextChildFreeNode, nodemgmt_page_from_address(scan_start_addr), nodemgmt_node_from_address(scan_start_addr)) != 2)
+    {
+        nodemgmt_current_handle.nextParentFreeNode = NODE_ADDR_NULL;
+        nodemgmt_current_handle.nextChildFreeNode = NODE_ADDR_NULL;
+    }
+    
+    return nb_nodes_found;
+}
+
+/*! \fn     nodemgmt_store_data_node(uint16_t parent_address, uint16_t prev_address, uint16_t address, child_data_node_t* data_node)
+*   \brief  Write a data node to a previously reserved address, then append it to its file
+*   \param  parent_address  Address of the data parent node
+*   \param  prev_address    Address of the previous data node in sequence, NODE_ADDR_NULL for the first one
+*   \param  address         Where to write
+*   \param  data_node       Pointer to the node, data & data_length already filled
+*   \note   The node is only linked once written, so the data nodes chain never points to a free node
+*/
+void nodemgmt_store_data_node(uint16_t parent_address, uint16_t prev_address, uint16_t address, child_data_node_t* data_node)
+{
+    // Flags: data node type, valid bit set to 0, user id set by the write function
+    data_node->flags = (NODE_TYPE_DATA << NODEMGMT_TYPE_FLAG_BITSHIFT);
+    data_node->fakeFlags = data_node->flags;
+    data_node->nextDataAddress = NODE_ADDR_NULL;
+    nodemgmt_write_child_node_block_to_flash(address, (child_node_t*)data_node, FALSE);
+    
+    // Link it from the previous node or the parent
+    if (prev_address == NODE_ADDR_NULL)
+    {
+        nodemgmt_write_node_address_field(parent_address, offsetof(parent_data_node_t, nextChildAddress), address);
+    }
+    else
+    {
+        nodemgmt_write_node_address_field(prev_address, offsetof(child_data_node_t, nextDataAddress), address);
+    }
+}
+
+/*! \fn     nodemgmt_delete_data_nodes(uint16_t address)
+*   \brief  Delete a chain of data nodes
+*   \param  address     Address of the first data node
+*   \note   The chain ends at the first address not containing a data node. Free nodes are then looked for from the start of the memory, 
+*   \note   so the deleted nodes and the ones reserved but not written can be used again
+*/
+void nodemgmt_delete_data_nodes(uint16_t address)
+{
+    child_data_node_t temp_data_node;
+    
+    // Erase each node once we know the next one
+    while ((address != NODE_ADDR_NULL) && (nodemgmt_read_data_node(address, &temp_data_node) == RETURN_OK))
+    {
+        dbflash_write_data_pattern_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(address), BASE_NODE_SIZE * nodemgmt_node_from_address(address), BASE_NODE_SIZE, 0xFF);
+        dbflash_write_data_pattern_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(nodemgmt_get_incremented_address(address)), BASE_NODE_SIZE * nodemgmt_node_from_address(nodemgmt_get_incremented_address(address)), BASE_NODE_SIZE, 0xFF);
+        address = temp_data_node.nextDataAddress;
+    }
+    memset(&temp_data_node, 0, sizeof(temp_data_node));
+    
+    // Scan for next free parent and child nodes from the start of the memory
+    if (nodemgmt_find_free_nodes(1, &nodemgmt_current_handle.nextParentFreeNode, 1, &nodemgmt_current_handle.nextChildFreeNode, 0, 0) != 2)
+    {
+        nodemgmt_current_handle.nextParentFreeNode = NODE_ADDR_NULL;
+        nodemgmt_current_handle.nextChildFreeNode = NODE_ADDR_NULL;
+    }
+}
+
+/*! \fn     nodemgmt_read_data_node(uint16_t address, child_data_node_t* data_node)
+*   \brief  Read a data node
+*   \param  address     Where to read
+*   \param  data_node   Pointer to the node
+*   \return RETURN_OK if the node is a valid data node
+*/
+RET_TYPE nodemgmt_read_data_node(uint16_t address, child_data_node_t* data_node)
+{
+    nodemgmt_read_child_node_data_block_from_flash(address, (child_node_t*)data_node);
+    nodemgmt_check_user_perm_from_flags_and_lock(data_node->flags);
+    
+    // Check node type & validity
+    if ((validBitFromFlags(data_node->flags) != NODEMGMT_VBIT_VALID) || (nodeTypeFromFlags(data_node->flags) != NODE_TYPE_DATA) || (data_node->data_length > sizeof(data_node->data) + sizeof(data_node->data2)))
+    {
+        return RETURN_NOK;
+    }
+    
+    return RETURN_OK;
+}
+
 /*! \fn     nodemgmt_get_current_category_flags(void)
  *  \brief  Get current selected category ID in flag form
  *  \return The category in flag form
@@ -1629,6 +2270,7 @@ void nodemgmt_init_context(uint16_t userIdNum, uint16_t* userSecFlags, uint16_t*
     nodemgmt_current_handle.currentCategoryId = 0;
     nodemgmt_current_handle.datadbChanged = FALSE;
     nodemgmt_current_handle.dbChanged = FALSE;
+    nodemgmt_invalidate_read_ahead();
     
     // Get starting cred parents
     for (uint16_t i = 0; i < MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes); i++)
@@ -1644,6 +2286,9 @@ void nodemgmt_init_context(uint16_t userIdNum, uint16_t* userSecFlags, uint16_t*
     
     // scan for next free parent and child nodes from the start of the memory
     nodemgmt_scan_node_usage();
+    
+    // Children summaries belong to the previous user
+    nodemgmt_invalidate_parent_summaries();
 
     // Store user security preference and language
     *userSecFlags = nodemgmt_get_user_sec_preferences();
@@ -1678,12 +2323,49 @@ void nodemgmt_user_db_changed_actions(BOOL dataChanged)
     }
 }
 
+/*! \fn     nodemgmt_get_page_ownership(uint16_t page)
+*   \brief  Scan the flags of all node slots inside a page to know who owns its contents
+*   \param  page    Page to scan
+*   \return NODEMGMT_PAGE_OWNER_xxx bitmask
+*   \note   Second slot of a child node contains fakeFlags, which carry the same user id
+*/
+static uint16_t nodemgmt_get_page_ownership(uint16_t page)
+{
+    uint16_t ownership = NODEMGMT_PAGE_OWNER_NONE;
+    uint16_t slot_flags;
+    
+    for (uint16_t slot = 0; slot < BYTES_PER_PAGE/BASE_NODE_SIZE; slot++)
+    {
+        dbflash_read_data_from_flash(&dbflash_descriptor, page, BASE_NODE_SIZE*slot, sizeof(slot_flags), (void*)&slot_flags);
+        
+        if (validBitFromFlags(slot_flags) == NODEMGMT_VBIT_INVALID)
+        {
+            // Empty slot
+        }
+        else if (userIdFromFlags(slot_flags) == nodemgmt_current_handle.currentUserId)
+        {
+            ownership |= NODEMGMT_PAGE_OWNER_CUR_USER;
+        }
+        else
+        {
+            ownership |= NODEMGMT_PAGE_OWNER_OTHER_USER;
+        }
+    }
+    
+    return ownership;
+}
+
 /*! \fn     nodemgmt_delete_current_user_from_flash(void)
 *   \brief  Delete user data from flash
+*   \note   User chains are first browsed to know which flash blocks contain user nodes.
+*   \note   Blocks only containing user nodes (or empty slots) are then erased in one go, 
+*   \note   pages only containing user nodes are page erased, and user nodes located in pages shared with other users are individually wiped.
 */
 void nodemgmt_delete_current_user_from_flash(void)
 {
+    uint8_t touched_blocks[(BLOCK_COUNT+7)/8];
     uint16_t next_parent_addr = NODE_ADDR_NULL;
+    uint16_t page_ownership[NODEMGMT_PAGES_PER_BLOCK];
     uint16_t next_child_addr;
     uint16_t temp_buffer[4];
     uint16_t temp_address;
@@ -1693,11 +2375,18 @@ void nodemgmt_delete_current_user_from_flash(void)
     /* Boundary checks for the buffer we'll use to store start of node data */
     _Static_assert(sizeof(temp_buffer) >= offsetof(parent_data_node_t, nextChildAddress) + sizeof(parent_node_pt->nextChildAddress), "Buffer not long enough to store first bytes");
     _Static_assert(sizeof(temp_buffer) >= offsetof(child_cred_node_t, nextChildAddress) + sizeof(child_node_pt->nextChildAddress), "Buffer not long enough to store first bytes");
-        
+    
+    /* Block erase can only be used on blocks located inside the node area */
+    _Static_assert(NODEMGMT_PAGES_PER_BLOCK*BLOCK_COUNT == PAGE_COUNT, "Incorrect number of pages per block");
+    _Static_assert(PAGE_PER_SECTOR % NODEMGMT_PAGES_PER_BLOCK == 0, "Node area doesn't start on a block boundary");
+    
     // Delete user profile memory
     nodemgmt_format_user_profile(nodemgmt_current_handle.currentUserId, 0, 0, 0, 0);
     
-    // Then browse through all the credentials to delete them
+    // Clear touched blocks bitmap
+    memset(touched_blocks, 0, sizeof(touched_blocks));
+    
+    // Then browse through all the credentials to list the blocks containing user nodes
     for (uint16_t i = 0; i < MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes) + MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstDataParentNodes); i++)
     {
         // Logic depending if we're tackling credential or data nodes
@@ -1727,21 +2416,23 @@ void nodemgmt_delete_current_user_from_flash(void)
                 nodemgmt_check_user_perm_from_flags_and_lock(child_node_pt->flags);
                 
                 // Store the next child address in temp
-                if (i == 0)
+                if (i < MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes))
                 {
-                    // First loop is cnode
+                    // Credential child node
                     temp_address = child_node_pt->nextChildAddress;
                 }
                 else
                 {
-                    // Second loop is dnode
+                    // Data child node
                     child_data_node_t* temp_dnode_ptr = (child_data_node_t*)child_node_pt;
                     temp_address = temp_dnode_ptr->nextDataAddress;
                 }
                 
-                // Delete child data block
-                dbflash_write_data_pattern_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(next_child_addr), BASE_NODE_SIZE * nodemgmt_node_from_address(next_child_addr), BASE_NODE_SIZE, 0xFF);
-                dbflash_write_data_pattern_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(nodemgmt_get_incremented_address(next_child_addr)), BASE_NODE_SIZE * nodemgmt_node_from_address(nodemgmt_get_incremented_address(next_child_addr)), BASE_NODE_SIZE, 0xFF);
+                // Flag the block(s) containing the child node
+                uint16_t child_block = nodemgmt_page_from_address(next_child_addr) / NODEMGMT_PAGES_PER_BLOCK;
+                touched_blocks[child_block >> 3] |= (1 << (child_block & 0x07));
+                child_block = nodemgmt_page_from_address(nodemgmt_get_incremented_address(next_child_addr)) / NODEMGMT_PAGES_PER_BLOCK;
+                touched_blocks[child_block >> 3] |= (1 << (child_block & 0x07));
                 
                 // Set correct next address
                 next_child_addr = temp_address;
@@ -1750,13 +2441,382 @@ void nodemgmt_delete_current_user_from_flash(void)
             // Store the next parent address in temp
             temp_address = parent_node_pt->nextParentAddress;
             
-            // Delete parent data block
-            dbflash_write_data_pattern_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(next_parent_addr), BASE_NODE_SIZE * nodemgmt_node_from_address(next_parent_addr), BASE_NODE_SIZE, 0xFF);
+            // Flag the block containing the parent node
+            uint16_t parent_block = nodemgmt_page_from_address(next_parent_addr) / NODEMGMT_PAGES_PER_BLOCK;
+            touched_blocks[parent_block >> 3] |= (1 << (parent_block & 0x07));
             
             // Set correct next address
             next_parent_addr = temp_address;
         }
     }
+    
+    // Erase each block we flagged
+    for (uint16_t block = PAGE_PER_SECTOR/NODEMGMT_PAGES_PER_BLOCK; block < BLOCK_COUNT; block++)
+    {
+        if ((touched_blocks[block >> 3] & (1 << (block & 0x07))) == 0)
+        {
+            continue;
+        }
+        
+        // Build the block ownership map
+        BOOL block_shared = FALSE;
+        for (uint16_t i = 0; i < NODEMGMT_PAGES_PER_BLOCK; i++)
+        {
+            page_ownership[i] = nodemgmt_get_page_ownership(block*NODEMGMT_PAGES_PER_BLOCK + i);
+            if ((page_ownership[i] & NODEMGMT_PAGE_OWNER_OTHER_USER) != 0)
+            {
+                block_shared = TRUE;
+            }
+        }
+        
+        // Only this user's nodes in this block: one block erase
+        if (block_shared == FALSE)
+        {
+            dbflash_block_erase(&dbflash_descriptor, block);
+            continue;
+        }
+        
+        // Shared block: page erase or individual node wipe
+        for (uint16_t i = 0; i < NODEMGMT_PAGES_PER_BLOCK; i++)
+        {
+            uint16_t page = block*NODEMGMT_PAGES_PER_BLOCK + i;
+            
+            if (page_ownership[i] == NODEMGMT_PAGE_OWNER_CUR_USER)
+            {
+                dbflash_page_erase(&dbflash_descriptor, page);
+            }
+            else if (page_ownership[i] == (NODEMGMT_PAGE_OWNER_CUR_USER|NODEMGMT_PAGE_OWNER_OTHER_USER))
+            {
+                for (uint16_t slot = 0; slot < BYTES_PER_PAGE/BASE_NODE_SIZE; slot++)
+                {
+                    uint16_t slot_flags;
+                    dbflash_read_data_from_flash(&dbflash_descriptor, page, BASE_NODE_SIZE*slot, sizeof(slot_flags), (void*)&slot_flags);
+                    
+                    if ((validBitFromFlags(slot_flags) != NODEMGMT_VBIT_INVALID) && (userIdFromFlags(slot_flags) == nodemgmt_current_handle.currentUserId))
+                    {
+                        dbflash_write_data_pattern_to_flash(&dbflash_descriptor, page, BASE_NODE_SIZE*slot, BASE_NODE_SIZE, 0xFF);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*! \fn     nodemgmt_find_free_node_in_page_window(BOOL child_node, uint16_t start_page)
+*   \brief  Look for a free node slot inside a small window of pages
+*   \param  child_node  TRUE to look for a child node (two consecutive free slots)
+*   \param  start_page  First page of the window
+*   \return Free node address or NODE_ADDR_NULL
+*/
+static uint16_t nodemgmt_find_free_node_in_page_window(BOOL child_node, uint16_t start_page)
+{
+    uint16_t node_flags;
+    
+    if (start_page < PAGE_PER_SECTOR)
+    {
+        start_page = PAGE_PER_SECTOR;
+    }
+    
+    for (uint16_t page_itr = start_page; (page_itr <= start_page + NODEMGMT_COMPACT_PAGE_WINDOW) && (page_itr < PAGE_COUNT); page_itr++)
+    {
+        for (uint16_t node_itr = 0; node_itr < BYTES_PER_PAGE/BASE_NODE_SIZE; node_itr++)
+        {
+            uint16_t candidate_addr = constructAddress(page_itr, node_itr);
+            dbflash_read_data_from_flash(&dbflash_descriptor, page_itr, BASE_NODE_SIZE*node_itr, sizeof(node_flags), &node_flags);
+            
+            if (validBitFromFlags(node_flags) != NODEMGMT_VBIT_INVALID)
+            {
+                continue;
+            }
+            
+            if (child_node == FALSE)
+            {
+                return candidate_addr;
+            }
+            
+            // Child nodes also need the next slot
+            uint16_t next_slot_addr = nodemgmt_get_incremented_address(candidate_addr);
+            if (nodemgmt_page_from_address(next_slot_addr) < PAGE_COUNT)
+            {
+                dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(next_slot_addr), BASE_NODE_SIZE*nodemgmt_node_from_address(next_slot_addr), sizeof(node_flags), &node_flags);
+                
+                if (validBitFromFlags(node_flags) == NODEMGMT_VBIT_INVALID)
+                {
+                    return candidate_addr;
+                }
+            }
+        }
+    }
+    
+    return NODE_ADDR_NULL;
+}
+
+/*! \fn     nodemgmt_update_favorites_address(favorite_addr_t* favorites, uint16_t old_addr, uint16_t new_addr, BOOL child_node)
+*   \brief  Make the favorites pointing to a relocated node point to its new address
+*   \param  favorites   RAM copy of all the user favorites, as returned by nodemgmt_get_favorites
+*   \param  old_addr    Previous node address
+*   \param  new_addr    New node address
+*   \param  child_node  TRUE if the relocated node is a child node
+*   \note   The RAM copy is only used to find the favorites to update, these are written to flash right away
+*/
+static void nodemgmt_update_favorites_address(favorite_addr_t* favorites, uint16_t old_addr, uint16_t new_addr, BOOL child_node)
+{
+    uint16_t nb_favs_per_category = MEMBER_ARRAY_SIZE(nodemgmt_userprofile_t, category_favorites[0].favorite);
+    
+    for (uint16_t i = 0; i < MEMBER_SIZE(nodemgmt_userprofile_t, category_favorites)/(sizeof(favorite_addr_t)); i++)
+    {
+        if ((child_node == FALSE) && (favorites[i].parent_addr == old_addr))
+        {
+            favorites[i].parent_addr = new_addr;
+        }
+        else if ((child_node != FALSE) && (favorites[i].child_addr == old_addr))
+        {
+            favorites[i].child_addr = new_addr;
+        }
+        else
+        {
+            continue;
+        }
+        nodemgmt_set_favorite(i / nb_favs_per_category, i % nb_favs_per_category, favorites[i].parent_addr, favorites[i].child_addr);
+    }
+}
+
+/*! \fn     nodemgmt_update_mirrored_child_address(uint16_t mirror_addr, uint16_t old_addr, uint16_t new_addr)
+*   \brief  Make the mirror of a relocated child node point to its new address
+*   \param  mirror_addr Mirrored node address, as stored in the relocated child node
+*   \param  old_addr    Previous child node address
+*   \param  new_addr    New child node address
+*   \note   The mirror is only updated if it is a valid node of the current user pointing to the old address
+*/
+static void nodemgmt_update_mirrored_child_address(uint16_t mirror_addr, uint16_t old_addr, uint16_t new_addr)
+{
+    uint16_t mirror_fields[4];
+    
+    /* Boundary checks for the buffer we'll use to store start of node data */
+    _Static_assert(sizeof(mirror_fields) == offsetof(child_cred_node_t, mirroredChildAddress) + MEMBER_SIZE(child_cred_node_t, mirroredChildAddress), "Buffer not long enough to store first bytes");
+    
+    if ((mirror_addr == NODE_ADDR_NULL) || (mirror_addr == old_addr) || (nodemgmt_page_from_address(mirror_addr) >= PAGE_COUNT))
+    {
+        return;
+    }
+    
+    // Read without user permission lock: the mirror address comes from the node, not from a browsed list
+    dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(mirror_addr), BASE_NODE_SIZE * nodemgmt_node_from_address(mirror_addr), sizeof(mirror_fields), (void*)mirror_fields);
+    child_cred_node_t* mirror_pt = (child_cred_node_t*)mirror_fields;
+    
+    if ((validBitFromFlags(mirror_pt->flags) != NODEMGMT_VBIT_INVALID) && (userIdFromFlags(mirror_pt->flags) == nodemgmt_current_handle.currentUserId) && (mirror_pt->mirroredChildAddress == old_addr))
+    {
+        nodemgmt_write_node_address_field(mirror_addr, offsetof(child_cred_node_t, mirroredChildAddress), new_addr);
+    }
+}
+
+/*! \fn     nodemgmt_compact_relocate_node(uint16_t node_addr, uint16_t target_page, uint16_t parent_addr, uint16_t credential_type_id, favorite_addr_t* favorites)
+*   \brief  Move a node close to a target page if it isn't already and if there's space there
+*   \param  node_addr           Address of the node to relocate
+*   \param  target_page         Page the node should be stored at (or right after)
+*   \param  parent_addr         Parent address for a child node, NODE_ADDR_NULL when relocating a parent node
+*   \param  credential_type_id  Credential type ID of the parent node
+*   \param  favorites           RAM copy of the user favorites, kept in sync with flash
+*   \return The node address, new or not
+*   \note   The copy is written first, then the pointers are updated, then the old node is erased: 
+*   \note   a power loss at any step leaves a browsable database, at worst with an orphan node copy
+*/
+static uint16_t nodemgmt_compact_relocate_node(uint16_t node_addr, uint16_t target_page, uint16_t parent_addr, uint16_t credential_type_id, favorite_addr_t* favorites)
+{
+    BOOL is_child_node = (parent_addr == NODE_ADDR_NULL) ? FALSE : TRUE;
+    uint16_t node_page = nodemgmt_page_from_address(node_addr);
+    child_node_t temp_node;
+    
+    // Already where it should be?
+    if ((node_page >= target_page) && (node_page <= target_page + NODEMGMT_COMPACT_PAGE_WINDOW))
+    {
+        return node_addr;
+    }
+    
+    // Space available there?
+    uint16_t new_addr = nodemgmt_find_free_node_in_page_window(is_child_node, target_page);
+    if (new_addr == NODE_ADDR_NULL)
+    {
+        return node_addr;
+    }
+    
+    // Write the node copy
+    if (is_child_node == FALSE)
+    {
+        nodemgmt_read_parent_node(node_addr, (parent_node_t*)&temp_node, FALSE);
+        nodemgmt_write_parent_node_data_block_to_flash(new_addr, (parent_node_t*)&temp_node);
+    }
+    else
+    {
+        nodemgmt_read_child_node_data_block_from_flash(node_addr, &temp_node);
+        nodemgmt_check_user_perm_from_flags_and_lock(temp_node.cred_child.flags);
+        nodemgmt_write_child_node_block_to_flash(new_addr, &temp_node, FALSE);
+    }
+    
+    // Parent nodes & cred / webauthn child nodes share the same first fields
+    node_common_first_three_fields_t* first_three_fields_pt = (node_common_first_three_fields_t*)&temp_node;
+    
+    // Update previous node (or parent / start address)
+    if (first_three_fields_pt->prevAddress != NODE_ADDR_NULL)
+    {
+        nodemgmt_write_node_address_field(first_three_fields_pt->prevAddress, offsetof(node_common_first_three_fields_t, nextAddress), new_addr);
+    }
+    else if (is_child_node == FALSE)
+    {
+        nodemgmt_set_cred_start_address(new_addr, credential_type_id);
+    }
+    else
+    {
+        nodemgmt_write_node_address_field(parent_addr, offsetof(parent_cred_node_t, nextChildAddress), new_addr);
+    }
+    
+    // Update next node
+    if (first_three_fields_pt->nextAddress != NODE_ADDR_NULL)
+    {
+        nodemgmt_write_node_address_field(first_three_fields_pt->nextAddress, offsetof(node_common_first_three_fields_t, prevAddress), new_addr);
+    }
+    
+    // Update favorites
+    nodemgmt_update_favorites_address(favorites, node_addr, new_addr, is_child_node);
+    
+    // Update mirrored node
+    if (is_child_node != FALSE)
+    {
+        nodemgmt_update_mirrored_child_address(temp_node.cred_child.mirroredChildAddress, node_addr, new_addr);
+    }
+    
+    // Nothing points to the old node anymore: erase it
+    dbflash_write_data_pattern_to_flash(&dbflash_descriptor, node_page, BASE_NODE_SIZE * nodemgmt_node_from_address(node_addr), BASE_NODE_SIZE, 0xFF);
+    if (is_child_node != FALSE)
+    {
+        dbflash_write_data_pattern_to_flash(&dbflash_descriptor, nodemgmt_page_from_address(nodemgmt_get_incremented_address(node_addr)), BASE_NODE_SIZE * nodemgmt_node_from_address(nodemgmt_get_incremented_address(node_addr)), BASE_NODE_SIZE, 0xFF);
+    }
+    
+    return new_addr;
+}
+
+/*! \fn     nodemgmt_get_cred_db_page_touches(void)
+*   \brief  Count the number of page changes needed to browse all the credential parents & children of the current user
+*   \return Number of page changes
+*   \note   Mimics what a service list / login list browsing does: reading the first bytes of each node in listing order
+*/
+uint16_t nodemgmt_get_cred_db_page_touches(void)
+{
+    uint16_t last_page_read = PAGE_COUNT;
+    uint16_t nb_page_touches = 0;
+    uint16_t temp_buffer[4];
+    parent_cred_node_t* parent_node_pt = (parent_cred_node_t*)temp_buffer;
+    node_common_first_three_fields_t* child_node_pt = (node_common_first_three_fields_t*)temp_buffer;
+    
+    /* Boundary checks for the buffer we'll use to store start of node data */
+    _Static_assert(sizeof(temp_buffer) >= offsetof(parent_cred_node_t, nextChildAddress) + sizeof(parent_node_pt->nextChildAddress), "Buffer not long enough to store first bytes");
+    
+    for (uint16_t i = 0; i < MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes); i++)
+    {
+        uint16_t next_parent_addr = nodemgmt_current_handle.firstCredParentNodes[i];
+        
+        while (next_parent_addr != NODE_ADDR_NULL)
+        {
+            if (nodemgmt_page_from_address(next_parent_addr) != last_page_read)
+            {
+                last_page_read = nodemgmt_page_from_address(next_parent_addr);
+                nb_page_touches++;
+            }
+            
+            dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(next_parent_addr), BASE_NODE_SIZE * nodemgmt_node_from_address(next_parent_addr), sizeof(temp_buffer), (void*)parent_node_pt);
+            nodemgmt_check_user_perm_from_flags_and_lock(parent_node_pt->flags);
+            uint16_t next_child_addr = parent_node_pt->nextChildAddress;
+            next_parent_addr = parent_node_pt->nextParentAddress;
+            
+            while (next_child_addr != NODE_ADDR_NULL)
+            {
+                if (nodemgmt_page_from_address(next_child_addr) != last_page_read)
+                {
+                    last_page_read = nodemgmt_page_from_address(next_child_addr);
+                    nb_page_touches++;
+                }
+                
+                dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(next_child_addr), BASE_NODE_SIZE * nodemgmt_node_from_address(next_child_addr), sizeof(node_common_first_three_fields_t), (void*)child_node_pt);
+                nodemgmt_check_user_perm_from_flags_and_lock(child_node_pt->flags);
+                next_child_addr = child_node_pt->nextAddress;
+            }
+        }
+    }
+    
+    return nb_page_touches;
+}
+
+/*! \fn     nodemgmt_compact_credential_database(void)
+*   \brief  Relocate the current user credential nodes so that each node is stored on (or right after) the page of the node browsed before it
+*   \return Number of relocated nodes
+*   \note   Nodes are only moved to free slots close to their predecessor, there's no node swapping: several passes may improve locality further
+*   \note   To be called in management mode only
+*/
+uint16_t nodemgmt_compact_credential_database(void)
+{
+    uint16_t nb_relocated_nodes = 0;
+    uint16_t target_page = PAGE_COUNT;
+    node_common_first_three_fields_t child_fields;
+    favorite_addr_t favorites[MEMBER_SIZE(nodemgmt_userprofile_t, category_favorites)/(sizeof(favorite_addr_t))];
+    uint16_t temp_buffer[4];
+    parent_cred_node_t* parent_node_pt = (parent_cred_node_t*)temp_buffer;
+    
+    /* Boundary checks for the buffer we'll use to store start of node data */
+    _Static_assert(sizeof(temp_buffer) >= offsetof(parent_cred_node_t, nextChildAddress) + sizeof(parent_node_pt->nextChildAddress), "Buffer not long enough to store first bytes");
+    
+    // Favorites are read once here, so that relocating a node doesn't scan them in flash
+    nodemgmt_get_favorites((uint16_t*)favorites);
+    
+    for (uint16_t i = 0; i < MEMBER_ARRAY_SIZE(nodemgmtHandle_t, firstCredParentNodes); i++)
+    {
+        uint16_t parent_addr = nodemgmt_current_handle.firstCredParentNodes[i];
+        
+        while (parent_addr != NODE_ADDR_NULL)
+        {
+            // Parent node should follow the last node we browsed
+            uint16_t new_parent_addr = nodemgmt_compact_relocate_node(parent_addr, target_page, NODE_ADDR_NULL, i, favorites);
+            if (new_parent_addr != parent_addr)
+            {
+                nb_relocated_nodes++;
+            }
+            parent_addr = new_parent_addr;
+            target_page = nodemgmt_page_from_address(parent_addr);
+            
+            // Read its first bytes (pointers may have been updated by previous relocations)
+            dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(parent_addr), BASE_NODE_SIZE * nodemgmt_node_from_address(parent_addr), sizeof(temp_buffer), (void*)parent_node_pt);
+            nodemgmt_check_user_perm_from_flags_and_lock(parent_node_pt->flags);
+            uint16_t child_addr = parent_node_pt->nextChildAddress;
+            
+            // Then its children
+            while (child_addr != NODE_ADDR_NULL)
+            {
+                uint16_t new_child_addr = nodemgmt_compact_relocate_node(child_addr, target_page, parent_addr, i, favorites);
+                if (new_child_addr != child_addr)
+                {
+                    nb_relocated_nodes++;
+                }
+                child_addr = new_child_addr;
+                target_page = nodemgmt_page_from_address(nodemgmt_get_incremented_address(child_addr));
+                
+                dbflash_read_data_from_flash(&dbflash_descriptor, nodemgmt_page_from_address(child_addr), BASE_NODE_SIZE * nodemgmt_node_from_address(child_addr), sizeof(child_fields), (void*)&child_fields);
+                child_addr = child_fields.nextAddress;
+            }
+            
+            // Move on to next parent
+            parent_addr = parent_node_pt->nextParentAddress;
+        }
+    }
+    
+    // Let the free node scan start from the beginning again, as slots were freed
+    if (nb_relocated_nodes != 0)
+    {
+        nodemgmt_current_handle.nextParentFreeNode = NODE_ADDR_NULL;
+        nodemgmt_invalidate_parent_summaries();
+        nodemgmt_scan_node_usage();
+        nodemgmt_user_db_changed_actions(FALSE);
+    }
+    
+    return nb_relocated_nodes;
 }
 
 /*! \fn     nodemgmt_create_generic_node(generic_node_t* g, node_type_te node_type, uint16_t firstNodeAddress, uint16_t* newFirstNodeAddress, uint16_t* storedAddress)
@@ -2057,5 +3117,14 @@ RET_TYPE nodemgmt_create_child_node(uint16_t pAddr, child_cred_node_t* c, uint16
         nodemgmt_write_parent_node_data_block_to_flash(pAddr, &nodemgmt_current_handle.temp_parent_node);
     }
     
+    // Keep the parent summary up to date if it is cached
+    nodemgmt_parent_summary_t* summary_pt = nodemgmt_get_parent_summary_slot(pAddr);
+    if ((temprettype == RETURN_OK) && (summary_pt->parent_addr == pAddr) && (summary_pt->first_child_addr == childFirstAddress))
+    {
+        summary_pt->category_bitmask |= (1 << categoryFromFlags(c->flags));
+        summary_pt->first_child_addr = temp_address;
+        summary_pt->nb_children++;
+    }
+    
     return temprettype;
 }  
@@ -24,6 +24,7 @@
 #ifndef NODEMGMT_H_
 #define NODEMGMT_H_
 
+#include <stddef.h>
 #include "platform_defines.h"
 #include "defines.h"
 #include "dbflash.h"
@@ -70,6 +71,18 @@ typedef enum    {NODE_TYPE_PARENT = 0, NODE_TYPE_CHILD = 1, NODE_TYPE_PARENT_DAT
 #define NODEMGMT_CAT_MASK                           0x000F
 #define NODEMGMT_CAT_BITSHIFT                       0
 
+// Page ownership bitmask, used when deleting a user
+#define NODEMGMT_PAGE_OWNER_NONE                    0x00
+#define NODEMGMT_PAGE_OWNER_CUR_USER                0x01
+#define NODEMGMT_PAGE_OWNER_OTHER_USER              0x02
+#define NODEMGMT_PAGES_PER_BLOCK                    (PAGE_COUNT/BLOCK_COUNT)
+
+// Database compaction: a node is considered close to its predecessor if stored on its page or the page(s) after
+#define NODEMGMT_COMPACT_PAGE_WINDOW                1
+
+// Per parent children summary cache, must be a power of 2
+#define NODEMGMT_PARENT_SUMMARY_CACHE_SIZE          64
+
 /* User security settings flags */
 #define USER_SEC_FLG_LOGIN_CONF             0x01
 #define USER_SEC_FLG_PIN_FOR_MMM            0x02
@@ -89,6 +102,21 @@ typedef enum    {NODE_TYPE_PARENT = 0, NODE_TYPE_CHILD = 1, NODE_TYPE_PARENT_DAT
 #if NB_MAX_BONDING_INFORMATION > NB_MAX_BONDING_INFORMATION_TH
     #error "Max number of bonding information too high"
 #endif
+#define NODEMGMT_BTBONDINFO_NB_VUSER_SLOTS          ((NB_MAX_BONDING_INFORMATION+3)/4)  // Each virtual user slot stores 4 bonding information
+
+/*  The remaining virtual user slots are used to store database wear statistics (last slot)... */
+/*  and, when enabled, as spare slots to relocate worn out user profiles                       */
+#define NODEMGMT_WEAR_SPARE_VUSER_SLOT_START        (NODEMGMT_BTBONDINFO_VUSER_SLOT_START+NODEMGMT_BTBONDINFO_NB_VUSER_SLOTS)
+#define NODEMGMT_WEAR_STATS_VUSER_SLOT              (NODEMGMT_BTBONDINFO_VUSER_SLOT_STOP-1)
+#define NODEMGMT_WEAR_NB_SPARE_VUSER_SLOTS          (NODEMGMT_WEAR_STATS_VUSER_SLOT-NODEMGMT_WEAR_SPARE_VUSER_SLOT_START)
+#if NODEMGMT_WEAR_SPARE_VUSER_SLOT_START > NODEMGMT_WEAR_STATS_VUSER_SLOT
+    #error "No virtual user slot left for wear statistics"
+#endif
+#define NODEMGMT_WEAR_STATS_MAGIC                   0x57A7B10C
+#define NODEMGMT_WEAR_COUNT_UNIT                    16          // Stored program counters are in units of 16 page programs
+#define NODEMGMT_WEAR_PROFILE_DEFAULT_SLOT          0xFF
+//#define NODEMGMT_WEAR_PROFILE_RELOCATION                      // Move user profiles to a spare slot once their page got programmed too many times
+#define NODEMGMT_WEAR_PROFILE_RELOC_THRESHOLD       (50000/NODEMGMT_WEAR_COUNT_UNIT)
 
 /* Credential types IDs */
 #define NODEMGMT_STANDARD_CRED_TYPE_ID      0
@@ -311,9 +339,37 @@ typedef struct
     uint8_t host_ltk_random_nb[8];
     uint16_t host_ltk_key_size;
     uint8_t host_csrk_key[16];
-    uint8_t reserved[10];
+    uint16_t tuned_typing_delay;
+    uint8_t reserved[8];
 } nodemgmt_bluetooth_bonding_information_t;
 
+// Database wear statistics, stored in the user profile area of the wear statistics virtual slot
+typedef struct
+{
+    uint32_t magic;
+    uint32_t nb_page_programs;
+    uint32_t nb_page_erases;
+    uint16_t nb_profile_relocations;
+    uint16_t nb_sectors;
+    uint16_t sector_programs[DBFLASH_NB_SECTORS];   // In NODEMGMT_WEAR_COUNT_UNIT
+    uint8_t profile_slots[NB_MAX_USERS];            // Virtual user slot storing a given user profile, NODEMGMT_WEAR_PROFILE_DEFAULT_SLOT for its own
+} nodemgmt_wear_stats_t;
+
+// User profile pages programs, stored in the category strings area of the wear statistics virtual slot
+typedef struct
+{
+    uint16_t profile_programs[NB_MAX_USERS];        // In NODEMGMT_WEAR_COUNT_UNIT, reset on relocation
+} nodemgmt_wear_profile_stats_t;
+
+// Cached summary of a parent node children
+typedef struct
+{
+    uint16_t parent_addr;           // NODE_ADDR_NULL for empty slots
+    uint16_t first_child_addr;      // Parent first child when the summary was computed
+    uint16_t category_bitmask;      // Bit n set when at least one child has category n
+    uint16_t nb_children;
+} nodemgmt_parent_summary_t;
+
 // Node management handle
 typedef struct
 {
@@ -395,6 +451,9 @@ static inline uint16_t nodemgmt_node_from_address(uint16_t addr)
     #endif
 }
 
+/* Read fields first_member to last_member (included) of a node_type node, stored at their offsets in *node_pt */
+#define nodemgmt_read_node_fields(address, node_type, first_member, last_member, node_pt)   nodemgmt_read_node_bytes((address), offsetof(node_type, first_member), offsetof(node_type, last_member) + MEMBER_SIZE(node_type, last_member) - offsetof(node_type, first_member), (void*)(node_pt))
+
 /* Prototypes */
 RET_TYPE nodemgmt_get_bluetooth_bonding_information_for_mac_addr(uint8_t address_resolv_type, uint8_t* mac_address, nodemgmt_bluetooth_bonding_information_t* bonding_information);
 uint16_t nodemgmt_find_free_nodes(uint16_t nbParentNodes, uint16_t* parentNodeArray, uint16_t nbChildtNodes, uint16_t* childNodeArray, uint16_t startPage, uint16_t startNode);
@@ -404,6 +463,7 @@ void nodemgmt_init_context(uint16_t userIdNum, uint16_t* userSecFlags, uint16_t*
 RET_TYPE nodemgmt_get_bluetooth_bonding_information_for_irk(uint8_t* irk_key, nodemgmt_bluetooth_bonding_information_t* bonding_information);
 void nodemgmt_format_user_profile(uint16_t uid, uint16_t secPreferences, uint16_t languageId, uint16_t keyboardId, uint16_t bleKeyboardId);
 void nodemgmt_read_webauthn_child_node(uint16_t address, child_webauthn_node_t* child_node, BOOL update_date_and_increment_preinc_count);
+BOOL nodemgmt_check_for_logins_with_category_in_parent(uint16_t parent_addr, uint16_t first_child_addr, uint16_t category_flags);
 uint16_t nodemgmt_get_prev_parent_node_for_cur_category(uint16_t search_start_parent_addr, uint16_t credential_type_id);
 uint16_t nodemgmt_get_next_parent_node_for_cur_category(uint16_t search_start_parent_addr, uint16_t credential_type_id);
 RET_TYPE nodemgmt_create_parent_node(parent_node_t* p, service_type_te type, uint16_t* storedAddress, uint16_t typeId);
@@ -415,15 +475,23 @@ void nodemgmt_write_child_node_block_to_flash(uint16_t address, child_node_t* ch
 void nodemgmt_set_favorite(uint16_t categoryId, uint16_t favId, uint16_t parentAddress, uint16_t childAddress);
 void nodemgmt_get_bluetooth_bonding_info_starting_offset(uint16_t uid, uint16_t *page, uint16_t *pageOffset);
 void nodemgmt_get_user_category_names_starting_offset(uint16_t uid, uint16_t *page, uint16_t *pageOffset);
+void nodemgmt_read_wear_stats(nodemgmt_wear_stats_t* stats, nodemgmt_wear_profile_stats_t* profile_stats);
+RET_TYPE nodemgmt_store_bluetooth_bonding_typing_delay(uint8_t* mac_address, uint16_t tuned_typing_delay);
 void nodemgmt_get_bluetooth_bonding_information_irks(uint16_t* nb_keys, uint8_t* aggregated_keys_buffer);
+uint16_t nodemgmt_get_number_of_children_in_parent_node(uint16_t parent_addr, uint16_t first_child_addr);
+void nodemgmt_store_data_node(uint16_t parent_address, uint16_t prev_address, uint16_t address, child_data_node_t* data_node);
+void nodemgmt_read_node_bytes(uint16_t address, uint16_t node_offset, uint16_t nb_bytes, void* node);
 void nodemgmt_get_user_profile_starting_offset(uint16_t uid, uint16_t *page, uint16_t *pageOffset);
 RET_TYPE nodemgmt_create_child_node(uint16_t pAddr, child_cred_node_t* c, uint16_t* storedAddress);
 void nodemgmt_read_parent_node_data_block_from_flash(uint16_t address, parent_node_t* parent_node);
+void nodemgmt_read_cred_child_node_login_and_desc(uint16_t address, child_cred_node_t* child_node);
+void nodemgmt_read_cred_child_node_no_date_update(uint16_t address, child_cred_node_t* child_node);
 void nodemgmt_write_parent_node_data_block_to_flash(uint16_t address, parent_node_t* parent_node);
 void nodemgmt_read_child_node_data_block_from_flash(uint16_t address, child_node_t* child_node);
 void nodemgmt_read_cred_child_node_except_pwd(uint16_t address, child_cred_node_t* child_node);
 void nodemgmt_read_parent_node(uint16_t address, parent_node_t* parent_node, BOOL data_clean);
 void nodemgmt_set_cred_start_address(uint16_t parentAddress, uint16_t credential_type_id);
+uint16_t nodemgmt_reserve_free_child_nodes(uint16_t nb_nodes, uint16_t* child_node_array);
 uint16_t nodemgmt_get_prev_child_node_for_cur_category(uint16_t search_start_child_addr);
 uint16_t nodemgmt_get_next_child_node_for_cur_category(uint16_t search_start_child_addr);
 uint16_t nodemgmt_get_starting_parent_addr_for_category(uint16_t credential_type_id);
@@ -432,12 +500,14 @@ void nodemgmt_read_cred_child_node(uint16_t address, child_cred_node_t* child_no
 void nodemgmt_set_data_start_address(uint16_t dataParentAddress, uint16_t typeId);
 void nodemgmt_get_category_strings(nodemgmt_user_category_strings_t* strings_pt);
 void nodemgmt_set_category_strings(nodemgmt_user_category_strings_t* strings_pt);
+RET_TYPE nodemgmt_read_data_node(uint16_t address, child_data_node_t* data_node);
 void nodemgmt_get_category_string(uint16_t category_id, cust_char_t* string_pt);
 void nodemgmt_set_category_string(uint16_t category_id, cust_char_t* string_pt);
 uint16_t nodemgmt_construct_date(uint16_t year, uint16_t month, uint16_t day);
 int16_t nodemgmt_get_next_non_null_favorite_before_index(uint16_t favId);
 int16_t nodemgmt_get_next_non_null_favorite_after_index(uint16_t favId);
 uint16_t nodemgmt_get_starting_parent_addr(uint16_t credential_type_id);
+void nodemgmt_update_cred_child_node_date_last_used(uint16_t address);
 void nodemgmt_store_user_sec_preferences(uint16_t sec_preferences);
 void nodemgmt_check_user_perm_from_flags_and_lock(uint16_t flags);
 uint16_t nodemgmt_get_start_addresses(uint16_t* addresses_array);
@@ -453,10 +523,15 @@ void nodemgmt_user_db_changed_actions(BOOL dataChanged);
 void nodemgmt_store_user_language(uint16_t languageId);
 void nodemgmt_store_user_ble_layout(uint16_t layoutId);
 void nodemgmt_set_current_category_id(uint16_t catId);
+void nodemgmt_wear_stats_flush(BOOL allow_relocation);
+uint16_t nodemgmt_compact_credential_database(void);
 void nodemgmt_delete_current_user_from_flash(void);
 uint16_t nodemgmt_get_current_category_flags(void);
 void nodemgmt_store_user_layout(uint16_t layoutId);
+void nodemgmt_delete_data_nodes(uint16_t address);
 uint16_t nodemgmt_get_user_sec_preferences(void);
+uint16_t nodemgmt_get_cred_db_page_touches(void);
+void nodemgmt_invalidate_parent_summaries(void);
 uint32_t nodemgmt_get_cred_change_number(void);
 uint32_t nodemgmt_get_data_change_number(void);
 void nodemgmt_set_current_date(uint16_t date);
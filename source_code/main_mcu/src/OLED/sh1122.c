@@ -541,7 +541,7 @@ void sh1122_check_for_flush_and_terminate(sh1122_descriptor_t* oled_descriptor)
     if (oled_descriptor->frame_buffer_flush_in_progress != FALSE)
     {        
         /* Wait for data to be transferred */
-        while(dma_oled_check_and_clear_dma_transfer_flag() == FALSE);
+        timer_wait_for_event(dma_oled_check_and_clear_dma_transfer_flag);
 
         /* Wait for spi buffer to be sent */
         sercom_spi_wait_for_transmit_complete(oled_descriptor->sercom_pt);
@@ -1381,7 +1381,7 @@ void sh1122_draw_full_screen_image_from_bitstream(sh1122_descriptor_t* oled_desc
             bitstream_bitmap_array_read(bitstream, pixel_buffer[(buffer_sel+1)&0x01], sizeof(pixel_buffer[0])*2);
             
             /* Wait for transfer done */
-            while(dma_oled_check_and_clear_dma_transfer_flag() == FALSE);
+            timer_wait_for_event(dma_oled_check_and_clear_dma_transfer_flag);
             
             /* Init DMA transfer */
             buffer_sel = (buffer_sel+1) & 0x01;
@@ -1389,7 +1389,7 @@ void sh1122_draw_full_screen_image_from_bitstream(sh1122_descriptor_t* oled_desc
         }
         
         /* Wait for data to be transferred */
-        while(dma_oled_check_and_clear_dma_transfer_flag() == FALSE);
+        timer_wait_for_event(dma_oled_check_and_clear_dma_transfer_flag);
     #else        
         uint8_t pixel_buffer[16];
         
@@ -1557,7 +1557,7 @@ void sh1122_draw_image_from_bitstream(sh1122_descriptor_t* oled_descriptor, int1
             if ((y+j >= oled_descriptor->min_disp_y) && (y+j <= oled_descriptor->max_disp_y))
             { 
                 /* Wait for transfer done */
-                while(dma_oled_check_and_clear_dma_transfer_flag() == FALSE);
+                timer_wait_for_event(dma_oled_check_and_clear_dma_transfer_flag);
                 
                 /* Wait for spi buffer to be sent */
                 sercom_spi_wait_for_transmit_complete(oled_descriptor->sercom_pt);
@@ -20,6 +20,7 @@
  * Created: 19/04/2017 09:39:16
  *  Author: stephan
  */ 
+#include <string.h>
 #include <asf.h>
 #include "smartcard_lowlevel.h"
 #include "platform_defines.h"
@@ -43,6 +44,11 @@ static int rtc_offset;
 volatile timerEntry_t context_timers[TOTAL_NUMBER_OF_TIMERS];
 /* System tick */
 volatile uint32_t sysTick;
+#if defined(DEBUG_USB_COMMANDS_ENABLED) && !defined(EMULATOR_BUILD) && !defined(BOOTLOADER)
+/* Time spent in event waits, asleep or not, for each power source */
+timer_wait_stats_t timer_wait_stats[TIMER_WAIT_STATS_NB_POWER_SOURCES];
+_Static_assert(TRANSITIONING_TO_BATTERY_POWER + 1 == TIMER_WAIT_STATS_NB_POWER_SOURCES, "Wait stats array doesn't cover all power sources");
+#endif
 
 #ifndef EMULATOR_BUILD
 /*! \fn     TCC0_Handler(void)
@@ -181,6 +187,9 @@ void timer_initialize_timebase(void)
     TCC2->CTRLA = tcc_ctrl_reg;                                         // Write register
     TCC2->INTENSET.reg = TCC_INTENSET_OVF;                              // Enable overflow interrupt
     NVIC_EnableIRQ(TCC2_IRQn);                                          // Enable int
+    
+    /* Event waits: only stop the CPU clock when going to sleep, DMA and SERCOMs keep running */
+    PM->SLEEP.reg = PM_SLEEP_IDLE_CPU;
 #endif
 }
 
@@ -364,5 +373,133 @@ uint32_t timer_get_timer_val(timer_id_te uid)
 void timer_delay_ms(uint32_t ms)
 {
     timer_start_timer(TIMER_WAIT_FUNCTS, ms+1);
-    while(timer_has_timer_expired(TIMER_WAIT_FUNCTS, TRUE) != TIMER_EXPIRED);
+    timer_wait_for_event_or_timer_expiry(0, TIMER_WAIT_FUNCTS);
+    timer_has_timer_expired(TIMER_WAIT_FUNCTS, TRUE);
+}
+
+#if defined(DEBUG_USB_COMMANDS_ENABLED) && !defined(EMULATOR_BUILD) && !defined(BOOTLOADER)
+/*! \fn     timer_get_wait_timestamp_us(void)
+*   \brief  Get a us timestamp from the ms tick and TCC0 counter
+*   \note   Must be called with interrupts disabled
+*   \return us timestamp, wrapping around
+*/
+static uint32_t timer_get_wait_timestamp_us(void)
+{
+    /* Request COUNT read synchronization */
+    TCC0->CTRLBSET.reg = TCC_CTRLBSET_CMD_READSYNC;
+    while ((TCC0->SYNCBUSY.reg & (TCC_SYNCBUSY_CTRLB | TCC_SYNCBUSY_COUNT)) != 0);
+    uint32_t tcc_count = TCC0->COUNT.reg;
+    uint32_t ms_tick = sysTick;
+    
+    /* Overflow interrupt pending but not yet serviced */
+    if (((TCC0->INTFLAG.reg & TCC_INTFLAG_OVF) != 0) && (tcc_count < (48000/2)))
+    {
+        ms_tick++;
+    }
+    
+    return ms_tick*1000 + tcc_count/48;
+}
+#endif
+
+/*! \fn     timer_wait_for_event_or_timer_expiry(BOOL (*event_check_fct)(void), timer_id_te timer_id)
+*   \brief  Wait for an interrupt-driven event or a timer expiry, putting the core to sleep in between
+*   \param  event_check_fct     Event check function (may clear the event), or 0 to only wait for the timer
+*   \param  timer_id            Timeout timer, or TOTAL_NUMBER_OF_TIMERS to wait for the event only
+*   \return TRUE if the event happened, FALSE if the timer expired
+*   \note   The check is done with interrupts masked before each WFI so an interrupt setting the event can't be missed
+*   \note   The 1ms tick interrupt wakes up the core, making timer expiry checks possible
+*/
+BOOL timer_wait_for_event_or_timer_expiry(BOOL (*event_check_fct)(void), timer_id_te timer_id)
+{
+#if defined(EMULATOR_BUILD) || defined(BOOTLOADER)
+    while (TRUE)
+    {
+        if ((event_check_fct != 0) && (event_check_fct() != FALSE))
+        {
+            return TRUE;
+        }
+        if ((timer_id != TOTAL_NUMBER_OF_TIMERS) && (timer_has_timer_expired(timer_id, FALSE) == TIMER_EXPIRED))
+        {
+            return FALSE;
+        }
+    }
+#else
+    BOOL return_val;
+    
+    #ifdef DEBUG_USB_COMMANDS_ENABLED
+    uint32_t asleep_us = 0;
+    irqflags_t stats_irq_flags = cpu_irq_save();
+    uint32_t wait_start_us = timer_get_wait_timestamp_us();
+    cpu_irq_restore(stats_irq_flags);
+    #endif
+    
+    while (TRUE)
+    {
+        irqflags_t irq_flags = cpu_irq_save();
+        
+        if ((event_check_fct != 0) && (event_check_fct() != FALSE))
+        {
+            cpu_irq_restore(irq_flags);
+            return_val = TRUE;
+            break;
+        }
+        if ((timer_id != TOTAL_NUMBER_OF_TIMERS) && (timer_has_timer_expired(timer_id, FALSE) == TIMER_EXPIRED))
+        {
+            cpu_irq_restore(irq_flags);
+            return_val = FALSE;
+            break;
+        }
+        
+        #ifdef DEBUG_USB_COMMANDS_ENABLED
+        uint32_t sleep_start_us = timer_get_wait_timestamp_us();
+        #endif
+        
+        /* Sleep until next interrupt: a pending one wakes the core even when masked, it is then serviced when unmasking */
+        SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+        __DSB();
+        __WFI();
+        
+        #ifdef DEBUG_USB_COMMANDS_ENABLED
+        asleep_us += timer_get_wait_timestamp_us() - sleep_start_us;
+        #endif
+        
+        cpu_irq_restore(irq_flags);
+    }
+    
+    #ifdef DEBUG_USB_COMMANDS_ENABLED
+    stats_irq_flags = cpu_irq_save();
+    timer_wait_stats_t* stats_pt = &timer_wait_stats[logic_power_get_power_source()];
+    stats_pt->total_wait_us += timer_get_wait_timestamp_us() - wait_start_us;
+    stats_pt->asleep_us += asleep_us;
+    stats_pt->nb_waits++;
+    cpu_irq_restore(stats_irq_flags);
+    #endif
+    
+    return return_val;
+#endif
+}
+
+/*! \fn     timer_wait_for_event(BOOL (*event_check_fct)(void))
+*   \brief  Wait for an interrupt-driven event, putting the core to sleep in between
+*   \param  event_check_fct     Event check function (may clear the event)
+*/
+void timer_wait_for_event(BOOL (*event_check_fct)(void))
+{
+    timer_wait_for_event_or_timer_expiry(event_check_fct, TOTAL_NUMBER_OF_TIMERS);
+}
+
+/*! \fn     timer_get_and_reset_wait_stats(timer_wait_stats_t* stats_pt)
+*   \brief  Get and reset the event wait statistics
+*   \param  stats_pt    Pointer to an array of TIMER_WAIT_STATS_NB_POWER_SOURCES stats, indexed by power source
+*/
+void timer_get_and_reset_wait_stats(timer_wait_stats_t* stats_pt)
+{
+#if defined(DEBUG_USB_COMMANDS_ENABLED) && !defined(EMULATOR_BUILD) && !defined(BOOTLOADER)
+    cpu_irq_enter_critical();
+    memcpy(stats_pt, timer_wait_stats, sizeof(timer_wait_stats));
+    memset(timer_wait_stats, 0, sizeof(timer_wait_stats));
+    cpu_irq_leave_critical();
+#else
+    memset(stats_pt, 0, sizeof(timer_wait_stats_t)*TIMER_WAIT_STATS_NB_POWER_SOURCES);
+#endif
 }
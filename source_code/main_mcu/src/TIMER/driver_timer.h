@@ -35,6 +35,13 @@ typedef struct
     uint32_t flag;
 } timerEntry_t;
 
+typedef struct
+{
+    uint32_t nb_waits;
+    uint32_t total_wait_us;
+    uint32_t asleep_us;
+} timer_wait_stats_t;
+
 /* Typedefs */
 typedef RTC_MODE2_CLOCK_Type calendar_t;
 
@@ -42,6 +49,9 @@ typedef RTC_MODE2_CLOCK_Type calendar_t;
 typedef enum {TIMER_WAIT_FUNCTS = 0, TIMER_TIMEOUT_FUNCTS = 1, TIMER_USER_INTERACTION = 2, TIMER_SCROLLING = 3, TIMER_ANIMATIONS = 4, TIMER_SCREEN = 5, TIMER_CHECK_PASSWORD = 6, TIMER_BATTERY_ANIM = 7, TIMER_HANDED_MODE_CHANGE = 8, TIMER_AUX_MCU_FLOOD = 9, TIMER_ADC_WATCHDOG = 10, TIMER_DEVICE_ACTION_TIMEOUT = 11, TOTAL_NUMBER_OF_TIMERS} timer_id_te;
 typedef enum {TIMER_EXPIRED = 0, TIMER_RUNNING = 1} timer_flag_te;
     
+/* Defines */
+#define TIMER_WAIT_STATS_NB_POWER_SOURCES   3
+
 /* Macros */
 #ifdef EMULATOR_BUILD
 #include <unistd.h>
@@ -62,7 +72,10 @@ typedef enum {TIMER_EXPIRED = 0, TIMER_RUNNING = 1} timer_flag_te;
 
 /* Prototypes */
 void timer_set_calendar(uint16_t year, uint16_t month, uint16_t day, uint16_t hour, uint16_t minute, uint16_t second);
+BOOL timer_wait_for_event_or_timer_expiry(BOOL (*event_check_fct)(void), timer_id_te timer_id);
 timer_flag_te timer_has_timer_expired(timer_id_te uid, BOOL clear);
+void timer_get_and_reset_wait_stats(timer_wait_stats_t* stats_pt);
+void timer_wait_for_event(BOOL (*event_check_fct)(void));
 void timer_start_timer(timer_id_te uid, uint32_t val);
 void timer_get_calendar(calendar_t* calendar_pt);
 uint32_t timer_get_timer_val(timer_id_te uid);
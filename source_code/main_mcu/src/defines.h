@@ -27,6 +27,8 @@
 
 /* Defines */
 #define AUX_MCU_MESSAGE_REPLY_TIMEOUT_MS    500
+#define AUX_MCU_CREDITS_REQUEST_TIMEOUT_MS  20
+#define AUX_MCU_DROPPED_MSG_MAX_RESENDS     3
 
 /* Fonts defines */
 #define FONT_UBUNTU_MONO_BOLD_30_ID 0
@@ -75,6 +77,7 @@ typedef enum    {DISP_MSG_INFO = 0, DISP_MSG_WARNING = 1, DISP_MSG_ACTION = 2} d
 typedef enum    {RETURN_REL = 0, RETURN_DET, RETURN_JDETECT, RETURN_JRELEASED} det_ret_type_te;
 typedef enum    {CUSTOM_FS_INIT_OK = 0, CUSTOM_FS_INIT_NO_RWEE = 1} custom_fs_init_ret_type_te;
 typedef enum    {COMPARE_MODE_MATCH = 0, COMPARE_MODE_COMPARE = 1} service_compare_mode_te;
+typedef enum    {SEARCH_MODE_PREFIX = 0, SEARCH_MODE_SUBSTRING = 1} service_search_mode_te;
 typedef enum    {RETURN_BACK = -2, RETURN_NOK = -1, RETURN_OK = 0} ret_type_te;
 typedef enum    {SERVICE_CRED_TYPE, SERVICE_DATA_TYPE} service_type_te;
     
@@ -18,6 +18,7 @@
 #include "gui_prompts.h"
 #include "logic_power.h"
 #include "platform_io.h"
+#include "logic_tasks.h"
 #include "logic_user.h"
 #include "custom_fs.h"
 #include "dataflash.h"
@@ -244,12 +245,14 @@ void main_platform_init(void)
         while(1);
     }
     
+    /* We may have rebooted while the aux MCU was using variable length frames: get it back to fixed size frames */
+    comms_aux_mcu_reset_framing();
+    
     /* Is Aux MCU present? */
     if (comms_aux_mcu_send_receive_ping() != RETURN_OK)
     {
         /* Try to reset our comms link */
-        dma_aux_mcu_disable_transfer();
-        comms_aux_arm_rx_and_clear_no_comms();
+        comms_aux_mcu_reset_framing();
         
         /* Try again */
         if (comms_aux_mcu_send_receive_ping() != RETURN_OK)
@@ -265,6 +268,9 @@ void main_platform_init(void)
         }
     }
     
+    /* Switch to variable length frames if the aux MCU supports them (link is still idle) */
+    comms_aux_mcu_set_variable_length_framing(TRUE);
+    
     /* If debugger attached, let the aux mcu know it shouldn't use the no comms signal */
     if (debugger_present != FALSE)
     {
@@ -388,12 +394,15 @@ void main_reboot(void)
     
     /* Wait for accelerometer DMA transfer end */
     lis2hh12_check_data_received_flag_and_arm_other_transfer(&plat_acc_descriptor, TRUE);
-    while (dma_acc_check_and_clear_dma_transfer_flag() == FALSE);
+    timer_wait_for_event(dma_acc_check_and_clear_dma_transfer_flag);
     
     /* Power Off OLED screen */
     sh1122_oled_off(&plat_oled_descriptor);
     platform_io_power_down_oled();
     
+    /* Back to fixed size frames, used by our next boot */
+    comms_aux_mcu_set_variable_length_framing(FALSE);
+    
     /* No comms */
     platform_io_set_no_comms();
     
@@ -426,7 +435,7 @@ void main_standby_sleep(void)
     
         /* Wait for accelerometer DMA transfer end and put it to sleep */
         lis2hh12_check_data_received_flag_and_arm_other_transfer(&plat_acc_descriptor, TRUE);
-        while (dma_acc_check_and_clear_dma_transfer_flag() == FALSE);
+        timer_wait_for_event(dma_acc_check_and_clear_dma_transfer_flag);
         lis2hh12_deassert_ncs_and_go_to_sleep(&plat_acc_descriptor);
     
         /* DB & Dataflash power down */
@@ -697,11 +706,8 @@ int main(void)
             comms_aux_mcu_routine(MSG_RESTRICT_ALLBUT_BUNDLE);            
         }
         
-        /* ADC watchdog */
-        if (timer_has_timer_expired(TIMER_ADC_WATCHDOG, TRUE) == TIMER_EXPIRED)
-        {
-            platform_io_get_voledin_conversion_result_and_trigger_conversion();
-        }
+        /* Background tasks: device status update, ADC watchdog, database wear statistics */
+        logic_tasks_run();
         
         /* Accelerometer routine */
         BOOL is_screen_on_copy = sh1122_is_oled_on(&plat_oled_descriptor);
@@ -776,12 +782,6 @@ int main(void)
             }            
         }
         
-        /* Device state changed, inform aux MCU so it can update its buffer */
-        if (logic_device_get_state_changed_and_reset_bool() != FALSE)
-        {
-            comms_aux_mcu_update_device_status_buffer();
-        }
-        
         /* Get current smartcard detection result */
         card_detection_res = smartcard_lowlevel_is_card_plugged();
     }
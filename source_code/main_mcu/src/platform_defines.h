@@ -147,6 +147,7 @@
 
 #if defined(EMULATOR_BUILD)
     #undef DEVELOPER_FEATURES_ENABLED
+    #define AES_CT64_BATCH_BACKEND
 #endif
 
 /* Developer features */
@@ -198,6 +199,8 @@ typedef struct
 /********************/
 #define SCREEN_TIMEOUT_MS       15000
 #define AUX_FLOOD_TIMEOUT_MS    2
+#define USB_STREAM_PACKET_MS    10
+#define BLE_STREAM_PACKET_MS    50
 
 /********************/
 /* Voltage cutout   */
@@ -337,6 +340,8 @@ typedef struct
 #define DMA_DESCID_TX_OLED          4
 #define DMA_DESCID_RX_ACC           5
 #define DMA_DESCID_TX_COMMS         6
+#define DMA_DESCID_RX_DBFLASH       7
+#define DMA_DESCID_TX_DBFLASH       8
 
 /* External interrupts numbers */
 #if defined(PLAT_V1_SETUP) || defined(PLAT_V2_SETUP)